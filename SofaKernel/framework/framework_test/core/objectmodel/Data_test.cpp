@@ -117,6 +117,66 @@ TEST_F(vectorData_test , test_link )
 /////////////////////////////////
 
 
+/** Test suite for the per-aspect storage of Data values
+ */
+struct DataAspectValues_test: public ::testing::Test
+{
+    typedef DataValue<helper::vector<int>, true> ValueType;
+    DataAspectValues<ValueType, 4> values;
+
+    void test_lazyAllocation()
+    {
+        values[0].setValue(helper::vector<int>(3, 1));
+        ASSERT_FALSE(values.hasOtherAspects());
+        values.release(2);
+        ASSERT_FALSE(values.hasOtherAspects());
+
+        // copying to another aspect allocates it and shares the value until it is modified
+        values[2] = values[0];
+        ASSERT_TRUE(values.hasOtherAspects());
+        ASSERT_EQ(&values[2].getValue(), &values[0].getValue());
+        (*values[2].beginEdit())[0] = 2;
+        ASSERT_EQ(values[0].getValue()[0], 1);
+        ASSERT_EQ(values[2].getValue()[0], 2);
+        ASSERT_TRUE(values[3].getValue().empty());
+    }
+};
+
+TEST_F(DataAspectValues_test , lazyAllocation )
+{
+    this->test_lazyAllocation();
+}
+
+
+/////////////////////////////////
+
+
+TEST(DataMemoryFootprint_test, typeAwareSizes)
+{
+    Data<int> dataInt;
+    EXPECT_EQ(sizeof(int), dataInt.getMemoryFootprint());
+
+    Data< helper::vector<double> > dataVector;
+    dataVector.setValue(helper::vector<double>(10, 1.0));
+    EXPECT_EQ(10*sizeof(double), dataVector.getMemoryFootprint());
+
+    Data<std::string> dataString;
+    dataString.setValue("hello");
+    EXPECT_EQ(5u, dataString.getMemoryFootprint());
+
+    helper::vector<std::string> strings;
+    strings.push_back("ab");
+    strings.push_back("cde");
+    Data< helper::vector<std::string> > dataStrings;
+    dataStrings.setValue(strings);
+    const BaseData* baseData = &dataStrings;
+    EXPECT_EQ(5u, baseData->getMemoryFootprint());
+}
+
+
+/////////////////////////////////
+
+
 /** Test suite for DataFileNameVector
  *
  * @author M Nesme @date 2016
@@ -21,6 +21,10 @@
 ******************************************************************************/
 #include <sofa/core/loader/MeshLoader.h>
 #include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
 
 namespace sofa
 {
@@ -803,6 +807,196 @@ void MeshLoader::addPyramid(helper::vector< Pyramid >* pPyramids, const Pyramid&
     pPyramids->push_back(p);
 }
 
+namespace
+{
+
+const char binaryCacheMagic[8] = { 'S','O','F','A','M','E','S','H' };
+const uint32_t binaryCacheVersion = 2;
+
+/// Header of the binary cache, the options of the loader and the arrays follow it
+struct BinaryCacheHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t realSize;
+    uint32_t indexSize;
+    uint32_t reserved;
+    uint64_t key;
+};
+
+template<class T>
+bool writeArray(std::ofstream& out, const helper::vector<T>& v)
+{
+    const uint64_t n = v.size();
+    out.write((const char*)&n, sizeof(n));
+    if (n) out.write((const char*)v.data(), n*sizeof(T));
+    return out.good();
+}
+
+template<class T>
+bool readArray(std::ifstream& in, Data< helper::vector<T> >& d)
+{
+    uint64_t n = 0;
+    if (!in.read((char*)&n, sizeof(n))) return false;
+    helper::vector<T>& v = *d.beginWriteOnly();
+    v.resize((std::size_t)n);
+    if (n) in.read((char*)v.data(), n*sizeof(T)); // straight into the Data
+    d.endEdit();
+    return in.good();
+}
+
+bool writeGroups(std::ofstream& out, const helper::vector<PrimitiveGroup>& groups)
+{
+    const uint64_t n = groups.size();
+    out.write((const char*)&n, sizeof(n));
+    for (std::size_t i = 0; i < groups.size(); ++i)
+    {
+        const PrimitiveGroup& g = groups[i];
+        const int32_t values[3] = { g.p0, g.nbp, g.materialId };
+        out.write((const char*)values, sizeof(values));
+        const uint32_t sizes[2] = { (uint32_t)g.materialName.size(), (uint32_t)g.groupName.size() };
+        out.write((const char*)sizes, sizeof(sizes));
+        out.write(g.materialName.data(), sizes[0]);
+        out.write(g.groupName.data(), sizes[1]);
+    }
+    return out.good();
+}
+
+bool readGroups(std::ifstream& in, Data< helper::vector<PrimitiveGroup> >& d)
+{
+    uint64_t n = 0;
+    if (!in.read((char*)&n, sizeof(n))) return false;
+    helper::vector<PrimitiveGroup>& groups = *d.beginWriteOnly();
+    groups.resize((std::size_t)n);
+    for (std::size_t i = 0; i < groups.size() && in.good(); ++i)
+    {
+        PrimitiveGroup& g = groups[i];
+        int32_t values[3];
+        uint32_t sizes[2];
+        in.read((char*)values, sizeof(values));
+        in.read((char*)sizes, sizeof(sizes));
+        if (!in.good()) break;
+        g.p0 = values[0]; g.nbp = values[1]; g.materialId = values[2];
+        g.materialName.resize(sizes[0]);
+        g.groupName.resize(sizes[1]);
+        if (sizes[0]) in.read(&g.materialName[0], sizes[0]);
+        if (sizes[1]) in.read(&g.groupName[0], sizes[1]);
+    }
+    d.endEdit();
+    return in.good();
+}
+
+/// Options of the loader stored in the cache, a cache written with other options is ignored
+std::string binaryCacheOptions(const std::string& className, bool flipNormals, bool triangulate, const std::string& options)
+{
+    std::ostringstream out;
+    out << className << " flipNormals=" << flipNormals << " triangulate=" << triangulate << " " << options;
+    return out.str();
+}
+
+bool writeString(std::ofstream& out, const std::string& s)
+{
+    const uint32_t n = (uint32_t)s.size();
+    out.write((const char*)&n, sizeof(n));
+    out.write(s.data(), n);
+    return out.good();
+}
+
+bool readString(std::ifstream& in, std::string& s)
+{
+    uint32_t n = 0;
+    if (!in.read((char*)&n, sizeof(n)) || n > (1u<<16)) return false;
+    s.resize(n);
+    if (n) in.read(&s[0], n);
+    return in.good();
+}
+
+} // namespace
+
+std::string MeshLoader::getBinaryCacheFilename(const std::string& filename)
+{
+    return filename + ".sofacache";
+}
+
+bool MeshLoader::readBinaryCache(const std::string& filename, uint64_t key, const std::string& options)
+{
+    std::ifstream in(getBinaryCacheFilename(filename).c_str(), std::ios::in | std::ios::binary);
+    if (!in.is_open())
+        return false;
+
+    BinaryCacheHeader header;
+    if (!in.read((char*)&header, sizeof(header))
+            || std::memcmp(header.magic, binaryCacheMagic, sizeof(binaryCacheMagic))
+            || header.version != binaryCacheVersion
+            || header.realSize != sizeof(SReal) || header.indexSize != sizeof(PointID)
+            || header.key != key)
+        return false;
+    std::string cacheOptions;
+    if (!readString(in, cacheOptions)
+            || cacheOptions != binaryCacheOptions(getClassName(), d_flipNormals.getValue(), d_triangulate.getValue(), options))
+        return false;
+
+    if (readArray(in, d_positions) && readArray(in, d_normals)
+            && readArray(in, d_edges) && readArray(in, d_triangles) && readArray(in, d_quads)
+            && readGroups(in, d_edgesGroups) && readGroups(in, d_trianglesGroups) && readGroups(in, d_quadsGroups))
+    {
+        msg_info() << "Mesh read from the binary cache " << getBinaryCacheFilename(filename);
+        return true;
+    }
+
+    // the outputs read before the error are dropped, the mesh file reader starts from empty ones
+    d_positions.beginWriteOnly()->clear(); d_positions.endEdit();
+    d_normals.beginWriteOnly()->clear(); d_normals.endEdit();
+    d_edges.beginWriteOnly()->clear(); d_edges.endEdit();
+    d_triangles.beginWriteOnly()->clear(); d_triangles.endEdit();
+    d_quads.beginWriteOnly()->clear(); d_quads.endEdit();
+    d_edgesGroups.beginWriteOnly()->clear(); d_edgesGroups.endEdit();
+    d_trianglesGroups.beginWriteOnly()->clear(); d_trianglesGroups.endEdit();
+    d_quadsGroups.beginWriteOnly()->clear(); d_quadsGroups.endEdit();
+
+    msg_warning() << "Invalid binary cache " << getBinaryCacheFilename(filename) << ", the mesh file is read instead.";
+    return false;
+}
+
+bool MeshLoader::writeBinaryCache(const std::string& filename, uint64_t key, const std::string& options)
+{
+    // written under a temporary name first, so that a concurrent reader never sees a partial file
+    const std::string cacheFilename = getBinaryCacheFilename(filename);
+    const std::string tmpFilename = cacheFilename + ".tmp";
+    bool written = false;
+    {
+        std::ofstream out(tmpFilename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!out.is_open())
+        {
+            msg_info() << "Cannot write the binary cache " << cacheFilename;
+            return false;
+        }
+
+        BinaryCacheHeader header;
+        std::memcpy(header.magic, binaryCacheMagic, sizeof(binaryCacheMagic));
+        header.version = binaryCacheVersion;
+        header.realSize = sizeof(SReal);
+        header.indexSize = sizeof(PointID);
+        header.reserved = 0;
+        header.key = key;
+        out.write((const char*)&header, sizeof(header));
+
+        written = writeString(out, binaryCacheOptions(getClassName(), d_flipNormals.getValue(), d_triangulate.getValue(), options))
+                && writeArray(out, d_positions.getValue()) && writeArray(out, d_normals.getValue())
+                && writeArray(out, d_edges.getValue()) && writeArray(out, d_triangles.getValue()) && writeArray(out, d_quads.getValue())
+                && writeGroups(out, d_edgesGroups.getValue()) && writeGroups(out, d_trianglesGroups.getValue()) && writeGroups(out, d_quadsGroups.getValue());
+    }
+
+    std::remove(cacheFilename.c_str());
+    if (!written || std::rename(tmpFilename.c_str(), cacheFilename.c_str()) != 0)
+    {
+        std::remove(tmpFilename.c_str());
+        msg_info() << "Cannot write the binary cache " << cacheFilename;
+        return false;
+    }
+    return true;
+}
+
 } // namespace loader
 
 } // namespace core
@@ -220,6 +220,21 @@ protected:
     void addPyramid(helper::vector< Pyramid>* pPyramids, const Pyramid& p);
     void addPyramid(helper::vector< Pyramid>* pPyramids,
                     unsigned int p0, unsigned int p1, unsigned int p2, unsigned int p3, unsigned int p4);
+
+    /// @name Binary cache
+    /// Positions, normals, edges, triangles, quads and their groups are stored in
+    /// a binary file next to the mesh file, tagged with a key computed by the loader
+    /// from the content of the mesh file and with the options of the loader, which
+    /// are compared as-is on read.
+    /// @{
+
+    /// Path of the binary cache of the given mesh file
+    static std::string getBinaryCacheFilename(const std::string& filename);
+    /// Load the mesh from the binary cache of the given file, if it exists and was written with the same key and options
+    bool readBinaryCache(const std::string& filename, uint64_t key, const std::string& options = std::string());
+    /// Write the loaded mesh in the binary cache of the given file
+    bool writeBinaryCache(const std::string& filename, uint64_t key, const std::string& options = std::string());
+    /// @}
 };
 
 
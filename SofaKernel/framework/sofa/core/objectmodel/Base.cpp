@@ -206,6 +206,16 @@ void Base::releaseAspect(int aspect)
     }
 }
 
+size_t Base::getMemoryFootprint() const
+{
+    size_t bytes = 0;
+    for(VecData::const_iterator iData = m_vecData.begin(); iData != m_vecData.end(); ++iData)
+    {
+        bytes += (*iData)->getMemoryFootprint();
+    }
+    return bytes;
+}
+
 /// Get the type name of this object (i.e. class and template types)
 std::string Base::getTypeName() const
 {
@@ -316,6 +316,10 @@ public:
     virtual void copyAspect(int destAspect, int srcAspect);
 
     virtual void releaseAspect(int aspect);
+
+    /// Approximate number of bytes used by the values of the Data of this object.
+    /// Objects holding large buffers outside of their Data should add them.
+    virtual size_t getMemoryFootprint() const;
     /// @}
 
     /// @name tags
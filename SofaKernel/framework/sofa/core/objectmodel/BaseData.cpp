@@ -297,6 +297,28 @@ bool BaseData::copyValue(const BaseData* parent)
     return false;
 }
 
+size_t BaseData::getMemoryFootprint() const
+{
+    return getValueFootprint(getValueVoidPtr());
+}
+
+size_t BaseData::getValueFootprint(const void* value) const
+{
+    const defaulttype::AbstractTypeInfo* typeInfo = getValueTypeInfo();
+    if (!value || !typeInfo || !typeInfo->ValidInfo())
+        return 0;
+
+    const size_t nbValues = typeInfo->size(value);
+    if (typeInfo->Text())
+    {
+        size_t bytes = 0;
+        for (size_t i = 0; i < nbValues; ++i)
+            bytes += typeInfo->getTextValue(value, i).size();
+        return bytes;
+    }
+    return nbValues * typeInfo->byteSize();
+}
+
 bool BaseData::findDataLinkDest(DDGNode*& ptr, const std::string& path, const BaseLink* link)
 {
     return DDGNode::findDataLinkDest(ptr, path, link);
@@ -164,6 +164,30 @@ public:
     /// Release memory allocated for the specified aspect.
     virtual void releaseAspect(int aspect) = 0;
 
+    /// Approximate number of bytes used by the value of this %Data in the current aspect.
+    ///
+    /// The size is computed from the DataTypeInfo of the value: containers count
+    /// their elements (not their capacity) and types without a valid DataTypeInfo
+    /// count 0. A value shared with a parent %Data is counted by both.
+    virtual size_t getMemoryFootprint() const;
+
+    /// Saved value of a %Data, see createSnapshot()
+    class Snapshot
+    {
+    public:
+        virtual ~Snapshot() {}
+    };
+
+    /// Save the value of this %Data in the current aspect, to be assigned back with restoreSnapshot().
+    ///
+    /// Copy-on-write values are shared with the %Data until one of them is modified.
+    /// Returns NULL if the value can not be saved.
+    virtual Snapshot* createSnapshot() const { return NULL; }
+
+    /// Assign back a value saved by createSnapshot().
+    /// Returns false if the snapshot was not taken from a %Data of the same type.
+    virtual bool restoreSnapshot(const Snapshot* /*snapshot*/) { return false; }
+
     /// Get a help message that describes this %Data.
     const char* getHelp() const { return help; }
 
@@ -334,6 +358,9 @@ protected:
 
     /// @}
 
+    /// Number of bytes used by the given value, which must have the type of this %Data
+    size_t getValueFootprint(const void* value) const;
+
     virtual void doSetParent(BaseData* parent);
 
     virtual void doDelInput(DDGNode* n);
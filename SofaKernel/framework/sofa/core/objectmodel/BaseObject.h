@@ -121,6 +121,10 @@ public:
     /// Reset to initial state
     virtual void reset();
 
+    /// Append the Data holding part of the state of this object that are not
+    /// registered as its fields, so that they are saved by simulation checkpoints
+    virtual void getExtraStateData(VecData& /*data*/) {}
+
     /// Called just before deleting this object
     /// Any object in the tree bellow this object that are to be removed will be removed only after this call,
     /// so any references this object holds should still be valid.
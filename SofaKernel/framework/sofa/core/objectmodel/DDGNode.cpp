@@ -62,10 +62,10 @@ TClass<DDGNode,void>::TClass()
 
 void DDGNode::setDirtyValue(const core::ExecParams* params)
 {
-    bool& dirtyValue = dirtyFlags[currentAspect(params)].dirtyValue;
-    if (!dirtyValue)
+    std::atomic<bool>& dirtyValue = dirtyFlags[currentAspect(params)].dirtyValue;
+    // only the thread switching the flag propagates it
+    if (!dirtyValue && !dirtyValue.exchange(true))
     {
-        dirtyValue = true;
 
 #ifdef SOFA_DDG_TRACE
         // TRACE LOG
@@ -79,10 +79,9 @@ void DDGNode::setDirtyValue(const core::ExecParams* params)
 
 void DDGNode::setDirtyOutputs(const core::ExecParams* params)
 {
-    bool& dirtyOutputs = dirtyFlags[currentAspect(params)].dirtyOutputs;
-    if (!dirtyOutputs)
+    std::atomic<bool>& dirtyOutputs = dirtyFlags[currentAspect(params)].dirtyOutputs;
+    if (!dirtyOutputs && !dirtyOutputs.exchange(true))
     {
-        dirtyOutputs = true;
         for(DDGLinkIterator it=outputs.begin(params), itend=outputs.end(params); it != itend; ++it)
         {
             (*it)->setDirtyValue(params);
@@ -92,10 +91,9 @@ void DDGNode::setDirtyOutputs(const core::ExecParams* params)
 
 void DDGNode::cleanDirty(const core::ExecParams* params)
 {
-    bool& dirtyValue = dirtyFlags[currentAspect(params)].dirtyValue;
-    if (dirtyValue)
+    std::atomic<bool>& dirtyValue = dirtyFlags[currentAspect(params)].dirtyValue;
+    if (dirtyValue && dirtyValue.exchange(false))
     {
-        dirtyValue = false;
 
 #ifdef SOFA_DDG_TRACE
         Base* owner = getOwner();
@@ -110,8 +108,13 @@ void DDGNode::cleanDirty(const core::ExecParams* params)
 
 void DDGNode::cleanDirtyOutputsOfInputs(const core::ExecParams* params)
 {
+    // only written when set, to avoid contention on the inputs shared by many engines
     for(DDGLinkIterator it=inputs.begin(params), itend=inputs.end(params); it != itend; ++it)
-        (*it)->dirtyFlags[currentAspect(params)].dirtyOutputs = false;
+    {
+        std::atomic<bool>& dirtyOutputs = (*it)->dirtyFlags[currentAspect(params)].dirtyOutputs;
+        if (dirtyOutputs)
+            dirtyOutputs = false;
+    }
 }
 
 
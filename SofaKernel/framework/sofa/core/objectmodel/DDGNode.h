@@ -32,6 +32,7 @@
 #include <sofa/core/objectmodel/Link.h>
 #include <sofa/core/objectmodel/BaseClass.h>
 #include <list>
+#include <atomic>
 
 namespace sofa
 {
@@ -253,12 +254,21 @@ protected:
 
 private:
 
+    /// The flags are atomic because the engines of a same level can be updated
+    /// concurrently (see DataEngineScheduler), and they share inputs and outputs.
     struct DirtyFlags
     {
         DirtyFlags() : dirtyValue(false), dirtyOutputs(false) {}
+        DirtyFlags(const DirtyFlags& f) : dirtyValue(f.dirtyValue.load()), dirtyOutputs(f.dirtyOutputs.load()) {}
+        DirtyFlags& operator=(const DirtyFlags& f)
+        {
+            dirtyValue = f.dirtyValue.load();
+            dirtyOutputs = f.dirtyOutputs.load();
+            return *this;
+        }
 
-        bool dirtyValue;
-        bool dirtyOutputs;
+        std::atomic<bool> dirtyValue;
+        std::atomic<bool> dirtyOutputs;
     };
     helper::fixed_array<DirtyFlags, SOFA_DATA_MAX_ASPECTS> dirtyFlags;
 };
@@ -31,6 +31,7 @@
 #include <sofa/helper/accessor.h>
 #include <sofa/helper/vector.h>
 #include <memory>
+#include <atomic>
 #include <string>
 #include <sofa/helper/logging/Message.h>
 namespace sofa
@@ -317,6 +318,90 @@ public:
 };
 
 
+/// Values of a Data for each aspect.
+///
+/// The value of the first aspect is stored inline. The values of the other
+/// aspects are allocated together the first time one of them is used (usually
+/// by copyAspect when an aspect is created by the AspectPool), so that a Data
+/// that is only used from the main aspect costs one value and one pointer.
+template <class ValueType, int NbAspects>
+class DataAspectValues
+{
+public:
+    DataAspectValues()
+        : others(NULL)
+    {
+    }
+
+    ~DataAspectValues()
+    {
+        delete[] others.load();
+    }
+
+    ValueType& operator[](size_t aspect)
+    {
+        return aspect ? getOthers()[aspect-1] : first;
+    }
+
+    const ValueType& operator[](size_t aspect) const
+    {
+        return aspect ? getOthers()[aspect-1] : first;
+    }
+
+    /// Release the memory of the given aspect, without allocating the other aspects
+    void release(size_t aspect)
+    {
+        if (!aspect)
+            first.release();
+        else if (ValueType* o = others.load())
+            o[aspect-1].release();
+    }
+
+    /// True once the values of the aspects other than the first one are allocated
+    bool hasOtherAspects() const
+    {
+        return others.load() != NULL;
+    }
+
+protected:
+    ValueType* getOthers() const
+    {
+        ValueType* o = others.load(std::memory_order_acquire);
+        if (!o)
+        {
+            // several threads can reach a new aspect at the same time, only one allocation is kept
+            ValueType* created = new ValueType[NbAspects-1];
+            if (others.compare_exchange_strong(o, created, std::memory_order_acq_rel))
+                o = created;
+            else
+                delete[] created;
+        }
+        return o;
+    }
+
+    ValueType first;
+    mutable std::atomic<ValueType*> others;
+
+private:
+    DataAspectValues(const DataAspectValues&);
+    DataAspectValues& operator=(const DataAspectValues&);
+};
+
+/// Without aspects, only the inline value is kept
+template <class ValueType>
+class DataAspectValues<ValueType, 1>
+{
+public:
+    ValueType& operator[](size_t /*aspect*/) { return first; }
+    const ValueType& operator[](size_t /*aspect*/) const { return first; }
+    void release(size_t /*aspect*/) { first.release(); }
+    bool hasOtherAspects() const { return false; }
+
+protected:
+    ValueType first;
+};
+
+
 /** \brief Container that holds a variable for a component.
  *
  * This is a fundamental class template in Sofa.  Data are used to encapsulated
@@ -407,8 +492,6 @@ public:
         , m_values()
         , shared(NULL)
     {
-        ValueType val;
-        m_values.assign(val);
     }
 
     /** \copydoc BaseData(const char*, bool, bool)
@@ -484,7 +567,30 @@ public:
 
     void releaseAspect(int aspect)
     {
-        m_values[aspect].release();
+        m_values.release(aspect);
+    }
+
+    /// Unlike getValue(), this does not update the Data if it is dirty
+    size_t getMemoryFootprint() const
+    {
+        return this->getValueFootprint(&m_values[DDGNode::currentAspect()].getValue());
+    }
+
+    BaseData::Snapshot* createSnapshot() const
+    {
+        return new ValueSnapshot(m_values[DDGNode::currentAspect()]);
+    }
+
+    bool restoreSnapshot(const BaseData::Snapshot* snapshot)
+    {
+        const ValueSnapshot* s = dynamic_cast<const ValueSnapshot*>(snapshot);
+        if (!s) return false;
+        size_t aspect = DDGNode::currentAspect();
+        this->m_values[aspect] = s->value;
+        ++this->m_counters[aspect];
+        this->m_isSets[aspect] = true;
+        BaseData::setDirtyOutputs();
+        return true;
     }
     /// @}
 
@@ -539,8 +645,15 @@ protected:
 
     typedef DataValue<T, sofa::defaulttype::DataTypeInfo<T>::CopyOnWrite> ValueType;
 
-    /// Value
-    helper::fixed_array<ValueType, SOFA_DATA_MAX_ASPECTS> m_values;
+    class ValueSnapshot : public BaseData::Snapshot
+    {
+    public:
+        explicit ValueSnapshot(const ValueType& v) : value(v) {}
+        ValueType value;
+    };
+
+    /// Value, the aspects other than the first one are allocated on first use
+    DataAspectValues<ValueType, SOFA_DATA_MAX_ASPECTS> m_values;
 
 public:
     mutable void* shared;
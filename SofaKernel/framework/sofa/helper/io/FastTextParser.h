@@ -0,0 +1,211 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2018 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#ifndef SOFA_HELPER_IO_FASTTEXTPARSER_H
+#define SOFA_HELPER_IO_FASTTEXTPARSER_H
+
+#include <sofa/helper/helper.h>
+#include <sofa/helper/system/config.h>
+#include <sofa/helper/vector.h>
+
+#include <locale>
+#include <sstream>
+#include <string>
+
+namespace sofa
+{
+
+namespace helper
+{
+
+namespace io
+{
+
+/// Locale-independent helpers to parse text files held in memory (see MemoryMappedFile).
+///
+/// Each function reads from the position p and stops at end without ever
+/// reading past it, so a buffer can be split in chunks parsed concurrently.
+namespace fasttext
+{
+
+inline bool isBlank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline const char* skipBlanks(const char* p, const char* end)
+{
+    while (p != end && isBlank(*p)) ++p;
+    return p;
+}
+
+/// Position of the end of the line ('\n' or end)
+inline const char* lineEnd(const char* p, const char* end)
+{
+    while (p != end && *p != '\n') ++p;
+    return p;
+}
+
+/// Position of the start of the next line
+inline const char* nextLine(const char* p, const char* end)
+{
+    p = lineEnd(p, end);
+    return p == end ? p : p+1;
+}
+
+/// Skip the given keyword if it is the next token of the line
+inline bool matchToken(const char*& p, const char* end, const char* token)
+{
+    const char* q = p;
+    while (*token)
+    {
+        if (q == end || *q != *token) return false;
+        ++q; ++token;
+    }
+    if (q != end && !isBlank(*q) && *q != '\n') return false;
+    p = q;
+    return true;
+}
+
+/// Read the next blank-separated token of the line
+inline std::string readToken(const char*& p, const char* end)
+{
+    p = skipBlanks(p, end);
+    const char* q = p;
+    while (q != end && !isBlank(*q) && *q != '\n') ++q;
+    std::string token(p, q);
+    p = q;
+    return token;
+}
+
+/// Read a signed integer, returns false if there is none at p
+inline bool parseInt(const char*& p, const char* end, int& value)
+{
+    const char* q = p;
+    bool negative = false;
+    if (q != end && (*q == '-' || *q == '+')) { negative = (*q == '-'); ++q; }
+    if (q == end || *q < '0' || *q > '9') return false;
+    int v = 0;
+    while (q != end && *q >= '0' && *q <= '9') { v = v*10 + (*q - '0'); ++q; }
+    value = negative ? -v : v;
+    p = q;
+    return true;
+}
+
+/// Read a floating point number, returns false if there is none at p.
+///
+/// Numbers of at most 15 significant digits and a decimal exponent within
+/// [-22,22], i.e. all numbers usually found in mesh files, are converted
+/// exactly with a single multiplication or division. Other numbers are handed
+/// to a stream imbued with the classic locale.
+inline bool parseReal(const char*& p, const char* end, double& value)
+{
+    static const double powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                     1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+    const char* q = p;
+    bool negative = false;
+    if (q != end && (*q == '-' || *q == '+')) { negative = (*q == '-'); ++q; }
+
+    uint64_t mantissa = 0;
+    int nbDigits = 0;   // significant digits stored in mantissa
+    int exponent = 0;
+    bool anyDigit = false;
+    while (q != end && *q >= '0' && *q <= '9')
+    {
+        anyDigit = true;
+        if (nbDigits < 19) { mantissa = mantissa*10 + (*q - '0'); if (mantissa) ++nbDigits; }
+        else ++exponent;
+        ++q;
+    }
+    if (q != end && *q == '.')
+    {
+        ++q;
+        while (q != end && *q >= '0' && *q <= '9')
+        {
+            anyDigit = true;
+            if (nbDigits < 19) { mantissa = mantissa*10 + (*q - '0'); if (mantissa) ++nbDigits; --exponent; }
+            ++q;
+        }
+    }
+    if (!anyDigit)
+    {
+        // inf, nan, or not a number at all
+        const char* t = q;
+        while (t != end && !isBlank(*t) && *t != '\n' && *t != '/') ++t;
+        if (t == q) return false;
+        std::istringstream in(std::string(p, t));
+        in.imbue(std::locale::classic());
+        if (!(in >> value)) return false;
+        p = t;
+        return true;
+    }
+    if (q != end && (*q == 'e' || *q == 'E'))
+    {
+        const char* e = q+1;
+        int exp = 0;
+        if (parseInt(e, end, exp)) { exponent += exp; q = e; }
+    }
+
+    if (nbDigits <= 15 && exponent >= -22 && exponent <= 22)
+    {
+        double v = (double)mantissa;
+        v = (exponent < 0) ? v / powers[-exponent] : v * powers[exponent];
+        value = negative ? -v : v;
+        p = q;
+        return true;
+    }
+
+    std::istringstream in(std::string(p, q));
+    in.imbue(std::locale::classic());
+    if (!(in >> value)) return false;
+    p = q;
+    return true;
+}
+
+/// Split [begin,end) in at most nbChunks ranges starting at the beginning of a line.
+/// Returns the boundaries of the ranges (its size is the number of ranges + 1).
+inline helper::vector<const char*> splitLines(const char* begin, const char* end, std::size_t nbChunks)
+{
+    helper::vector<const char*> bounds;
+    bounds.push_back(begin);
+    if (nbChunks < 1) nbChunks = 1;
+    const std::size_t size = (std::size_t)(end - begin);
+    for (std::size_t c = 1; c < nbChunks; ++c)
+    {
+        const char* p = begin + size * c / nbChunks;
+        if (p < bounds.back()) p = bounds.back();
+        p = nextLine(p, end);
+        if (p != bounds.back() && p != end)
+            bounds.push_back(p);
+    }
+    bounds.push_back(end);
+    return bounds;
+}
+
+} // namespace fasttext
+
+} // namespace io
+
+} // namespace helper
+
+} // namespace sofa
+
+#endif // SOFA_HELPER_IO_FASTTEXTPARSER_H
@@ -0,0 +1,197 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2018 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#include <sofa/helper/io/MemoryMappedFile.h>
+#include <sofa/helper/io/File.h>
+#include <sofa/helper/io/FileAccess.h>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace sofa
+{
+
+namespace helper
+{
+
+namespace io
+{
+
+MemoryMappedFile::MemoryMappedFile()
+    : m_data(NULL)
+    , m_size(0)
+    , m_mapping(NULL)
+#ifdef WIN32
+    , m_fileHandle(NULL)
+    , m_mappingHandle(NULL)
+#endif
+    , m_isOpen(false)
+{
+}
+
+MemoryMappedFile::MemoryMappedFile(const std::string& filename)
+    : m_data(NULL)
+    , m_size(0)
+    , m_mapping(NULL)
+#ifdef WIN32
+    , m_fileHandle(NULL)
+    , m_mappingHandle(NULL)
+#endif
+    , m_isOpen(false)
+{
+    open(filename);
+}
+
+MemoryMappedFile::~MemoryMappedFile()
+{
+    close();
+}
+
+bool MemoryMappedFile::open(const std::string& filename)
+{
+    close();
+
+    // a custom FileAccess may not read from the file system, use it as is
+    BaseFileAccess* access = BaseFileAccess::Create();
+    const bool defaultAccess = dynamic_cast<FileAccess*>(access) != NULL;
+    delete access;
+
+    if (defaultAccess)
+    {
+#ifdef WIN32
+        HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file != INVALID_HANDLE_VALUE)
+        {
+            LARGE_INTEGER size;
+            if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+            {
+                HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+                if (mapping)
+                {
+                    m_mapping = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+                    if (m_mapping)
+                    {
+                        m_fileHandle = file;
+                        m_mappingHandle = mapping;
+                        m_data = static_cast<const char*>(m_mapping);
+                        m_size = (std::size_t)size.QuadPart;
+                        m_isOpen = true;
+                        return true;
+                    }
+                    CloseHandle(mapping);
+                }
+            }
+            else if (GetFileSizeEx(file, &size))
+            {
+                // empty file, nothing to map
+                CloseHandle(file);
+                m_isOpen = true;
+                return true;
+            }
+            CloseHandle(file);
+        }
+#else
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd >= 0)
+        {
+            struct stat st;
+            if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode))
+            {
+                if (st.st_size == 0)
+                {
+                    ::close(fd);
+                    m_isOpen = true;
+                    return true;
+                }
+                void* mapping = mmap(NULL, (std::size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (mapping != MAP_FAILED)
+                {
+                    ::close(fd); // the mapping stays valid
+#ifdef MADV_SEQUENTIAL
+                    madvise(mapping, (std::size_t)st.st_size, MADV_SEQUENTIAL);
+#endif
+                    m_mapping = mapping;
+                    m_data = static_cast<const char*>(mapping);
+                    m_size = (std::size_t)st.st_size;
+                    m_isOpen = true;
+                    return true;
+                }
+            }
+            ::close(fd);
+        }
+#endif
+    }
+
+    File file;
+    if (!file.open(filename))
+        return false;
+    m_buffer = file.readAll();
+    file.close();
+    m_data = m_buffer.data();
+    m_size = m_buffer.size();
+    m_isOpen = true;
+    return true;
+}
+
+void MemoryMappedFile::close()
+{
+    if (m_mapping)
+    {
+#ifdef WIN32
+        UnmapViewOfFile(m_mapping);
+        CloseHandle(m_mappingHandle);
+        CloseHandle(m_fileHandle);
+        m_mappingHandle = NULL;
+        m_fileHandle = NULL;
+#else
+        munmap(m_mapping, m_size);
+#endif
+        m_mapping = NULL;
+    }
+    std::string().swap(m_buffer);
+    m_data = NULL;
+    m_size = 0;
+    m_isOpen = false;
+}
+
+uint64_t MemoryMappedFile::hash(uint64_t seed) const
+{
+    uint64_t h = seed;
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(m_data);
+    for (std::size_t i = 0; i < m_size; ++i)
+    {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+} // namespace io
+
+} // namespace helper
+
+} // namespace sofa
@@ -0,0 +1,84 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2018 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#ifndef SOFA_HELPER_IO_MEMORYMAPPEDFILE_H
+#define SOFA_HELPER_IO_MEMORYMAPPEDFILE_H
+
+#include <sofa/helper/helper.h>
+#include <sofa/helper/system/config.h>
+
+#include <string>
+
+namespace sofa
+{
+
+namespace helper
+{
+
+namespace io
+{
+
+/// \brief Read-only view of the whole content of a file.
+///
+/// The file is memory-mapped when it is a regular file read through the
+/// default FileAccess. Otherwise (custom FileAccess, mapping failure) its
+/// content is read once through helper::io::File into a buffer.
+class SOFA_HELPER_API MemoryMappedFile
+{
+public:
+    MemoryMappedFile();
+    explicit MemoryMappedFile(const std::string& filename);
+    ~MemoryMappedFile();
+
+    bool open(const std::string& filename);
+    void close();
+
+    bool isOpen() const { return m_isOpen; }
+    bool isMapped() const { return m_mapping != NULL; }
+
+    const char* data() const { return m_data; }
+    std::size_t size() const { return m_size; }
+
+    /// 64-bit FNV-1a hash of the content, chained from the given seed
+    uint64_t hash(uint64_t seed = 14695981039346656037ULL) const;
+
+private:
+    MemoryMappedFile(const MemoryMappedFile&);
+    MemoryMappedFile& operator=(const MemoryMappedFile&);
+
+    const char* m_data;
+    std::size_t m_size;
+    void* m_mapping;
+#ifdef WIN32
+    void* m_fileHandle;
+    void* m_mappingHandle;
+#endif
+    std::string m_buffer;
+    bool m_isOpen;
+};
+
+} // namespace io
+
+} // namespace helper
+
+} // namespace sofa
+
+#endif // SOFA_HELPER_IO_MEMORYMAPPEDFILE_H
@@ -84,7 +84,16 @@ protected :
 
     vector< TREENODE > tree; unsigned int firstNode;
 
-    unsigned int build(UIlist &list, unsigned char direction, const VecCoord& positions); // recursive function to build the kdtree
+    typedef typename vector<unsigned int>::iterator UIvectorIt;
+    unsigned int build(UIvectorIt begin, UIvectorIt end, unsigned char direction, const VecCoord& positions); // recursive function to build the kdtree
+
+    /// orders point indices along one direction (used to find medians when building the tree)
+    struct CompareAlongDirection
+    {
+        const VecCoord& positions; unsigned char direction;
+        CompareAlongDirection(const VecCoord& p, unsigned char d) : positions(p), direction(d) {}
+        bool operator()(unsigned int i, unsigned int j) const { return positions[i][direction]<positions[j][direction]; }
+    };
     void closest(distanceSet &cl, const Coord &x, const unsigned int &currentnode, const VecCoord& positions, unsigned N) const;     // recursive function to get closest points
     void closest(distanceToPoint &cl,const Coord &x, const unsigned int &currentnode, const VecCoord& positions) const;  // recursive function to get closest point
 };
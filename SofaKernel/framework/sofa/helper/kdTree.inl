@@ -25,6 +25,7 @@
 #include "kdTree.h"
 
 #include <map>
+#include <algorithm>
 #include <limits>
 #include <iterator>
 #include <cmath>
@@ -38,20 +39,17 @@ template<class Coord>
 void kdTree<Coord>::build(const VecCoord& positions)
 {
     const unsigned int nbp=positions.size();
-    UIlist list;   for(unsigned int i=0; i<nbp; i++) list.push_back(i);
+    vector<unsigned int> ids(nbp);   for(unsigned int i=0; i<nbp; i++) ids[i]=i;
     tree.resize(nbp);
-    firstNode=build(list,(unsigned char)0, positions);
+    firstNode = nbp ? build(ids.begin(),ids.end(),(unsigned char)0, positions) : 0;
 }
 
 template<class Coord>
 void kdTree<Coord>::build(const VecCoord& positions, const vector<unsigned int> &ROI)
 {
-    const size_t nbp = ROI.size();
-    UIlist list;
-    for(size_t i=0; i<nbp; i++)
-        list.push_back(ROI[i]);
+    vector<unsigned int> ids(ROI.begin(),ROI.end());
     tree.resize(positions.size());
-    firstNode=build(list,(unsigned char)0, positions);
+    firstNode = ids.size() ? build(ids.begin(),ids.end(),(unsigned char)0, positions) : 0;
 }
 
 template<class Coord>
@@ -63,33 +61,27 @@ void kdTree<Coord>::print(const unsigned int index)
 }
 
 template<class Coord>
-unsigned int kdTree<Coord>::build(UIlist &list, unsigned char direction, const VecCoord& positions)
+unsigned int kdTree<Coord>::build(UIvectorIt begin, UIvectorIt end, unsigned char direction, const VecCoord& positions)
 {
     // detect leaf
-    if(list.size()==(unsigned int)1)
+    if(end-begin==1)
     {
-        unsigned int index=list.front(); list.pop_front();
+        unsigned int index=*begin;
         tree[index].left=tree[index].right=index;
         tree[index].splitdir=direction;
         return index;
     }
-    // ordered list of 1D coord
-    distanceSet q;
-    UIlist::iterator it;
-    for(it=list.begin(); it!=list.end(); it++) q.insert( distanceToPoint(positions[*it][direction],*it));
-    it=list.begin();    for(distanceSetIt sit=q.begin(); sit!=q.end(); sit++) {*it=sit->second; it++;}
-    // split list in 2
-    it=list.begin(); advance (it,list.size()/2);
-    UIlist newlist;
-    newlist.splice(newlist.begin(),list,list.begin(),it);
+    // split in 2 around the median along direction (partial ordering is enough, no need to sort)
+    UIvectorIt median=begin+(end-begin)/2;
+    std::nth_element(begin,median,end,CompareAlongDirection(positions,direction));
     // add node
-    unsigned int index=list.front(); list.pop_front();
+    unsigned int index=*median;
     tree[index].splitdir=direction;
     tree[index].left=tree[index].right=index;
     // split children recursively
     unsigned char newdirection=direction+1; if(newdirection==dim) newdirection=0;
-    if(newlist.size()!=0) tree[index].left=build(newlist,newdirection,positions);
-    if(list.size()!=0) tree[index].right=build(list,newdirection,positions);
+    if(median!=begin) tree[index].left=build(begin,median,newdirection,positions);
+    if(median+1!=end) tree[index].right=build(median+1,end,newdirection,positions);
     // return child index to parent
     return index;
 }
@@ -0,0 +1,175 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2018 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#include <sofa/simulation/Checkpoint.h>
+#include <sofa/simulation/Node.h>
+#include <sofa/simulation/Visitor.h>
+#include <sofa/core/objectmodel/BaseObject.h>
+
+namespace sofa
+{
+
+namespace simulation
+{
+
+namespace
+{
+
+/// Collect the nodes and objects of a graph, in visiting order
+class CollectObjectsVisitor : public Visitor
+{
+public:
+    CollectObjectsVisitor(const core::ExecParams* params, helper::vector<core::objectmodel::Base*>& objects)
+        : Visitor(params), objects(objects)
+    {
+    }
+
+    virtual Result processNodeTopDown(Node* node)
+    {
+        objects.push_back(node);
+        for (Node::ObjectIterator it = node->object.begin(); it != node->object.end(); ++it)
+            addObject(it->get());
+        return RESULT_CONTINUE;
+    }
+
+    virtual const char* getClassName() const { return "CollectObjectsVisitor"; }
+
+protected:
+    void addObject(core::objectmodel::BaseObject* obj)
+    {
+        objects.push_back(obj);
+        const core::objectmodel::BaseObject::VecSlaves& slaves = obj->getSlaves();
+        for (core::objectmodel::BaseObject::VecSlaves::const_iterator it = slaves.begin(); it != slaves.end(); ++it)
+            addObject(it->get());
+    }
+
+    helper::vector<core::objectmodel::Base*>& objects;
+};
+
+} // namespace
+
+Checkpoint::Checkpoint()
+{
+}
+
+Checkpoint::~Checkpoint()
+{
+    clear();
+}
+
+void Checkpoint::clear()
+{
+    for (size_t i = 0; i < objects.size(); ++i)
+        for (size_t j = 0; j < objects[i].data.size(); ++j)
+            delete objects[i].data[j].snapshot;
+    objects.clear();
+    objectIndex.clear();
+}
+
+size_t Checkpoint::getNbData() const
+{
+    size_t nb = 0;
+    for (size_t i = 0; i < objects.size(); ++i)
+        nb += objects[i].data.size();
+    return nb;
+}
+
+void Checkpoint::getStateData(core::objectmodel::Base* object, core::objectmodel::Base::VecData& data)
+{
+    const core::objectmodel::Base::VecData& fields = object->getDataFields();
+    for (core::objectmodel::Base::VecData::const_iterator it = fields.begin(); it != fields.end(); ++it)
+    {
+        core::objectmodel::BaseData* d = *it;
+        // linked Data and engine outputs are computed from the other ones
+        if (d->getParent() || !d->getInputs().empty())
+            continue;
+        data.push_back(d);
+    }
+    if (core::objectmodel::BaseObject* obj = dynamic_cast<core::objectmodel::BaseObject*>(object))
+        obj->getExtraStateData(data);
+}
+
+void Checkpoint::save(Node* root)
+{
+    clear();
+
+    helper::vector<core::objectmodel::Base*> graph;
+    CollectObjectsVisitor(core::ExecParams::defaultInstance(), graph).execute(root);
+
+    core::objectmodel::Base::VecData data;
+    objects.resize(graph.size());
+    for (size_t i = 0; i < graph.size(); ++i)
+    {
+        ObjectState& state = objects[i];
+        state.object = graph[i];
+        objectIndex[graph[i]] = i;
+
+        data.clear();
+        getStateData(graph[i], data);
+        state.data.reserve(data.size());
+        for (size_t j = 0; j < data.size(); ++j)
+        {
+            DataState s;
+            s.data = data[j];
+            s.snapshot = data[j]->createSnapshot();
+            s.counter = data[j]->getCounter();
+            if (s.snapshot)
+                state.data.push_back(s);
+        }
+    }
+}
+
+void Checkpoint::restore(Node* root)
+{
+    helper::vector<core::objectmodel::Base*> graph;
+    CollectObjectsVisitor(core::ExecParams::defaultInstance(), graph).execute(root);
+
+    core::objectmodel::Base::VecData data;
+    for (size_t i = 0; i < graph.size(); ++i)
+    {
+        std::map<const core::objectmodel::Base*, size_t>::const_iterator found = objectIndex.find(graph[i]);
+        if (found == objectIndex.end()) continue; // created after the checkpoint
+        helper::vector<DataState>& saved = objects[found->second].data;
+
+        data.clear();
+        getStateData(graph[i], data);
+        size_t next = 0;
+        for (size_t j = 0; j < data.size(); ++j)
+        {
+            // the Data are usually listed in the same order as when they were saved
+            if (next >= saved.size() || saved[next].data != data[j])
+            {
+                next = 0;
+                while (next < saved.size() && saved[next].data != data[j])
+                    ++next;
+                if (next == saved.size()) continue; // not saved
+            }
+            DataState& s = saved[next++];
+            if (s.data->getCounter() == s.counter) continue; // not modified since it was saved or restored
+            if (s.data->restoreSnapshot(s.snapshot))
+                s.counter = s.data->getCounter();
+        }
+    }
+}
+
+} // namespace simulation
+
+} // namespace sofa
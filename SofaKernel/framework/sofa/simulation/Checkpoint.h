@@ -0,0 +1,100 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2018 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#ifndef SOFA_SIMULATION_CHECKPOINT_H
+#define SOFA_SIMULATION_CHECKPOINT_H
+
+#include <sofa/simulation/simulationcore.h>
+#include <sofa/core/objectmodel/BaseData.h>
+#include <sofa/core/objectmodel/Base.h>
+#include <sofa/helper/vector.h>
+#include <map>
+
+namespace sofa
+{
+
+namespace simulation
+{
+
+class Node;
+
+/// In-memory copy of the state of a graph, to rewind a simulation without reloading it.
+///
+/// save() keeps a snapshot of the Data of every node and object below the given
+/// node, including the vectors allocated by the solvers in the mechanical states
+/// (see BaseObject::getExtraStateData). Linked Data and engine outputs are not
+/// saved, as they are computed from the other ones. Copy-on-write values (vectors,
+/// strings...) are shared with the scene until either side modifies them.
+///
+/// restore() assigns the saved values back, skipping the Data that were not modified
+/// since the checkpoint was saved or last restored, and can be called many times.
+/// Objects added after save() are left untouched, and topological changes are not
+/// notified to the components.
+class SOFA_SIMULATION_CORE_API Checkpoint
+{
+public:
+    Checkpoint();
+    ~Checkpoint();
+
+    /// Save the state of the graph below root, replacing the previous one
+    void save(Node* root);
+
+    /// Restore the state saved by save() in the graph below root
+    void restore(Node* root);
+
+    /// Release the saved state
+    void clear();
+
+    bool empty() const { return objects.empty(); }
+
+    /// Number of Data saved in this checkpoint
+    size_t getNbData() const;
+
+protected:
+    struct DataState
+    {
+        core::objectmodel::BaseData* data;
+        core::objectmodel::BaseData::Snapshot* snapshot;
+        int counter; ///< counter of the Data when it was saved or restored
+    };
+
+    struct ObjectState
+    {
+        core::objectmodel::Base::SPtr object; ///< kept alive, so that its address is not reused
+        helper::vector<DataState> data;
+    };
+
+    helper::vector<ObjectState> objects;
+    std::map<const core::objectmodel::Base*, size_t> objectIndex;
+
+    /// Data holding the state of an object
+    static void getStateData(core::objectmodel::Base* object, core::objectmodel::Base::VecData& data);
+
+private:
+    Checkpoint(const Checkpoint&);
+    Checkpoint& operator=(const Checkpoint&);
+};
+
+} // namespace simulation
+
+} // namespace sofa
+
+#endif
@@ -0,0 +1,308 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2018 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#include <sofa/simulation/DataEngineScheduler.h>
+#include <sofa/simulation/Node.h>
+#include <sofa/helper/system/thread/CTime.h>
+#include <sofa/helper/IndexOpenMP.h>
+#include <algorithm>
+#include <map>
+#include <set>
+
+namespace sofa
+{
+
+namespace simulation
+{
+
+using sofa::helper::system::thread::CTime;
+using sofa::helper::system::thread::ctime_t;
+
+namespace
+{
+
+/// The engines are the DDGNodes which are not Data
+core::DataEngine* asEngine(core::objectmodel::DDGNode* n)
+{
+    if (n->getData()) return NULL;
+    return dynamic_cast<core::DataEngine*>(n);
+}
+
+}
+
+DataEngineScheduler::DataEngineScheduler()
+    : parallel(true)
+{
+    clear();
+}
+
+void DataEngineScheduler::clear()
+{
+    engines.clear();
+    levelBegin.clear();
+    predBegin.clear();
+    predIndex.clear();
+    criticalPath.clear();
+    nbLevels = 0;
+    criticalPathTime = 0;
+    totalEngineTime = 0;
+    elapsedTime = 0;
+}
+
+void DataEngineScheduler::update(const helper::vector<DDGNode*>& changed, const core::ExecParams* params)
+{
+    const ctime_t t0 = CTime::getRefTime();
+    schedule(changed, params);
+    evaluate(params);
+    elapsedTime = (double)(CTime::getRefTime() - t0) / (double)CTime::getRefTicksPerSec();
+}
+
+void DataEngineScheduler::update(simulation::Node* root, const core::ExecParams* params)
+{
+    helper::vector<DataEngine*> all;
+    root->getTreeObjects<DataEngine>(&all);
+
+    helper::vector<DDGNode*> dirty;
+    for (unsigned int i = 0; i < all.size(); ++i)
+        if (all[i]->isDirty(params))
+            dirty.push_back(all[i]);
+
+    update(dirty, params);
+}
+
+void DataEngineScheduler::schedule(const helper::vector<DDGNode*>& roots, const core::ExecParams* params)
+{
+    clear();
+
+    // dirty engines reachable from the roots. The propagation of the dirty flags
+    // stops at clean nodes, so the walk does too (except for the roots, a Data
+    // that was just set is itself clean).
+    std::map<DDGNode*, unsigned> engineIds;
+    helper::vector<DataEngine*> found;
+    {
+        std::set<DDGNode*> visited;
+        helper::vector<DDGNode*> stack(roots.begin(), roots.end());
+        visited.insert(roots.begin(), roots.end());
+        while (!stack.empty())
+        {
+            DDGNode* n = stack.back();
+            stack.pop_back();
+            DataEngine* e = asEngine(n);
+            if (e && e->isDirty(params))
+            {
+                engineIds[n] = (unsigned)found.size();
+                found.push_back(e);
+            }
+            const DDGNode::DDGLinkContainer& outputs = n->getOutputs();
+            for (DDGNode::DDGLinkIterator it = outputs.begin(); it != outputs.end(); ++it)
+                if ((*it)->isDirty(params) && visited.insert(*it).second)
+                    stack.push_back(*it);
+        }
+    }
+    if (found.empty()) return;
+
+    // dependencies between the engines, through any chain of Data
+    const std::size_t nbEngines = found.size();
+    helper::vector< helper::vector<unsigned> > succ(nbEngines);
+    helper::vector<unsigned> nbPred(nbEngines, 0u);
+    for (unsigned i = 0; i < nbEngines; ++i)
+    {
+        std::set<DDGNode*> visited;
+        helper::vector<DDGNode*> stack;
+        stack.push_back(found[i]);
+        while (!stack.empty())
+        {
+            DDGNode* n = stack.back();
+            stack.pop_back();
+            const DDGNode::DDGLinkContainer& outputs = n->getOutputs();
+            for (DDGNode::DDGLinkIterator it = outputs.begin(); it != outputs.end(); ++it)
+            {
+                DDGNode* o = *it;
+                if (!visited.insert(o).second) continue;
+                std::map<DDGNode*, unsigned>::const_iterator id = engineIds.find(o);
+                if (id != engineIds.end())
+                {
+                    if (id->second != i)
+                    {
+                        succ[i].push_back(id->second);
+                        ++nbPred[id->second];
+                    }
+                }
+                else if (o->isDirty(params))
+                    stack.push_back(o);
+            }
+        }
+    }
+
+    // levels in topological order: the level of an engine is the length of the
+    // longest chain of engines leading to it
+    helper::vector<unsigned> level(nbEngines, 0u);
+    helper::vector<unsigned> order;
+    order.reserve(nbEngines);
+    {
+        helper::vector<unsigned> remaining = nbPred;
+        for (unsigned i = 0; i < nbEngines; ++i)
+            if (remaining[i] == 0)
+                order.push_back(i);
+        for (unsigned k = 0; k < order.size(); ++k)
+        {
+            const unsigned i = order[k];
+            for (unsigned s = 0; s < succ[i].size(); ++s)
+            {
+                const unsigned j = succ[i][s];
+                level[j] = std::max(level[j], level[i]+1);
+                if (--remaining[j] == 0)
+                    order.push_back(j);
+            }
+        }
+        // a cycle should not happen in the DDG, but its engines are still
+        // updated, one per level after the others
+        unsigned next = 0;
+        for (unsigned k = 0; k < order.size(); ++k)
+            next = std::max(next, level[order[k]]+1);
+        for (unsigned i = 0; i < nbEngines; ++i)
+            if (remaining[i] != 0)
+            {
+                level[i] = next++;
+                order.push_back(i);
+            }
+    }
+
+    // engines sorted by level
+    helper::vector<unsigned> position(nbEngines);
+    nbLevels = 0;
+    for (unsigned i = 0; i < nbEngines; ++i)
+        nbLevels = std::max(nbLevels, level[i]+1);
+    levelBegin.assign(nbLevels+1, 0);
+    for (unsigned i = 0; i < nbEngines; ++i)
+        ++levelBegin[level[i]+1];
+    for (unsigned l = 0; l < nbLevels; ++l)
+        levelBegin[l+1] += levelBegin[l];
+    {
+        helper::vector<unsigned> fill(levelBegin.begin(), levelBegin.end()-1);
+        engines.resize(nbEngines);
+        for (unsigned k = 0; k < nbEngines; ++k)
+        {
+            const unsigned i = order[k];
+            position[i] = fill[level[i]]++;
+            engines[position[i]].engine = found[i];
+            engines[position[i]].level = level[i];
+        }
+    }
+
+    predBegin.assign(nbEngines+1, 0);
+    for (unsigned i = 0; i < nbEngines; ++i)
+        for (unsigned s = 0; s < succ[i].size(); ++s)
+            ++predBegin[position[succ[i][s]]+1];
+    for (unsigned i = 0; i < nbEngines; ++i)
+        predBegin[i+1] += predBegin[i];
+    predIndex.resize(predBegin[nbEngines]);
+    {
+        helper::vector<unsigned> fill(predBegin.begin(), predBegin.end()-1);
+        for (unsigned i = 0; i < nbEngines; ++i)
+            for (unsigned s = 0; s < succ[i].size(); ++s)
+                predIndex[fill[position[succ[i][s]]]++] = position[i];
+    }
+}
+
+void DataEngineScheduler::evaluate(const core::ExecParams* params)
+{
+    const double ticks = (double)CTime::getRefTicksPerSec();
+
+    for (unsigned l = 0; l < nbLevels; ++l)
+    {
+        const int begin = (int)levelBegin[l];
+        const int end = (int)levelBegin[l+1];
+
+        // the inputs are brought up to date sequentially: the engines of the
+        // previous levels are clean, only Data copies from their parents remain
+        for (int k = begin; k < end; ++k)
+        {
+            const DDGNode::DDGLinkContainer& inputs = engines[k].engine->getInputs();
+            for (DDGNode::DDGLinkIterator it = inputs.begin(); it != inputs.end(); ++it)
+                (*it)->updateIfDirty(params);
+        }
+
+#ifdef _OPENMP
+        #pragma omp parallel for schedule(dynamic) if (parallel && end - begin > 1)
+#endif
+        for (helper::IndexOpenMP<int>::type k = begin; k < end; ++k)
+        {
+            EngineTiming& t = engines[k];
+            // it may have been pulled by the update of an input
+            if (!t.engine->isDirty(params)) continue;
+            const ctime_t t0 = CTime::getRefTime();
+            t.engine->update();
+            t.time = (double)(CTime::getRefTime() - t0) / ticks;
+        }
+    }
+
+    computeCriticalPath();
+}
+
+void DataEngineScheduler::computeCriticalPath()
+{
+    const std::size_t nbEngines = engines.size();
+    if (!nbEngines) return;
+
+    // engines are sorted by level, the predecessors of an engine come before it
+    helper::vector<double> finish(nbEngines, 0.0);
+    helper::vector<int> bestPred(nbEngines, -1);
+    unsigned last = 0;
+    for (unsigned i = 0; i < nbEngines; ++i)
+    {
+        double start = 0;
+        for (unsigned p = predBegin[i]; p < predBegin[i+1]; ++p)
+        {
+            if (bestPred[i] < 0 || finish[predIndex[p]] > start)
+            {
+                start = finish[predIndex[p]];
+                bestPred[i] = (int)predIndex[p];
+            }
+        }
+        finish[i] = start + engines[i].time;
+        totalEngineTime += engines[i].time;
+        if (finish[i] > finish[last] || (finish[i] == finish[last] && engines[i].level > engines[last].level))
+            last = i;
+    }
+
+    criticalPathTime = finish[last];
+    for (int i = (int)last; i >= 0; i = bestPred[i])
+        criticalPath.push_back(engines[i]);
+    std::reverse(criticalPath.begin(), criticalPath.end());
+}
+
+void DataEngineScheduler::printCriticalPath(std::ostream& out) const
+{
+    out << engines.size() << " engines in " << nbLevels << " levels, "
+        << totalEngineTime*1000 << " ms in engines, "
+        << elapsedTime*1000 << " ms elapsed" << std::endl;
+    for (unsigned l = 0; l < nbLevels; ++l)
+        out << "  level " << l << ": " << (levelBegin[l+1]-levelBegin[l]) << " engines" << std::endl;
+    out << "critical path: " << criticalPathTime*1000 << " ms" << std::endl;
+    for (unsigned i = 0; i < criticalPath.size(); ++i)
+        out << "  " << criticalPath[i].engine->getPathName() << " (" << criticalPath[i].engine->getClassName()
+            << "): " << criticalPath[i].time*1000 << " ms" << std::endl;
+}
+
+} // namespace simulation
+
+} // namespace sofa
@@ -0,0 +1,136 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2018 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#ifndef SOFA_SIMULATION_DATAENGINESCHEDULER_H
+#define SOFA_SIMULATION_DATAENGINESCHEDULER_H
+
+#include <sofa/simulation/simulationcore.h>
+#include <sofa/core/DataEngine.h>
+#include <sofa/core/ExecParams.h>
+#include <sofa/helper/vector.h>
+#include <iostream>
+
+namespace sofa
+{
+
+namespace simulation
+{
+
+class Node;
+
+/**
+ *  \brief Evaluates the dirty DataEngines of a scene ahead of their readers.
+ *
+ *  Engine outputs are normally recomputed lazily, one engine at a time, by
+ *  whichever code reads them. This scheduler walks the DDGNode graph forward
+ *  from a set of changed Data (or from all the engines of a subtree) to find
+ *  the dirty engines, orders them by dependency levels and updates the engines
+ *  of a same level concurrently (OpenMP).
+ *
+ *  Before a level is started, the inputs of its engines are pulled
+ *  sequentially, so that the engines only read clean Data while they run.
+ *  The dirty flags they clean on shared inputs and set on shared downstream
+ *  Data are atomic (see DDGNode). Engines reading Data they did not declare as
+ *  inputs can still trigger a lazy update from several threads: disable the
+ *  parallel mode for such scenes.
+ *
+ *  The time spent in each engine is measured, and the longest chain of
+ *  dependent engines (the critical path) of the last update is kept.
+ */
+class SOFA_SIMULATION_CORE_API DataEngineScheduler
+{
+public:
+    typedef core::objectmodel::DDGNode DDGNode;
+    typedef core::DataEngine DataEngine;
+
+    struct EngineTiming
+    {
+        EngineTiming() : engine(NULL), level(0), time(0) {}
+        DataEngine* engine;
+        unsigned level; ///< dependency level, engines of a same level are independent
+        double time; ///< time spent in the update of the engine, in seconds
+    };
+
+    DataEngineScheduler();
+
+    /// Update the dirty engines reachable from the given nodes (usually Data that were just modified)
+    void update(const helper::vector<DDGNode*>& changed, const core::ExecParams* params = NULL);
+
+    /// Update all the dirty engines of the subtree rooted at the given node
+    void update(simulation::Node* root, const core::ExecParams* params = NULL);
+
+    /// Update engines of a same level concurrently (default)
+    void setParallel(bool b) { parallel = b; }
+    bool isParallel() const { return parallel; }
+
+    /// Engines updated by the last call, in the order they were scheduled
+    const helper::vector<EngineTiming>& getEngines() const { return engines; }
+
+    /// Number of dependency levels of the last update
+    unsigned getNbLevels() const { return nbLevels; }
+
+    /// Engines of the critical path of the last update, from the first to evaluate to the last
+    const helper::vector<EngineTiming>& getCriticalPath() const { return criticalPath; }
+
+    /// Sum of the update times of the engines of the critical path, in seconds
+    double getCriticalPathTime() const { return criticalPathTime; }
+
+    /// Sum of the update times of all the engines, in seconds
+    double getTotalEngineTime() const { return totalEngineTime; }
+
+    /// Elapsed time of the last update, in seconds
+    double getElapsedTime() const { return elapsedTime; }
+
+    /// Print the levels and the critical path of the last update
+    void printCriticalPath(std::ostream& out) const;
+
+protected:
+    bool parallel;
+
+    helper::vector<EngineTiming> engines;
+    /// engines[levelBegin[l]..levelBegin[l+1]] are the engines of level l
+    helper::vector<unsigned> levelBegin;
+    /// predecessors of each engine in the dependency graph, in compressed rows
+    helper::vector<unsigned> predBegin;
+    helper::vector<unsigned> predIndex;
+
+    unsigned nbLevels;
+    helper::vector<EngineTiming> criticalPath;
+    double criticalPathTime;
+    double totalEngineTime;
+    double elapsedTime;
+
+    /// Collect the dirty engines reachable from roots and sort them by level
+    void schedule(const helper::vector<DDGNode*>& roots, const core::ExecParams* params);
+
+    /// Update the scheduled engines, level by level
+    void evaluate(const core::ExecParams* params);
+
+    void computeCriticalPath();
+
+    void clear();
+};
+
+} // namespace simulation
+
+} // namespace sofa
+
+#endif
@@ -41,6 +41,7 @@
 #include <stdlib.h>
 #include <math.h>
 #include <algorithm>
+#include <sstream>
 
 namespace sofa
 {
@@ -58,6 +59,7 @@ int DefaultAnimationLoopClass = core::RegisterObject("The simplest animation loo
 
 DefaultAnimationLoop::DefaultAnimationLoop(simulation::Node* _gnode)
     : Inherit()
+    , d_parallelEngines(initData(&d_parallelEngines, false, "parallelEngines", "Update the dirty engines after init and at the end of each step, independent engines in parallel"))
     , gnode(_gnode)
 {
     //assert(gnode);
@@ -74,6 +76,29 @@ void DefaultAnimationLoop::init()
         gnode = dynamic_cast<simulation::Node*>(this->getContext());
 }
 
+void DefaultAnimationLoop::bwdInit()
+{
+    // the loop is on the root node, its bwdInit comes after the init of all the components
+    updateEngines(core::ExecParams::defaultInstance());
+}
+
+void DefaultAnimationLoop::updateEngines(const core::ExecParams* params)
+{
+    if (!d_parallelEngines.getValue() || !gnode)
+        return;
+
+    sofa::helper::AdvancedTimer::stepBegin("UpdateEngines");
+    engineScheduler.update(gnode, params);
+    sofa::helper::AdvancedTimer::stepEnd("UpdateEngines");
+
+    if (f_printLog.getValue() && !engineScheduler.getEngines().empty())
+    {
+        std::ostringstream out;
+        engineScheduler.printCriticalPath(out);
+        msg_info() << out.str();
+    }
+}
+
 void DefaultAnimationLoop::setNode( simulation::Node* n )
 {
     gnode=n;
@@ -131,6 +156,8 @@ void DefaultAnimationLoop::step(const core::ExecParams* params, SReal dt)
     }
     sofa::helper::AdvancedTimer::stepEnd("UpdateMapping");
 
+    updateEngines(params);
+
 #ifndef SOFA_NO_UPDATE_BBOX
     sofa::helper::AdvancedTimer::stepBegin("UpdateBBox");
     gnode->execute< UpdateBoundingBoxVisitor >(params);
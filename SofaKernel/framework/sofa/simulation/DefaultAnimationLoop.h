@@ -27,6 +27,7 @@
 #include <sofa/core/ExecParams.h>
 #include <sofa/simulation/simulationcore.h>
 #include <sofa/simulation/Node.h>
+#include <sofa/simulation/DataEngineScheduler.h>
 #include <sofa/helper/AdvancedTimer.h>
 
 namespace sofa
@@ -59,6 +60,9 @@ public:
     /// Set the simulation node to the local context if not specified previously
     virtual void init() override;
 
+    /// Update the engines left dirty by the initialization, if parallelEngines is set
+    virtual void bwdInit() override;
+
     /// perform one animation step
     virtual void step(const core::ExecParams* params, SReal dt) override;
 
@@ -74,10 +78,16 @@ public:
         return obj;
     }
 
+    Data<bool> d_parallelEngines; ///< Update the dirty engines after init and at the end of each step, independent engines in parallel
+
 protected :
 
     simulation::Node* gnode;  ///< the node controlled by the loop
 
+    DataEngineScheduler engineScheduler;
+
+    void updateEngines(const core::ExecParams* params);
+
 };
 
 } // namespace simulation
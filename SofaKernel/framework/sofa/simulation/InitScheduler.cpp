@@ -0,0 +1,605 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2018 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#include <sofa/simulation/InitScheduler.h>
+#include <sofa/simulation/Node.h>
+#include <sofa/simulation/Visitor.h>
+#include <sofa/core/DataEngine.h>
+#include <sofa/defaulttype/BoundingBox.h>
+#include <sofa/helper/system/thread/CTime.h>
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <set>
+
+namespace sofa
+{
+
+namespace simulation
+{
+
+using sofa::helper::system::thread::CTime;
+using sofa::helper::system::thread::ctime_t;
+
+namespace
+{
+
+/// Initialize the nodes and list them with their components, in the order of InitVisitor
+class InitializeNodesVisitor : public Visitor
+{
+public:
+    InitializeNodesVisitor(const core::ExecParams* params, helper::vector<Node*>& nodes, const std::set<Node*>& skipped)
+        : Visitor(params), nodes(nodes), skipped(skipped)
+    {
+    }
+
+    virtual Result processNodeTopDown(Node* node)
+    {
+        if (skipped.find(node) == skipped.end())
+        {
+            node->initialize();
+            nodes.push_back(node);
+        }
+        return RESULT_CONTINUE;
+    }
+
+    virtual const char* getClassName() const { return "InitializeNodesVisitor"; }
+
+protected:
+    helper::vector<Node*>& nodes;
+    const std::set<Node*>& skipped;
+};
+
+/// Collect the components of a subtree, in the order of InitVisitor
+class CollectComponentsVisitor : public Visitor
+{
+public:
+    CollectComponentsVisitor(const core::ExecParams* params, helper::vector<core::objectmodel::BaseObject*>& objects)
+        : Visitor(params), objects(objects)
+    {
+    }
+
+    virtual Result processNodeTopDown(Node* node)
+    {
+        for (Node::ObjectIterator it = node->object.begin(); it != node->object.end(); ++it)
+            objects.push_back(it->get());
+        return RESULT_CONTINUE;
+    }
+
+    virtual const char* getClassName() const { return "CollectComponentsVisitor"; }
+
+protected:
+    helper::vector<core::objectmodel::BaseObject*>& objects;
+};
+
+/// Does the work of InitVisitor, measuring the time spent in each component
+class TimedInitVisitor : public Visitor
+{
+public:
+    typedef InitScheduler::ComponentTiming ComponentTiming;
+
+    TimedInitVisitor(const core::ExecParams* params, helper::vector<Node*>& nodes, helper::vector<ComponentTiming>& components)
+        : Visitor(params), nodes(nodes), components(components), ticks((double)CTime::getRefTicksPerSec())
+    {
+    }
+
+    virtual Result processNodeTopDown(Node* node)
+    {
+        node->initialize();
+        nodes.push_back(node);
+
+        sofa::defaulttype::BoundingBox* nodeBBox = node->f_bbox.beginEdit(params);
+        if (!node->f_bbox.isSet())
+            nodeBBox->invalidate();
+
+        for (unsigned i = 0; i < node->object.size(); ++i)
+        {
+            ComponentTiming t;
+            t.object = node->object[i].get();
+            const ctime_t t0 = CTime::getRefTime();
+            t.object->init();
+            t.initTime = (double)(CTime::getRefTime() - t0) / ticks;
+            t.object->computeBBox(params, true);
+            nodeBBox->include(t.object->f_bbox.getValue(params));
+            componentIds[t.object] = (unsigned)components.size();
+            components.push_back(t);
+        }
+        node->f_bbox.endEdit(params);
+        return RESULT_CONTINUE;
+    }
+
+    virtual void processNodeBottomUp(Node* node)
+    {
+        node->setDefaultVisualContextValue();
+        sofa::defaulttype::BoundingBox* nodeBBox = node->f_bbox.beginEdit(params);
+
+        for (unsigned i = (unsigned)node->object.size(); i > 0; --i)
+        {
+            core::objectmodel::BaseObject* obj = node->object[i-1].get();
+            const ctime_t t0 = CTime::getRefTime();
+            obj->bwdInit();
+            const double time = (double)(CTime::getRefTime() - t0) / ticks;
+            std::map<core::objectmodel::BaseObject*, unsigned>::const_iterator it = componentIds.find(obj);
+            if (it != componentIds.end())
+                components[it->second].bwdInitTime = time;
+            nodeBBox->include(obj->f_bbox.getValue(params));
+        }
+
+        node->f_bbox.endEdit(params);
+        node->bwdInit();
+    }
+
+    virtual const char* getClassName() const { return "TimedInitVisitor"; }
+
+protected:
+    helper::vector<Node*>& nodes;
+    helper::vector<ComponentTiming>& components;
+    std::map<core::objectmodel::BaseObject*, unsigned> componentIds;
+    const double ticks;
+};
+
+/// Build compressed rows from lists of indices
+void compress(const helper::vector< helper::vector<unsigned> >& rows, helper::vector<unsigned>& begin, helper::vector<unsigned>& index)
+{
+    begin.resize(rows.size()+1);
+    begin[0] = 0;
+    for (unsigned i = 0; i < rows.size(); ++i)
+        begin[i+1] = begin[i] + (unsigned)rows[i].size();
+    index.clear();
+    index.reserve(begin.back());
+    for (unsigned i = 0; i < rows.size(); ++i)
+        index.insert(index.end(), rows[i].begin(), rows[i].end());
+}
+
+/// List the engines a component may update when reading its inputs: the
+/// engines owning them and, transitively, the engines their own inputs depend on
+const helper::vector<unsigned>& collectUpstreamEngines(unsigned k, const helper::vector< helper::vector<unsigned> >& inputs,
+                                                      const helper::vector<bool>& isEngine, helper::vector< helper::vector<unsigned> >& upstream,
+                                                      helper::vector<bool>& visited)
+{
+    if (visited[k]) return upstream[k]; // done, or a cycle being collected
+    visited[k] = true;
+    helper::vector<unsigned> engines;
+    for (unsigned i = 0; i < inputs[k].size(); ++i)
+    {
+        const unsigned j = inputs[k][i];
+        if (isEngine[j])
+            engines.push_back(j);
+        const helper::vector<unsigned>& above = collectUpstreamEngines(j, inputs, isEngine, upstream, visited);
+        engines.insert(engines.end(), above.begin(), above.end());
+    }
+    std::sort(engines.begin(), engines.end());
+    engines.erase(std::unique(engines.begin(), engines.end()), engines.end());
+    upstream[k].swap(engines);
+    return upstream[k];
+}
+
+}
+
+InitScheduler::InitScheduler()
+    : parallel(true)
+{
+    clear();
+}
+
+void InitScheduler::clear()
+{
+    nodes.clear();
+    components.clear();
+    predBegin.clear();
+    predIndex.clear();
+    succBegin.clear();
+    succIndex.clear();
+    initCriticalPath.clear();
+    bwdInitCriticalPath.clear();
+    criticalPathTime = 0;
+    totalComponentTime = 0;
+    elapsedTime = 0;
+}
+
+void InitScheduler::init(simulation::Node* root, const core::ExecParams* params)
+{
+    const ctime_t t0 = CTime::getRefTime();
+    if (!params) params = core::ExecParams::defaultInstance();
+    clear();
+
+    if (parallel)
+        initConcurrently(root, params);
+    else
+        initSequentially(root, params);
+
+    for (unsigned i = 0; i < components.size(); ++i)
+        totalComponentTime += components[i].initTime + components[i].bwdInitTime;
+    criticalPathTime = computeCriticalPath(false, initCriticalPath) + computeCriticalPath(true, bwdInitCriticalPath);
+    elapsedTime = (double)(CTime::getRefTime() - t0) / (double)CTime::getRefTicksPerSec();
+}
+
+void InitScheduler::initSequentially(simulation::Node* root, const core::ExecParams* params)
+{
+    TimedInitVisitor visitor(params, nodes, components);
+    visitor.execute(root);
+
+    // the dependencies are only used to compute the critical paths, the
+    // components are listed again as they may have been added during the init
+    std::map<core::objectmodel::BaseObject*, ComponentTiming> timings;
+    for (unsigned i = 0; i < components.size(); ++i)
+        timings[components[i].object] = components[i];
+    components.clear();
+    for (unsigned i = 0; i < nodes.size(); ++i)
+    {
+        for (Node::ObjectIterator it = nodes[i]->object.begin(); it != nodes[i]->object.end(); ++it)
+        {
+            ComponentTiming t = timings[it->get()];
+            t.object = it->get();
+            components.push_back(t);
+        }
+    }
+    schedule();
+}
+
+void InitScheduler::initConcurrently(simulation::Node* root, const core::ExecParams* params)
+{
+    collect(root, params);
+    schedule();
+
+    const unsigned revision = Node::getGraphRevision();
+    run(false, params);
+    if (Node::getGraphRevision() != revision)
+        initAddedComponents(root, params);
+
+    for (unsigned i = 0; i < nodes.size(); ++i)
+    {
+        Node* node = nodes[i];
+        sofa::defaulttype::BoundingBox* nodeBBox = node->f_bbox.beginEdit(params);
+        if (!node->f_bbox.isSet())
+            nodeBBox->invalidate();
+        for (unsigned j = 0; j < node->object.size(); ++j)
+            nodeBBox->include(node->object[j]->f_bbox.getValue(params));
+        node->f_bbox.endEdit(params);
+    }
+
+    for (unsigned i = (unsigned)nodes.size(); i > 0; --i)
+    {
+        nodes[i-1]->setDefaultVisualContextValue();
+        nodes[i-1]->bwdInit();
+    }
+
+    run(true, params);
+
+    for (unsigned i = 0; i < nodes.size(); ++i)
+    {
+        Node* node = nodes[i];
+        sofa::defaulttype::BoundingBox* nodeBBox = node->f_bbox.beginEdit(params);
+        for (unsigned j = 0; j < node->object.size(); ++j)
+            nodeBBox->include(node->object[j]->f_bbox.getValue(params));
+        node->f_bbox.endEdit(params);
+    }
+}
+
+void InitScheduler::collect(simulation::Node* root, const core::ExecParams* params)
+{
+    // Node::initialize() can reorder the components of the node, they are
+    // listed once all the nodes are initialized
+    const std::set<Node*> none;
+    InitializeNodesVisitor initNodes(params, nodes, none);
+    initNodes.execute(root);
+
+    for (unsigned i = 0; i < nodes.size(); ++i)
+    {
+        Node* node = nodes[i];
+        for (Node::ObjectIterator it = node->object.begin(); it != node->object.end(); ++it)
+        {
+            ComponentTiming t;
+            t.object = it->get();
+            components.push_back(t);
+        }
+    }
+}
+
+void InitScheduler::schedule()
+{
+    const unsigned nbComponents = (unsigned)components.size();
+    std::map<core::objectmodel::Base*, unsigned> componentIds;
+    for (unsigned i = 0; i < nbComponents; ++i)
+        componentIds[components[i].object] = i;
+
+    helper::vector< helper::vector<unsigned> > preds(nbComponents);
+
+    // the first component of a node waits for the last components of its
+    // parents (or of their parents if they have none), the others for the
+    // previous component of the node
+    {
+        std::map<core::objectmodel::BaseNode*, helper::vector<unsigned> > lastComponents;
+        unsigned k = 0;
+        for (unsigned i = 0; i < nodes.size(); ++i)
+        {
+            Node* node = nodes[i];
+            helper::vector<unsigned> last;
+            const core::objectmodel::BaseNode::Parents parents = node->getParents();
+            for (unsigned p = 0; p < parents.size(); ++p)
+            {
+                std::map<core::objectmodel::BaseNode*, helper::vector<unsigned> >::const_iterator it = lastComponents.find(parents[p]);
+                if (it != lastComponents.end())
+                    last.insert(last.end(), it->second.begin(), it->second.end());
+            }
+            std::sort(last.begin(), last.end());
+            last.erase(std::unique(last.begin(), last.end()), last.end());
+
+            if (node->object.empty())
+            {
+                lastComponents[node] = last;
+                continue;
+            }
+            preds[k] = last;
+            for (unsigned j = 1; j < node->object.size(); ++j)
+                preds[k+j].push_back(k+j-1);
+            k += (unsigned)node->object.size();
+            lastComponents[node] = helper::vector<unsigned>(1, k-1);
+        }
+    }
+
+    // Links and Data links, in the order of the traversal
+    helper::vector< helper::vector<unsigned> > dataInputs(nbComponents);
+    for (unsigned k = 0; k < nbComponents; ++k)
+    {
+        core::objectmodel::BaseObject* obj = components[k].object;
+
+        const core::objectmodel::Base::VecLink& links = obj->getLinks();
+        for (unsigned l = 0; l < links.size(); ++l)
+        {
+            for (unsigned i = 0; i < links[l]->getSize(); ++i)
+            {
+                std::map<core::objectmodel::Base*, unsigned>::const_iterator it = componentIds.find(links[l]->getLinkedBase(i));
+                if (it != componentIds.end() && it->second != k)
+                    preds[std::max(k, it->second)].push_back(std::min(k, it->second));
+            }
+        }
+
+        const core::objectmodel::Base::VecData& datas = obj->getDataFields();
+        for (unsigned d = 0; d < datas.size(); ++d)
+        {
+            const core::objectmodel::DDGNode::DDGLinkContainer& inputs = datas[d]->getInputs();
+            for (core::objectmodel::DDGNode::DDGLinkIterator in = inputs.begin(); in != inputs.end(); ++in)
+            {
+                std::map<core::objectmodel::Base*, unsigned>::const_iterator it = componentIds.find((*in)->getOwner());
+                if (it == componentIds.end() || it->second == k) continue;
+                preds[std::max(k, it->second)].push_back(std::min(k, it->second));
+                dataInputs[k].push_back(it->second);
+            }
+        }
+    }
+
+    // reading an input may update the engine owning it, and in turn the
+    // engines it depends on: the readers of a same engine, directly or not, are chained
+    helper::vector<bool> isEngine(nbComponents);
+    for (unsigned k = 0; k < nbComponents; ++k)
+    {
+        isEngine[k] = dynamic_cast<core::DataEngine*>(components[k].object) != NULL;
+        std::sort(dataInputs[k].begin(), dataInputs[k].end());
+        dataInputs[k].erase(std::unique(dataInputs[k].begin(), dataInputs[k].end()), dataInputs[k].end());
+    }
+    helper::vector< helper::vector<unsigned> > upstream(nbComponents);
+    helper::vector<bool> visited(nbComponents);
+    std::map< unsigned, helper::vector<unsigned> > engineReaders;
+    for (unsigned k = 0; k < nbComponents; ++k)
+    {
+        const helper::vector<unsigned>& engines = collectUpstreamEngines(k, dataInputs, isEngine, upstream, visited);
+        for (unsigned e = 0; e < engines.size(); ++e)
+            engineReaders[engines[e]].push_back(k);
+    }
+    for (std::map< unsigned, helper::vector<unsigned> >::iterator it = engineReaders.begin(); it != engineReaders.end(); ++it)
+    {
+        const helper::vector<unsigned>& readers = it->second;
+        for (unsigned r = 1; r < readers.size(); ++r)
+            preds[readers[r]].push_back(readers[r-1]);
+    }
+
+    helper::vector< helper::vector<unsigned> > succs(nbComponents);
+    for (unsigned i = 0; i < nbComponents; ++i)
+    {
+        std::sort(preds[i].begin(), preds[i].end());
+        preds[i].erase(std::unique(preds[i].begin(), preds[i].end()), preds[i].end());
+        for (unsigned p = 0; p < preds[i].size(); ++p)
+            succs[preds[i][p]].push_back(i);
+    }
+    compress(preds, predBegin, predIndex);
+    compress(succs, succBegin, succIndex);
+}
+
+void InitScheduler::run(bool backward, const core::ExecParams* params)
+{
+    const unsigned nbComponents = (unsigned)components.size();
+    if (!nbComponents) return;
+    const double ticks = (double)CTime::getRefTicksPerSec();
+
+    // bwdInit goes in the reverse order: a component waits for its successors
+    const helper::vector<unsigned>& waitBegin = backward ? succBegin : predBegin;
+    const helper::vector<unsigned>& nextBegin = backward ? predBegin : succBegin;
+    const helper::vector<unsigned>& nextIndex = backward ? predIndex : succIndex;
+
+    // the ready components are started in the order of InitVisitor
+    std::priority_queue< unsigned, std::vector<unsigned>, std::greater<unsigned> > ready;
+    helper::vector<unsigned> remaining(nbComponents);
+    for (unsigned i = 0; i < nbComponents; ++i)
+    {
+        remaining[i] = waitBegin[i+1] - waitBegin[i];
+        if (remaining[i] == 0)
+            ready.push(backward ? nbComponents-1-i : i);
+    }
+    unsigned nbDone = 0;
+    std::mutex mutex;
+    std::condition_variable cond;
+
+#ifdef _OPENMP
+    #pragma omp parallel if (parallel && nbComponents > 1)
+#endif
+    for (;;)
+    {
+        unsigned i;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (ready.empty() && nbDone < nbComponents)
+                cond.wait(lock);
+            if (ready.empty()) break;
+            i = backward ? nbComponents-1-ready.top() : ready.top();
+            ready.pop();
+        }
+
+        ComponentTiming& t = components[i];
+        if (t.object) // NULL if it was removed during the init
+        {
+            const ctime_t t0 = CTime::getRefTime();
+            if (backward)
+            {
+                t.object->bwdInit();
+                t.bwdInitTime = (double)(CTime::getRefTime() - t0) / ticks;
+            }
+            else
+            {
+                t.object->init();
+                t.initTime = (double)(CTime::getRefTime() - t0) / ticks;
+                t.object->computeBBox(params, true);
+            }
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            ++nbDone;
+            for (unsigned n = nextBegin[i]; n < nextBegin[i+1]; ++n)
+            {
+                const unsigned j = nextIndex[n];
+                if (--remaining[j] == 0)
+                    ready.push(backward ? nbComponents-1-j : j);
+            }
+        }
+        cond.notify_all();
+    }
+}
+
+void InitScheduler::initAddedComponents(simulation::Node* root, const core::ExecParams* params)
+{
+    const std::set<Node*> known(nodes.begin(), nodes.end());
+    InitializeNodesVisitor initNodes(params, nodes, known);
+    initNodes.execute(root);
+
+    helper::vector<core::objectmodel::BaseObject*> objects;
+    CollectComponentsVisitor collectComponents(params, objects);
+    collectComponents.execute(root);
+
+    // the removed components are forgotten
+    const std::set<core::objectmodel::BaseObject*> current(objects.begin(), objects.end());
+    std::set<core::objectmodel::BaseObject*> scheduled;
+    for (unsigned i = 0; i < components.size(); ++i)
+    {
+        if (current.find(components[i].object) == current.end())
+            components[i].object = NULL;
+        else
+            scheduled.insert(components[i].object);
+    }
+
+    const double ticks = (double)CTime::getRefTicksPerSec();
+    for (unsigned i = 0; i < objects.size(); ++i)
+    {
+        if (scheduled.find(objects[i]) != scheduled.end()) continue;
+        ComponentTiming t;
+        t.object = objects[i];
+        const ctime_t t0 = CTime::getRefTime();
+        t.object->init();
+        t.initTime = (double)(CTime::getRefTime() - t0) / ticks;
+        t.object->computeBBox(params, true);
+        components.push_back(t);
+        // no dependency: they are the first ones to run bwdInit()
+        predBegin.push_back(predBegin.back());
+        succBegin.push_back(succBegin.back());
+    }
+}
+
+double InitScheduler::computeCriticalPath(bool backward, helper::vector<ComponentTiming>& path) const
+{
+    path.clear();
+    const unsigned nbComponents = (unsigned)components.size();
+    if (!nbComponents) return 0;
+
+    const helper::vector<unsigned>& waitBegin = backward ? succBegin : predBegin;
+    const helper::vector<unsigned>& waitIndex = backward ? succIndex : predIndex;
+
+    // the dependencies of a component come before it in the pass order
+    helper::vector<double> finish(components.size(), 0.0);
+    helper::vector<int> bestPred(components.size(), -1);
+    unsigned last = backward ? nbComponents-1 : 0;
+    for (unsigned k = 0; k < nbComponents; ++k)
+    {
+        const unsigned i = backward ? nbComponents-1-k : k;
+        double start = 0;
+        for (unsigned p = waitBegin[i]; p < waitBegin[i+1]; ++p)
+        {
+            if (bestPred[i] < 0 || finish[waitIndex[p]] > start)
+            {
+                start = finish[waitIndex[p]];
+                bestPred[i] = (int)waitIndex[p];
+            }
+        }
+        finish[i] = start + (backward ? components[i].bwdInitTime : components[i].initTime);
+        if (finish[i] > finish[last])
+            last = i;
+    }
+
+    for (int i = (int)last; i >= 0; i = bestPred[i])
+        path.push_back(components[i]);
+    std::reverse(path.begin(), path.end());
+    return finish[last];
+}
+
+void InitScheduler::printReport(std::ostream& out) const
+{
+    out << components.size() << " components, " << getNbDependencies() << " dependencies, "
+        << totalComponentTime*1000 << " ms in components, "
+        << elapsedTime*1000 << " ms elapsed" << std::endl;
+    out << "critical path: " << criticalPathTime*1000 << " ms" << std::endl;
+    for (unsigned i = 0; i < initCriticalPath.size(); ++i)
+        if (initCriticalPath[i].object)
+            out << "  init " << initCriticalPath[i].object->getPathName() << " (" << initCriticalPath[i].object->getClassName()
+                << "): " << initCriticalPath[i].initTime*1000 << " ms" << std::endl;
+    for (unsigned i = 0; i < bwdInitCriticalPath.size(); ++i)
+        if (bwdInitCriticalPath[i].object)
+            out << "  bwdInit " << bwdInitCriticalPath[i].object->getPathName() << " (" << bwdInitCriticalPath[i].object->getClassName()
+                << "): " << bwdInitCriticalPath[i].bwdInitTime*1000 << " ms" << std::endl;
+
+    helper::vector< std::pair<double, unsigned> > sorted(components.size());
+    for (unsigned i = 0; i < components.size(); ++i)
+        sorted[i] = std::make_pair(-(components[i].initTime + components[i].bwdInitTime), i);
+    std::sort(sorted.begin(), sorted.end());
+    out << "components:" << std::endl;
+    for (unsigned k = 0; k < sorted.size(); ++k)
+    {
+        const ComponentTiming& t = components[sorted[k].second];
+        if (!t.object) continue;
+        out << "  " << t.object->getPathName() << " (" << t.object->getClassName() << "): init "
+            << t.initTime*1000 << " ms, bwdInit " << t.bwdInitTime*1000 << " ms" << std::endl;
+    }
+}
+
+} // namespace simulation
+
+} // namespace sofa
@@ -0,0 +1,163 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2018 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#ifndef SOFA_SIMULATION_INITSCHEDULER_H
+#define SOFA_SIMULATION_INITSCHEDULER_H
+
+#include <sofa/simulation/simulationcore.h>
+#include <sofa/core/objectmodel/BaseObject.h>
+#include <sofa/core/ExecParams.h>
+#include <sofa/helper/vector.h>
+#include <iostream>
+
+namespace sofa
+{
+
+namespace simulation
+{
+
+class Node;
+
+/**
+ *  \brief Initializes a scene graph, running the init of independent components concurrently.
+ *
+ *  It does the work of InitVisitor. The components are listed in the order
+ *  InitVisitor initializes them, and each one depends on:
+ *  - the previous component of its node, or the last components of the parent
+ *    nodes for the first one. Components of a same node usually find each other
+ *    through their context rather than through links, so their order is kept;
+ *  - the components its Data are linked to and the targets of its Links. The
+ *    one coming first in the traversal is initialized first;
+ *  - the previous reader of a same DataEngine, directly or through other
+ *    components and engines, as reading the outputs of an engine can trigger
+ *    its update and the update of the engines it depends on.
+ *
+ *  The init() of the components whose dependencies are done run concurrently
+ *  (OpenMP), then their bwdInit() with the dependencies reversed. All the init()
+ *  calls come before the bwdInit() calls, as with the traversal of DAGSimulation.
+ *  The traversal of TreeSimulation runs the bwdInit() of a subtree before the
+ *  init() of its next sibling, so this order differs from InitVisitor there.
+ *
+ *  Node::initialize() (context propagation and sorting of the components) and
+ *  Node::bwdInit() modify the nodes: they are run sequentially, before the
+ *  init() and the bwdInit() of the components respectively. Components added
+ *  during the init are initialized afterwards, sequentially. Components looking
+ *  for components of unrelated branches or modifying the graph in their init
+ *  are not safe to initialize concurrently: disable the parallel mode for such scenes.
+ *
+ *  When the parallel mode is disabled, the scene is initialized by a traversal
+ *  doing the work of InitVisitor, in its order whatever the simulation, and
+ *  the dependency graph is only built to compute the critical paths.
+ *
+ *  The time spent in init() and bwdInit() by each component is measured, and
+ *  the longest chains of dependent components (the critical paths) are kept.
+ */
+class SOFA_SIMULATION_CORE_API InitScheduler
+{
+public:
+    typedef core::objectmodel::BaseObject BaseObject;
+
+    struct ComponentTiming
+    {
+        ComponentTiming() : object(NULL), initTime(0), bwdInitTime(0) {}
+        BaseObject* object;
+        double initTime; ///< time spent in init(), in seconds
+        double bwdInitTime; ///< time spent in bwdInit(), in seconds
+    };
+
+    InitScheduler();
+
+    /// Initialize the nodes and the components of the subtree rooted at the given node
+    void init(simulation::Node* root, const core::ExecParams* params = NULL);
+
+    /// Initialize independent components concurrently (default), or in the order of InitVisitor
+    void setParallel(bool b) { parallel = b; }
+    bool isParallel() const { return parallel; }
+
+    /// Components initialized by the last call, in the order of InitVisitor
+    const helper::vector<ComponentTiming>& getComponents() const { return components; }
+
+    /// Number of dependencies between the components of the last call
+    size_t getNbDependencies() const { return predIndex.size(); }
+
+    /// Components of the critical path of the init() pass, from the first to initialize to the last
+    const helper::vector<ComponentTiming>& getInitCriticalPath() const { return initCriticalPath; }
+
+    /// Components of the critical path of the bwdInit() pass, from the first to initialize to the last
+    const helper::vector<ComponentTiming>& getBwdInitCriticalPath() const { return bwdInitCriticalPath; }
+
+    /// Sum of the init() and bwdInit() times along the critical paths, in seconds
+    double getCriticalPathTime() const { return criticalPathTime; }
+
+    /// Sum of the init() and bwdInit() times of all the components, in seconds
+    double getTotalComponentTime() const { return totalComponentTime; }
+
+    /// Elapsed time of the last call, in seconds
+    double getElapsedTime() const { return elapsedTime; }
+
+    /// Print the components sorted by decreasing init time, and the critical paths
+    void printReport(std::ostream& out) const;
+
+protected:
+    bool parallel;
+
+    helper::vector<simulation::Node*> nodes;
+    helper::vector<ComponentTiming> components;
+    /// predecessors and successors of each component in the dependency graph, in compressed rows
+    helper::vector<unsigned> predBegin;
+    helper::vector<unsigned> predIndex;
+    helper::vector<unsigned> succBegin;
+    helper::vector<unsigned> succIndex;
+
+    helper::vector<ComponentTiming> initCriticalPath;
+    helper::vector<ComponentTiming> bwdInitCriticalPath;
+    double criticalPathTime;
+    double totalComponentTime;
+    double elapsedTime;
+
+    /// Traverse the subtree as InitVisitor does, measuring the time spent in each component
+    void initSequentially(simulation::Node* root, const core::ExecParams* params);
+
+    /// Run the init() and bwdInit() of the components as soon as their dependencies are done
+    void initConcurrently(simulation::Node* root, const core::ExecParams* params);
+
+    /// Initialize the nodes and list the components of the subtree, in the order of InitVisitor
+    void collect(simulation::Node* root, const core::ExecParams* params);
+
+    /// Build the dependency graph of the listed components
+    void schedule();
+
+    /// Run the init() (or the bwdInit() if backward) of the components as soon as their dependencies are done
+    void run(bool backward, const core::ExecParams* params);
+
+    /// Initialize sequentially the components added to the graph during the init() pass, forget the removed ones
+    void initAddedComponents(simulation::Node* root, const core::ExecParams* params);
+
+    double computeCriticalPath(bool backward, helper::vector<ComponentTiming>& path) const;
+
+    void clear();
+};
+
+} // namespace simulation
+
+} // namespace sofa
+
+#endif
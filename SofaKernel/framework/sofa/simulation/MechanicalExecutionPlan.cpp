@@ -0,0 +1,396 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2018 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#include <sofa/simulation/MechanicalExecutionPlan.h>
+#include <sofa/simulation/MechanicalVisitor.h>
+#include <sofa/simulation/Node.h>
+#include <sofa/helper/cast.h>
+#include <map>
+
+namespace sofa
+{
+
+namespace simulation
+{
+
+namespace
+{
+
+/// Visitor recording the nodes reached by a mechanical traversal, in traversal order
+class MechanicalPlanRecorderVisitor : public BaseMechanicalVisitor
+{
+public:
+    MechanicalPlanRecorderVisitor(const core::ExecParams* params)
+        : BaseMechanicalVisitor(params)
+    {
+    }
+
+    Result processNodeTopDown(simulation::Node* node) override
+    {
+        nodes.push_back(node);
+        return RESULT_CONTINUE;
+    }
+
+    void processNodeBottomUp(simulation::Node* /*node*/) override
+    {
+    }
+
+    const char* getClassName() const override { return "MechanicalPlanRecorderVisitor"; }
+
+    helper::vector<simulation::Node*> nodes;
+};
+
+inline MechanicalExecutionPlan::Call makeCall(MechanicalExecutionPlan::Call::Method method)
+{
+    MechanicalExecutionPlan::Call call;
+    call.method = method;
+    return call;
+}
+
+} // namespace
+
+bool MechanicalExecutionPlan::enabled = true;
+
+void MechanicalExecutionPlan::SetEnabled(bool e)
+{
+    enabled = e;
+}
+
+bool MechanicalExecutionPlan::IsEnabled()
+{
+    return enabled;
+}
+
+MechanicalExecutionPlan::MechanicalExecutionPlan()
+    : revision(0)
+    , compiled(false)
+    , supported(true)
+{
+}
+
+MechanicalExecutionPlan* MechanicalExecutionPlan::Get(core::objectmodel::BaseContext* ctx, const core::ExecParams* params)
+{
+#if defined(SOFA_DUMP_VISITOR_INFO) || defined(SOFA_VERBOSE_TRAVERSAL)
+    // the visitors must run to be traced
+    SOFA_UNUSED(ctx);
+    SOFA_UNUSED(params);
+    return NULL;
+#else
+    // tags restrict the visited components per call, the plans record all of them
+    if (!enabled || !ctx || !ctx->getTags().empty())
+        return NULL;
+    core::objectmodel::BaseNode* node = ctx->toBaseNode();
+    if (!node)
+        return NULL;
+    return down_cast<Node>(node)->getMechanicalExecutionPlan(params);
+#endif
+}
+
+void MechanicalExecutionPlan::compile(Node* root, const core::ExecParams* params)
+{
+    nodes.clear();
+    mappings.clear();
+    vOpCalls.clear();
+    vOpMappedCalls.clear();
+    propagateCalls.clear();
+    propagateAllCalls.clear();
+    forceCalls.clear();
+    projectCalls.clear();
+    revision = Node::getGraphRevision();
+    compiled = true;
+    supported = true;
+
+    // let a visitor find the reachable nodes, so that the same activation and sleeping rules apply
+    MechanicalPlanRecorderVisitor recorder(params);
+    root->executeVisitor(&recorder);
+
+    std::map<Node*,unsigned> indices;
+    nodes.resize(recorder.nodes.size());
+    for (std::size_t i = 0; i < recorder.nodes.size(); ++i)
+    {
+        Node* node = recorder.nodes[i];
+        NodeEntry& entry = nodes[i];
+        entry.node = node;
+        entry.parent = -1;
+        indices[node] = (unsigned)i;
+        if (i == 0)
+            continue;
+        if (node->getNbParents() != 1)
+        {
+            // a node shared by several parents is visited once, at a place the plan can not reproduce
+            supported = false;
+            return;
+        }
+        std::map<Node*,unsigned>::const_iterator parent = indices.find(down_cast<Node>(node->getFirstParent()));
+        if (parent == indices.end())
+        {
+            supported = false;
+            return;
+        }
+        entry.parent = (int)parent->second;
+        nodes[parent->second].children.push_back((unsigned)i);
+    }
+
+    for (std::size_t i = 0; i < nodes.size(); ++i)
+    {
+        if (BaseMapping* map = nodes[i].node->mechanicalMapping)
+            mappings.push_back(std::make_pair(map, map->areForcesMapped()));
+    }
+
+    if (nodes.empty())
+        return;
+
+    record(0, STATES, true, vOpCalls);
+    record(0, STATES, false, vOpMappedCalls);
+    record(0, PROPAGATION, true, propagateCalls);
+    record(0, PROPAGATION, false, propagateAllCalls);
+    record(0, FORCES, true, forceCalls);
+    record(0, PROJECTION, false, projectCalls);
+}
+
+void MechanicalExecutionPlan::record(unsigned index, int methods, bool prune, CallList& calls) const
+{
+    const NodeEntry& entry = nodes[index];
+    Node* node = entry.node;
+    BaseMechanicalState* mm = node->mechanicalState;
+    BaseMapping* map = node->mechanicalMapping;
+    const bool stop = prune && map && !map->areForcesMapped();
+
+    if (!stop)
+    {
+        if (map && (methods & (1<<Call::FWD_MAPPING)))
+        {
+            Call call = makeCall(Call::FWD_MAPPING);
+            call.mapping = map;
+            calls.push_back(call);
+        }
+        if (mm && (methods & (1<<(map ? Call::FWD_MAPPED_STATE : Call::FWD_STATE))))
+        {
+            Call call = makeCall(map ? Call::FWD_MAPPED_STATE : Call::FWD_STATE);
+            call.state = mm;
+            calls.push_back(call);
+        }
+        if (methods & (1<<Call::FWD_FORCEFIELD))
+        {
+            for (unsigned i = 0; i < node->forceField.size(); ++i)
+            {
+                Call call = makeCall(Call::FWD_FORCEFIELD);
+                call.forceField = node->forceField[i];
+                calls.push_back(call);
+            }
+            for (unsigned i = 0; i < node->interactionForceField.size(); ++i)
+            {
+                Call call = makeCall(Call::FWD_FORCEFIELD);
+                call.forceField = node->interactionForceField[i];
+                calls.push_back(call);
+            }
+        }
+        for (std::size_t i = 0; i < entry.children.size(); ++i)
+            record(entry.children[i], methods, prune, calls);
+    }
+
+    if (methods & (1<<Call::BWD_PROJECTIVE))
+    {
+        for (unsigned i = 0; i < node->projectiveConstraintSet.size(); ++i)
+        {
+            Call call = makeCall(Call::BWD_PROJECTIVE);
+            call.constraint = node->projectiveConstraintSet[i];
+            calls.push_back(call);
+        }
+    }
+    if (mm && map && !stop && (methods & (1<<Call::BWD_MAPPING)))
+    {
+        Call call = makeCall(Call::BWD_MAPPING);
+        call.mapping = map;
+        calls.push_back(call);
+    }
+    else if (mm && !map && (methods & (1<<Call::BWD_STATE)))
+    {
+        Call call = makeCall(Call::BWD_STATE);
+        call.state = mm;
+        calls.push_back(call);
+    }
+}
+
+bool MechanicalExecutionPlan::isValid() const
+{
+    if (!compiled || revision != Node::getGraphRevision())
+        return false;
+    for (std::size_t i = 0; i < mappings.size(); ++i)
+        if (mappings[i].first->areForcesMapped() != mappings[i].second)
+            return false;
+    return true;
+}
+
+void MechanicalExecutionPlan::vOp(const core::ExecParams* params, core::MultiVecId v, core::ConstMultiVecId a, core::ConstMultiVecId b, SReal f, bool mapped, bool onlyMapped) const
+{
+    const CallList& calls = (mapped || onlyMapped) ? vOpMappedCalls : vOpCalls;
+    for (CallList::const_iterator it = calls.begin(); it != calls.end(); ++it)
+    {
+        BaseMechanicalState* mm = it->state;
+        if (it->method == Call::FWD_STATE ? !onlyMapped : (mapped || onlyMapped))
+            mm->vOp(params, v.getId(mm), a.getId(mm), b.getId(mm), f);
+    }
+}
+
+SReal MechanicalExecutionPlan::vDot(const core::ExecParams* params, core::ConstMultiVecId a, core::ConstMultiVecId b) const
+{
+    SReal result = 0;
+    for (CallList::const_iterator it = vOpCalls.begin(); it != vOpCalls.end(); ++it)
+    {
+        if (it->method == Call::FWD_STATE)
+            result += it->state->vDot(params, a.getId(it->state), b.getId(it->state));
+    }
+    return result;
+}
+
+void MechanicalExecutionPlan::propagateDx(const core::MechanicalParams* mparams, core::MultiVecDerivId dx, bool ignoreMask, bool ignoreFlag) const
+{
+    const CallList& calls = ignoreFlag ? propagateAllCalls : propagateCalls;
+    for (CallList::const_iterator it = calls.begin(); it != calls.end(); ++it)
+    {
+        if (it->method == Call::FWD_MAPPING)
+        {
+            BaseMapping* map = it->mapping;
+            if (!ignoreMask)
+            {
+                BaseMechanicalVisitor::ForceMaskActivate(map->getMechFrom());
+                BaseMechanicalVisitor::ForceMaskActivate(map->getMechTo());
+            }
+            map->applyJ(mparams, dx, dx);
+            if (!ignoreMask)
+                BaseMechanicalVisitor::ForceMaskDeactivate(map->getMechTo());
+        }
+        else if (!ignoreMask)
+        {
+            it->state->forceMask.activate(false);
+        }
+    }
+}
+
+void MechanicalExecutionPlan::propagateXAndV(const core::MechanicalParams* mparams, core::MultiVecCoordId x, core::MultiVecDerivId v, bool ignoreMask) const
+{
+    for (CallList::const_iterator it = propagateAllCalls.begin(); it != propagateAllCalls.end(); ++it)
+    {
+        if (it->method == Call::FWD_MAPPING)
+        {
+            BaseMapping* map = it->mapping;
+            if (!ignoreMask)
+            {
+                BaseMechanicalVisitor::ForceMaskActivate(map->getMechFrom());
+                BaseMechanicalVisitor::ForceMaskActivate(map->getMechTo());
+            }
+            map->apply(mparams, x, x);
+            map->applyJ(mparams, v, v);
+            if (!ignoreMask)
+                BaseMechanicalVisitor::ForceMaskDeactivate(map->getMechTo());
+        }
+        else
+        {
+            it->state->forceMask.activate(false);
+        }
+    }
+}
+
+void MechanicalExecutionPlan::resetForce(const core::ExecParams* params, core::MultiVecDerivId res, bool onlyMapped) const
+{
+    for (CallList::const_iterator it = vOpCalls.begin(); it != vOpCalls.end(); ++it)
+    {
+        if (it->method == Call::FWD_MAPPED_STATE || !onlyMapped)
+            it->state->resetForce(params, res.getId(it->state));
+    }
+}
+
+void MechanicalExecutionPlan::computeForce(const core::MechanicalParams* mparams, core::MultiVecDerivId res, bool accumulate, bool neglectingCompliance) const
+{
+    for (CallList::const_iterator it = forceCalls.begin(); it != forceCalls.end(); ++it)
+    {
+        switch (it->method)
+        {
+        case Call::FWD_STATE:
+        case Call::FWD_MAPPED_STATE:
+            it->state->accumulateForce(mparams, res.getId(it->state));
+            break;
+        case Call::FWD_FORCEFIELD:
+            if (!neglectingCompliance || !it->forceField->isCompliance.getValue()) it->forceField->addForce(mparams, res);
+            else it->forceField->updateForceMask(); // compliances must update the force mask too
+            break;
+        case Call::BWD_MAPPING:
+            if (accumulate)
+            {
+                BaseMapping* map = it->mapping;
+                BaseMechanicalVisitor::ForceMaskActivate(map->getMechFrom());
+                BaseMechanicalVisitor::ForceMaskActivate(map->getMechTo());
+                map->applyJT(mparams, res, res);
+                BaseMechanicalVisitor::ForceMaskDeactivate(map->getMechTo());
+            }
+            break;
+        case Call::BWD_STATE:
+            it->state->forceMask.activate(false);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+void MechanicalExecutionPlan::computeDf(const core::MechanicalParams* mparams, core::MultiVecDerivId res, bool accumulate) const
+{
+    for (CallList::const_iterator it = forceCalls.begin(); it != forceCalls.end(); ++it)
+    {
+        switch (it->method)
+        {
+        case Call::FWD_FORCEFIELD:
+            if (!it->forceField->isCompliance.getValue()) it->forceField->addDForce(mparams, res);
+            break;
+        case Call::BWD_MAPPING:
+            if (accumulate)
+            {
+                BaseMapping* map = it->mapping;
+                BaseMechanicalVisitor::ForceMaskActivate(map->getMechFrom());
+                BaseMechanicalVisitor::ForceMaskActivate(map->getMechTo());
+                map->applyJT(mparams, res, res);
+                if (mparams->kFactor()) map->applyDJT(mparams, res, res);
+                BaseMechanicalVisitor::ForceMaskDeactivate(map->getMechTo());
+            }
+            break;
+        case Call::BWD_STATE:
+            it->state->forceMask.activate(false);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+void MechanicalExecutionPlan::projectResponse(const core::MechanicalParams* mparams, core::MultiVecDerivId res, double** W) const
+{
+    for (CallList::const_iterator it = projectCalls.begin(); it != projectCalls.end(); ++it)
+    {
+        it->constraint->projectResponse(mparams, res);
+        if (W != NULL)
+            it->constraint->projectResponse(mparams, W);
+    }
+}
+
+} // namespace simulation
+
+} // namespace sofa
@@ -0,0 +1,195 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2018 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#ifndef SOFA_SIMULATION_MECHANICALEXECUTIONPLAN_H
+#define SOFA_SIMULATION_MECHANICALEXECUTIONPLAN_H
+
+#include <sofa/simulation/simulationcore.h>
+#include <sofa/core/MechanicalParams.h>
+#include <sofa/core/MultiVecId.h>
+#include <sofa/core/objectmodel/BaseContext.h>
+#include <sofa/helper/vector.h>
+
+namespace sofa
+{
+
+namespace core
+{
+class BaseMapping;
+namespace behavior
+{
+class BaseMechanicalState;
+class BaseForceField;
+class BaseProjectiveConstraintSet;
+} // namespace behavior
+} // namespace core
+
+namespace simulation
+{
+
+class Node;
+
+/**
+ *  \brief Flat lists of the component calls done by the hottest mechanical visitors.
+ *
+ *  Solvers run vector operations, force accumulations and mapping propagations
+ *  many times per time step, each of them being a full traversal of the scene
+ *  graph that mostly skips empty nodes and re-tests the same mapping flags.
+ *  This plan walks the subtree once, records in traversal order the
+ *  (component, method) pairs each of these visitors would reach, and replays
+ *  them as plain loops.
+ *
+ *  The lists follow the rules of the corresponding visitors: sleeping and
+ *  inactive nodes are skipped, the subtree below a mapping whose forces are not
+ *  mapped is pruned, and the bottom-up calls are interleaved with the top-down
+ *  ones as in the graph traversal.
+ *
+ *  A plan is owned by the Node it was compiled from (see
+ *  Node::getMechanicalExecutionPlan) and is recompiled after any change of the
+ *  graph: nodes or components added, removed or moved, nodes (de)activated or
+ *  put to sleep, or a mapping changing its mapForces flag.
+ *  Subtrees containing nodes with several parents are not supported, the
+ *  visitors are used for them.
+ */
+class SOFA_SIMULATION_CORE_API MechanicalExecutionPlan
+{
+public:
+    typedef core::behavior::BaseMechanicalState BaseMechanicalState;
+    typedef core::behavior::BaseForceField BaseForceField;
+    typedef core::behavior::BaseProjectiveConstraintSet BaseProjectiveConstraintSet;
+    typedef core::BaseMapping BaseMapping;
+
+    /// One recorded call
+    struct Call
+    {
+        enum Method
+        {
+            FWD_STATE,          ///< unmapped mechanical state, top-down
+            FWD_MAPPED_STATE,   ///< mapped mechanical state, top-down
+            FWD_MAPPING,        ///< mechanical mapping, top-down
+            FWD_FORCEFIELD,     ///< force field or interaction force field, top-down
+            BWD_PROJECTIVE,     ///< projective constraint, bottom-up
+            BWD_MAPPING,        ///< mechanical mapping, bottom-up
+            BWD_STATE           ///< unmapped mechanical state, bottom-up
+        };
+        Method method;
+        union
+        {
+            BaseMechanicalState* state;
+            BaseMapping* mapping;
+            BaseForceField* forceField;
+            BaseProjectiveConstraintSet* constraint;
+        };
+    };
+    typedef helper::vector<Call> CallList;
+
+    MechanicalExecutionPlan();
+
+    /// Record the calls of the subtree rooted at the given node
+    void compile(Node* root, const core::ExecParams* params);
+
+    /// Check that the plan still matches the graph it was compiled from
+    bool isValid() const;
+
+    /// False if the subtree can not be replayed (nodes with several parents)
+    bool isSupported() const { return supported; }
+
+    /// Plan to use instead of a visitor started from the given context,
+    /// or NULL if the visitor must be executed
+    static MechanicalExecutionPlan* Get(core::objectmodel::BaseContext* ctx, const core::ExecParams* params);
+
+    /// Globally enable or disable the replay of execution plans (enabled by default)
+    static void SetEnabled(bool enabled);
+    static bool IsEnabled();
+
+    /// @name Replays of the mechanical visitors
+    /// @{
+
+    /// MechanicalVOpVisitor: v = a + b*f
+    void vOp(const core::ExecParams* params, core::MultiVecId v, core::ConstMultiVecId a, core::ConstMultiVecId b, SReal f, bool mapped=false, bool onlyMapped=false) const;
+    /// MechanicalVDotVisitor: a.b over the unmapped states
+    SReal vDot(const core::ExecParams* params, core::ConstMultiVecId a, core::ConstMultiVecId b) const;
+    /// MechanicalPropagateDxVisitor
+    void propagateDx(const core::MechanicalParams* mparams, core::MultiVecDerivId dx, bool ignoreMask, bool ignoreFlag) const;
+    /// MechanicalPropagateOnlyPositionAndVelocityVisitor
+    void propagateXAndV(const core::MechanicalParams* mparams, core::MultiVecCoordId x, core::MultiVecDerivId v, bool ignoreMask) const;
+    /// MechanicalResetForceVisitor
+    void resetForce(const core::ExecParams* params, core::MultiVecDerivId res, bool onlyMapped) const;
+    /// MechanicalComputeForceVisitor
+    void computeForce(const core::MechanicalParams* mparams, core::MultiVecDerivId res, bool accumulate, bool neglectingCompliance) const;
+    /// MechanicalComputeDfVisitor
+    void computeDf(const core::MechanicalParams* mparams, core::MultiVecDerivId res, bool accumulate) const;
+    /// MechanicalApplyConstraintsVisitor
+    void projectResponse(const core::MechanicalParams* mparams, core::MultiVecDerivId res, double** W) const;
+
+    /// @}
+
+    /// Number of nodes reached by the traversal
+    std::size_t getNbNodes() const { return nodes.size(); }
+    /// Revision of the graph the plan was compiled from
+    unsigned getRevision() const { return revision; }
+
+protected:
+
+    /// Recorded node, in traversal order
+    struct NodeEntry
+    {
+        Node* node;
+        int parent; ///< index of the parent entry, -1 for the root
+        helper::vector<unsigned> children;
+    };
+
+    helper::vector<NodeEntry> nodes;
+
+    /// Mechanical mappings of the subtree with the mapForces flag they had when compiled
+    helper::vector< std::pair<BaseMapping*,bool> > mappings;
+
+    CallList vOpCalls;           ///< states, pruned below unmapped forces
+    CallList vOpMappedCalls;     ///< states, whole subtree
+    CallList propagateCalls;     ///< mappings and masks, pruned below unmapped forces
+    CallList propagateAllCalls;  ///< mappings and masks, whole subtree
+    CallList forceCalls;         ///< states, force fields, mappings and masks, pruned below unmapped forces
+    CallList projectCalls;       ///< projective constraints, whole subtree
+
+    unsigned revision;
+    bool compiled;
+    bool supported;
+
+    enum
+    {
+        STATES = (1<<Call::FWD_STATE)|(1<<Call::FWD_MAPPED_STATE),
+        PROPAGATION = (1<<Call::FWD_MAPPING)|(1<<Call::BWD_STATE),
+        FORCES = STATES|(1<<Call::FWD_FORCEFIELD)|(1<<Call::BWD_MAPPING)|(1<<Call::BWD_STATE),
+        PROJECTION = (1<<Call::BWD_PROJECTIVE)
+    };
+
+    /// Append the calls of the given methods for the subtree of the given entry,
+    /// pruning below the mappings not mapping forces if requested
+    void record(unsigned index, int methods, bool prune, CallList& calls) const;
+
+    static bool enabled;
+};
+
+} // namespace simulation
+
+} // namespace sofa
+
+#endif
@@ -23,6 +23,7 @@
 #include <sofa/simulation/MechanicalVisitor.h>
 #include <sofa/simulation/MechanicalMatrixVisitor.h>
 #include <sofa/simulation/MechanicalComputeEnergyVisitor.h>
+#include <sofa/simulation/MechanicalExecutionPlan.h>
 #include <sofa/core/MultiVecId.h>
 #include <sofa/core/VecId.h>
 #include <sofa/core/ConstraintParams.h>
@@ -114,7 +115,10 @@ void MechanicalOperations::setDf(core::ConstMultiVecDerivId& v)
 void MechanicalOperations::propagateDx(core::MultiVecDerivId dx, bool ignore_flag)
 {
     setDx(dx);
-    executeVisitor( MechanicalPropagateDxVisitor(&mparams, dx, false, ignore_flag) );
+    if (MechanicalExecutionPlan* plan = MechanicalExecutionPlan::Get(ctx, &mparams))
+        plan->propagateDx(&mparams, dx, false, ignore_flag);
+    else
+        executeVisitor( MechanicalPropagateDxVisitor(&mparams, dx, false, ignore_flag) );
 }
 
 /// Propagate the given displacement through all mappings and reset the current force delta
@@ -146,6 +150,13 @@ void MechanicalOperations::propagateXAndV(core::MultiVecCoordId x, core::MultiVe
 {
     setX(x);
     setV(v);
+#ifndef SOFA_SUPPORT_MAPPED_MASS
+    if (MechanicalExecutionPlan* plan = MechanicalExecutionPlan::Get(ctx, &mparams))
+    {
+        plan->propagateXAndV(&mparams, x, v, false); //Don't ignore the masks
+        return;
+    }
+#endif
     MechanicalPropagateOnlyPositionAndVelocityVisitor visitor(&mparams, 0.0, x, v, false); //Don't ignore the masks
     executeVisitor( visitor );
 }
@@ -187,7 +198,10 @@ void MechanicalOperations::projectVelocity(core::MultiVecDerivId v, SReal time)
 void MechanicalOperations::projectResponse(core::MultiVecDerivId dx, double **W)
 {
     setDx(dx);
-    executeVisitor( MechanicalApplyConstraintsVisitor(&mparams, dx, W) );
+    if (MechanicalExecutionPlan* plan = MechanicalExecutionPlan::Get(ctx, &mparams))
+        plan->projectResponse(&mparams, dx, W);
+    else
+        executeVisitor( MechanicalApplyConstraintsVisitor(&mparams, dx, W) );
 }
 
 /// Apply projective constraints to the given position and velocity vectors
@@ -223,6 +237,13 @@ void MechanicalOperations::accFromF(core::MultiVecDerivId a, core::ConstMultiVec
 void MechanicalOperations::computeForce(core::MultiVecDerivId result, bool clear, bool accumulate, bool neglectingCompliance)
 {
     setF(result);
+    if (MechanicalExecutionPlan* plan = MechanicalExecutionPlan::Get(ctx, &mparams))
+    {
+        if (clear)
+            plan->resetForce(&mparams, result, false);
+        plan->computeForce(&mparams, result, accumulate, neglectingCompliance);
+        return;
+    }
     if (clear)
     {
         executeVisitor( MechanicalResetForceVisitor(&mparams, result, false) );
@@ -236,6 +257,13 @@ void MechanicalOperations::computeForce(core::MultiVecDerivId result, bool clear
 void MechanicalOperations::computeDf(core::MultiVecDerivId df, bool clear, bool accumulate)
 {
     setDf(df);
+    if (MechanicalExecutionPlan* plan = MechanicalExecutionPlan::Get(ctx, &mparams))
+    {
+        if (clear)
+            plan->resetForce(&mparams, df, false);
+        plan->computeDf(&mparams, df, accumulate);
+        return;
+    }
     if (clear)
     {
         executeVisitor( MechanicalResetForceVisitor(&mparams, df, false) );
@@ -250,12 +278,21 @@ void MechanicalOperations::computeDfV(core::MultiVecDerivId df, bool clear, bool
     core::ConstMultiVecDerivId dx = mparams.dx();
     mparams.setDx(mparams.v());
     setDf(df);
-    if (clear)
+    if (MechanicalExecutionPlan* plan = MechanicalExecutionPlan::Get(ctx, &mparams))
     {
-        executeVisitor( MechanicalResetForceVisitor(&mparams, df, false) );
-        //finish();
+        if (clear)
+            plan->resetForce(&mparams, df, false);
+        plan->computeDf(&mparams, df, accumulate);
+    }
+    else
+    {
+        if (clear)
+        {
+            executeVisitor( MechanicalResetForceVisitor(&mparams, df, false) );
+            //finish();
+        }
+        executeVisitor( MechanicalComputeDfVisitor(&mparams, df, accumulate) );
     }
-    executeVisitor( MechanicalComputeDfVisitor(&mparams, df, accumulate) );
     mparams.setDx(dx);
 }
 
@@ -707,6 +707,13 @@ SReal MechanicalVNormVisitor::getResult() const
     else return accum;
 }
 
+Visitor::Result MechanicalVMultiDotVisitor::fwdMechanicalState(VisitorContext* /*ctx*/, core::behavior::BaseMechanicalState* mm)
+{
+    for (unsigned int i=0; i<dots.size(); ++i)
+        results[i] += mm->vDot(this->params, dots[i].first.getId(mm), dots[i].second.getId(mm) );
+    return RESULT_CONTINUE;
+}
+
 #if 0
 /// Parallel code
 Visitor::Result MechanicalVDotVisitor::processNodeTopDown(simulation::Node* /*node*/, LocalStorage* stack)
@@ -990,6 +990,56 @@ public:
 #endif
 };
 
+/** Compute several dot products in a single traversal of the graph.
+ * Each pair (a,b) of @a dots gives \f$ a \cdot b \f$ in the corresponding entry of @a results,
+ * so that all the reductions of an iteration share the same synchronization point.
+ */
+class SOFA_SIMULATION_CORE_API MechanicalVMultiDotVisitor : public BaseMechanicalVisitor
+{
+public:
+    typedef helper::vector< std::pair< sofa::core::ConstMultiVecId, sofa::core::ConstMultiVecId > > VecDots;
+    VecDots dots;
+    SReal* results;
+    MechanicalVMultiDotVisitor(const sofa::core::ExecParams* params, const VecDots& dots, SReal* results)
+        : BaseMechanicalVisitor(params), dots(dots), results(results)
+    {
+#ifdef SOFA_DUMP_VISITOR_INFO
+        setReadWriteVectors();
+#endif
+        for (unsigned int i=0; i<dots.size(); ++i)
+            results[i] = 0;
+    }
+
+    virtual Result fwdMechanicalState(VisitorContext* ctx, core::behavior::BaseMechanicalState* mm);
+
+    /// Return a class name for this visitor
+    /// Only used for debugging / profiling purposes
+    virtual const char* getClassName() const { return "MechanicalVMultiDotVisitor";}
+    virtual std::string getInfos() const
+    {
+        std::string name("v[i]= a[i]*b[i] with");
+        for (unsigned int i=0; i<dots.size(); ++i)
+            name += " (" + dots[i].first.getName() + "," + dots[i].second.getName() + ")";
+        return name;
+    }
+    /// Specify whether this action can be parallelized.
+    virtual bool isThreadSafe() const
+    {
+        return false;
+    }
+
+#ifdef SOFA_DUMP_VISITOR_INFO
+    void setReadWriteVectors()
+    {
+        for (unsigned int i=0; i<dots.size(); ++i)
+        {
+            addReadVector(dots[i].first);
+            addReadVector(dots[i].second);
+        }
+    }
+#endif
+};
+
 /** Apply a hypothetical displacement.
 This action does not modify the state (i.e. positions and velocities) of the objects.
 It is typically applied before a MechanicalComputeDfVisitor, in order to compute the df corresponding to a given dx (i.e. apply stiffness).
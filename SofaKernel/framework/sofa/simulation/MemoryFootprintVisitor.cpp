@@ -0,0 +1,198 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2018 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#include <sofa/simulation/MemoryFootprintVisitor.h>
+#include <sofa/core/objectmodel/BaseData.h>
+#include <sofa/core/objectmodel/BaseObject.h>
+#include <sofa/simulation/Node.h>
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace sofa
+{
+
+namespace simulation
+{
+
+namespace
+{
+
+bool greaterFootprint(const MemoryFootprintVisitor::Entry& a, const MemoryFootprintVisitor::Entry& b)
+{
+    return a.bytes > b.bytes;
+}
+
+helper::vector<MemoryFootprintVisitor::Entry> sortedEntries(const helper::vector<MemoryFootprintVisitor::Entry>& entries)
+{
+    helper::vector<MemoryFootprintVisitor::Entry> sorted(entries);
+    std::stable_sort(sorted.begin(), sorted.end(), greaterFootprint);
+    return sorted;
+}
+
+std::string formatBytes(size_t bytes)
+{
+    static const char* units[] = { "B", "KB", "MB", "GB", "TB" };
+    double value = (double)bytes;
+    int unit = 0;
+    while (value >= 1024 && unit < 4)
+    {
+        value /= 1024;
+        ++unit;
+    }
+    std::ostringstream o;
+    o << std::fixed << std::setprecision(unit ? 1 : 0) << value << ' ' << units[unit];
+    return o.str();
+}
+
+std::string jsonString(const std::string& s)
+{
+    std::ostringstream o;
+    o << '"';
+    for (std::string::const_iterator it = s.begin(); it != s.end(); ++it)
+    {
+        const unsigned char c = (unsigned char)*it;
+        if (c == '"' || c == '\\') o << '\\' << (char)c;
+        else if (c < 0x20) o << "\\u" << std::hex << std::setw(4) << std::setfill('0') << (int)c << std::dec << std::setfill(' ');
+        else o << (char)c;
+    }
+    o << '"';
+    return o.str();
+}
+
+} // namespace
+
+MemoryFootprintVisitor::MemoryFootprintVisitor(const sofa::core::ExecParams* params)
+    : Visitor(params)
+    , total(0)
+{
+}
+
+Visitor::Result MemoryFootprintVisitor::processNodeTopDown(simulation::Node* node)
+{
+    size_t bytes = node->getMemoryFootprint();
+    for (Node::ObjectIterator it = node->object.begin(); it != node->object.end(); ++it)
+    {
+        const core::objectmodel::BaseObject* obj = it->get();
+        Entry entry;
+        entry.path = obj->getPathName();
+        entry.typeName = obj->getTypeName();
+        entry.bytes = obj->getMemoryFootprint();
+        const core::objectmodel::Base::VecData& datas = obj->getDataFields();
+        for (core::objectmodel::Base::VecData::const_iterator d = datas.begin(); d != datas.end(); ++d)
+        {
+            const size_t dataBytes = (*d)->getMemoryFootprint();
+            if (dataBytes > entry.largestDataBytes)
+            {
+                entry.largestData = (*d)->getName();
+                entry.largestDataBytes = dataBytes;
+            }
+        }
+        bytes += entry.bytes;
+        objects.push_back(entry);
+    }
+    total += bytes;
+    nodeBytes[node] = bytes;
+
+    Entry entry;
+    entry.path = node->getPathName();
+    if (entry.path.empty()) entry.path = "/";
+    nodeEntries[node] = nodes.size();
+    nodes.push_back(entry);
+    return RESULT_CONTINUE;
+}
+
+void MemoryFootprintVisitor::processNodeBottomUp(simulation::Node* node)
+{
+    // the children were all visited before, unless they are shared with another parent not visited yet
+    size_t bytes = nodeBytes[node];
+    for (Node::ChildIterator it = node->child.begin(); it != node->child.end(); ++it)
+    {
+        std::map<const simulation::Node*, size_t>::const_iterator child = nodeBytes.find(it->get());
+        if (child != nodeBytes.end())
+            bytes += child->second;
+    }
+    nodeBytes[node] = bytes;
+    nodes[nodeEntries[node]].bytes = bytes;
+}
+
+void MemoryFootprintVisitor::printReport(std::ostream& out, const std::string& format) const
+{
+    if (format == "json")
+        printJSON(out);
+    else
+        printText(out);
+}
+
+void MemoryFootprintVisitor::printText(std::ostream& out) const
+{
+    out << "Memory footprint: " << formatBytes(total) << " in " << objects.size() << " objects and " << nodes.size() << " nodes" << std::endl;
+
+    const helper::vector<Entry> sortedObjects = sortedEntries(objects);
+    out << "Objects:" << std::endl;
+    for (helper::vector<Entry>::const_iterator it = sortedObjects.begin(); it != sortedObjects.end(); ++it)
+    {
+        out << std::setw(12) << formatBytes(it->bytes) << ' '
+            << std::setw(6) << std::fixed << std::setprecision(1) << (total ? 100.0*it->bytes/total : 0.0) << "%  "
+            << it->path << "  " << it->typeName;
+        if (it->largestDataBytes)
+            out << "  (largest Data: " << it->largestData << ", " << formatBytes(it->largestDataBytes) << ")";
+        out << std::endl;
+    }
+
+    const helper::vector<Entry> sortedNodes = sortedEntries(nodes);
+    out << "Nodes (including their children):" << std::endl;
+    for (helper::vector<Entry>::const_iterator it = sortedNodes.begin(); it != sortedNodes.end(); ++it)
+    {
+        out << std::setw(12) << formatBytes(it->bytes) << ' '
+            << std::setw(6) << std::fixed << std::setprecision(1) << (total ? 100.0*it->bytes/total : 0.0) << "%  "
+            << it->path << std::endl;
+    }
+}
+
+void MemoryFootprintVisitor::printJSON(std::ostream& out) const
+{
+    out << "{\n  \"total\": " << total << ",\n  \"objects\": [";
+    const helper::vector<Entry> sortedObjects = sortedEntries(objects);
+    for (helper::vector<Entry>::const_iterator it = sortedObjects.begin(); it != sortedObjects.end(); ++it)
+    {
+        out << (it == sortedObjects.begin() ? "\n" : ",\n")
+            << "    { \"path\": " << jsonString(it->path)
+            << ", \"type\": " << jsonString(it->typeName)
+            << ", \"bytes\": " << it->bytes
+            << ", \"largestData\": " << jsonString(it->largestData)
+            << ", \"largestDataBytes\": " << it->largestDataBytes << " }";
+    }
+    out << "\n  ],\n  \"nodes\": [";
+    const helper::vector<Entry> sortedNodes = sortedEntries(nodes);
+    for (helper::vector<Entry>::const_iterator it = sortedNodes.begin(); it != sortedNodes.end(); ++it)
+    {
+        out << (it == sortedNodes.begin() ? "\n" : ",\n")
+            << "    { \"path\": " << jsonString(it->path)
+            << ", \"bytes\": " << it->bytes << " }";
+    }
+    out << "\n  ]\n}" << std::endl;
+}
+
+} // namespace simulation
+
+} // namespace sofa
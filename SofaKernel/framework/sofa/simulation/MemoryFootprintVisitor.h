@@ -0,0 +1,85 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2018 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#ifndef SOFA_SIMULATION_MEMORYFOOTPRINTVISITOR_H
+#define SOFA_SIMULATION_MEMORYFOOTPRINTVISITOR_H
+
+#include <sofa/simulation/Visitor.h>
+#include <sofa/helper/vector.h>
+#include <iosfwd>
+#include <map>
+#include <string>
+
+
+namespace sofa
+{
+
+namespace simulation
+{
+
+/// Collect the memory footprint of the objects of a graph, as given by
+/// Base::getMemoryFootprint, and print it as a report sorted by decreasing size.
+class SOFA_SIMULATION_CORE_API MemoryFootprintVisitor : public Visitor
+{
+public:
+    struct Entry
+    {
+        std::string path; ///< path of the object or node in the graph
+        std::string typeName; ///< class and template names
+        size_t bytes; ///< footprint of the object, or of the node and its descendants
+        std::string largestData; ///< name of the largest Data of the object
+        size_t largestDataBytes;
+        Entry() : bytes(0), largestDataBytes(0) {}
+    };
+
+    MemoryFootprintVisitor(const sofa::core::ExecParams* params);
+
+    virtual Result processNodeTopDown(simulation::Node* node);
+    virtual void processNodeBottomUp(simulation::Node* node);
+    virtual const char* getClassName() const { return "MemoryFootprintVisitor"; }
+
+    /// Objects in visiting order
+    const helper::vector<Entry>& getObjects() const { return objects; }
+    /// Nodes in visiting order, counting the objects of their descendants
+    const helper::vector<Entry>& getNodes() const { return nodes; }
+    /// Footprint of all the visited nodes and objects
+    size_t getTotal() const { return total; }
+
+    /// Print the objects and nodes sorted by decreasing footprint, either as "text" or as "json"
+    void printReport(std::ostream& out, const std::string& format = "text") const;
+
+protected:
+    helper::vector<Entry> objects;
+    helper::vector<Entry> nodes;
+    size_t total;
+    /// footprint of each visited node, including its descendants
+    std::map<const simulation::Node*, size_t> nodeBytes;
+    std::map<const simulation::Node*, size_t> nodeEntries;
+
+    void printText(std::ostream& out) const;
+    void printJSON(std::ostream& out) const;
+};
+
+} // namespace simulation
+
+} // namespace sofa
+
+#endif
@@ -38,6 +38,7 @@
 #include <sofa/simulation/DeactivatedNodeVisitor.h>
 #include <sofa/simulation/InitVisitor.h>
 #include <sofa/simulation/MechanicalVisitor.h>
+#include <sofa/simulation/MechanicalExecutionPlan.h>
 #include <sofa/simulation/VisualVisitor.h>
 #include <sofa/simulation/UpdateMappingVisitor.h>
 
@@ -101,6 +102,9 @@ Node::Node(const std::string& name)
 
     , debug_(false)
     , initialized(false)
+    , mechanicalPlan(NULL)
+    , localRevision(0)
+    , subtreeRevision(0)
     , depend(initData(&depend,"depend","Dependencies between the nodes.\nname 1 name 2 name3 name4 means that name1 must be initialized before name2 and name3 before name4"))
 {
     _context = this;
@@ -110,6 +114,7 @@ Node::Node(const std::string& name)
 
 Node::~Node()
 {
+    delete mechanicalPlan;
 }
 
 void Node::parse( sofa::core::objectmodel::BaseObjectDescription* arg )
@@ -220,6 +225,8 @@ void Node::moveObject(BaseObject::SPtr obj)
 
 void Node::notifyAddChild(Node::SPtr node)
 {
+    graphChanged();
+    node->localRevision = getGraphRevision(); // its parents change
     for (helper::vector<MutationListener*>::const_iterator it = listener.begin(); it != listener.end(); ++it)
         (*it)->addChild(this, node.get());
 }
@@ -227,6 +234,8 @@ void Node::notifyAddChild(Node::SPtr node)
 
 void Node::notifyRemoveChild(Node::SPtr node)
 {
+    graphChanged();
+    node->localRevision = getGraphRevision();
     for (helper::vector<MutationListener*>::const_iterator it = listener.begin(); it != listener.end(); ++it)
         (*it)->removeChild(this, node.get());
 }
@@ -234,6 +243,9 @@ void Node::notifyRemoveChild(Node::SPtr node)
 
 void Node::notifyMoveChild(Node::SPtr node, Node* prev)
 {
+    graphChanged();
+    prev->graphChanged();
+    node->localRevision = getGraphRevision();
     for (helper::vector<MutationListener*>::const_iterator it = listener.begin(); it != listener.end(); ++it)
         (*it)->moveChild(prev, this, node.get());
 }
@@ -241,18 +253,22 @@ void Node::notifyMoveChild(Node::SPtr node, Node* prev)
 
 void Node::notifyAddObject(core::objectmodel::BaseObject::SPtr obj)
 {
+    graphChanged();
     for (helper::vector<MutationListener*>::const_iterator it = listener.begin(); it != listener.end(); ++it)
         (*it)->addObject(this, obj.get());
 }
 
 void Node::notifyRemoveObject(core::objectmodel::BaseObject::SPtr obj)
 {
+    graphChanged();
     for (helper::vector<MutationListener*>::const_iterator it = listener.begin(); it != listener.end(); ++it)
         (*it)->removeObject(this, obj.get());
 }
 
 void Node::notifyMoveObject(core::objectmodel::BaseObject::SPtr obj, Node* prev)
 {
+    graphChanged();
+    prev->graphChanged();
     for (helper::vector<MutationListener*>::const_iterator it = listener.begin(); it != listener.end(); ++it)
         (*it)->moveObject(prev, this, obj.get());
 }
@@ -260,24 +276,28 @@ void Node::notifyMoveObject(core::objectmodel::BaseObject::SPtr obj, Node* prev)
 
 void Node::notifyAddSlave(core::objectmodel::BaseObject* master, core::objectmodel::BaseObject* slave)
 {
+    graphChanged();
     for (helper::vector<MutationListener*>::const_iterator it = listener.begin(); it != listener.end(); ++it)
         (*it)->addSlave(master, slave);
 }
 
 void Node::notifyRemoveSlave(core::objectmodel::BaseObject* master, core::objectmodel::BaseObject* slave)
 {
+    graphChanged();
     for (helper::vector<MutationListener*>::const_iterator it = listener.begin(); it != listener.end(); ++it)
         (*it)->removeSlave(master, slave);
 }
 
 void Node::notifyMoveSlave(core::objectmodel::BaseObject* previousMaster, core::objectmodel::BaseObject* master, core::objectmodel::BaseObject* slave)
 {
+    graphChanged();
     for (helper::vector<MutationListener*>::const_iterator it = listener.begin(); it != listener.end(); ++it)
         (*it)->moveSlave(previousMaster, master, slave);
 }
 
 void Node::notifySleepChanged()
 {
+    graphChanged();
     for (helper::vector<MutationListener*>::const_iterator it = listener.begin(); it != listener.end(); ++it)
         (*it)->sleepChanged(this);
 }
@@ -981,6 +1001,43 @@ void Node::setSleeping(bool val)
     }
 }
 
+void Node::setActive(bool val)
+{
+    graphChanged();
+    Context::setActive(val);
+}
+
+MechanicalExecutionPlan* Node::getMechanicalExecutionPlan(const core::ExecParams* params)
+{
+    if (!mechanicalPlan)
+        mechanicalPlan = new MechanicalExecutionPlan;
+    if (!mechanicalPlan->isValid())
+        mechanicalPlan->compile(this, params);
+    return mechanicalPlan->isSupported() ? mechanicalPlan : NULL;
+}
+
+std::atomic<unsigned> Node::graphRevision(0);
+
+void Node::graphChanged()
+{
+    const unsigned revision = ++graphRevision;
+    localRevision = revision;
+    subtreeChanged(revision);
+}
+
+void Node::subtreeChanged(unsigned revision)
+{
+    unsigned previous = subtreeRevision.load();
+    while (previous < revision && !subtreeRevision.compare_exchange_weak(previous, revision)) {}
+    // a later change already went through this node, it updates the ancestors too;
+    // this also visits the common ancestors of a diamond only once
+    if (previous >= revision)
+        return;
+    const Parents parents = getParents();
+    for (Parents::const_iterator it = parents.begin(); it != parents.end(); ++it)
+        static_cast<Node*>(*it)->subtreeChanged(revision);
+}
+
 SOFA_DECL_CLASS(Node)
 
 }
@@ -34,6 +34,7 @@
 #define SOFA_SIMULATION_CORE_NODE_H
 
 #include <type_traits>
+#include <atomic>
 
 #include <sofa/core/ExecParams.h>
 #include <sofa/core/objectmodel/Context.h>
@@ -96,6 +97,8 @@ class VisualParams;
 namespace simulation
 {
 
+class MechanicalExecutionPlan;
+
 /**
    Implements the object (component) management of the core::Context.
    Contains objects in lists and provides accessors.
@@ -541,6 +544,29 @@ public:
 	/// override context setSleeping to add notification.
 	virtual void setSleeping(bool /*val*/) override;
 
+    /// override context setActive to invalidate the execution plans
+    virtual void setActive(bool val) override;
+
+    /// @name Mechanical execution plan
+    /// @{
+
+    /// Calls of the hot mechanical visitors of this subtree, (re)compiled on first use after a graph change.
+    /// Returns NULL if the subtree can not be replayed without a visitor.
+    MechanicalExecutionPlan* getMechanicalExecutionPlan(const sofa::core::ExecParams* params);
+
+    /// Counter incremented each time a node or a component is added, removed or moved
+    /// anywhere, or a node is (de)activated or put to sleep
+    static unsigned getGraphRevision() { return graphRevision.load(); }
+
+    /// Graph revision of the last change of this node: its components, its children,
+    /// its parents, its activation or sleep state
+    unsigned getLocalRevision() const { return localRevision.load(); }
+
+    /// Graph revision of the last change of this node or of one of its descendants
+    unsigned getSubtreeRevision() const { return subtreeRevision.load(); }
+
+    /// @}
+
 protected:
     bool debug_;
     bool initialized;
@@ -564,6 +590,18 @@ protected:
 
     helper::vector<MutationListener*> listener;
 
+    MechanicalExecutionPlan* mechanicalPlan;
+
+    /// atomic, the graph can be modified by init() calls running concurrently (see InitScheduler)
+    static std::atomic<unsigned> graphRevision;
+    std::atomic<unsigned> localRevision;
+    std::atomic<unsigned> subtreeRevision;
+
+    /// Increment the graph revision and record it as the last change of this node and of the subtrees containing it
+    void graphChanged();
+    /// Record a change of revision in the subtree of this node and of its ancestors
+    void subtreeChanged(unsigned revision);
+
 
 public:
 
@@ -587,8 +625,8 @@ public:
     /// @{
 
 #define NODE_ADD_IN_SEQUENCE( CLASSNAME, FUNCTIONNAME, SEQUENCENAME ) \
-    virtual void add##FUNCTIONNAME( CLASSNAME* obj ) override { SEQUENCENAME.add(obj); } \
-    virtual void remove##FUNCTIONNAME( CLASSNAME* obj ) override { SEQUENCENAME.remove(obj); }
+    virtual void add##FUNCTIONNAME( CLASSNAME* obj ) override { SEQUENCENAME.add(obj); graphChanged(); } \
+    virtual void remove##FUNCTIONNAME( CLASSNAME* obj ) override { SEQUENCENAME.remove(obj); graphChanged(); }
 
     // WARNINGS subtilities:
     // an InteractioFF is NOT in the FF Sequence
@@ -83,6 +83,8 @@ using namespace sofa::defaulttype;
 using namespace sofa;
 
 Simulation::Simulation()
+    : d_initTimings(initData(&d_initTimings, false, "initTimings", "Measure the time spent in the init of each component"))
+    , d_parallelInit(initData(&d_parallelInit, false, "parallelInit", "Initialize concurrently the components which do not depend on each other (implies initTimings)"))
 {
     // Safety check; it could be elsewhere, but here is a good place, I guess.
     if (!sofa::simulation::core::isInitialized())
@@ -197,7 +199,7 @@ void Simulation::init ( Node* root )
 
     // apply the init() and bwdInit() methods to all the components.
     // and put the VisualModels in a separate graph, rooted at getVisualRoot()
-    root->execute<InitVisitor>(params);
+    initComponents(root, params);
 
     // Save reset state for later uses in reset()
     root->execute<StoreResetStateVisitor>(params);
@@ -216,6 +218,17 @@ void Simulation::init ( Node* root )
 }
 
 
+void Simulation::initComponents( Node* node, const sofa::core::ExecParams* params )
+{
+    if (d_parallelInit.getValue() || d_initTimings.getValue())
+    {
+        initScheduler.setParallel(d_parallelInit.getValue());
+        initScheduler.init(node, params);
+    }
+    else
+        node->execute<InitVisitor>(params);
+}
+
 void Simulation::initNode( Node* node)
 {
     if(!node)
@@ -223,7 +236,7 @@ void Simulation::initNode( Node* node)
         return;
     }
     sofa::core::ExecParams* params = sofa::core::ExecParams::defaultInstance();
-    node->execute<InitVisitor>(params);
+    initComponents(node, params);
 
     //node->execute<MechanicalPropagatePositionAndVelocityVisitor>(params);
     //node->execute<MechanicalPropagateFreePositionVisitor>(params);
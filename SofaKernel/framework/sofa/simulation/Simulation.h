@@ -29,6 +29,7 @@
 
 #include <sofa/simulation/DefaultAnimationLoop.h>
 #include <sofa/simulation/DefaultVisualManagerLoop.h>
+#include <sofa/simulation/InitScheduler.h>
 
 namespace sofa
 {
@@ -133,6 +134,18 @@ public:
     /// Can the simulation handle a directed acyclic graph?
     virtual bool isDirectedAcyclicGraph() = 0;
 
+    Data<bool> d_initTimings; ///< Measure the time spent in the init of each component
+    Data<bool> d_parallelInit; ///< Initialize concurrently the components which do not depend on each other
+
+    /// Scheduler of the last init() or initNode() done with initTimings or parallelInit, with the timings of the components
+    const InitScheduler& getInitScheduler() const { return initScheduler; }
+
+protected:
+    InitScheduler initScheduler;
+
+    /// Apply the init() and bwdInit() methods to all the components of the subtree
+    void initComponents(Node* node, const sofa::core::ExecParams* params);
+
 };
 
 /// Set the (unique) simulation which controls the scene
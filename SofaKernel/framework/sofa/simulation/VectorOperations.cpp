@@ -22,6 +22,7 @@
 #include <sofa/simulation/VectorOperations.h>
 #include <sofa/core/MultiVecId.h>
 #include <sofa/simulation/MechanicalVisitor.h>
+#include <sofa/simulation/MechanicalExecutionPlan.h>
 
 
 #include <sofa/simulation/VelocityThresholdVisitor.h>
@@ -105,33 +106,41 @@ void VectorOperations::v_realloc(sofa::core::MultiVecDerivId& v, bool interactio
 
 void VectorOperations::v_clear(sofa::core::MultiVecId v) //v=0
 {
-    executeVisitor( MechanicalVOpVisitor(params, v, core::ConstMultiVecId::null(), core::ConstMultiVecId::null(), 1.0) );
+    executeVOp(v, core::ConstMultiVecId::null(), core::ConstMultiVecId::null(), 1.0);
 }
 
 void VectorOperations::v_eq(sofa::core::MultiVecId v, sofa::core::ConstMultiVecId a) // v=a
 {
-    executeVisitor( MechanicalVOpVisitor(params, v, a, core::ConstMultiVecId::null(), 1.0) );
+    executeVOp(v, a, core::ConstMultiVecId::null(), 1.0);
 }
 
 void VectorOperations::v_eq(sofa::core::MultiVecId v, sofa::core::ConstMultiVecId a, SReal f) // v=f*a
 {
-    executeVisitor( MechanicalVOpVisitor(params, v, core::ConstMultiVecId::null(), a, f) );
+    executeVOp(v, core::ConstMultiVecId::null(), a, f);
 }
 
 void VectorOperations::v_peq(sofa::core::MultiVecId v, sofa::core::ConstMultiVecId a, SReal f)
 {
-    executeVisitor( MechanicalVOpVisitor(params, v, v, a, f) );
+    executeVOp(v, v, a, f);
 }
 
 
 void VectorOperations::v_teq(sofa::core::MultiVecId v, SReal f)
 {
-    executeVisitor( MechanicalVOpVisitor(params, v, core::MultiVecId::null(), v, f) );
+    executeVOp(v, core::MultiVecId::null(), v, f);
 }
 
 void VectorOperations::v_op(core::MultiVecId v, sofa::core::ConstMultiVecId a, sofa::core::ConstMultiVecId b, SReal f )
 {
-    executeVisitor( MechanicalVOpVisitor(params, v, a, b, f) );
+    executeVOp(v, a, b, f);
+}
+
+void VectorOperations::executeVOp(core::MultiVecId v, core::ConstMultiVecId a, core::ConstMultiVecId b, SReal f)
+{
+    if (MechanicalExecutionPlan* plan = MechanicalExecutionPlan::Get(ctx, params))
+        plan->vOp(params, v, a, b, f);
+    else
+        executeVisitor( MechanicalVOpVisitor(params, v, a, b, f) );
 }
 
 void VectorOperations::v_multiop(const core::behavior::BaseMechanicalState::VMultiOp& o)
@@ -143,7 +152,10 @@ void VectorOperations::v_multiop(const core::behavior::BaseMechanicalState::VMul
 void VectorOperations::v_dot( sofa::core::ConstMultiVecId a, sofa::core::ConstMultiVecId b)
 {
     result = 0;
-    MechanicalVDotVisitor(params, a,b,&result).setTags(ctx->getTags()).execute( ctx, executeVisitor.precomputedTraversalOrder );
+    if (MechanicalExecutionPlan* plan = MechanicalExecutionPlan::Get(ctx, params))
+        result = plan->vDot(params, a, b);
+    else
+        MechanicalVDotVisitor(params, a,b,&result).setTags(ctx->getTags()).execute( ctx, executeVisitor.precomputedTraversalOrder );
 }
 
 void VectorOperations::v_norm( sofa::core::ConstMultiVecId a, unsigned l)
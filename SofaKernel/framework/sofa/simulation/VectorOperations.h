@@ -75,6 +75,9 @@ public:
 
 protected:
     VisitorExecuteFunc executeVisitor;
+
+    /// v=a+b*f, replayed from the execution plan of the context when possible
+    void executeVOp(core::MultiVecId v, core::ConstMultiVecId a, core::ConstMultiVecId b, SReal f);
     /// Result of latest v_dot operation
     SReal result;
 
@@ -0,0 +1,146 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2018 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#ifndef SOFA_COMPONENT_LINEARSOLVER_ASYNCMATRIXLINEARSOLVER_H
+#define SOFA_COMPONENT_LINEARSOLVER_ASYNCMATRIXLINEARSOLVER_H
+#include "config.h"
+
+#include <SofaBaseLinearSolver/MatrixLinearSolver.h>
+#include <sofa/helper/system/atomic.h>
+
+#ifdef SOFA_HAVE_BOOST_THREAD
+#include <boost/thread/thread.hpp>
+#endif
+
+namespace sofa
+{
+
+namespace component
+{
+
+namespace linearsolver
+{
+
+/// Thread manager used to refactorize the system matrix on a worker thread.
+///
+/// The matrix assembled when the worker is idle is factorized in background, while the
+/// solves keep using the previous factorization until the new one is ready.
+/// Without boost::thread the factorization is computed synchronously, with the same delay.
+class AsyncThreadManager
+{
+public:
+    static std::string Name() { return "Async"; }
+
+    static bool isAsyncSolver()
+    {
+        return true;
+    }
+};
+
+template<class Matrix, class Vector>
+class MatrixLinearSolver<Matrix,Vector,AsyncThreadManager> : public MatrixLinearSolver<Matrix,Vector,NoThreadManager>
+{
+public:
+    SOFA_ABSTRACT_CLASS(SOFA_TEMPLATE3(MatrixLinearSolver,Matrix,Vector,AsyncThreadManager), SOFA_TEMPLATE3(MatrixLinearSolver,Matrix,Vector,NoThreadManager));
+
+    typedef MatrixLinearSolver<Matrix,Vector,NoThreadManager> Inherit;
+    typedef AsyncThreadManager ThreadManager;
+
+    Data<bool> d_async; ///< refactorize the matrix on a worker thread, the previous factorization is used until the new one is ready
+    Data<unsigned> d_factorAge; ///< number of matrix updates since the matrix of the current factorization was assembled (output)
+    Data<unsigned> d_nbFactorizations; ///< number of factorizations computed since the beginning of the simulation (output)
+    Data<double> d_factorizationTime; ///< duration of the last factorization in ms (output)
+
+    MatrixLinearSolver();
+    virtual ~MatrixLinearSolver();
+
+    virtual void cleanup() override;
+
+    /// Reset the right and left hand vectors, the factorized matrix is kept
+    virtual void resetSystem() override;
+
+    /// Assemble the matrix and start its factorization if the worker is idle.
+    /// A finished factorization is only used from the call starting the next one, so that
+    /// objects depending on the matrix (such as WarpPreconditioner rotations) stay consistent.
+    virtual void setSystemMBKMatrix(const core::MechanicalParams* mparams) override;
+
+    /// True if the last call to setSystemMBKMatrix started a new factorization
+    virtual bool hasUpdatedMatrix() override { return updatedMatrix; }
+
+    virtual bool isAsyncSolver() override
+    {
+        return d_async.getValue();
+    }
+
+    static std::string templateName(const MatrixLinearSolver<Matrix,Vector,ThreadManager>* = NULL)
+    {
+        return ThreadManager::Name()+Matrix::Name();
+    }
+
+    virtual std::string getTemplateName() const override
+    {
+        return templateName(this);
+    }
+
+    virtual MatrixInvertData * getMatrixInvertData(defaulttype::BaseMatrix * m) override;
+
+    /// True while the worker thread is factorizing a matrix
+    bool isFactorizing() const { return running && factorizationDone == 0; }
+
+    /// Wait for the end of the current factorization
+    void waitFactorization();
+
+protected:
+    /// the two matrices alternatively used for the current and the next factorization
+    Matrix* factorMatrix[2];
+    MatrixInvertData* factorData[2];
+    /// size of the system for each matrix
+    int factorSize[2];
+    /// matrix update at which each matrix was assembled
+    unsigned factorStep[2];
+
+    /// index of the matrix used by the solves (-1 if none)
+    int readyIndex;
+    /// index of the matrix factorized in background (-1 if none)
+    int pendingIndex;
+    unsigned nbMatrixUpdates;
+    bool updatedMatrix;
+
+    bool running;
+    helper::system::atomic<int> factorizationDone;
+    double lastFactorizationTime;
+#ifdef SOFA_HAVE_BOOST_THREAD
+    boost::thread worker;
+#endif
+
+    void startFactorization(int index);
+    void computeFactorization(int index);
+    void setReadyFactorization(int index);
+    void updateStatistics();
+};
+
+} // namespace linearsolver
+
+} // namespace component
+
+} // namespace sofa
+
+#endif
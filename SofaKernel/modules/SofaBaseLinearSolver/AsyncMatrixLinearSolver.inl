@@ -0,0 +1,232 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2018 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#ifndef SOFA_COMPONENT_LINEARSOLVER_ASYNCMATRIXLINEARSOLVER_INL
+#define SOFA_COMPONENT_LINEARSOLVER_ASYNCMATRIXLINEARSOLVER_INL
+
+#include <SofaBaseLinearSolver/AsyncMatrixLinearSolver.h>
+#include <SofaBaseLinearSolver/MatrixLinearSolver.inl>
+#include <sofa/helper/system/thread/CTime.h>
+#include <sofa/helper/AdvancedTimer.h>
+
+#ifdef SOFA_HAVE_BOOST_THREAD
+#include <boost/bind.hpp>
+#endif
+
+namespace sofa {
+
+namespace component {
+
+namespace linearsolver {
+
+template<class Matrix, class Vector>
+MatrixLinearSolver<Matrix,Vector,AsyncThreadManager>::MatrixLinearSolver()
+    : Inherit()
+    , d_async( initData( &d_async, true, "async", "refactorize the matrix on a worker thread, the previous factorization is used until the new one is ready" ) )
+    , d_factorAge( initData( &d_factorAge, (unsigned)0, "factorAge", "number of matrix updates since the matrix of the current factorization was assembled (output)" ) )
+    , d_nbFactorizations( initData( &d_nbFactorizations, (unsigned)0, "nbFactorizations", "number of factorizations computed since the beginning of the simulation (output)" ) )
+    , d_factorizationTime( initData( &d_factorizationTime, 0.0, "factorizationTime", "duration of the last factorization in ms (output)" ) )
+    , readyIndex(-1)
+    , pendingIndex(-1)
+    , nbMatrixUpdates(0)
+    , updatedMatrix(false)
+    , running(false)
+    , lastFactorizationTime(0)
+{
+    d_factorAge.setReadOnly(true);
+    d_nbFactorizations.setReadOnly(true);
+    d_factorizationTime.setReadOnly(true);
+    for (int i=0; i<2; ++i)
+    {
+        factorMatrix[i] = NULL;
+        factorData[i] = NULL;
+        factorSize[i] = 0;
+        factorStep[i] = 0;
+    }
+}
+
+template<class Matrix, class Vector>
+MatrixLinearSolver<Matrix,Vector,AsyncThreadManager>::~MatrixLinearSolver()
+{
+    waitFactorization();
+    // the current matrix is owned by the default group
+    for (int i=0; i<2; ++i)
+    {
+        if (factorMatrix[i] && factorMatrix[i] != this->defaultGroup.systemMatrix) Inherit::deleteMatrix(factorMatrix[i]);
+        if (factorData[i]) delete factorData[i];
+    }
+}
+
+template<class Matrix, class Vector>
+void MatrixLinearSolver<Matrix,Vector,AsyncThreadManager>::cleanup()
+{
+    // the factorization uses the data of the derived solvers, it must end before they are destroyed
+    waitFactorization();
+    Inherit::cleanup();
+}
+
+template<class Matrix, class Vector>
+void MatrixLinearSolver<Matrix,Vector,AsyncThreadManager>::waitFactorization()
+{
+    if (!running) return;
+#ifdef SOFA_HAVE_BOOST_THREAD
+    worker.join();
+#endif
+    running = false;
+}
+
+template<class Matrix, class Vector>
+MatrixInvertData * MatrixLinearSolver<Matrix,Vector,AsyncThreadManager>::getMatrixInvertData(defaulttype::BaseMatrix * m)
+{
+    for (int i=0; i<2; ++i)
+    {
+        if (factorMatrix[i] != NULL && m == factorMatrix[i])
+        {
+            if (factorData[i]==NULL) factorData[i] = this->createInvertData();
+            return factorData[i];
+        }
+    }
+    return Inherit::getMatrixInvertData(m);
+}
+
+template<class Matrix, class Vector>
+void MatrixLinearSolver<Matrix,Vector,AsyncThreadManager>::resetSystem()
+{
+    if (this->isMultiGroup() || readyIndex < 0)
+    {
+        Inherit::resetSystem();
+        return;
+    }
+
+    typename Inherit::GroupData* group = &this->defaultGroup;
+    if (group->systemRHVector) group->systemRHVector->clear();
+    if (group->systemLHVector) group->systemLHVector->clear();
+    group->solutionVecId = core::MultiVecDerivId::null();
+}
+
+template<class Matrix, class Vector>
+void MatrixLinearSolver<Matrix,Vector,AsyncThreadManager>::setSystemMBKMatrix(const core::MechanicalParams* mparams)
+{
+    if (this->isMultiGroup())
+    {
+        // the asynchronous factorization is only implemented for a single group
+        Inherit::setSystemMBKMatrix(mparams);
+        updatedMatrix = true;
+        return;
+    }
+
+    updatedMatrix = false;
+    if (this->frozen) return;
+
+    ++nbMatrixUpdates;
+
+    this->createGroups(mparams);
+    const int size = this->defaultGroup.systemSize;
+    const bool sameSize = (readyIndex >= 0 && factorSize[readyIndex] == size);
+
+    if (isFactorizing() && d_async.getValue() && sameSize)
+    {
+        // keep solving with the current factorization
+        updateStatistics();
+        return;
+    }
+    waitFactorization();
+
+    // the factorization computed in background becomes the current one
+    if (pendingIndex >= 0)
+    {
+        if (factorSize[pendingIndex] == size) setReadyFactorization(pendingIndex);
+        pendingIndex = -1;
+    }
+
+    // the matrix is assembled in the buffer which is not used by the solves
+    const int index = (readyIndex == 0) ? 1 : 0;
+    this->defaultGroup.systemMatrix = factorMatrix[index];
+    Inherit::setSystemMBKMatrix(mparams);
+    factorMatrix[index] = this->defaultGroup.systemMatrix;
+    factorSize[index] = size;
+    factorStep[index] = nbMatrixUpdates;
+    getMatrixInvertData(factorMatrix[index]);
+
+    if (d_async.getValue() && readyIndex >= 0 && factorSize[readyIndex] == size)
+    {
+        pendingIndex = index;
+        startFactorization(index);
+    }
+    else
+    {
+        // no valid factorization to use in the meantime
+        computeFactorization(index);
+        setReadyFactorization(index);
+    }
+
+    this->defaultGroup.systemMatrix = factorMatrix[readyIndex];
+    this->defaultGroup.needInvert = false;
+    updatedMatrix = true;
+    updateStatistics();
+}
+
+template<class Matrix, class Vector>
+void MatrixLinearSolver<Matrix,Vector,AsyncThreadManager>::startFactorization(int index)
+{
+    factorizationDone = 0;
+    running = true;
+#ifdef SOFA_HAVE_BOOST_THREAD
+    worker = boost::thread(boost::bind(&MatrixLinearSolver<Matrix,Vector,AsyncThreadManager>::computeFactorization, this, index));
+#else
+    computeFactorization(index);
+#endif
+}
+
+template<class Matrix, class Vector>
+void MatrixLinearSolver<Matrix,Vector,AsyncThreadManager>::computeFactorization(int index)
+{
+    using sofa::helper::system::thread::CTime;
+    const double t0 = (double)CTime::getRefTime();
+    this->invert(*factorMatrix[index]);
+    lastFactorizationTime = ((double)CTime::getRefTime() - t0) * 1000.0 / (double)CTime::getRefTicksPerSec();
+    factorizationDone = 1;
+}
+
+template<class Matrix, class Vector>
+void MatrixLinearSolver<Matrix,Vector,AsyncThreadManager>::setReadyFactorization(int index)
+{
+    readyIndex = index;
+    d_nbFactorizations.setValue(d_nbFactorizations.getValue()+1);
+    d_factorizationTime.setValue(lastFactorizationTime);
+}
+
+template<class Matrix, class Vector>
+void MatrixLinearSolver<Matrix,Vector,AsyncThreadManager>::updateStatistics()
+{
+    if (readyIndex < 0) return;
+    const unsigned age = nbMatrixUpdates - factorStep[readyIndex];
+    d_factorAge.setValue(age);
+    sofa::helper::AdvancedTimer::valSet("FactorAge", age);
+}
+
+} // namespace linearsolver
+
+} // namespace component
+
+} // namespace sofa
+
+#endif
@@ -0,0 +1,366 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2018 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#ifndef SOFA_COMPONENT_LINEARSOLVER_BLOCKCOMPRESSEDMATRIX_H
+#define SOFA_COMPONENT_LINEARSOLVER_BLOCKCOMPRESSEDMATRIX_H
+#include "config.h"
+
+#include <sofa/defaulttype/BaseMatrix.h>
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#include <math.h>
+
+namespace sofa
+{
+
+namespace component
+{
+
+namespace linearsolver
+{
+
+/// Dense matrix stored by square tiles, meant for large precomputed inverses.
+///
+/// Tiles are stored contiguously, so that products only touch a few cache
+/// lines per row of a tile. When a tolerance is given, each tile is replaced
+/// by a low-rank product U.V^T (adaptive cross approximation with full
+/// pivoting) if its relative error in Frobenius norm is below the tolerance
+/// and if it takes less memory than the dense tile. The global error is thus
+/// bounded by tolerance * ||A||_F. Values are stored with the precision TReal,
+/// computations are done in double.
+///
+/// The matrix is filled row by row (beginRows / setRow / endRows), only one
+/// row of tiles being buffered in double precision at a time.
+template<class TReal>
+class BlockCompressedMatrix
+{
+public:
+    typedef TReal Real;
+    typedef defaulttype::BaseMatrix::Index Index;
+
+    BlockCompressedMatrix()
+        : nRow(0), nCol(0), bsize(0), nbBlocRows(0), nbBlocCols(0), tolerance(0), bufferBlocRow(-1)
+    {
+    }
+
+    Index rowSize() const { return nRow; }
+    Index colSize() const { return nCol; }
+    Index getBlockSize() const { return bsize; }
+    double getTolerance() const { return tolerance; }
+
+    void clear()
+    {
+        nRow = nCol = bsize = nbBlocRows = nbBlocCols = 0;
+        tolerance = 0;
+        tiles.clear();
+        data.clear();
+        buffer.clear();
+        bufferBlocRow = -1;
+    }
+
+    /// Start filling a nbRow x nbCol matrix with tiles of size bs.
+    /// Tiles are compressed if tol > 0, and kept dense otherwise.
+    void beginRows(Index nbRow, Index nbCol, Index bs, double tol)
+    {
+        clear();
+        nRow = nbRow;
+        nCol = nbCol;
+        bsize = (bs > 0) ? bs : 1;
+        tolerance = tol;
+        nbBlocRows = (nRow + bsize - 1) / bsize;
+        nbBlocCols = (nCol + bsize - 1) / bsize;
+        tiles.resize((std::size_t)nbBlocRows * nbBlocCols);
+        buffer.assign((std::size_t)bsize * nCol, 0.0);
+    }
+
+    /// Set row i to values*scale. The rows of a row of tiles must all be set
+    /// before the next row of tiles is started, rows which are never set are zero.
+    template<class T>
+    void setRow(Index i, const T* values, double scale = 1.0)
+    {
+        const Index bi = i / bsize;
+        if (bi != bufferBlocRow)
+        {
+            flush();
+            bufferBlocRow = bi;
+        }
+        double* row = &buffer[(std::size_t)(i - bi*bsize) * nCol];
+        for (Index j=0; j<nCol; ++j)
+            row[j] = values[j] * scale;
+    }
+
+    /// Compress the last buffered row of tiles and release the buffer
+    void endRows()
+    {
+        flush();
+        buffer.clear();
+        buffer.shrink_to_fit();
+    }
+
+    Real element(Index i, Index j) const
+    {
+        const Index bi = i / bsize, bj = j / bsize;
+        const Tile& t = tiles[(std::size_t)bi * nbBlocCols + bj];
+        const Index ii = i - bi*bsize, jj = j - bj*bsize;
+        if (t.rank < 0)
+            return data[t.offset + (std::size_t)ii * tileCols(bj) + jj];
+        double v = 0.0;
+        const Real* u = &data[t.offset] + (std::size_t)ii * t.rank;
+        const Real* w = &data[t.offset] + (std::size_t)tileRows(bi) * t.rank + (std::size_t)jj * t.rank;
+        for (int r=0; r<t.rank; ++r)
+            v += (double)u[r] * w[r];
+        return (Real)v;
+    }
+
+    /// res = A * v
+    template<class V1, class V2>
+    void mul(V1& res, const V2& v) const
+    {
+        std::vector<double> acc(bsize), tmp(bsize);
+        for (Index bi=0; bi<nbBlocRows; ++bi)
+        {
+            const Index r0 = bi*bsize, nr = tileRows(bi);
+            std::fill(acc.begin(), acc.begin()+nr, 0.0);
+            for (Index bj=0; bj<nbBlocCols; ++bj)
+            {
+                const Tile& t = tiles[(std::size_t)bi * nbBlocCols + bj];
+                if (t.rank == 0) continue;
+                const Index c0 = bj*bsize, nc = tileCols(bj);
+                const Real* d = &data[t.offset];
+                if (t.rank < 0)
+                {
+                    for (Index ii=0; ii<nr; ++ii, d+=nc)
+                    {
+                        double s = 0.0;
+                        for (Index jj=0; jj<nc; ++jj)
+                            s += (double)d[jj] * v[c0+jj];
+                        acc[ii] += s;
+                    }
+                }
+                else
+                {
+                    const int k = t.rank;
+                    const Real* w = d + (std::size_t)nr * k;
+                    // tmp = V^T v, then acc += U tmp
+                    std::fill(tmp.begin(), tmp.begin()+k, 0.0);
+                    for (Index jj=0; jj<nc; ++jj)
+                    {
+                        const double vj = v[c0+jj];
+                        for (int r=0; r<k; ++r)
+                            tmp[r] += (double)w[(std::size_t)jj*k+r] * vj;
+                    }
+                    for (Index ii=0; ii<nr; ++ii)
+                    {
+                        double s = 0.0;
+                        for (int r=0; r<k; ++r)
+                            s += (double)d[(std::size_t)ii*k+r] * tmp[r];
+                        acc[ii] += s;
+                    }
+                }
+            }
+            for (Index ii=0; ii<nr; ++ii)
+                res[r0+ii] = acc[ii];
+        }
+    }
+
+    /// out[c] += factor * A(i,cols[c]) for each c
+    template<class T>
+    void addRowTimes(Index i, T factor, const std::vector<int>& cols, T* out) const
+    {
+        const Index bi = i / bsize, ii = i - bi*bsize, nr = tileRows(bi);
+        for (std::size_t c=0; c<cols.size(); ++c)
+        {
+            const Index j = cols[c], bj = j / bsize, jj = j - bj*bsize;
+            const Tile& t = tiles[(std::size_t)bi * nbBlocCols + bj];
+            if (t.rank < 0)
+                out[c] += factor * (T)data[t.offset + (std::size_t)ii * tileCols(bj) + jj];
+            else if (t.rank > 0)
+            {
+                const Real* u = &data[t.offset] + (std::size_t)ii * t.rank;
+                const Real* w = &data[t.offset] + (std::size_t)nr * t.rank + (std::size_t)jj * t.rank;
+                double v = 0.0;
+                for (int r=0; r<t.rank; ++r)
+                    v += (double)u[r] * w[r];
+                out[c] += factor * (T)v;
+            }
+        }
+    }
+
+    /// Memory used by the stored values, in bytes
+    std::size_t memorySize() const
+    {
+        return data.size() * sizeof(Real) + tiles.size() * sizeof(Tile);
+    }
+
+    /// Number of tiles stored as a low-rank product (or skipped because they are zero)
+    unsigned nbCompressedTiles() const
+    {
+        unsigned n = 0;
+        for (std::size_t t=0; t<tiles.size(); ++t)
+            if (tiles[t].rank >= 0) ++n;
+        return n;
+    }
+
+    void write(std::ostream& out) const
+    {
+        const int header[5] = { (int)sizeof(Real), (int)nRow, (int)nCol, (int)bsize, 0 };
+        const std::size_t sizes[2] = { tiles.size(), data.size() };
+        out.write((const char*)header, sizeof(header));
+        out.write((const char*)&tolerance, sizeof(tolerance));
+        out.write((const char*)sizes, sizeof(sizes));
+        if (!tiles.empty()) out.write((const char*)&tiles[0], tiles.size() * sizeof(Tile));
+        if (!data.empty()) out.write((const char*)&data[0], data.size() * sizeof(Real));
+    }
+
+    /// Read a matrix written by write(), returns false if the stream does not hold a nbRow x nbCol matrix of this precision
+    bool read(std::istream& in, Index nbRow, Index nbCol)
+    {
+        int header[5];
+        std::size_t sizes[2];
+        double tol;
+        in.read((char*)header, sizeof(header));
+        in.read((char*)&tol, sizeof(tol));
+        in.read((char*)sizes, sizeof(sizes));
+        if (!in.good() || header[0] != (int)sizeof(Real) || header[1] != (int)nbRow || header[2] != (int)nbCol || header[3] <= 0)
+            return false;
+        beginRows(nbRow, nbCol, header[3], tol);
+        buffer.clear();
+        if (sizes[0] != tiles.size())
+            return false;
+        data.resize(sizes[1]);
+        if (!tiles.empty()) in.read((char*)&tiles[0], tiles.size() * sizeof(Tile));
+        if (!data.empty()) in.read((char*)&data[0], data.size() * sizeof(Real));
+        return in.good();
+    }
+
+protected:
+
+    /// rank < 0 : dense row-major tile, rank 0 : zero tile, rank > 0 : U (rows x rank) followed by V (cols x rank)
+    struct Tile
+    {
+        int rank;
+        std::size_t offset;
+        Tile() : rank(0), offset(0) {}
+    };
+
+    Index tileRows(Index bi) const { return std::min(bsize, nRow - bi*bsize); }
+    Index tileCols(Index bj) const { return std::min(bsize, nCol - bj*bsize); }
+
+    void flush()
+    {
+        if (bufferBlocRow < 0) return;
+        const Index bi = bufferBlocRow, nr = tileRows(bi);
+        std::vector<double> tile;
+        for (Index bj=0; bj<nbBlocCols; ++bj)
+        {
+            const Index c0 = bj*bsize, nc = tileCols(bj);
+            tile.resize((std::size_t)nr * nc);
+            for (Index ii=0; ii<nr; ++ii)
+                for (Index jj=0; jj<nc; ++jj)
+                    tile[(std::size_t)ii*nc+jj] = buffer[(std::size_t)ii*nCol + c0+jj];
+            compressTile(tiles[(std::size_t)bi * nbBlocCols + bj], tile, nr, nc);
+        }
+        std::fill(buffer.begin(), buffer.end(), 0.0);
+        bufferBlocRow = -1;
+    }
+
+    void compressTile(Tile& t, const std::vector<double>& tile, Index nr, Index nc)
+    {
+        double norm2 = 0.0;
+        for (std::size_t k=0; k<tile.size(); ++k)
+            norm2 += tile[k]*tile[k];
+        t.offset = data.size();
+        if (norm2 == 0.0)
+        {
+            t.rank = 0;
+            return;
+        }
+
+        if (tolerance > 0)
+        {
+            // a rank k approximation is only worth it if k*(nr+nc) < nr*nc
+            const int maxRank = (int)((nr*nc - 1) / (nr+nc));
+            const double tol2 = tolerance*tolerance*norm2;
+            std::vector<double> res(tile), u, w;
+            double res2 = norm2;
+            int rank = 0;
+            while (res2 > tol2 && rank < maxRank)
+            {
+                std::size_t pivot = 0;
+                for (std::size_t k=1; k<res.size(); ++k)
+                    if (fabs(res[k]) > fabs(res[pivot])) pivot = k;
+                const Index p = (Index)(pivot / nc), q = (Index)(pivot % nc);
+                const double inv = 1.0 / res[pivot];
+                u.resize((std::size_t)(rank+1) * nr);
+                w.resize((std::size_t)(rank+1) * nc);
+                for (Index ii=0; ii<nr; ++ii) u[(std::size_t)rank*nr+ii] = res[(std::size_t)ii*nc+q];
+                for (Index jj=0; jj<nc; ++jj) w[(std::size_t)rank*nc+jj] = res[(std::size_t)p*nc+jj] * inv;
+                res2 = 0.0;
+                for (Index ii=0; ii<nr; ++ii)
+                    for (Index jj=0; jj<nc; ++jj)
+                    {
+                        double& r = res[(std::size_t)ii*nc+jj];
+                        r -= u[(std::size_t)rank*nr+ii] * w[(std::size_t)rank*nc+jj];
+                        res2 += r*r;
+                    }
+                ++rank;
+            }
+            if (res2 <= tol2)
+            {
+                t.rank = rank;
+                data.resize(t.offset + (std::size_t)rank * (nr+nc));
+                Real* d = &data[t.offset];
+                for (Index ii=0; ii<nr; ++ii)
+                    for (int r=0; r<rank; ++r)
+                        d[(std::size_t)ii*rank+r] = (Real)u[(std::size_t)r*nr+ii];
+                d += (std::size_t)nr * rank;
+                for (Index jj=0; jj<nc; ++jj)
+                    for (int r=0; r<rank; ++r)
+                        d[(std::size_t)jj*rank+r] = (Real)w[(std::size_t)r*nc+jj];
+                return;
+            }
+        }
+
+        t.rank = -1;
+        data.resize(t.offset + tile.size());
+        for (std::size_t k=0; k<tile.size(); ++k)
+            data[t.offset+k] = (Real)tile[k];
+    }
+
+    Index nRow, nCol, bsize;
+    Index nbBlocRows, nbBlocCols;
+    double tolerance;
+    std::vector<Tile> tiles;
+    std::vector<Real> data;
+
+    std::vector<double> buffer; ///< rows of the tile row being filled
+    Index bufferBlocRow;
+};
+
+} // namespace linearsolver
+
+} // namespace component
+
+} // namespace sofa
+
+#endif
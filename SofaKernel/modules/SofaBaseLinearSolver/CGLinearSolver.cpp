@@ -64,6 +64,50 @@ inline void CGLinearSolver<component::linearsolver::GraphScatteredMatrix,compone
 #endif
 }
 
+template<> SOFA_BASE_LINEAR_SOLVER_API
+inline void CGLinearSolver<component::linearsolver::GraphScatteredMatrix,component::linearsolver::GraphScatteredVector>::cgdot_pipelined(const core::ExecParams* params, Vector& r, Vector& w, SReal& gamma, SReal& delta)
+{
+    // both reductions in a single traversal of the graph
+    simulation::MechanicalVMultiDotVisitor::VecDots dots;
+    dots.push_back(std::make_pair((core::ConstMultiVecId)(MultiVecDerivId)r,(core::ConstMultiVecId)(MultiVecDerivId)r));
+    dots.push_back(std::make_pair((core::ConstMultiVecId)(MultiVecDerivId)w,(core::ConstMultiVecId)(MultiVecDerivId)r));
+    SReal results[2];
+    this->executeVisitor(simulation::MechanicalVMultiDotVisitor(params, dots, results));
+    gamma = results[0];
+    delta = results[1];
+}
+
+template<> SOFA_BASE_LINEAR_SOLVER_API
+inline void CGLinearSolver<component::linearsolver::GraphScatteredMatrix,component::linearsolver::GraphScatteredVector>::cgstep_pipelined(const core::ExecParams* params, Vector& x, Vector& r, Vector& w, Vector& n, Vector& z, Vector& s, Vector& p, SReal alpha, SReal beta, bool first)
+{
+    // all the vector updates of an iteration in a single traversal of the graph
+    typedef sofa::core::behavior::BaseMechanicalState::VMultiOp VMultiOp;
+    VMultiOp ops;
+    ops.resize(6);
+    ops[0].first = (MultiVecDerivId)z;
+    ops[0].second.push_back(std::make_pair((MultiVecDerivId)n,1.0));
+    ops[1].first = (MultiVecDerivId)s;
+    ops[1].second.push_back(std::make_pair((MultiVecDerivId)w,1.0));
+    ops[2].first = (MultiVecDerivId)p;
+    ops[2].second.push_back(std::make_pair((MultiVecDerivId)r,1.0));
+    if (!first)
+    {
+        ops[0].second.push_back(std::make_pair((MultiVecDerivId)z,beta));
+        ops[1].second.push_back(std::make_pair((MultiVecDerivId)s,beta));
+        ops[2].second.push_back(std::make_pair((MultiVecDerivId)p,beta));
+    }
+    ops[3].first = (MultiVecDerivId)x;
+    ops[3].second.push_back(std::make_pair((MultiVecDerivId)x,1.0));
+    ops[3].second.push_back(std::make_pair((MultiVecDerivId)p,alpha));
+    ops[4].first = (MultiVecDerivId)r;
+    ops[4].second.push_back(std::make_pair((MultiVecDerivId)r,1.0));
+    ops[4].second.push_back(std::make_pair((MultiVecDerivId)s,-alpha));
+    ops[5].first = (MultiVecDerivId)w;
+    ops[5].second.push_back(std::make_pair((MultiVecDerivId)w,1.0));
+    ops[5].second.push_back(std::make_pair((MultiVecDerivId)z,-alpha));
+    this->executeVisitor(simulation::MechanicalVMultiOpVisitor(params, ops));
+}
+
 SOFA_DECL_CLASS(CGLinearSolver)
 
 int CGLinearSolverClass = core::RegisterObject("Linear system solver using the conjugate gradient iterative algorithm")
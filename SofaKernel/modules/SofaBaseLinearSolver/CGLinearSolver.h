@@ -56,6 +56,7 @@ public:
     Data<SReal> f_smallDenominatorThreshold; ///< minimum value of the denominator in the conjugate Gradient solution
     Data<bool> f_warmStart; ///< Use previous solution as initial solution
     Data<bool> f_verbose; ///< Dump system state at each iteration
+    Data<bool> f_pipelined; ///< Use the pipelined variant, with a single fused reduction per iteration
     Data<std::map < std::string, sofa::helper::vector<SReal> > > f_graph; ///< Graph of residuals at each iteration
 #ifdef DISPLAY_TIME
     SReal time1;
@@ -72,6 +73,17 @@ protected:
     /// This method is separated from the rest to be able to use custom/optimized versions depending on the types of vectors.
     /// It computes: x += p*alpha, r -= q*alpha
     inline void cgstep_alpha(const core::ExecParams* params, Vector& x, Vector& r, Vector& p, Vector& q, SReal alpha);
+    /// This method is separated from the rest to be able to use custom/optimized versions depending on the types of vectors.
+    /// It computes: gamma = r.r, delta = w.r
+    inline void cgdot_pipelined(const core::ExecParams* params, Vector& r, Vector& w, SReal& gamma, SReal& delta);
+    /// This method is separated from the rest to be able to use custom/optimized versions depending on the types of vectors.
+    /// It computes: z = n + z*beta, s = w + s*beta, p = r + p*beta, then x += p*alpha, r -= s*alpha, w -= z*alpha
+    /// (z, s and p are only initialized on the first step)
+    inline void cgstep_pipelined(const core::ExecParams* params, Vector& x, Vector& r, Vector& w, Vector& n, Vector& z, Vector& s, Vector& p, SReal alpha, SReal beta, bool first);
+
+    /// Pipelined conjugate gradient (Ghysels & Vanroose): the two dot products of an iteration
+    /// are computed together, before and independently of the matrix-vector product
+    void solvePipelined(Matrix& M, Vector& x, Vector& b);
 
 public:
     virtual void init() override;
@@ -92,6 +104,12 @@ inline void CGLinearSolver<component::linearsolver::GraphScatteredMatrix,compone
 template<>
 inline void CGLinearSolver<component::linearsolver::GraphScatteredMatrix,component::linearsolver::GraphScatteredVector>::cgstep_alpha(const core::ExecParams* params, Vector& x, Vector& r, Vector& p, Vector& q, SReal alpha);
 
+template<>
+inline void CGLinearSolver<component::linearsolver::GraphScatteredMatrix,component::linearsolver::GraphScatteredVector>::cgdot_pipelined(const core::ExecParams* params, Vector& r, Vector& w, SReal& gamma, SReal& delta);
+
+template<>
+inline void CGLinearSolver<component::linearsolver::GraphScatteredMatrix,component::linearsolver::GraphScatteredVector>::cgstep_pipelined(const core::ExecParams* params, Vector& x, Vector& r, Vector& w, Vector& n, Vector& z, Vector& s, Vector& p, SReal alpha, SReal beta, bool first);
+
 #if defined(SOFA_EXTERN_TEMPLATE) && !defined(SOFA_COMPONENT_LINEARSOLVER_CGLINEARSOLVER_CPP)
 extern template class SOFA_BASE_LINEAR_SOLVER_API CGLinearSolver< GraphScatteredMatrix, GraphScatteredVector >;
 #ifndef SOFA_FLOAT
@@ -51,6 +51,7 @@ CGLinearSolver<TMatrix,TVector>::CGLinearSolver()
     , f_smallDenominatorThreshold( initData(&f_smallDenominatorThreshold,(SReal)1e-5,"threshold","Minimum value of the denominator in the conjugate Gradient solution") )
     , f_warmStart( initData(&f_warmStart,false,"warmStart","Use previous solution as initial solution") )
     , f_verbose( initData(&f_verbose,false,"verbose","Dump system state at each iteration") )
+    , f_pipelined( initData(&f_pipelined,false,"pipelined","Use the pipelined variant of the algorithm, which computes both dot products of an iteration in a single reduction") )
     , f_graph( initData(&f_graph,"graph","Graph of residuals at each iteration") )
 {
     f_graph.setWidget("graph");
@@ -128,6 +129,12 @@ void CGLinearSolver<TMatrix,TVector>::setSystemMBKMatrix(const sofa::core::Mecha
 template<class TMatrix, class TVector>
 void CGLinearSolver<TMatrix,TVector>::solve(Matrix& M, Vector& x, Vector& b)
 {
+    if (f_pipelined.getValue())
+    {
+        solvePipelined(M, x, b);
+        return;
+    }
+
 #ifdef SOFA_DUMP_VISITOR_INFO
     simulation::Visitor::printComment("ConjugateGradient");
 #endif
@@ -323,6 +330,136 @@ void CGLinearSolver<TMatrix,TVector>::solve(Matrix& M, Vector& x, Vector& b)
     vtmp.deleteTempVector(&r);
 }
 
+/// Solve Mx=b with the pipelined algorithm
+template<class TMatrix, class TVector>
+void CGLinearSolver<TMatrix,TVector>::solvePipelined(Matrix& M, Vector& x, Vector& b)
+{
+#ifdef SOFA_DUMP_VISITOR_INFO
+    simulation::Visitor::printComment("PipelinedConjugateGradient");
+#endif
+
+    const core::ExecParams* params = core::ExecParams::defaultInstance();
+    typename Inherit::TempVectorContainer vtmp(this, params, M, x, b);
+    Vector& r = *vtmp.createTempVector();
+    Vector& w = *vtmp.createTempVector();
+    Vector& n = *vtmp.createTempVector();
+    Vector& z = *vtmp.createTempVector();
+    Vector& s = *vtmp.createTempVector();
+    Vector& p = *vtmp.createTempVector();
+
+    const bool verbose  = f_verbose.getValue();
+    SReal gamma, gamma_1=0, delta, alpha=0, beta=0;
+
+    msg_info_when(verbose) << "b = " << b ;
+
+    /// Compute the initial residual r
+    if( f_warmStart.getValue() )
+    {
+        r = M * x;
+        r.eq( b, r, -1.0 );   // initial residual r = b - Ax;
+    }
+    else
+    {
+        x.clear();
+        r = b; // initial residual
+    }
+
+    /// w = A r is kept up to date by recurrence, as s = A p and z = A w
+    w = M * r;
+
+    /// Compute the norm of the right-hand-side vector b
+    double normb = b.norm();
+
+    std::map < std::string, sofa::helper::vector<SReal> >& graph = *f_graph.beginEdit();
+    sofa::helper::vector<SReal>& graph_error = graph[(this->isMultiGroup()) ? this->currentNode->getName()+std::string("-Error") : std::string("Error")];
+    graph_error.clear();
+    sofa::helper::vector<SReal>& graph_den = graph[(this->isMultiGroup()) ? this->currentNode->getName()+std::string("-Denominator") : std::string("Denominator")];
+    graph_den.clear();
+    graph_error.push_back(1);
+    unsigned nb_iter;
+    const char* endcond = "iterations";
+
+    for( nb_iter=1; nb_iter<=f_maxIter.getValue(); nb_iter++ )
+    {
+        /// Single reduction : gamma = r.r and delta = w.r
+        cgdot_pipelined(params, r, w, gamma, delta);
+
+        /// Compute the error from the norm of r and b
+        double err = sqrt(gamma)/normb;
+
+        graph_error.push_back(err);
+
+        /// Break condition = TOLERANCE criterion regarding the error err is reached
+        if (err <= f_tolerance.getValue())
+        {
+            if(nb_iter == 1)
+            {
+                msg_warning() << "tolerance reached at first iteration of CG" << msgendl
+                              << "Check the 'tolerance' data field, you might decrease it";
+            }
+
+            endcond = "tolerance";
+            msg_info_when(verbose) << "error = " << err <<", tolerance = " << f_tolerance.getValue();
+            break;
+        }
+
+        /// Compute the matrix-vector product n = A w, which does not depend on the reduction above
+        n = M * w;
+
+        /// Compute the denominator p.Ap from the reduced values
+        double den;
+        if( nb_iter==1 )
+        {
+            beta = 0;
+            den = delta;
+        }
+        else
+        {
+            beta = gamma / gamma_1;
+            den = delta - beta*gamma/alpha;
+        }
+
+        graph_den.push_back(den);
+
+        /// Break condition = THRESHOLD criterion regarding the denominator is reached (but do at least one iteration)
+        if (fabs(den) <= f_smallDenominatorThreshold.getValue())
+        {
+            if(nb_iter == 1 && den != 0.0)
+            {
+                msg_warning() << "denominator threshold reached at first iteration of CG" << msgendl
+                              << "Check the 'threshold' data field, you might decrease it";
+            }
+
+            endcond = "threshold";
+            msg_info_when(verbose) << "den = " << den <<", smallDenominatorThreshold = " << f_smallDenominatorThreshold.getValue();
+            break;
+        }
+
+        alpha = gamma/den;
+
+        /// Update the directions, then x, r and w
+        cgstep_pipelined(params, x, r, w, n, z, s, p, alpha, beta, nb_iter==1);
+
+        msg_info_when(verbose) << "den = " << den << ", alpha = " << alpha << ", x = " << x << ", r = " << r;
+
+        gamma_1 = gamma;
+    }
+
+    f_graph.endEdit();
+
+    sofa::helper::AdvancedTimer::valSet("CG iterations", nb_iter);
+
+    dmsg_info() << "solve, nbiter = "<<nb_iter<<" stop because of "<<endcond;
+    dmsg_info_when( verbose ) <<"solve, solution = "<< x ;
+
+    vtmp.deleteTempVector(&r);
+    vtmp.deleteTempVector(&w);
+    vtmp.deleteTempVector(&n);
+    vtmp.deleteTempVector(&z);
+    vtmp.deleteTempVector(&s);
+    vtmp.deleteTempVector(&p);
+}
+
 template<class TMatrix, class TVector>
 inline void CGLinearSolver<TMatrix,TVector>::cgstep_beta(const core::ExecParams* /*params*/, Vector& p, Vector& r, SReal beta)
 {
@@ -341,6 +478,33 @@ inline void CGLinearSolver<TMatrix,TVector>::cgstep_alpha(const core::ExecParams
     r.peq(q,-alpha);
 }
 
+template<class TMatrix, class TVector>
+inline void CGLinearSolver<TMatrix,TVector>::cgdot_pipelined(const core::ExecParams* /*params*/, Vector& r, Vector& w, SReal& gamma, SReal& delta)
+{
+    gamma = r.dot(r);
+    delta = w.dot(r);
+}
+
+template<class TMatrix, class TVector>
+inline void CGLinearSolver<TMatrix,TVector>::cgstep_pipelined(const core::ExecParams* /*params*/, Vector& x, Vector& r, Vector& w, Vector& n, Vector& z, Vector& s, Vector& p, SReal alpha, SReal beta, bool first)
+{
+    if (first)
+    {
+        z = n;
+        s = w;
+        p = r;
+    }
+    else
+    {
+        z.eq(n,z,beta); // z = n + z*beta
+        s.eq(w,s,beta); // s = w + s*beta
+        p.eq(r,p,beta); // p = r + p*beta
+    }
+    x.peq(p,alpha);     // x = x + alpha p
+    r.peq(s,-alpha);    // r = r - alpha s
+    w.peq(z,-alpha);    // w = w - alpha z
+}
+
 } // namespace linearsolver
 
 } // namespace component
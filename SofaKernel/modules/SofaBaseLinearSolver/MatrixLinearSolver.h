@@ -329,7 +329,7 @@ public :
 
 public:
 
-    MatrixInvertData * getMatrixInvertData(defaulttype::BaseMatrix * m);
+    virtual MatrixInvertData * getMatrixInvertData(defaulttype::BaseMatrix * m);
 
 protected:
 
@@ -0,0 +1,169 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2018 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#include <SofaBaseLinearSolver/AsyncMatrixLinearSolver.inl>
+#include <SofaBaseLinearSolver/FullMatrix.h>
+#include <SofaBaseLinearSolver/FullVector.h>
+using sofa::component::linearsolver::MatrixLinearSolver ;
+using sofa::component::linearsolver::AsyncThreadManager ;
+using sofa::component::linearsolver::FullMatrix ;
+using sofa::component::linearsolver::FullVector ;
+
+#include <SofaBaseMechanics/MechanicalObject.h>
+#include <SofaBaseMechanics/UniformMass.h>
+typedef sofa::component::container::MechanicalObject<sofa::defaulttype::Vec3Types> MechanicalObject3 ;
+typedef sofa::component::mass::UniformMass<sofa::defaulttype::Vec3Types, SReal> UniformMass3 ;
+
+#include <SofaSimulationGraph/DAGSimulation.h>
+using sofa::simulation::Node ;
+using sofa::core::ExecParams ;
+using sofa::core::objectmodel::New ;
+
+#include <SofaTest/Sofa_test.h>
+
+#include <atomic>
+#include <thread>
+
+namespace
+{
+
+/// Counts the factorizations, which can be held on a gate to emulate a long factorization
+class GatedAsyncSolver : public MatrixLinearSolver<FullMatrix<double>,FullVector<double>,AsyncThreadManager>
+{
+public:
+    SOFA_CLASS(GatedAsyncSolver, SOFA_TEMPLATE3(MatrixLinearSolver,FullMatrix<double>,FullVector<double>,AsyncThreadManager)) ;
+
+    typedef FullMatrix<double> Matrix ;
+    typedef FullVector<double> Vector ;
+
+    std::atomic<int> nbInverts ;
+    std::atomic<bool> gateOpen ;
+
+    virtual void invert(Matrix& /*M*/) override
+    {
+        while (!gateOpen) std::this_thread::yield() ;
+        ++nbInverts ;
+    }
+
+    virtual void solve(Matrix& /*M*/, Vector& x, Vector& b) override { x = b ; }
+
+protected:
+    GatedAsyncSolver() : nbInverts(0), gateOpen(true) {}
+};
+
+class AsyncMatrixLinearSolver_test : public sofa::Sofa_test<>
+{
+public:
+    Node::SPtr root ;
+    GatedAsyncSolver::SPtr solver ;
+
+    void SetUp()
+    {
+        sofa::simulation::setSimulation(new sofa::simulation::graph::DAGSimulation()) ;
+        root = sofa::simulation::getSimulation()->createNewGraph("root") ;
+        MechanicalObject3::SPtr dofs = New<MechanicalObject3>() ;
+        dofs->resize(2) ;
+        root->addObject(dofs) ;
+        root->addObject(New<UniformMass3>()) ;
+        solver = New<GatedAsyncSolver>() ;
+        root->addObject(solver) ;
+        root->init(ExecParams::defaultInstance()) ;
+    }
+
+    void TearDown()
+    {
+        if (solver) solver->gateOpen = true ;
+        if (root)
+            sofa::simulation::getSimulation()->unload(root) ;
+    }
+
+    /// assemble M and submit its factorization
+    void submit()
+    {
+        sofa::core::MechanicalParams mparams ;
+        mparams.setMFactor(1.0) ;
+        solver->setSystemMBKMatrix(&mparams) ;
+    }
+};
+
+TEST_F(AsyncMatrixLinearSolver_test, submitWaitShutdown)
+{
+    // without a previous factorization, the first one is synchronous
+    submit() ;
+    EXPECT_TRUE(solver->hasUpdatedMatrix()) ;
+    EXPECT_FALSE(solver->isFactorizing()) ;
+    EXPECT_EQ(solver->nbInverts, 1) ;
+    EXPECT_EQ(solver->d_nbFactorizations.getValue(), 1u) ;
+    EXPECT_EQ(solver->d_factorAge.getValue(), 0u) ;
+
+#ifdef SOFA_HAVE_BOOST_THREAD
+    // the next factorization runs in background, the solves keep the previous one
+    solver->gateOpen = false ;
+    submit() ;
+    EXPECT_TRUE(solver->hasUpdatedMatrix()) ;
+    EXPECT_TRUE(solver->isFactorizing()) ;
+    EXPECT_EQ(solver->d_nbFactorizations.getValue(), 1u) ;
+    EXPECT_EQ(solver->d_factorAge.getValue(), 1u) ;
+
+    // submitted while busy: the matrix is not updated
+    submit() ;
+    EXPECT_FALSE(solver->hasUpdatedMatrix()) ;
+    EXPECT_EQ(solver->d_factorAge.getValue(), 2u) ;
+
+    solver->gateOpen = true ;
+    solver->waitFactorization() ;
+    EXPECT_FALSE(solver->isFactorizing()) ;
+    EXPECT_EQ(solver->nbInverts, 2) ;
+    // the finished factorization becomes current when the next one is submitted
+    EXPECT_EQ(solver->d_nbFactorizations.getValue(), 1u) ;
+#else
+    // the factorization is computed inline, with the same delay
+    submit() ;
+    EXPECT_TRUE(solver->hasUpdatedMatrix()) ;
+    EXPECT_EQ(solver->nbInverts, 2) ;
+    EXPECT_EQ(solver->d_nbFactorizations.getValue(), 1u) ;
+#endif
+
+    submit() ;
+    EXPECT_TRUE(solver->hasUpdatedMatrix()) ;
+    EXPECT_EQ(solver->d_nbFactorizations.getValue(), 2u) ;
+
+    // shutdown waits for the factorization in progress
+    solver->cleanup() ;
+    EXPECT_FALSE(solver->isFactorizing()) ;
+    EXPECT_EQ(solver->nbInverts, 3) ;
+}
+
+TEST_F(AsyncMatrixLinearSolver_test, synchronousWhenDisabled)
+{
+    solver->d_async.setValue(false) ;
+    for (unsigned i=1; i<=3; ++i)
+    {
+        submit() ;
+        EXPECT_TRUE(solver->hasUpdatedMatrix()) ;
+        EXPECT_FALSE(solver->isFactorizing()) ;
+        EXPECT_EQ(solver->nbInverts, (int)i) ;
+        EXPECT_EQ(solver->d_nbFactorizations.getValue(), i) ;
+        EXPECT_EQ(solver->d_factorAge.getValue(), 0u) ;
+    }
+}
+
+}
@@ -0,0 +1,140 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2018 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+
+#include <SofaBaseLinearSolver/BlockCompressedMatrix.h>
+#include <SofaBaseLinearSolver/FullVector.h>
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+
+namespace sofa {
+
+using component::linearsolver::BlockCompressedMatrix;
+using component::linearsolver::FullVector;
+
+/** Tiled storage of a dense matrix with a smooth, slowly decaying kernel:
+ * off-diagonal tiles are numerically low-rank, as in the inverse of a stiffness.
+ */
+template <class Real>
+struct BlockCompressedMatrix_test : public ::testing::Test
+{
+    enum { N = 300, BS = 32 };
+    std::vector<double> A;
+
+    BlockCompressedMatrix_test()
+        : A(N*N)
+    {
+        for (int i=0; i<N; ++i)
+            for (int j=0; j<N; ++j)
+                A[i*N+j] = 1.0 / (1.0 + fabs((double)(i-j)));
+    }
+
+    void build(BlockCompressedMatrix<Real>& m, double tolerance)
+    {
+        m.beginRows(N, N, BS, tolerance);
+        for (int i=0; i<N; ++i)
+            m.setRow(i, &A[i*N]);
+        m.endRows();
+    }
+
+    double relativeError(const BlockCompressedMatrix<Real>& m)
+    {
+        double err = 0, norm = 0;
+        for (int i=0; i<N; ++i)
+            for (int j=0; j<N; ++j)
+            {
+                const double e = m.element(i,j) - A[i*N+j];
+                err += e*e;
+                norm += A[i*N+j]*A[i*N+j];
+            }
+        return sqrt(err/norm);
+    }
+};
+
+typedef ::testing::Types<float, double> RealTypes;
+TYPED_TEST_CASE(BlockCompressedMatrix_test, RealTypes);
+
+TYPED_TEST(BlockCompressedMatrix_test, denseTilesAreExact)
+{
+    BlockCompressedMatrix<TypeParam> m;
+    this->build(m, 0.0);
+    EXPECT_EQ(m.nbCompressedTiles(), 0u);
+    EXPECT_LT(this->relativeError(m), sizeof(TypeParam) == sizeof(float) ? 1e-6 : 1e-14);
+}
+
+TYPED_TEST(BlockCompressedMatrix_test, compressionMeetsTolerance)
+{
+    const double tolerance = 1e-4;
+    BlockCompressedMatrix<TypeParam> m;
+    this->build(m, tolerance);
+    EXPECT_GT(m.nbCompressedTiles(), 0u);
+    EXPECT_LT(m.memorySize(), (std::size_t)this->N * this->N * sizeof(TypeParam) / 2);
+    EXPECT_LT(this->relativeError(m), tolerance);
+}
+
+TYPED_TEST(BlockCompressedMatrix_test, products)
+{
+    const int N = this->N;
+    BlockCompressedMatrix<TypeParam> m;
+    this->build(m, 1e-6);
+
+    FullVector<double> v(N), res(N);
+    for (int i=0; i<N; ++i)
+        v[i] = sin((double)i);
+    m.mul(res, v);
+    for (int i=0; i<N; ++i)
+    {
+        double expected = 0;
+        for (int j=0; j<N; ++j)
+            expected += this->A[i*N+j] * v[j];
+        EXPECT_NEAR(res[i], expected, 1e-4);
+    }
+
+    std::vector<int> cols;
+    cols.push_back(3); cols.push_back(40); cols.push_back(250); cols.push_back(N-1);
+    std::vector<double> out(cols.size(), 1.0);
+    m.addRowTimes(120, 2.0, cols, &out[0]);
+    for (unsigned c=0; c<cols.size(); ++c)
+        EXPECT_NEAR(out[c], 1.0 + 2.0*this->A[120*N+cols[c]], 1e-5);
+}
+
+TYPED_TEST(BlockCompressedMatrix_test, writeRead)
+{
+    const int N = this->N;
+    BlockCompressedMatrix<TypeParam> m, m2;
+    this->build(m, 1e-4);
+
+    std::stringstream stream;
+    m.write(stream);
+    ASSERT_TRUE(m2.read(stream, N, N));
+    EXPECT_EQ(m2.memorySize(), m.memorySize());
+    for (int i=0; i<N; i+=7)
+        for (int j=0; j<N; j+=5)
+            EXPECT_EQ(m2.element(i,j), m.element(i,j));
+
+    std::stringstream stream2;
+    m.write(stream2);
+    EXPECT_FALSE(m2.read(stream2, N+1, N));
+}
+
+} // namespace sofa
@@ -0,0 +1,136 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2018 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#include <SofaBaseLinearSolver/CGLinearSolver.h>
+
+#include <SofaBaseMechanics/MechanicalObject.h>
+typedef sofa::component::container::MechanicalObject<sofa::defaulttype::Vec3Types> MechanicalObject3 ;
+
+#include <SofaSimulationGraph/DAGSimulation.h>
+using sofa::simulation::Node ;
+
+#include <SofaSimulationCommon/SceneLoaderXML.h>
+using sofa::simulation::SceneLoaderXML ;
+using sofa::core::ExecParams ;
+
+#include <SofaTest/Sofa_test.h>
+
+namespace
+{
+
+typedef std::map < std::string, sofa::helper::vector<SReal> > ResidualGraph ;
+
+/// A spring grid under gravity, with a classic and a pipelined CGLinearSolver
+/// stopped by the same tolerance
+std::string cgNode(const std::string& name, const std::string& matrixType, bool pipelined)
+{
+    return
+            "   <Node name='" + name + "'>                                                          \n"
+            "       <EulerImplicitSolver rayleighStiffness='0' rayleighMass='0'/>                     \n"
+            "       <CGLinearSolver name='solver' template='" + matrixType + "' pipelined='" + (pipelined ? "1" : "0") + "'"
+            "                       iterations='500' tolerance='1e-9' threshold='1e-30'/>            \n"
+            "       <RegularGridTopology n='5 5 3' min='0 0 0' max='4 4 2'/>                          \n"
+            "       <MechanicalObject name='dofs'/>                                                  \n"
+            "       <UniformMass totalMass='2'/>                                                     \n"
+            "       <MeshSpringForceField linesStiffness='1000'/>                                    \n"
+            "       <FixedConstraint indices='0 4 20 24'/>                                           \n"
+            "   </Node>                                                                              \n" ;
+}
+
+class CGLinearSolver_test : public sofa::Sofa_test<>,
+                            public ::testing::WithParamInterface<std::string>
+{
+public:
+    Node::SPtr root ;
+
+    void TearDown()
+    {
+        if (root)
+            sofa::simulation::getSimulation()->unload(root) ;
+    }
+
+    const sofa::helper::vector<SReal>& residuals(const std::string& nodeName)
+    {
+        sofa::core::objectmodel::BaseObject* solver = root->getChild(nodeName)->getObject("solver") ;
+        const ResidualGraph& graph = dynamic_cast< sofa::core::objectmodel::Data<ResidualGraph>* >(solver->findData("graph"))->getValue() ;
+        ResidualGraph::const_iterator it = graph.find("Error") ;
+        static const sofa::helper::vector<SReal> empty ;
+        return it == graph.end() ? empty : it->second ;
+    }
+
+    /// The pipelined recurrence is algebraically equivalent to the classic one, it
+    /// only computes the residual norm from r and w in the fused reduction: both must
+    /// record the same residual history and stop after the same number of iterations
+    void checkPipelinedResiduals(const std::string& matrixType)
+    {
+        EXPECT_MSG_NOEMIT(Error) ;
+        std::stringstream scene ;
+        scene << "<?xml version='1.0'?>                                                           \n"
+                 "<Node name='Root' gravity='0 0 -9.81' dt='0.01'>                                \n"
+                 "   <DefaultAnimationLoop/>                                                      \n"
+              << cgNode("classic", matrixType, false)
+              << cgNode("pipelined", matrixType, true)
+              << "</Node>                                                                         \n" ;
+
+        root = SceneLoaderXML::loadFromMemory("testscene", scene.str().c_str(), scene.str().size()) ;
+        ASSERT_NE(root.get(), nullptr) ;
+        root->init(ExecParams::defaultInstance()) ;
+        sofa::simulation::getSimulation()->animate(root.get(), 0.01) ;
+
+        const sofa::helper::vector<SReal>& classic = residuals("classic") ;
+        const sofa::helper::vector<SReal>& pipelined = residuals("pipelined") ;
+        ASSERT_GT(classic.size(), 5u) ;
+        ASSERT_LT(classic.size(), 500u) ;
+
+        // same iteration count, up to one iteration lost to round-off near the tolerance
+        EXPECT_LE(std::abs((int)pipelined.size() - (int)classic.size()), 1) ;
+        EXPECT_LE(pipelined.back(), 1e-9) ;
+        EXPECT_LE(classic.back(), 1e-9) ;
+
+        // identical residual history while the recurrences have not drifted apart
+        const unsigned n = std::min<unsigned>(10, std::min(classic.size(), pipelined.size())) ;
+        for (unsigned i=0; i<n; ++i)
+            EXPECT_NEAR(pipelined[i], classic[i], 1e-6*classic[i]) << "residual at iteration " << i ;
+
+        MechanicalObject3* classicDofs = NULL ;
+        MechanicalObject3* pipelinedDofs = NULL ;
+        root->getChild("classic")->get(classicDofs) ;
+        root->getChild("pipelined")->get(pipelinedDofs) ;
+        ASSERT_NE(classicDofs, nullptr) ;
+        ASSERT_NE(pipelinedDofs, nullptr) ;
+        const MechanicalObject3::VecCoord& x = pipelinedDofs->read(sofa::core::ConstVecCoordId::position())->getValue() ;
+        const MechanicalObject3::VecCoord& xref = classicDofs->read(sofa::core::ConstVecCoordId::position())->getValue() ;
+        ASSERT_EQ(x.size(), xref.size()) ;
+        for (unsigned i=0; i<x.size(); ++i)
+            EXPECT_LT((x[i]-xref[i]).norm(), 1e-6) << "position of vertex " << i ;
+    }
+};
+
+TEST_P(CGLinearSolver_test, pipelinedResidualHistory)
+{
+    checkPipelinedResiduals(GetParam()) ;
+}
+
+INSTANTIATE_TEST_CASE_P(checkPipelinedResiduals,
+                        CGLinearSolver_test,
+                        ::testing::Values("GraphScattered", "CompressedRowSparseMatrixd")) ;
+
+}
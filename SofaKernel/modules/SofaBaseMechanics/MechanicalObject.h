@@ -177,6 +177,9 @@ public:
 
     virtual void reset() override;
 
+    /// Adds the dynamically allocated vectors (e.g. the solvers' temporary and warm-start vectors)
+    virtual void getExtraStateData(core::objectmodel::Base::VecData& data) override;
+
     virtual void writeVec(core::ConstVecId v, std::ostream &out) override;
     virtual void readVec(core::VecId v, std::istream &in) override;
     virtual SReal compareVec(core::ConstVecId v, std::istream &in) override;
@@ -1333,6 +1333,21 @@ void MechanicalObject<DataTypes>::reset()
 }
 
 
+template <class DataTypes>
+void MechanicalObject<DataTypes>::getExtraStateData(core::objectmodel::Base::VecData& data)
+{
+    // the static vectors are registered as fields, only the ones created by write() are added
+    for (unsigned int i = 0; i < vectorsCoord.size(); ++i)
+        if (vectorsCoord[i] && !vectorsCoord[i]->getOwner())
+            data.push_back(vectorsCoord[i]);
+    for (unsigned int i = 0; i < vectorsDeriv.size(); ++i)
+        if (vectorsDeriv[i] && !vectorsDeriv[i]->getOwner())
+            data.push_back(vectorsDeriv[i]);
+    for (unsigned int i = 0; i < vectorsMatrixDeriv.size(); ++i)
+        if (vectorsMatrixDeriv[i] && !vectorsMatrixDeriv[i]->getOwner())
+            data.push_back(vectorsMatrixDeriv[i]);
+}
+
 template <class DataTypes>
 void MechanicalObject<DataTypes>::writeVec(core::ConstVecId v, std::ostream &out)
 {
@@ -121,4 +121,53 @@ TEST( VisualModelImpl_test , checkThatMembersAreCorrectlyConstructed )
     ASSERT_EQ(1u, visualModel.xforms.size());
 }
 
+TEST( VisualModelImpl_test , computeNormalsWithUpdateTolerance )
+{
+    typedef component::visualmodel::VisualModelImpl::Coord Coord;
+    StubVisualModelImpl visualModel;
+
+    component::visualmodel::VisualModelImpl::VecCoord positions;
+    positions.push_back(Coord(0,0,0));
+    positions.push_back(Coord(1,0,0));
+    positions.push_back(Coord(1,1,0));
+    positions.push_back(Coord(0,1,0));
+    positions.push_back(Coord(2,0,0));
+    defaulttype::ResizableExtVector< sofa::core::topology::BaseMeshTopology::Quad > quads;
+    quads.push_back(sofa::core::topology::BaseMeshTopology::Quad(0,1,2,3));
+    defaulttype::ResizableExtVector< sofa::core::topology::BaseMeshTopology::Triangle > triangles;
+    triangles.push_back(sofa::core::topology::BaseMeshTopology::Triangle(1,4,2));
+
+    visualModel.m_positions.setValue(positions);
+    visualModel.m_quads.setValue(quads);
+    visualModel.m_triangles.setValue(triangles);
+    visualModel.m_updateTolerance.setValue(0.1f);
+    visualModel.computeNormals();
+
+    ASSERT_EQ(5u, visualModel.getVnormals().size());
+    for (unsigned int i = 0; i < 5; ++i)
+        EXPECT_NEAR(1.0, visualModel.getVnormals()[i][2], 1e-6);
+
+    // below the tolerance, the normals are kept
+    positions[3][2] = 0.05f;
+    visualModel.m_positions.setValue(positions);
+    visualModel.computeNormals();
+    EXPECT_NEAR(1.0, visualModel.getVnormals()[3][2], 1e-6);
+
+    // above it, the vertices around the moved one are updated, the others are kept
+    positions[3][2] = 0.5f;
+    visualModel.m_positions.setValue(positions);
+    visualModel.computeNormals();
+    EXPECT_GT(0.99, visualModel.getVnormals()[3][2]);
+    EXPECT_GT(0.99, visualModel.getVnormals()[0][2]);
+    EXPECT_NEAR(1.0, visualModel.getVnormals()[4][2], 1e-6);
+
+    // without tolerance, every normal is recomputed
+    visualModel.m_updateTolerance.setValue(0.0f);
+    positions[3][2] = 0.0f;
+    visualModel.m_positions.setValue(positions);
+    visualModel.computeNormals();
+    for (unsigned int i = 0; i < 5; ++i)
+        EXPECT_NEAR(1.0, visualModel.getVnormals()[i][2], 1e-6);
+}
+
 } //sofa
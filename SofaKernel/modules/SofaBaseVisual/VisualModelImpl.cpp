@@ -43,7 +43,9 @@
 #include <sofa/helper/io/MeshSTL.h>
 #include <sofa/helper/rmath.h>
 #include <sofa/helper/accessor.h>
+#include <sofa/helper/IndexOpenMP.h>
 #include <sstream>
+#include <algorithm>
 #include <map>
 #include <memory>
 
@@ -130,6 +132,7 @@ VisualModelImpl::VisualModelImpl() //const std::string &name, std::string filena
     , m_handleDynamicTopology (initData   (&m_handleDynamicTopology, true, "handleDynamicTopology", "True if topological changes should be handled"))
     , m_fixMergedUVSeams (initData   (&m_fixMergedUVSeams, true, "fixMergedUVSeams", "True if UV seams should be handled even when duplicate UVs are merged"))
     , m_keepLines (initData   (&m_keepLines, false, "keepLines", "keep and draw lines (false by default)"))
+    , m_updateTolerance (initData   (&m_updateTolerance, (Real)0, "updateTolerance", "Normals and tangents are only updated around vertices that moved more than this distance since their last update (0 to always update them)"))
     , m_vertices2       (initData   (&m_vertices2, "vertices", "vertices of the model (only if vertices have multiple normals/texcoords, otherwise positions are used)"))
     , m_vtexcoords      (initData   (&m_vtexcoords, "texcoords", "coordinates of the texture"))
     , m_vtangents       (initData   (&m_vtangents, "tangents", "tangents for normal mapping"))
@@ -139,6 +142,7 @@ VisualModelImpl::VisualModelImpl() //const std::string &name, std::string filena
     , m_quads           (initData   (&m_quads, "quads", "quads of the model"))
     , m_vertPosIdx      (initData   (&m_vertPosIdx, "vertPosIdx", "If vertices have multiple normals/texcoords stores vertices position indices"))
     , m_vertNormIdx     (initData   (&m_vertNormIdx, "vertNormIdx", "If vertices have multiple normals/texcoords stores vertices normal indices"))
+    , m_movedVerticesCounter(-1)
     , fileMesh          (initData   (&fileMesh, "fileMesh"," Path to the model"))
     , texturename       (initData   (&texturename, "texturename", "Name of the Texture"))
     , m_translation     (initData   (&m_translation, Vec3Real(), "translation", "Initial Translation of the object"))
@@ -154,6 +158,7 @@ VisualModelImpl::VisualModelImpl() //const std::string &name, std::string filena
     , xformsModified(false)
 {
     m_topology = 0;
+    std::fill(m_adjacencyKey, m_adjacencyKey+4, -1);
 
     //material.setDisplayed(false);
     addAlias(&fileMesh, "filename");
@@ -810,116 +815,215 @@ void VisualModelImpl::init()
     updateVisual();
 }
 
-void VisualModelImpl::computeNormals()
+void VisualModelImpl::updateVertexFaceAdjacency()
 {
-    const VecCoord& vertices = getVertices();
-    //const VecCoord& vertices = m_vertices2.getValue();
-    if (vertices.empty() || (!m_updateNormals.getValue() && (m_vnormals.getValue()).size() == (vertices).size())) return;
-
     const ResizableExtVector<Triangle>& triangles = m_triangles.getValue();
     const ResizableExtVector<Quad>& quads = m_quads.getValue();
-    const ResizableExtVector<int> &vertNormIdx = m_vertNormIdx.getValue();
+    const ResizableExtVector<int>& vertNormIdx = m_vertNormIdx.getValue();
+    const int nbv = (int)getVertices().size();
+    const int key[4] = { nbv, m_triangles.getCounter(), m_quads.getCounter(), m_vertNormIdx.getCounter() };
+    if (std::equal(key, key+4, m_adjacencyKey)) return;
+    std::copy(key, key+4, m_adjacencyKey);
+
+    // the vertices flagged as moved refer to the previous mesh
+    m_lastUpdatePositions.clear();
+    m_movedVerticesCounter = -1;
+
+    const int nbt = (int)triangles.size();
+    const int nbq = (int)quads.size();
+    m_vertexFacesBegin.assign(nbv+1, 0);
+    for (int i = 0; i < nbt; i++)
+        for (int c = 0; c < 3; c++)
+            ++m_vertexFacesBegin[triangles[i][c]+1];
+    for (int i = 0; i < nbq; i++)
+        for (int c = 0; c < 4; c++)
+            ++m_vertexFacesBegin[quads[i][c]+1];
+    for (int i = 0; i < nbv; i++)
+        m_vertexFacesBegin[i+1] += m_vertexFacesBegin[i];
+
+    m_vertexFaces.resize(m_vertexFacesBegin[nbv]);
+    helper::vector<int> next(m_vertexFacesBegin.begin(), m_vertexFacesBegin.end()-1);
+    for (int i = 0; i < nbt; i++)
+        for (int c = 0; c < 3; c++)
+            m_vertexFaces[next[triangles[i][c]]++] = 4*i+c;
+    for (int i = 0; i < nbq; i++)
+        for (int c = 0; c < 4; c++)
+            m_vertexFaces[next[quads[i][c]]++] = 4*(nbt+i)+c;
+
+    m_normalVerticesBegin.clear();
+    m_normalVertices.clear();
+    if (vertNormIdx.empty()) return;
+
+    const int nbi = (int)vertNormIdx.size();
+    int nbn = 0;
+    for (int i = 0; i < nbi; i++)
+        if (vertNormIdx[i] >= nbn)
+            nbn = vertNormIdx[i]+1;
+
+    m_normalVerticesBegin.assign(nbn+1, 0);
+    for (int i = 0; i < nbi; i++)
+        ++m_normalVerticesBegin[vertNormIdx[i]+1];
+    for (int n = 0; n < nbn; n++)
+        m_normalVerticesBegin[n+1] += m_normalVerticesBegin[n];
+
+    m_normalVertices.resize(nbi);
+    next.assign(m_normalVerticesBegin.begin(), m_normalVerticesBegin.end()-1);
+    for (int i = 0; i < nbi; i++)
+        m_normalVertices[next[vertNormIdx[i]]++] = i;
+}
 
-    if (vertNormIdx.empty())
-    {
-        int nbn = (vertices).size();
+void VisualModelImpl::updateMovedVertices()
+{
+    const core::objectmodel::BaseData& positions = m_vertPosIdx.getValue().empty()
+            ? static_cast<const core::objectmodel::BaseData&>(m_positions) : m_vertices2;
+    if (positions.getCounter() == m_movedVerticesCounter) return; // already flagged for these positions
+    m_movedVerticesCounter = positions.getCounter();
 
-        ResizableExtVector<Deriv>& normals = *(m_vnormals.beginEdit());
+    const VecCoord& vertices = getVertices();
+    const int nbv = (int)vertices.size();
+    const Real tolerance = m_updateTolerance.getValue();
+    if (tolerance <= 0 || (int)m_lastUpdatePositions.size() != nbv)
+    {
+        m_movedVertices.clear();
+        if (tolerance > 0)
+            m_lastUpdatePositions.assign(vertices.begin(), vertices.end());
+        else
+            m_lastUpdatePositions.clear();
+        return;
+    }
 
-        normals.resize(nbn);
-        for (int i = 0; i < nbn; i++)
-            normals[i].clear();
+    // the reference position of a vertex only changes when it is flagged,
+    // so that slow motions are caught up once they exceed the tolerance
+    const Real tolerance2 = tolerance*tolerance;
+    m_movedVertices.resize(nbv);
+#ifdef _OPENMP
+    #pragma omp parallel for if (nbv > 4096)
+#endif
+    for (helper::IndexOpenMP<int>::type i = 0; i < nbv; i++)
+    {
+        const bool moved = (vertices[i] - m_lastUpdatePositions[i]).norm2() > tolerance2;
+        m_movedVertices[i] = moved;
+        if (moved)
+            m_lastUpdatePositions[i] = vertices[i];
+    }
+}
 
-        for (unsigned int i = 0; i < triangles.size(); i++)
+bool VisualModelImpl::isVertexAffected(const ResizableExtVector<Triangle>& triangles, const ResizableExtVector<Quad>& quads, int i) const
+{
+    if (m_movedVertices.empty()) return true;
+    const int nbt = (int)triangles.size();
+    for (int k = m_vertexFacesBegin[i]; k < m_vertexFacesBegin[i+1]; k++)
+    {
+        const int f = m_vertexFaces[k] >> 2;
+        if (f < nbt)
         {
-            const Coord& v1 = vertices[triangles[i][0]];
-            const Coord& v2 = vertices[triangles[i][1]];
-            const Coord& v3 = vertices[triangles[i][2]];
-            Coord n = cross(v2-v1, v3-v1);
-
-            normals[triangles[i][0]] += n;
-            normals[triangles[i][1]] += n;
-            normals[triangles[i][2]] += n;
+            const Triangle& t = triangles[f];
+            if (m_movedVertices[t[0]] || m_movedVertices[t[1]] || m_movedVertices[t[2]])
+                return true;
         }
-
-        for (unsigned int i = 0; i < quads.size(); i++)
+        else
         {
-            const Coord & v1 = vertices[quads[i][0]];
-            const Coord & v2 = vertices[quads[i][1]];
-            const Coord & v3 = vertices[quads[i][2]];
-            const Coord & v4 = vertices[quads[i][3]];
-            Coord n1 = cross(v2-v1, v4-v1);
-            Coord n2 = cross(v3-v2, v1-v2);
-            Coord n3 = cross(v4-v3, v2-v3);
-            Coord n4 = cross(v1-v4, v3-v4);
-
-            normals[quads[i][0]] += n1;
-            normals[quads[i][1]] += n2;
-            normals[quads[i][2]] += n3;
-            normals[quads[i][3]] += n4;
+            const Quad& q = quads[f-nbt];
+            if (m_movedVertices[q[0]] || m_movedVertices[q[1]] || m_movedVertices[q[2]] || m_movedVertices[q[3]])
+                return true;
         }
-
-        for (unsigned int i = 0; i < normals.size(); i++)
-            normals[i].normalize();
-
-        m_vnormals.endEdit();
     }
-    else
+    return false;
+}
+
+VisualModelImpl::Deriv VisualModelImpl::computeVertexNormal(const VecCoord& vertices, const ResizableExtVector<Triangle>& triangles,
+                                                            const ResizableExtVector<Quad>& quads, int i) const
+{
+    const int nbt = (int)triangles.size();
+    Deriv n;
+    for (int k = m_vertexFacesBegin[i]; k < m_vertexFacesBegin[i+1]; k++)
     {
-        vector<Coord> normals;
-        int nbn = 0;
-        for (unsigned int i = 0; i < vertNormIdx.size(); i++)
+        const int f = m_vertexFaces[k] >> 2;
+        if (f < nbt)
         {
-            if (vertNormIdx[i] >= nbn)
-                nbn = vertNormIdx[i]+1;
+            const Coord& v1 = vertices[triangles[f][0]];
+            const Coord& v2 = vertices[triangles[f][1]];
+            const Coord& v3 = vertices[triangles[f][2]];
+            n += cross(v2-v1, v3-v1);
         }
-
-        normals.resize(nbn);
-        for (int i = 0; i < nbn; i++)
-            normals[i].clear();
-
-        for (unsigned int i = 0; i < triangles.size() ; i++)
+        else
         {
-            const Coord & v1 = vertices[triangles[i][0]];
-            const Coord & v2 = vertices[triangles[i][1]];
-            const Coord & v3 = vertices[triangles[i][2]];
-            Coord n = cross(v2-v1, v3-v1);
-
-            normals[vertNormIdx[triangles[i][0]]] += n;
-            normals[vertNormIdx[triangles[i][1]]] += n;
-            normals[vertNormIdx[triangles[i][2]]] += n;
+            // each quad corner uses its two edges
+            const Quad& q = quads[f-nbt];
+            const int c = m_vertexFaces[k] & 3;
+            const Coord& v = vertices[q[c]];
+            n += cross(vertices[q[(c+1)&3]]-v, vertices[q[(c+3)&3]]-v);
         }
+    }
+    return n;
+}
 
-        for (unsigned int i = 0; i < quads.size() ; i++)
+void VisualModelImpl::computeNormals()
+{
+    const VecCoord& vertices = getVertices();
+    //const VecCoord& vertices = m_vertices2.getValue();
+    if (vertices.empty() || (!m_updateNormals.getValue() && (m_vnormals.getValue()).size() == (vertices).size())) return;
+
+    const ResizableExtVector<Triangle>& triangles = m_triangles.getValue();
+    const ResizableExtVector<Quad>& quads = m_quads.getValue();
+    const ResizableExtVector<int> &vertNormIdx = m_vertNormIdx.getValue();
+
+    updateVertexFaceAdjacency();
+    updateMovedVertices();
+
+    const int nbv = (int)vertices.size();
+    ResizableExtVector<Deriv>& normals = *(m_vnormals.beginEdit());
+    // normals of unaffected vertices are kept from the previous update
+    const bool incremental = !m_movedVertices.empty() && (int)normals.size() == nbv;
+    normals.resize(nbv);
+
+    // each vertex gathers the normals of its own faces, so that vertices are computed concurrently
+    if (vertNormIdx.empty())
+    {
+#ifdef _OPENMP
+        #pragma omp parallel for if (nbv > 4096)
+#endif
+        for (helper::IndexOpenMP<int>::type i = 0; i < nbv; i++)
         {
-            const Coord & v1 = vertices[quads[i][0]];
-            const Coord & v2 = vertices[quads[i][1]];
-            const Coord & v3 = vertices[quads[i][2]];
-            const Coord & v4 = vertices[quads[i][3]];
-            Coord n1 = cross(v2-v1, v4-v1);
-            Coord n2 = cross(v3-v2, v1-v2);
-            Coord n3 = cross(v4-v3, v2-v3);
-            Coord n4 = cross(v1-v4, v3-v4);
-
-            normals[vertNormIdx[quads[i][0]]] += n1;
-            normals[vertNormIdx[quads[i][1]]] += n2;
-            normals[vertNormIdx[quads[i][2]]] += n3;
-            normals[vertNormIdx[quads[i][3]]] += n4;
+            if (incremental && !isVertexAffected(triangles, quads, i)) continue;
+            Deriv n = computeVertexNormal(vertices, triangles, quads, i);
+            n.normalize();
+            normals[i] = n;
         }
-
-        for (unsigned int i = 0; i < normals.size(); i++)
+    }
+    else
+    {
+        const int nbn = (int)m_normalVerticesBegin.size()-1;
+        const bool sharedIncremental = incremental && (int)m_sharedNormals.size() == nbn;
+        m_sharedNormals.resize(nbn);
+#ifdef _OPENMP
+        #pragma omp parallel for if (nbn > 4096)
+#endif
+        for (helper::IndexOpenMP<int>::type j = 0; j < nbn; j++)
         {
-            normals[i].normalize();
+            const int begin = m_normalVerticesBegin[j];
+            const int end = m_normalVerticesBegin[j+1];
+            bool affected = !sharedIncremental;
+            for (int k = begin; k < end && !affected; k++)
+                affected = isVertexAffected(triangles, quads, m_normalVertices[k]);
+            if (!affected) continue;
+
+            Deriv n;
+            for (int k = begin; k < end; k++)
+                n += computeVertexNormal(vertices, triangles, quads, m_normalVertices[k]);
+            n.normalize();
+            m_sharedNormals[j] = n;
         }
 
-        ResizableExtVector<Deriv>& vnormals = *(m_vnormals.beginEdit());
-        vnormals.resize(vertices.size());
-        for (unsigned int i = 0; i < vertices.size(); i++)
+#ifdef _OPENMP
+        #pragma omp parallel for if (nbv > 4096)
+#endif
+        for (helper::IndexOpenMP<int>::type i = 0; i < nbv; i++)
         {
-            vnormals[i] = normals[vertNormIdx[i]];
+            normals[i] = m_sharedNormals[vertNormIdx[i]];
         }
-        m_vnormals.endEdit();
     }
+    m_vnormals.endEdit();
 }
 
 VisualModelImpl::Coord VisualModelImpl::computeTangent(const Coord &v1, const Coord &v2, const Coord &v3,
@@ -946,87 +1050,75 @@ void VisualModelImpl::computeTangents()
     const ResizableExtVector<Quad>& quads = m_quads.getValue();
     const VecCoord& vertices = getVertices();
     const VecTexCoord& texcoords = m_vtexcoords.getValue();
-    VecCoord& normals = *(m_vnormals.beginEdit());
+    const VecCoord& normals = m_vnormals.getValue();
     VecCoord& tangents = *(m_vtangents.beginEdit());
     VecCoord& bitangents = *(m_vbitangents.beginEdit());
 
-    tangents.resize(vertices.size());
-    bitangents.resize(vertices.size());
+    updateVertexFaceAdjacency();
+    updateMovedVertices();
+
+    const int nbv = (int)vertices.size();
+    const int nbt = (int)triangles.size();
+    const bool incremental = !m_movedVertices.empty() && (int)tangents.size() == nbv && (int)bitangents.size() == nbv;
+    tangents.resize(nbv);
+    bitangents.resize(nbv);
 
-    for (unsigned i = 0; i < vertices.size(); i++)
-    {
-        tangents[i].clear();
-        bitangents[i].clear();
-    }
     const bool fixMergedUVSeams = m_fixMergedUVSeams.getValue();
-    for (unsigned int i = 0; i < triangles.size() ; i++)
+#ifdef _OPENMP
+    #pragma omp parallel for if (nbv > 4096)
+#endif
+    for (helper::IndexOpenMP<int>::type i = 0; i < nbv; i++)
     {
-        const Coord v1 = vertices[triangles[i][0]];
-        const Coord v2 = vertices[triangles[i][1]];
-        const Coord v3 = vertices[triangles[i][2]];
-        TexCoord t1 = texcoords[triangles[i][0]];
-        TexCoord t2 = texcoords[triangles[i][1]];
-        TexCoord t3 = texcoords[triangles[i][2]];
-        if (fixMergedUVSeams)
+        if (incremental && !isVertexAffected(triangles, quads, i)) continue;
+
+        Coord t, b;
+        for (int k = m_vertexFacesBegin[i]; k < m_vertexFacesBegin[i+1]; k++)
         {
-            for (unsigned int j=0; j<t1.size(); ++j)
+            const int f = m_vertexFaces[k] >> 2;
+            if (f < nbt)
             {
-                t2[j] += helper::rnear(t1[j]-t2[j]);
-                t3[j] += helper::rnear(t1[j]-t3[j]);
+                const Coord& v1 = vertices[triangles[f][0]];
+                const Coord& v2 = vertices[triangles[f][1]];
+                const Coord& v3 = vertices[triangles[f][2]];
+                const TexCoord t1 = texcoords[triangles[f][0]];
+                TexCoord t2 = texcoords[triangles[f][1]];
+                TexCoord t3 = texcoords[triangles[f][2]];
+                if (fixMergedUVSeams)
+                {
+                    for (unsigned int j=0; j<t1.size(); ++j)
+                    {
+                        t2[j] += helper::rnear(t1[j]-t2[j]);
+                        t3[j] += helper::rnear(t1[j]-t3[j]);
+                    }
+                }
+                t += computeTangent(v1, v2, v3, t1, t2, t3);
+                b += computeBitangent(v1, v2, v3, t1, t2, t3);
+            }
+            else
+            {
+                // Too many options how to split a quad into two triangles...
+                // each corner sums the three triangles made of consecutive quad vertices that contain it
+                const Quad& q = quads[f-nbt];
+                const int c = m_vertexFaces[k] & 3;
+                for (int s = 0; s < 4; s++)
+                {
+                    if (s == ((c+1)&3)) continue;
+                    const int s1 = (s+1)&3;
+                    const int s2 = (s+2)&3;
+                    t += computeTangent(vertices[q[s]], vertices[q[s1]], vertices[q[s2]],
+                                        texcoords[q[s]], texcoords[q[s1]], texcoords[q[s2]]);
+                    // the bitangent of the first triangle uses (v1,v2,v2), unchanged to keep the existing shading
+                    b += computeBitangent(vertices[q[s]], vertices[q[s1]], vertices[q[s == 0 ? s1 : s2]],
+                                          texcoords[q[s]], texcoords[q[s1]], texcoords[q[s2]]);
+                }
             }
         }
-        Coord t = computeTangent(v1, v2, v3, t1, t2, t3);
-        Coord b = computeBitangent(v1, v2, v3, t1, t2, t3);
-
-        tangents[triangles[i][0]] += t;
-        tangents[triangles[i][1]] += t;
-        tangents[triangles[i][2]] += t;
-        bitangents[triangles[i][0]] += b;
-        bitangents[triangles[i][1]] += b;
-        bitangents[triangles[i][2]] += b;
-    }
-
-    for (unsigned int i = 0; i < quads.size() ; i++)
-    {
-        const Coord & v1 = vertices[quads[i][0]];
-        const Coord & v2 = vertices[quads[i][1]];
-        const Coord & v3 = vertices[quads[i][2]];
-        const Coord & v4 = vertices[quads[i][3]];
-        const TexCoord t1 = texcoords[quads[i][0]];
-        const TexCoord t2 = texcoords[quads[i][1]];
-        const TexCoord t3 = texcoords[quads[i][2]];
-        const TexCoord t4 = texcoords[quads[i][3]];
-
-        // Too many options how to split a quad into two triangles...
-        Coord t123 = computeTangent  (v1, v2, v3, t1, t2, t3);
-        Coord b123 = computeBitangent(v1, v2, v2, t1, t2, t3);
-
-        Coord t234 = computeTangent  (v2, v3, v4, t2, t3, t4);
-        Coord b234 = computeBitangent(v2, v3, v4, t2, t3, t4);
-
-        Coord t341 = computeTangent  (v3, v4, v1, t3, t4, t1);
-        Coord b341 = computeBitangent(v3, v4, v1, t3, t4, t1);
-
-        Coord t412 = computeTangent  (v4, v1, v2, t4, t1, t2);
-        Coord b412 = computeBitangent(v4, v1, v2, t4, t1, t2);
-
-        tangents  [quads[i][0]] += t123        + t341 + t412;
-        bitangents[quads[i][0]] += b123        + b341 + b412;
-        tangents  [quads[i][1]] += t123 + t234        + t412;
-        bitangents[quads[i][1]] += b123 + b234        + b412;
-        tangents  [quads[i][2]] += t123 + t234 + t341;
-        bitangents[quads[i][2]] += b123 + b234 + b341;
-        tangents  [quads[i][3]] +=        t234 + t341 + t412;
-        bitangents[quads[i][3]] +=        b234 + b341 + b412;
-    }
-    for (unsigned int i = 0; i < vertices.size(); i++)
-    {
-        Coord n = normals[i];
-        Coord& t = tangents[i];
-        Coord& b = bitangents[i];
 
+        const Coord& n = normals[i];
         b = sofa::defaulttype::cross(n, t.normalized());
         t = sofa::defaulttype::cross(b, n);
+        tangents[i] = t;
+        bitangents[i] = b;
     }
     m_vtangents.endEdit();
     m_vbitangents.endEdit();
@@ -205,6 +205,7 @@ public:
     Data<bool> m_handleDynamicTopology; ///< True if topological changes should be handled
     Data<bool> m_fixMergedUVSeams; ///< True if UV seams should be handled even when duplicate UVs are merged
     Data<bool> m_keepLines; ///< keep and draw lines (false by default)
+    Data<Real> m_updateTolerance; ///< Normals and tangents are only updated around vertices that moved more than this distance since their last update (0 to always update them)
 
     Data< VecCoord > m_vertices2; ///< vertices of the model (only if vertices have multiple normals/texcoords, otherwise positions are used)
     topology::PointData< VecTexCoord > m_vtexcoords; ///< coordinates of the texture
@@ -230,6 +231,35 @@ public:
     template<class VecType>
     void addTopoHandler(topology::PointData<VecType>* data, int algo = 0);
 
+    /// Faces around each vertex, in compressed row storage: the faces of vertex i are
+    /// m_vertexFaces[m_vertexFacesBegin[i]] to m_vertexFaces[m_vertexFacesBegin[i+1]-1].
+    /// Each one is stored as 4*face+corner, quads being numbered after the triangles.
+    helper::vector<int> m_vertexFacesBegin;
+    helper::vector<int> m_vertexFaces;
+    /// Vertices sharing each normal, in the same storage (only used with vertNormIdx)
+    helper::vector<int> m_normalVerticesBegin;
+    helper::vector<int> m_normalVertices;
+    helper::vector<Deriv> m_sharedNormals;
+    /// Vertex count and triangles, quads and vertNormIdx counters the adjacency was built for
+    int m_adjacencyKey[4];
+
+    /// Positions at the last normals update of each vertex, only kept if updateTolerance is set
+    helper::vector<Coord> m_lastUpdatePositions;
+    /// Vertices that moved more than updateTolerance, empty if all of them must be updated
+    helper::vector<char> m_movedVertices;
+    int m_movedVerticesCounter;
+
+    /// Rebuild the vertex to faces adjacency if the mesh changed since the last call
+    void updateVertexFaceAdjacency();
+    /// Flag the vertices that moved more than updateTolerance since their last update
+    void updateMovedVertices();
+    /// True if a vertex of one of the faces around vertex i was flagged by updateMovedVertices
+    bool isVertexAffected(const sofa::defaulttype::ResizableExtVector<Triangle>& triangles,
+            const sofa::defaulttype::ResizableExtVector<Quad>& quads, int i) const;
+    /// Sum of the (area weighted) normals of the faces around vertex i
+    Deriv computeVertexNormal(const VecCoord& vertices, const sofa::defaulttype::ResizableExtVector<Triangle>& triangles,
+            const sofa::defaulttype::ResizableExtVector<Quad>& quads, int i) const;
+
 public:
 
     sofa::core::objectmodel::DataFileName fileMesh;
@@ -0,0 +1,279 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2018 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#include "TestEngine.h"
+#include <SceneCreator/SceneCreator.h>
+#include <SofaTest/Sofa_test.h>
+#include <sofa/simulation/DataEngineScheduler.h>
+
+namespace sofa {
+
+/** Test suite for DataEngineScheduler using TestEngine.
+The output of engine1 is linked to the inputs of engine2 and engine3, the
+output of engine2 to the input of engine4.
+
+                  engine2 -- engine4
+                 /
+         engine1
+                 \
+                  engine3
+  */
+struct DataEngineScheduler_test : public Sofa_test<>
+{
+    typedef sofa::component::engine::TestEngine TestEngine;
+    typedef sofa::core::objectmodel::DDGNode DDGNode;
+    TestEngine::SPtr engine1;
+    TestEngine::SPtr engine2;
+    TestEngine::SPtr engine3;
+    TestEngine::SPtr engine4;
+    sofa::simulation::DataEngineScheduler scheduler;
+
+    void SetUp()
+    {
+        engine1 = sofa::core::objectmodel::New<TestEngine>();
+        engine1->f_numberToMultiply.setValue(1);
+        engine1->f_factor.setValue(2);
+        engine1->init();
+
+        engine2 = sofa::core::objectmodel::New<TestEngine>();
+        sofa::modeling::setDataLink(&engine1->f_result,&engine2->f_numberToMultiply);
+        engine2->f_factor.setValue(3);
+        engine2->init();
+
+        engine3 = sofa::core::objectmodel::New<TestEngine>();
+        sofa::modeling::setDataLink(&engine1->f_result,&engine3->f_numberToMultiply);
+        engine3->f_factor.setValue(3);
+        engine3->init();
+
+        engine4 = sofa::core::objectmodel::New<TestEngine>();
+        sofa::modeling::setDataLink(&engine2->f_result,&engine4->f_numberToMultiply);
+        engine4->f_factor.setValue(3);
+        engine4->init();
+
+        // TestEngine records its updates in a shared list
+        scheduler.setParallel(false);
+    }
+
+    helper::vector<DDGNode*> allEngines()
+    {
+        helper::vector<DDGNode*> engines;
+        engines.push_back(engine1.get());
+        engines.push_back(engine2.get());
+        engines.push_back(engine3.get());
+        engines.push_back(engine4.get());
+        return engines;
+    }
+
+    void resetCounters()
+    {
+        engine1->counter = engine2->counter = engine3->counter = engine4->counter = 0;
+    }
+};
+
+/// all the engines are updated once, by dependency levels
+TEST_F(DataEngineScheduler_test, update_all )
+{
+    scheduler.update(allEngines());
+
+    EXPECT_EQ(scheduler.getEngines().size(), 4u);
+    EXPECT_EQ(scheduler.getNbLevels(), 3u);
+    EXPECT_EQ(engine1->getCounterUpdate(), 1);
+    EXPECT_EQ(engine2->getCounterUpdate(), 1);
+    EXPECT_EQ(engine3->getCounterUpdate(), 1);
+    EXPECT_EQ(engine4->getCounterUpdate(), 1);
+    EXPECT_FALSE(engine4->isDirty());
+
+    // reading the outputs does not trigger any other update
+    EXPECT_EQ(engine2->f_result.getValue(), 6);
+    EXPECT_EQ(engine3->f_result.getValue(), 6);
+    EXPECT_EQ(engine4->f_result.getValue(), 18);
+    EXPECT_EQ(engine1->getCounterUpdate() + engine2->getCounterUpdate() + engine3->getCounterUpdate() + engine4->getCounterUpdate(), 4);
+
+    // depending on the measured times, the critical path ends with engine3 or engine4
+    const helper::vector<sofa::simulation::DataEngineScheduler::EngineTiming>& path = scheduler.getCriticalPath();
+    ASSERT_GE(path.size(), 2u);
+    EXPECT_EQ(path[0].engine, engine1.get());
+    for (unsigned i = 1; i < path.size(); ++i)
+        EXPECT_EQ(path[i].level, path[i-1].level + 1);
+}
+
+/// only the engines downstream of a changed Data are updated
+TEST_F(DataEngineScheduler_test, update_from_changed_data )
+{
+    scheduler.update(allEngines());
+    resetCounters();
+
+    engine3->f_factor.setValue(4);
+    helper::vector<DDGNode*> changed(1, &engine3->f_factor);
+    scheduler.update(changed);
+
+    EXPECT_EQ(scheduler.getEngines().size(), 1u);
+    EXPECT_EQ(engine1->getCounterUpdate(), 0);
+    EXPECT_EQ(engine2->getCounterUpdate(), 0);
+    EXPECT_EQ(engine3->getCounterUpdate(), 1);
+    EXPECT_EQ(engine4->getCounterUpdate(), 0);
+    EXPECT_EQ(engine3->f_result.getValue(), 8);
+
+    resetCounters();
+    engine1->f_factor.setValue(3);
+    changed[0] = &engine1->f_factor;
+    scheduler.update(changed);
+
+    EXPECT_EQ(scheduler.getEngines().size(), 4u);
+    EXPECT_EQ(engine1->getCounterUpdate(), 1);
+    EXPECT_EQ(engine2->getCounterUpdate(), 1);
+    EXPECT_EQ(engine3->getCounterUpdate(), 1);
+    EXPECT_EQ(engine4->getCounterUpdate(), 1);
+    EXPECT_EQ(engine3->f_result.getValue(), 12);
+    EXPECT_EQ(engine4->f_result.getValue(), 27);
+}
+
+/// nothing to do when the engines are clean
+TEST_F(DataEngineScheduler_test, clean_engines )
+{
+    scheduler.update(allEngines());
+    resetCounters();
+    scheduler.update(allEngines());
+
+    EXPECT_TRUE(scheduler.getEngines().empty());
+    EXPECT_TRUE(scheduler.getCriticalPath().empty());
+    EXPECT_EQ(engine1->getCounterUpdate() + engine2->getCounterUpdate() + engine3->getCounterUpdate() + engine4->getCounterUpdate(), 0);
+}
+
+/// Multiplies its number by a factor shared by all the ScaleEngines
+class ScaleEngine : public core::DataEngine
+{
+public:
+    SOFA_CLASS(ScaleEngine, core::DataEngine);
+
+    Data<SReal> f_number;
+    Data<SReal> f_result;
+    const Data<SReal>* factor;
+    int counter;
+
+    void setFactor(const Data<SReal>* f)
+    {
+        factor = f;
+        addInput(const_cast<Data<SReal>*>(f));
+        addInput(&f_number);
+        addOutput(&f_result);
+        setDirtyValue();
+    }
+
+    void update() override
+    {
+        ++counter;
+        const SReal number = f_number.getValue();
+        const SReal f = factor->getValue();
+        cleanDirty();
+        f_result.setValue(number*f);
+    }
+
+protected:
+    ScaleEngine()
+        : f_number(initData(&f_number, (SReal)0, "number", "number to multiply"))
+        , f_result(initData(&f_result, (SReal)0, "result", "number times the shared factor"))
+        , factor(NULL)
+        , counter(0)
+    {}
+};
+
+/// Sums the results of the ScaleEngines, and holds the factor they share
+class SumEngine : public core::DataEngine
+{
+public:
+    SOFA_CLASS(SumEngine, core::DataEngine);
+
+    Data<SReal> f_factor;
+    Data<SReal> f_sum;
+    helper::vector<const Data<SReal>*> terms;
+    int counter;
+
+    void addTerm(ScaleEngine* e)
+    {
+        terms.push_back(&e->f_result);
+        addInput(&e->f_result);
+    }
+
+    void update() override
+    {
+        ++counter;
+        SReal sum = 0;
+        for (unsigned i = 0; i < terms.size(); ++i)
+            sum += terms[i]->getValue();
+        cleanDirty();
+        f_sum.setValue(sum);
+    }
+
+protected:
+    SumEngine()
+        : f_factor(initData(&f_factor, (SReal)1, "factor", "factor of the ScaleEngines"))
+        , f_sum(initData(&f_sum, (SReal)0, "sum", "sum of the results of the ScaleEngines"))
+        , counter(0)
+    {
+        addOutput(&f_sum);
+    }
+};
+
+/// a level of engines sharing an input and a downstream engine, updated concurrently
+TEST( DataEngineSchedulerParallel_test, shared_input_and_output )
+{
+    const unsigned nbEngines = 64;
+    SumEngine::SPtr sum = sofa::core::objectmodel::New<SumEngine>();
+    helper::vector<ScaleEngine::SPtr> engines;
+    SReal numbers = 0;
+    for (unsigned i = 0; i < nbEngines; ++i)
+    {
+        ScaleEngine::SPtr e = sofa::core::objectmodel::New<ScaleEngine>();
+        e->f_number.setValue((SReal)i);
+        e->setFactor(&sum->f_factor);
+        sum->addTerm(e.get());
+        engines.push_back(e);
+        numbers += i;
+    }
+    sum->setDirtyValue();
+
+    sofa::simulation::DataEngineScheduler scheduler;
+    scheduler.setParallel(true);
+    for (int step = 1; step <= 20; ++step)
+    {
+        sum->f_factor.setValue((SReal)step);
+        helper::vector<core::objectmodel::DDGNode*> changed(1, &sum->f_factor);
+        scheduler.update(changed);
+
+        ASSERT_EQ(scheduler.getNbLevels(), 2u);
+        ASSERT_EQ(scheduler.getEngines().size(), (std::size_t)nbEngines+1);
+        for (unsigned i = 0; i < nbEngines; ++i)
+        {
+            EXPECT_EQ(engines[i]->counter, step);
+            EXPECT_FALSE(engines[i]->isDirty());
+            EXPECT_FALSE(engines[i]->f_result.isDirty());
+        }
+        EXPECT_EQ(sum->counter, step);
+        EXPECT_FALSE(sum->isDirty());
+
+        // reading the sum does not trigger any other update
+        EXPECT_EQ(sum->f_sum.getValue(), step*numbers);
+        EXPECT_EQ(sum->counter, step);
+    }
+}
+
+}// namespace sofa
@@ -74,6 +74,8 @@ public:
         virtual bool read(istream& f, int n, int binary) = 0;
         virtual bool read(const string& s, int n, int binary) = 0;
         virtual bool read(const string& s, int binary) = 0;
+        /// Copy n values (all the values if n <= 0) from raw bytes, swapped if binary == 2
+        virtual bool readBinary(const char* bytes, std::size_t nbBytes, int n, int binary) = 0;
         virtual bool write(ofstream& f, int n, int groups, int binary) = 0;
         virtual const void* getData() = 0;
         virtual void swap() = 0;
@@ -101,6 +103,7 @@ public:
         virtual bool read(const string& s, int n, int binary) ;
         virtual bool read(const string& s, int binary) ;
         virtual bool read(istream& in, int n, int binary) ;
+        virtual bool readBinary(const char* bytes, std::size_t nbBytes, int n, int binary) ;
         virtual bool write(ofstream& out, int n, int groups, int binary) ;
         virtual BaseData* createSofaData() ;
     };
@@ -26,6 +26,7 @@
 #include <string>
 #include <istream>
 #include <fstream>
+#include <cstring>
 
 
 namespace sofa
@@ -169,6 +170,23 @@ bool BaseVTKReader::VTKDataIO<T>::read(istream& in, int n, int binary)
     return true;
 }
 
+template<class T>
+bool BaseVTKReader::VTKDataIO<T>::readBinary(const char* bytes, std::size_t nbBytes, int n, int binary)
+{
+    if (n <= 0)
+        n = (int)(nbBytes / sizeof(T));
+    if ((std::size_t)n * sizeof(T) > nbBytes)
+    {
+        resize(0);
+        return false;
+    }
+    resize(n);
+    std::memcpy(data, bytes, n * sizeof(T));
+    if (binary == 2) // swap bytes
+        swap();
+    return true;
+}
+
 template<class T>
 bool BaseVTKReader::VTKDataIO<T>::write(ofstream& out, int n, int groups, int binary)
 {
@@ -23,8 +23,16 @@
 #include <SofaLoader/MeshObjLoader.h>
 #include <sofa/core/visual/VisualParams.h>
 #include <sofa/helper/io/File.h>
+#include <sofa/helper/io/MemoryMappedFile.h>
+#include <sofa/helper/io/FastTextParser.h>
 #include <sofa/helper/system/SetDirectory.h>
 #include <sofa/helper/system/Locale.h>
+#include <sofa/helper/IndexOpenMP.h>
+#include <iterator>
+#include <limits>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 namespace sofa
 {
@@ -52,10 +60,121 @@ int MeshObjLoaderClass = core::RegisterObject("Specific mesh loader for Obj file
         ;
 
 
+namespace
+{
+
+/// value of an index field left empty, as in "1//3"
+const int noObjIndex = std::numeric_limits<int>::min();
+
+/// Face or group change read in a chunk of the file, in file order
+struct ObjRecord
+{
+    enum Kind { FACE, GROUP, MATERIAL };
+    Kind kind;
+    unsigned int begin, end;       ///< FACE: range of its (position,normal) raw indices in ObjChunk::indices
+    unsigned int nbPositions;      ///< FACE: number of positions read in the chunk before this face
+    unsigned int nbNormals;        ///< FACE: number of normals read in the chunk before this face
+    string name;                   ///< GROUP: new group name
+
+    explicit ObjRecord(Kind k) : kind(k), begin(0), end(0), nbPositions(0), nbNormals(0) {}
+};
+
+/// Result of the parsing of a range of lines, independent of the other ranges
+struct ObjChunk
+{
+    vector<Vector3> positions;
+    vector<Vector3> normals;
+    vector<ObjRecord> records;
+    vector<int> indices;
+};
+
+void readObjVector(const char*& p, const char* end, Vector3& v)
+{
+    for (int i = 0; i < 3; ++i)
+    {
+        p = fasttext::skipBlanks(p, end);
+        double value = 0.0;
+        fasttext::parseReal(p, end, value);
+        v[i] = (SReal)value;
+    }
+}
+
+void parseObjChunk(const char* p, const char* end, bool storeGroups, ObjChunk& chunk)
+{
+    while (p != end)
+    {
+        const char* eol = fasttext::lineEnd(p, end);
+        const char* q = fasttext::skipBlanks(p, eol);
+
+        if (fasttext::matchToken(q, eol, "v"))
+        {
+            /* vertex */
+            Vector3 v;
+            readObjVector(q, eol, v);
+            chunk.positions.push_back(v);
+        }
+        else if (fasttext::matchToken(q, eol, "vn"))
+        {
+            /* normal */
+            Vector3 n;
+            readObjVector(q, eol, n);
+            chunk.normals.push_back(n);
+        }
+        else if (fasttext::matchToken(q, eol, "l") || fasttext::matchToken(q, eol, "f"))
+        {
+            /* face */
+            ObjRecord face(ObjRecord::FACE);
+            face.begin = (unsigned int)chunk.indices.size();
+            face.nbPositions = (unsigned int)chunk.positions.size();
+            face.nbNormals = (unsigned int)chunk.normals.size();
+            for (q = fasttext::skipBlanks(q, eol); q != eol; q = fasttext::skipBlanks(q, eol))
+            {
+                // vertex/texcoord/normal, each of them may be missing
+                int vtn[3] = { noObjIndex, noObjIndex, noObjIndex };
+                for (int j = 0; j < 3; ++j)
+                {
+                    if (q != eol && *q != '/' && !fasttext::isBlank(*q))
+                    {
+                        vtn[j] = 0; // not a number: invalid index
+                        fasttext::parseInt(q, eol, vtn[j]);
+                    }
+                    while (q != eol && *q != '/' && !fasttext::isBlank(*q)) ++q;
+                    if (q == eol || *q != '/') break;
+                    ++q;
+                }
+                chunk.indices.push_back(vtn[0]);
+                chunk.indices.push_back(vtn[2]);
+            }
+            face.end = (unsigned int)chunk.indices.size();
+            chunk.records.push_back(face);
+        }
+        else if (storeGroups && fasttext::matchToken(q, eol, "usemtl"))
+        {
+            chunk.records.push_back(ObjRecord(ObjRecord::MATERIAL));
+        }
+        else if (storeGroups && fasttext::matchToken(q, eol, "g"))
+        {
+            ObjRecord group(ObjRecord::GROUP);
+            for (string g = fasttext::readToken(q, eol); !g.empty(); g = fasttext::readToken(q, eol))
+            {
+                if (!group.name.empty())
+                    group.name += " ";
+                group.name += g;
+            }
+            chunk.records.push_back(group);
+        }
+
+        p = (eol == end) ? end : eol + 1;
+    }
+}
+
+} // namespace
+
 
 MeshObjLoader::MeshObjLoader()
     : MeshLoader()
     , d_storeGroups(initData(&d_storeGroups,false,"storeGroups", "should sub-groups be stored?"))
+    , d_binaryCache(initData(&d_binaryCache,false,"binaryCache", "write the loaded mesh in a binary file next to the OBJ file and read it instead of the OBJ file as long as its content does not change"))
 {
     d_positions.setPersistent(false);
     d_normals.setPersistent(false);
@@ -83,15 +202,31 @@ bool MeshObjLoader::load()
     if (!canLoad())
         return false;
 
-    const char* filename = m_filename.getFullPath().c_str();
-    File file;
-    file.open(filename);
-    istream stream(file.streambuf());
+    const std::string filename = m_filename.getFullPath();
+    MemoryMappedFile file;
+    if (!file.open(filename))
+    {
+        msg_error() << "Cannot read file '" << filename << "'.";
+        return false;
+    }
+
+    uint64_t cacheKey = 0;
+    std::string cacheOptions;
+    if (d_binaryCache.getValue())
+    {
+        cacheKey = file.hash();
+        cacheOptions = d_storeGroups.getValue() ? "storeGroups=1" : "storeGroups=0";
+        if (readBinaryCache(filename, cacheKey, cacheOptions))
+            return true;
+    }
 
     // -- Reading file
-    fileRead = this->readOBJ (stream, filename);
+    fileRead = this->readOBJ (file.data(), file.data() + file.size());
     file.close();
 
+    if (fileRead && d_binaryCache.getValue())
+        writeBinaryCache(filename, cacheKey, cacheOptions);
+
     return fileRead;
 }
 
@@ -100,14 +235,40 @@ bool MeshObjLoader::readOBJ (istream &stream, const char* filename)
 {
     SOFA_UNUSED(filename);
 
+    const string content((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+    return readOBJ(content.data(), content.data() + content.size());
+}
+
+
+bool MeshObjLoader::readOBJ (const char* begin, const char* end, std::size_t nbChunks)
+{
     dmsg_info() << " readOBJ" ;
 
+    // -- Parse ranges of lines concurrently, indices are resolved afterwards
+    // since negative ones are relative to the elements read before them
+    if (nbChunks == 0)
+    {
+        nbChunks = 1;
+#ifdef _OPENMP
+        if (end - begin > (1<<20))
+            nbChunks = 4 * (std::size_t)omp_get_max_threads();
+#endif
+    }
+    const vector<const char*> bounds = fasttext::splitLines(begin, end, nbChunks);
+    vector<ObjChunk> chunks(bounds.size() - 1);
+    const bool storeGroups = d_storeGroups.getValue();
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic,1)
+#endif
+    for (helper::IndexOpenMP<int>::type c = 0; c < (int)chunks.size(); ++c)
+        parseObjChunk(bounds[c], bounds[c+1], storeGroups, chunks[c]);
+
     vector<Vector3>& my_positions = *(d_positions.beginWriteOnly());
-    vector<int> nodes, nIndices;
+    vector<int> nodes;
 
     vector<Vector3> my_normals;
-    SVector< SVector <int> > my_faceList;
-    SVector< SVector <int> > my_normalsList;
+    vector<int> my_faceNormals; // (position,normal) pairs of all the faces
 
     vector<Edge >& my_edges = *(d_edges.beginWriteOnly());
     vector<Triangle >& my_triangles = *(d_triangles.beginWriteOnly());
@@ -122,8 +283,15 @@ bool MeshObjLoader::readOBJ (istream &stream, const char* filename)
     d_trianglesGroups.beginWriteOnly()->clear(); d_trianglesGroups.endEdit();
     d_quadsGroups.beginWriteOnly()->clear(); d_quadsGroups.endEdit();
 
-    int vtn[3];
-    Vector3 result;
+    std::size_t nbPositions = 0, nbNormals = 0;
+    for (std::size_t c = 0; c < chunks.size(); ++c)
+    {
+        nbPositions += chunks[c].positions.size();
+        nbNormals += chunks[c].normals.size();
+    }
+    my_positions.reserve(nbPositions);
+    my_normals.reserve(nbNormals);
+
     WriteAccessor<Data<vector< PrimitiveGroup> > > my_faceGroups[NBFACETYPE] =
     {
         d_edgesGroups,
@@ -135,98 +303,57 @@ bool MeshObjLoader::readOBJ (istream &stream, const char* filename)
     int curMaterialId = -1;
     int nbFaces[NBFACETYPE] = {0}; // number of edges, triangles, quads
     int groupF0[NBFACETYPE] = {0}; // first primitives indices in current group for edges, triangles, quads
-    string line;
-    while( std::getline(stream,line) )
+    for (std::size_t c = 0; c < chunks.size(); ++c)
     {
-        if (line.empty()) continue;
-        std::istringstream values(line);
-        string token;
+        ObjChunk& chunk = chunks[c];
+        const std::size_t positionOffset = my_positions.size();
+        const std::size_t normalOffset = my_normals.size();
+        my_positions.insert(my_positions.end(), chunk.positions.begin(), chunk.positions.end());
+        my_normals.insert(my_normals.end(), chunk.normals.begin(), chunk.normals.end());
 
-        values >> token;
-        if (token == "#")
-        {
-            /* comment */
-        }
-        else if (token == "v")
-        {
-            /* vertex */
-            values >> result[0] >> result[1] >> result[2];
-            my_positions.push_back(Vector3(result[0],result[1], result[2]));
-        }
-        else if (token == "vn")
-        {
-            /* normal */
-            values >> result[0] >> result[1] >> result[2];
-            my_normals.push_back(Vector3(result[0],result[1], result[2]));
-        }
-        else if ((token == "usemtl" || token == "g") && d_storeGroups.getValue() )
+        for (std::size_t r = 0; r < chunk.records.size(); ++r)
         {
-            // end of current group
-            //curGroup.nbp = nbf - curGroup.p0;
-            for (int ft = 0; ft < NBFACETYPE; ++ft)
-                if (nbFaces[ft] > groupF0[ft])
-                {
-                    my_faceGroups[ft].push_back(PrimitiveGroup(groupF0[ft], nbFaces[ft]-groupF0[ft], curMaterialName, curGroupName, curMaterialId));
-                    groupF0[ft] = nbFaces[ft];
-                }
-            if (token == "g")
+            const ObjRecord& record = chunk.records[r];
+            if (record.kind != ObjRecord::FACE)
             {
-                curGroupName.clear();
-                while (!values.eof())
-                {
-                    string g;
-                    values >> g;
-                    if (!curGroupName.empty())
-                        curGroupName += " ";
-                    curGroupName += g;
-                }
+                // end of current group
+                for (int ft = 0; ft < NBFACETYPE; ++ft)
+                    if (nbFaces[ft] > groupF0[ft])
+                    {
+                        my_faceGroups[ft].push_back(PrimitiveGroup(groupF0[ft], nbFaces[ft]-groupF0[ft], curMaterialName, curGroupName, curMaterialId));
+                        groupF0[ft] = nbFaces[ft];
+                    }
+                if (record.kind == ObjRecord::GROUP)
+                    curGroupName = record.name;
+                continue;
             }
-        }
-        else if (token == "l" || token == "f")
-        {
+
             /* face */
             nodes.clear();
-            nIndices.clear();
-
-            while (!values.eof())
+            const int counts[2] = { (int)(positionOffset + record.nbPositions), (int)(normalOffset + record.nbNormals) };
+            for (unsigned int k = record.begin; k < record.end; k += 2)
             {
-                string face;
-                values >> face;
-                if (face.empty()) continue;
-                for (int j = 0; j < 3; j++)
+                int vn[2];
+                for (int j = 0; j < 2; ++j)
                 {
-                    vtn[j] = -1;
-                    string::size_type pos = face.find('/');
-                    string tmp = face.substr(0, pos);
-                    if (pos == string::npos)
-                        face = "";
+                    const int index = chunk.indices[k+j];
+                    if (index == noObjIndex)
+                        vn[j] = -1;
+                    else if (index >= 1)
+                        vn[j] = index - 1; // -1 because the numerotation begins at 1 and a vector begins at 0
+                    else if (index < 0)
+                        vn[j] = index + counts[j];
                     else
                     {
-                        face = face.substr(pos + 1);
-                    }
-
-                    if (!tmp.empty())
-                    {
-                        vtn[j] = atoi(tmp.c_str());
-                        if (vtn[j] >= 1)
-                            vtn[j] -=1; // -1 because the numerotation begins at 1 and a vector begins at 0
-                        else if (vtn[j] < 0)
-                            vtn[j] += (j==0) ? my_positions.size() : (j==2) ? my_normals.size() : 0/*my_texCoords.size()*/;
-                        else
-                        {
-                            serr << "Invalid index " << tmp << sendl;
-                            vtn[j] = -1;
-                        }
+                        serr << "Invalid index " << index << sendl;
+                        vn[j] = -1;
                     }
                 }
-
-                nodes.push_back(vtn[0]);
-                nIndices.push_back(vtn[2]);
+                nodes.push_back(vn[0]);
+                my_faceNormals.push_back(vn[0]);
+                my_faceNormals.push_back(vn[1]);
             }
 
-            my_faceList.push_back(nodes);
-            my_normalsList.push_back(nIndices);
-
             if (nodes.size() == 2) // Edge
             {
                 if (nodes[0]<nodes[1])
@@ -246,8 +373,12 @@ bool MeshObjLoader::readOBJ (istream &stream, const char* filename)
                     addTriangle(&my_triangles, Triangle(nodes[0], nodes[j-1], nodes[j]));
                 ++nbFaces[MeshObjLoader::TRIANGLE];
             }
-
         }
+
+        // release the memory of the chunk as soon as it is merged
+        ObjChunk().positions.swap(chunk.positions);
+        ObjChunk().normals.swap(chunk.normals);
+        ObjChunk().indices.swap(chunk.indices);
     }
 
     // end of current group
@@ -272,19 +403,12 @@ bool MeshObjLoader::readOBJ (istream &stream, const char* filename)
     {
         vNormals.resize(0);
     }
-    for (size_t fi=0; fi<my_faceList.size(); ++fi)
+    for (size_t i = 0; i < my_faceNormals.size(); i += 2)
     {
-        const SVector<int>& nodes = my_faceList[fi];
-        const SVector<int>& nIndices = my_normalsList[fi];
-
-        for (size_t i = 0; i < nodes.size(); ++i)
-        {
-            unsigned int pi = nodes[i];
-            unsigned int ni = nIndices[i];
-            if (i >= vertexCount) continue;
-            if (ni < my_normals.size())
-                vNormals[pi] += my_normals[ni];
-        }
+        unsigned int pi = my_faceNormals[i];
+        unsigned int ni = my_faceNormals[i+1];
+        if (pi < vNormals.size() && ni < my_normals.size())
+            vNormals[pi] += my_normals[ni];
     }
     for (size_t i=0; i<vNormals.size(); ++i)
     {
@@ -307,4 +431,3 @@ bool MeshObjLoader::readOBJ (istream &stream, const char* filename)
 } // namespace component
 
 } // namespace sofa
-
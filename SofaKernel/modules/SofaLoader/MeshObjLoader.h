@@ -59,10 +59,13 @@ public:
 protected:
 
     bool readOBJ (std::istream &stream, const char* filename);
+    /// nbChunks: number of line ranges parsed concurrently, 0 to choose it from the buffer size and the number of threads
+    bool readOBJ (const char* begin, const char* end, std::size_t nbChunks = 0);
 
 public:
 
     Data< bool > d_storeGroups; ///< should sub-groups be stored?
+    Data< bool > d_binaryCache; ///< write the loaded mesh in a binary file next to the OBJ file and read it instead of the OBJ file as long as its content does not change
 
     virtual std::string type() { return "The format of this mesh is OBJ."; }
 };
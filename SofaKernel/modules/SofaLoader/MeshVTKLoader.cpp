@@ -21,7 +21,10 @@
 ******************************************************************************/
 #include <iostream>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <sstream>
+#include <algorithm>
 
 #include <sofa/core/ObjectFactory.h>
 #include <SofaLoader/MeshVTKLoader.h>
@@ -33,8 +36,15 @@ using sofa::component::loader::BaseVTKReader ;
 /// This is needed for template specialization.
 #include <SofaLoader/BaseVTKReader.inl>
 
+#include <sofa/helper/io/MemoryMappedFile.h>
+#include <sofa/helper/system/thread/CTime.h>
+
 #include <tinyxml.h>
 
+#if defined(WIN32) || defined(_XBOX)
+#define strcasecmp stricmp
+#endif
+
 //XML VTK Loader
 #define checkError(A) if (!A) { return false; }
 #define checkErrorPtr(A) if (!A) { return NULL; }
@@ -69,8 +79,20 @@ public:
 class XMLVTKReader : public BaseVTKReader
 {
 public:
+    XMLVTKReader() : headerSize(4), appendedData(NULL), appendedEnd(NULL), appendedBase64(false) {}
     bool readFile(const char* filename);
 protected:
+    /// size in bytes of the length prefixing each binary block (header_type)
+    int headerSize;
+    /// content of the AppendedData element, after the leading '_'
+    const char* appendedData;
+    const char* appendedEnd;
+    bool appendedBase64;
+
+    bool getBinaryBlock(TiXmlElement* dataArrayElement, const string& format, int binary,
+                        string& decoded, const char*& bytes, std::size_t& nbBytes);
+    BaseVTKDataIO* readConvertedDataArray(const string& type, const string& fileType,
+                                          const char* bytes, std::size_t nbBytes, int n, int binary);
     bool loadUnstructuredGrid(TiXmlHandle datasetFormatHandle);
     bool loadPolydata(TiXmlHandle datasetFormatHandle);
     bool loadRectilinearGrid(TiXmlHandle datasetFormatHandle);
@@ -165,12 +187,24 @@ bool MeshVTKLoader::load()
         return false;
     }
 
+    const helper::system::thread::ctime_t start = helper::system::thread::CTime::getRefTime();
+
     fileRead = reader->readVTK (filename);
     this->setInputsMesh();
     this->setInputsData();
 
     delete reader;
 
+    if (fileRead)
+    {
+        const double seconds = (double)(helper::system::thread::CTime::getRefTime() - start)
+                / (double)helper::system::thread::CTime::getRefTicksPerSec();
+        std::ifstream in(filename, std::ifstream::in | std::ifstream::binary | std::ifstream::ate);
+        const double nbBytes = (double)in.tellg();
+        msg_info(this) << "Read " << nbBytes << " bytes in " << seconds << " s ("
+                       << (seconds > 0 ? nbBytes / seconds / 1e6 : 0.0) << " MB/s)";
+    }
+
     return fileRead;
 }
 
@@ -184,11 +218,15 @@ bool MeshVTKLoader::setInputsMesh()
         if (vtkpd)
         {
             const double* inPoints = (vtkpd->data);
+            const std::size_t offset = my_positions.size();
             if (inPoints)
-                for (int i = 0; i < vtkpd->dataSize; i += 3)
+            {
+                my_positions.resize(offset + vtkpd->dataSize / 3);
+                for (int i = 0; i + 2 < vtkpd->dataSize; i += 3)
                 {
-                    my_positions.push_back(Vector3 ((double)inPoints[i + 0], (double)inPoints[i + 1], (double)inPoints[i + 2]));
+                    my_positions[offset + i / 3] = Vector3 ((double)inPoints[i + 0], (double)inPoints[i + 1], (double)inPoints[i + 2]);
                 }
+            }
             else
             {
                 return false;
@@ -197,11 +235,15 @@ bool MeshVTKLoader::setInputsMesh()
         else if (vtkpf)
         {
             const float* inPoints = (vtkpf->data);
+            const std::size_t offset = my_positions.size();
             if (inPoints)
-                for (int i = 0; i < vtkpf->dataSize; i += 3)
+            {
+                my_positions.resize(offset + vtkpf->dataSize / 3);
+                for (int i = 0; i + 2 < vtkpf->dataSize; i += 3)
                 {
-                    my_positions.push_back(Vector3 ((float)inPoints[i + 0], (float)inPoints[i + 1], (float)inPoints[i + 2]));
+                    my_positions[offset + i / 3] = Vector3 ((float)inPoints[i + 0], (float)inPoints[i + 1], (float)inPoints[i + 2]);
                 }
+            }
             else
             {
                 return false;
@@ -343,6 +385,20 @@ bool MeshVTKLoader::setInputsMesh()
         size_t j;
         int nbf = reader->numberOfCells;
         int i = 0;
+
+        // size the destination arrays once
+        std::size_t nbCells[13] = {0};
+        for (int c = 0; c < nbf; ++c)
+        {
+            const int t = dataT[c];
+            if (t >= 0 && t < 13) ++nbCells[t];
+            else if (t == 22) ++nbCells[5];
+            else if (t == 24) ++nbCells[10];
+        }
+        my_triangles.reserve(my_triangles.size() + nbCells[5]);
+        my_quads.reserve(my_quads.size() + nbCells[8] + nbCells[9]);
+        my_tetrahedra.reserve(my_tetrahedra.size() + nbCells[10]);
+        my_hexahedra.reserve(my_hexahedra.size() + nbCells[11] + nbCells[12]);
         for (int c = 0; c < nbf; ++c)
         {
             int t = dataT[c];// - 48; //ASCII
@@ -956,11 +1012,114 @@ bool LegacyVTKReader::readFile(const char* filename)
     return true;
 }
 
+namespace
+{
+
+/// Decode base64 text. Each padded quartet ends a block, so that data encoded
+/// in several blocks (length header then values) are decoded as one sequence.
+void decodeBase64(const char* p, const char* end, string& out)
+{
+    unsigned int bits = 0;
+    int nbChars = 0, nbPad = 0;
+    out.reserve(out.size() + (std::size_t)(end - p) / 4 * 3);
+    for ( ; p != end; ++p)
+    {
+        const char c = *p;
+        int v;
+        if (c >= 'A' && c <= 'Z') v = c - 'A';
+        else if (c >= 'a' && c <= 'z') v = c - 'a' + 26;
+        else if (c >= '0' && c <= '9') v = c - '0' + 52;
+        else if (c == '+') v = 62;
+        else if (c == '/') v = 63;
+        else if (c == '=') { v = 0; ++nbPad; }
+        else continue; // white spaces
+        bits = (bits << 6) | (unsigned int)v;
+        if (++nbChars == 4)
+        {
+            out += (char)((bits >> 16) & 0xff);
+            if (nbPad < 2) out += (char)((bits >> 8) & 0xff);
+            if (nbPad < 1) out += (char)(bits & 0xff);
+            bits = 0;
+            nbChars = nbPad = 0;
+        }
+    }
+}
+
+/// Number of base64 characters encoding nbBytes bytes
+std::size_t base64Length(std::size_t nbBytes)
+{
+    return (nbBytes + 2) / 3 * 4;
+}
+
+template<class TSrc, class TDst>
+bool convertBinary(BaseVTKReader::VTKDataIO<TDst>* dst, const char* bytes, std::size_t nbBytes, int n, int binary)
+{
+    if (n <= 0)
+        n = (int)(nbBytes / sizeof(TSrc));
+    if ((std::size_t)n * sizeof(TSrc) > nbBytes)
+        return false;
+    dst->resize(n);
+    for (int i = 0; i < n; ++i)
+    {
+        TSrc v;
+        std::memcpy(&v, bytes + i * sizeof(TSrc), sizeof(TSrc));
+        if (binary == 2)
+            v = BaseVTKReader::VTKDataIO<TSrc>::swapT(v, 1);
+        dst->data[i] = (TDst)v;
+    }
+    return true;
+}
+
+/// Convert the values of the file type to TDst while they are copied
+template<class TDst>
+bool convertBinary(BaseVTKReader::VTKDataIO<TDst>* dst, const string& fileType, const char* bytes, std::size_t nbBytes, int n, int binary)
+{
+    const char* t = fileType.c_str();
+    if (!strcasecmp(t, "Int8")) return convertBinary<char>(dst, bytes, nbBytes, n, binary);
+    if (!strcasecmp(t, "UInt8")) return convertBinary<std::uint8_t>(dst, bytes, nbBytes, n, binary);
+    if (!strcasecmp(t, "Int16")) return convertBinary<std::int16_t>(dst, bytes, nbBytes, n, binary);
+    if (!strcasecmp(t, "UInt16")) return convertBinary<std::uint16_t>(dst, bytes, nbBytes, n, binary);
+    if (!strcasecmp(t, "Int32")) return convertBinary<std::int32_t>(dst, bytes, nbBytes, n, binary);
+    if (!strcasecmp(t, "UInt32")) return convertBinary<std::uint32_t>(dst, bytes, nbBytes, n, binary);
+    if (!strcasecmp(t, "Int64")) return convertBinary<std::int64_t>(dst, bytes, nbBytes, n, binary);
+    if (!strcasecmp(t, "UInt64")) return convertBinary<std::uint64_t>(dst, bytes, nbBytes, n, binary);
+    if (!strcasecmp(t, "Float32")) return convertBinary<float>(dst, bytes, nbBytes, n, binary);
+    if (!strcasecmp(t, "Float64")) return convertBinary<double>(dst, bytes, nbBytes, n, binary);
+    return false;
+}
+
+} // namespace
+
 bool XMLVTKReader::readFile(const char* filename)
 {
-    TiXmlDocument vtkDoc(filename);
+    // The file is mapped: the XML part is parsed by TinyXML, the appended
+    // binary data (if any) is read in place without being parsed
+    helper::io::MemoryMappedFile file(filename);
+    checkErrorMsg(file.isOpen(), "Unknown error while loading VTK Xml doc");
+    const char* begin = file.data();
+    const char* end = begin + file.size();
+
+    static const char appendedTag[] = "<AppendedData";
+    const char* appended = std::search(begin, end, appendedTag, appendedTag + sizeof(appendedTag) - 1);
+    string xml(begin, appended);
+    if (appended != end)
+    {
+        const char* tagEnd = std::find(appended, end, '>');
+        const string tag(appended, tagEnd);
+        appendedBase64 = (tag.find("base64") != string::npos);
+        const char* p = (tagEnd == end) ? end : std::find(tagEnd + 1, end, '_');
+        checkErrorMsg((p != end), "AppendedData without data");
+        appendedData = p + 1;
+        static const char appendedEndTag[] = "</AppendedData>";
+        appendedEnd = std::find_end(appendedData, end, appendedEndTag, appendedEndTag + sizeof(appendedEndTag) - 1);
+        xml += "</VTKFile>\n";
+    }
+
+    TiXmlDocument vtkDoc;
+    vtkDoc.Parse(xml.c_str());
     //quick check
-    checkErrorMsg(vtkDoc.LoadFile(), "Unknown error while loading VTK Xml doc");
+    checkErrorMsg(!vtkDoc.Error(), "Unknown error while loading VTK Xml doc");
+    string().swap(xml);
 
     TiXmlHandle hVTKDoc(&vtkDoc);
     TiXmlElement* pElem;
@@ -974,7 +1133,12 @@ bool XMLVTKReader::readFile(const char* filename)
 
     //Endianness
     const char* endiannessStrTemp = pElem->Attribute("byte_order");
-    isLittleEndian = (string(endiannessStrTemp).compare("LittleEndian") == 0) ;
+    isLittleEndian = (endiannessStrTemp == NULL || string(endiannessStrTemp).compare("LittleEndian") == 0) ;
+
+    //Binary blocks
+    const char* headerTypeStrTemp = pElem->Attribute("header_type");
+    headerSize = (headerTypeStrTemp && string(headerTypeStrTemp).compare("UInt64") == 0) ? 8 : 4;
+    checkErrorMsg((pElem->Attribute("compressor") == NULL), "Compressed VTK Xml files are not supported");
 
     //read VTK data format type
     const char* datasetFormatStrTemp = pElem->Attribute("type");
@@ -1053,13 +1217,123 @@ BaseVTKReader::BaseVTKDataIO* XMLVTKReader::loadDataArray(TiXmlElement* dataArra
     return loadDataArray(dataArrayElement, size, "");
 }
 
+bool XMLVTKReader::getBinaryBlock(TiXmlElement* dataArrayElement, const string& format, int binary,
+                                  string& decoded, const char*& bytes, std::size_t& nbBytes)
+{
+    const char* block = NULL;
+    const char* blockEnd = NULL;
+    bool base64 = true;
+    if (format.compare("appended") == 0)
+    {
+        const char* offsetStr = dataArrayElement->Attribute("offset");
+        if (!offsetStr || !appendedData)
+            return false;
+        const std::size_t offset = (std::size_t)strtoull(offsetStr, NULL, 10);
+        if (offset >= (std::size_t)(appendedEnd - appendedData))
+            return false;
+        block = appendedData + offset;
+        blockEnd = appendedEnd;
+        base64 = appendedBase64;
+    }
+    else if (format.compare("binary") == 0)
+    {
+        block = dataArrayElement->GetText();
+        if (!block)
+            return false;
+        blockEnd = block + strlen(block);
+    }
+    else
+    {
+        return false;
+    }
+
+    // base64 data are written either as two encoded blocks (length header, then
+    // values) or as a single one, the first one then ends with a padding character
+    const std::size_t encodedHeaderSize = base64Length(headerSize);
+    const bool separateHeader = base64 && (std::size_t)(blockEnd - block) >= encodedHeaderSize
+            && block[encodedHeaderSize-1] == '=';
+    if (base64)
+    {
+        decoded.clear();
+        decodeBase64(block, std::min(blockEnd, block + encodedHeaderSize), decoded);
+        if (decoded.size() < (std::size_t)headerSize)
+            return false;
+    }
+    else if (blockEnd - block < headerSize)
+    {
+        return false;
+    }
+    const char* header = base64 ? decoded.data() : block;
+
+    uint64_t length;
+    if (headerSize == 8)
+    {
+        uint64_t h; std::memcpy(&h, header, 8);
+        length = (binary == 2) ? VTKDataIO<uint64_t>::swapT(h, 1) : h;
+    }
+    else
+    {
+        uint32_t h; std::memcpy(&h, header, 4);
+        length = (binary == 2) ? VTKDataIO<uint32_t>::swapT(h, 1) : h;
+    }
+
+    if (base64)
+    {
+        decoded.clear();
+        if (separateHeader)
+        {
+            block += encodedHeaderSize;
+            decodeBase64(block, std::min(blockEnd, block + base64Length((std::size_t)length)), decoded);
+        }
+        else
+        {
+            decodeBase64(block, std::min(blockEnd, block + base64Length(headerSize + (std::size_t)length)), decoded);
+            decoded.erase(0, std::min(decoded.size(), (std::size_t)headerSize));
+        }
+        if (decoded.size() < length)
+            return false;
+        bytes = decoded.data();
+    }
+    else
+    {
+        bytes = block + headerSize;
+        if ((uint64_t)(blockEnd - bytes) < length)
+            return false;
+    }
+    nbBytes = (std::size_t)length;
+    return true;
+}
+
+BaseVTKReader::BaseVTKDataIO* XMLVTKReader::readConvertedDataArray(const string& type, const string& fileType,
+                                                                   const char* bytes, std::size_t nbBytes, int n, int binary)
+{
+    BaseVTKDataIO* d = BaseVTKReader::newVTKDataIO(type);
+    checkErrorPtr(d);
+
+    bool state;
+    if (VTKDataIO<double>* dd = dynamic_cast<VTKDataIO<double>*>(d))
+        state = convertBinary(dd, fileType, bytes, nbBytes, n, binary);
+    else if (VTKDataIO<std::int32_t>* di = dynamic_cast<VTKDataIO<std::int32_t>*>(d))
+        state = convertBinary(di, fileType, bytes, nbBytes, n, binary);
+    else
+        state = !strcasecmp(type.c_str(), fileType.c_str()) && d->readBinary(bytes, nbBytes, n, binary);
+
+    if (!state)
+    {
+        delete d;
+        return NULL;
+    }
+    return d;
+}
+
 BaseVTKReader::BaseVTKDataIO* XMLVTKReader::loadDataArray(TiXmlElement* dataArrayElement, int size, string type)
 {
     //Type
+    const char* fileTypeStrTemp = dataArrayElement->Attribute("type");
     const char* typeStrTemp;
     if (type.empty())
     {
-        typeStrTemp = dataArrayElement->Attribute("type");
+        typeStrTemp = fileTypeStrTemp;
         checkErrorPtr(typeStrTemp);
     }
     else
@@ -1098,6 +1372,33 @@ BaseVTKReader::BaseVTKDataIO* XMLVTKReader::loadDataArray(TiXmlElement* dataArra
         numberOfComponents = 1;
     }
 
+    if (binary)
+    {
+        // inline base64 or appended values, copied once from the file into the array,
+        // converted on the fly to the requested type
+        checkErrorPtr(fileTypeStrTemp);
+        string decoded;
+        const char* bytes = NULL;
+        std::size_t nbBytes = 0;
+        if (!getBinaryBlock(dataArrayElement, string(formatStrTemp), binary, decoded, bytes, nbBytes))
+        {
+            msg_error(this) << "Invalid binary DataArray '" << (dataArrayElement->Attribute("Name") ? dataArrayElement->Attribute("Name") : "") << "'";
+            return NULL;
+        }
+
+        if (!type.empty())
+            return readConvertedDataArray(type, string(fileTypeStrTemp), bytes, nbBytes, numberOfComponents * size, binary);
+
+        BaseVTKDataIO* d = BaseVTKReader::newVTKDataIO(string(fileTypeStrTemp));
+        checkErrorPtr(d);
+        if (!d->readBinary(bytes, nbBytes, numberOfComponents * size, binary))
+        {
+            delete d;
+            return NULL;
+        }
+        return d;
+    }
+
     //Values
     const char* listValuesStrTemp = dataArrayElement->GetText();
 
@@ -1175,13 +1476,13 @@ bool XMLVTKReader::loadUnstructuredGrid(TiXmlHandle datasetFormatHandle)
                     if (currentDataArrayName.compare("connectivity") == 0)
                     {
                         //number of elements in values is not known ; have to guess it
-                        inputCells = loadDataArray(dataArrayElement);
+                        inputCells = loadDataArray(dataArrayElement, 0, "Int32");
                         checkError(inputCells);
                     }
                     ///DA - offsets
                     if (currentDataArrayName.compare("offsets") == 0)
                     {
-                        inputCellOffsets = loadDataArray(dataArrayElement, numberOfCells - 1);
+                        inputCellOffsets = loadDataArray(dataArrayElement, numberOfCells - 1, "Int32");
                         checkError(inputCellOffsets);
                     }
                     ///DA - types
@@ -28,7 +28,14 @@
 #include <sofa/helper/BackTrace.h>
 using sofa::helper::BackTrace ;
 
+#include <sofa/helper/io/FastTextParser.h>
+
+#include <boost/filesystem.hpp>
+#include <cstdio>
+#include <sstream>
+
 using namespace sofa::component::loader;
+using sofa::core::loader::PrimitiveGroup;
 
 namespace sofa
 {
@@ -76,6 +83,15 @@ public :
         EXPECT_EQ((size_t)normalPerVertexNb, this->d_normals.getValue().size());
     }
 
+    template<class Element>
+    static void expectSameElements(const sofa::helper::vector<Element>& expected, const sofa::helper::vector<Element>& actual)
+    {
+        ASSERT_EQ(expected.size(), actual.size());
+        for (std::size_t i = 0; i < expected.size(); ++i)
+            for (std::size_t j = 0; j < expected[i].size(); ++j)
+                EXPECT_EQ(expected[i][j], actual[i][j]) << "element " << i;
+    }
+
 };
 
 /** MeshObjLoader::load()
@@ -97,5 +113,148 @@ TEST_F(MeshObjLoader_test, LoadCall)
     loadTest("mesh/torus.obj", 800, 0, 1600,  0, 0, 0, 0, 0, 0, 861, 0);
 }
 
+/** MeshObjLoader::readOBJ()
+ * Relative and partial indices, groups
+ */
+TEST_F(MeshObjLoader_test, ReadBuffer)
+{
+    const std::string obj =
+            "# comment\n"
+            "v 0 0 0\nv 1 0 0\r\nv 1 1 0\nv 0 1 0\n"
+            "vn 0 0 1\n"
+            "g first\n"
+            "f 1//1 2//1 3//1\n"
+            "g second group\n"
+            "f -4 -2 -1\n"
+            "l 1 3\n";
+    this->d_storeGroups.setValue(true);
+    EXPECT_TRUE(this->readOBJ(obj.data(), obj.data() + obj.size()));
+
+    ASSERT_EQ((size_t)4, this->d_positions.getValue().size());
+    ASSERT_EQ((size_t)2, this->d_triangles.getValue().size());
+    EXPECT_EQ(0u, this->d_triangles.getValue()[1][0]);
+    EXPECT_EQ(2u, this->d_triangles.getValue()[1][1]);
+    EXPECT_EQ(3u, this->d_triangles.getValue()[1][2]);
+    ASSERT_EQ((size_t)1, this->d_edges.getValue().size());
+    EXPECT_EQ(0u, this->d_edges.getValue()[0][0]);
+    EXPECT_EQ(2u, this->d_edges.getValue()[0][1]);
+
+    ASSERT_EQ((size_t)2, this->d_trianglesGroups.getValue().size());
+    EXPECT_EQ(std::string("second group"), this->d_trianglesGroups.getValue()[1].groupName);
+
+    // normals only on the vertices of the first face
+    ASSERT_EQ((size_t)4, this->d_normals.getValue().size());
+    EXPECT_EQ((SReal)1, this->d_normals.getValue()[2][2]);
+    EXPECT_EQ((SReal)0, this->d_normals.getValue()[3][2]);
+}
+
+/** MeshObjLoader::readOBJ()
+ * A file parsed in several chunks, whatever the number of threads: the chunks are
+ * split in the middle of lines and the relative indices and groups refer to previous chunks.
+ */
+TEST_F(MeshObjLoader_test, ReadBufferInChunks)
+{
+    const unsigned int nbTriangles = 25000;
+    std::ostringstream out;
+    for (unsigned int t = 0; t < nbTriangles; ++t)
+    {
+        if (t % 1000 == 0)
+            out << "g group" << t / 1000 << "\n";
+        for (unsigned int i = 3*t; i < 3*t+3; ++i)
+            out << "v " << i << " " << i << ".5 -" << i << "\n";
+        out << "f -3 -2 -1\n";
+    }
+    const std::string obj = out.str();
+
+    // the chunk boundaries fall at the beginning of the next line
+    const sofa::helper::vector<const char*> bounds = sofa::helper::io::fasttext::splitLines(obj.data(), obj.data() + obj.size(), 8);
+    ASSERT_GT(bounds.size(), (std::size_t)2);
+    for (std::size_t c = 1; c + 1 < bounds.size(); ++c)
+        EXPECT_EQ('\n', bounds[c][-1]);
+
+    this->d_storeGroups.setValue(true);
+    EXPECT_TRUE(this->readOBJ(obj.data(), obj.data() + obj.size(), 8));
+
+    const sofa::helper::vector<sofa::defaulttype::Vector3>& positions = this->d_positions.getValue();
+    ASSERT_EQ((size_t)3*nbTriangles, positions.size());
+    for (unsigned int i = 0; i < positions.size(); ++i)
+        ASSERT_EQ(sofa::defaulttype::Vector3(i, i + 0.5, -(SReal)i), positions[i]) << "position " << i;
+
+    const sofa::helper::vector<Triangle>& triangles = this->d_triangles.getValue();
+    ASSERT_EQ((size_t)nbTriangles, triangles.size());
+    for (unsigned int t = 0; t < triangles.size(); ++t)
+        for (unsigned int j = 0; j < 3; ++j)
+            ASSERT_EQ(3*t+j, triangles[t][j]) << "triangle " << t;
+
+    const sofa::helper::vector<PrimitiveGroup>& groups = this->d_trianglesGroups.getValue();
+    ASSERT_EQ((size_t)nbTriangles/1000, groups.size());
+    EXPECT_EQ(std::string("group24"), groups.back().groupName);
+    EXPECT_EQ(24000, groups.back().p0);
+    EXPECT_EQ(1000, groups.back().nbp);
+}
+
+/** MeshLoader::writeBinaryCache(), MeshLoader::readBinaryCache()
+ * The cache restores the mesh and is ignored with another key or other options
+ */
+TEST_F(MeshObjLoader_test, BinaryCacheRoundTrip)
+{
+    const std::string obj =
+            "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\n"
+            "vn 0 0 1\n"
+            "g triangles\n"
+            "f 1//1 2//1 3//1\n"
+            "g quads\n"
+            "f 1 2 3 4\n"
+            "l 1 3\n";
+    this->d_storeGroups.setValue(true);
+    ASSERT_TRUE(this->readOBJ(obj.data(), obj.data() + obj.size()));
+
+    const std::string filename = boost::filesystem::temp_directory_path().string() + "/MeshObjLoader_test_cache.obj";
+    const std::string cacheFilename = getBinaryCacheFilename(filename);
+    ASSERT_TRUE(this->writeBinaryCache(filename, 42, "storeGroups=1"));
+
+    const sofa::helper::vector<sofa::defaulttype::Vector3> positions = this->d_positions.getValue();
+    const sofa::helper::vector<sofa::defaulttype::Vector3> normals = this->d_normals.getValue();
+    const sofa::helper::vector<Edge> edges = this->d_edges.getValue();
+    const sofa::helper::vector<Triangle> triangles = this->d_triangles.getValue();
+    const sofa::helper::vector<Quad> quads = this->d_quads.getValue();
+    const sofa::helper::vector<PrimitiveGroup> trianglesGroups = this->d_trianglesGroups.getValue();
+    const sofa::helper::vector<PrimitiveGroup> quadsGroups = this->d_quadsGroups.getValue();
+    ASSERT_EQ((size_t)1, quads.size());
+    ASSERT_EQ((size_t)1, trianglesGroups.size());
+    ASSERT_EQ((size_t)1, quadsGroups.size());
+
+    this->d_positions.setValue(sofa::helper::vector<sofa::defaulttype::Vector3>());
+    this->d_normals.setValue(sofa::helper::vector<sofa::defaulttype::Vector3>());
+    this->d_edges.setValue(sofa::helper::vector<Edge>());
+    this->d_triangles.setValue(sofa::helper::vector<Triangle>());
+    this->d_quads.setValue(sofa::helper::vector<Quad>());
+    this->d_trianglesGroups.setValue(sofa::helper::vector<PrimitiveGroup>());
+    this->d_quadsGroups.setValue(sofa::helper::vector<PrimitiveGroup>());
+
+    EXPECT_FALSE(this->readBinaryCache(filename, 43, "storeGroups=1"));
+    EXPECT_FALSE(this->readBinaryCache(filename, 42, "storeGroups=0"));
+    EXPECT_TRUE(this->d_positions.getValue().empty());
+
+    ASSERT_TRUE(this->readBinaryCache(filename, 42, "storeGroups=1"));
+    EXPECT_EQ(positions, this->d_positions.getValue());
+    EXPECT_EQ(normals, this->d_normals.getValue());
+    expectSameElements(edges, this->d_edges.getValue());
+    expectSameElements(triangles, this->d_triangles.getValue());
+    expectSameElements(quads, this->d_quads.getValue());
+    ASSERT_EQ((size_t)1, this->d_trianglesGroups.getValue().size());
+    EXPECT_EQ(trianglesGroups[0].groupName, this->d_trianglesGroups.getValue()[0].groupName);
+    ASSERT_EQ((size_t)1, this->d_quadsGroups.getValue().size());
+    EXPECT_EQ(quadsGroups[0].groupName, this->d_quadsGroups.getValue()[0].groupName);
+    EXPECT_EQ(quadsGroups[0].p0, this->d_quadsGroups.getValue()[0].p0);
+    EXPECT_EQ(quadsGroups[0].nbp, this->d_quadsGroups.getValue()[0].nbp);
+
+    // nor with other options of the base loader
+    this->d_flipNormals.setValue(true);
+    EXPECT_FALSE(this->readBinaryCache(filename, 42, "storeGroups=1"));
+
+    std::remove(cacheFilename.c_str());
+}
+
 } // namespace meshobjloader_test
 } // namespace sofa
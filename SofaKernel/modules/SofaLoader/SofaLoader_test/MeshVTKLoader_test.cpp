@@ -32,6 +32,12 @@ using sofa::helper::BackTrace ;
 #include <sofa/helper/testing/BaseTest.h>
 using sofa::helper::testing::BaseTest ;
 
+#include <boost/filesystem.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
 namespace sofa
 {
 namespace meshvtkloader_test
@@ -125,6 +131,149 @@ TEST_F(MeshVTKLoaderTest, loadLegacy_binary)
     EXPECT_TRUE(dynamic_cast<Data<helper::vector<defaulttype::Vec3f>>*>(vect2) != nullptr);
 }
 
+/// Two tetrahedra sharing a face, written with appended raw values of
+/// various types (Float32 points, Int64 connectivity and offsets, UInt8 types)
+static void writeAppendedVTU(const std::string& filename)
+{
+    const float points[15] = { 0,0,0, 1,0,0, 0,1,0, 0,0,1, 1,1,1 };
+    const std::int64_t connectivity[8] = { 0,1,2,3, 1,2,3,4 };
+    const std::int64_t offsets[2] = { 4, 8 };
+    const std::uint8_t types[2] = { 10, 10 };
+
+    std::ofstream out(filename.c_str(), std::ios::out | std::ios::binary);
+    out << "<?xml version=\"1.0\"?>\n"
+        << "<VTKFile type=\"UnstructuredGrid\" version=\"1.0\" byte_order=\"LittleEndian\" header_type=\"UInt32\">\n"
+        << "<UnstructuredGrid><Piece NumberOfPoints=\"5\" NumberOfCells=\"2\">\n"
+        << "<Points><DataArray type=\"Float32\" NumberOfComponents=\"3\" format=\"appended\" offset=\"0\"/></Points>\n"
+        << "<Cells>\n"
+        << "<DataArray type=\"Int64\" Name=\"connectivity\" format=\"appended\" offset=\"64\"/>\n"
+        << "<DataArray type=\"Int64\" Name=\"offsets\" format=\"appended\" offset=\"132\"/>\n"
+        << "<DataArray type=\"UInt8\" Name=\"types\" format=\"appended\" offset=\"152\"/>\n"
+        << "</Cells>\n"
+        << "</Piece></UnstructuredGrid>\n"
+        << "<AppendedData encoding=\"raw\">\n_";
+    std::uint32_t n = sizeof(points);
+    out.write((const char*)&n, 4); out.write((const char*)points, n);
+    n = sizeof(connectivity);
+    out.write((const char*)&n, 4); out.write((const char*)connectivity, n);
+    n = sizeof(offsets);
+    out.write((const char*)&n, 4); out.write((const char*)offsets, n);
+    n = sizeof(types);
+    out.write((const char*)&n, 4); out.write((const char*)types, n);
+    out << "\n</AppendedData>\n</VTKFile>\n";
+}
+
+TEST_F(MeshVTKLoaderTest, loadXML_appendedRaw)
+{
+    const std::string filename = boost::filesystem::temp_directory_path().string() + "/MeshVTKLoader_test_appended.vtu";
+    writeAppendedVTU(filename);
+    testLoad(filename, 5, 0, 0, 0, 0, 2, 0);
+    std::remove(filename.c_str());
+
+    ASSERT_EQ(2u, d_tetrahedra.getValue().size());
+    EXPECT_EQ(4u, d_tetrahedra.getValue()[1][3]);
+    EXPECT_EQ(1.0, d_positions.getValue()[4][2]);
+}
+
+static std::string encodeBase64(const void* data, std::size_t size)
+{
+    static const char chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    const unsigned char* bytes = (const unsigned char*)data;
+    std::string out;
+    for (std::size_t i = 0; i < size; i += 3)
+    {
+        unsigned int bits = (unsigned int)bytes[i] << 16;
+        if (i+1 < size) bits |= (unsigned int)bytes[i+1] << 8;
+        if (i+2 < size) bits |= bytes[i+2];
+        out += chars[(bits >> 18) & 63];
+        out += chars[(bits >> 12) & 63];
+        out += (i+1 < size) ? chars[(bits >> 6) & 63] : '=';
+        out += (i+2 < size) ? chars[bits & 63] : '=';
+    }
+    return out;
+}
+
+/// Base64 block of the given values, prefixed with their length: either encoded
+/// together, or as two blocks as written by VTK (length, then values)
+static std::string base64Block(const void* data, std::uint32_t size, bool separateHeader)
+{
+    if (separateHeader)
+        return encodeBase64(&size, 4) + encodeBase64(data, size);
+    std::string block((const char*)&size, 4);
+    block.append((const char*)data, size);
+    return encodeBase64(block.data(), block.size());
+}
+
+/// The two tetrahedra of writeAppendedVTU, encoded in base64 either inline in
+/// the DataArray elements or in the AppendedData section
+static void writeBase64VTU(const std::string& filename, bool appended)
+{
+    const float points[15] = { 0,0,0, 1,0,0, 0,1,0, 0,0,1, 1,1,1 };
+    const std::int64_t connectivity[8] = { 0,1,2,3, 1,2,3,4 };
+    const std::int64_t offsets[2] = { 4, 8 };
+    const std::uint8_t types[2] = { 10, 10 };
+
+    const std::string blocks[4] = {
+        base64Block(points, sizeof(points), true),
+        base64Block(connectivity, sizeof(connectivity), false),
+        base64Block(offsets, sizeof(offsets), true),
+        base64Block(types, sizeof(types), false)
+    };
+    std::string arrays[4];
+    std::size_t offset = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+        std::ostringstream a;
+        if (appended)
+        {
+            a << " format=\"appended\" offset=\"" << offset << "\"/>";
+            offset += blocks[i].size();
+        }
+        else
+            a << " format=\"binary\">" << blocks[i] << "</DataArray>";
+        arrays[i] = a.str();
+    }
+
+    std::ofstream out(filename.c_str(), std::ios::out | std::ios::binary);
+    out << "<?xml version=\"1.0\"?>\n"
+        << "<VTKFile type=\"UnstructuredGrid\" version=\"1.0\" byte_order=\"LittleEndian\" header_type=\"UInt32\">\n"
+        << "<UnstructuredGrid><Piece NumberOfPoints=\"5\" NumberOfCells=\"2\">\n"
+        << "<Points><DataArray type=\"Float32\" NumberOfComponents=\"3\"" << arrays[0] << "</Points>\n"
+        << "<Cells>\n"
+        << "<DataArray type=\"Int64\" Name=\"connectivity\"" << arrays[1] << "\n"
+        << "<DataArray type=\"Int64\" Name=\"offsets\"" << arrays[2] << "\n"
+        << "<DataArray type=\"UInt8\" Name=\"types\"" << arrays[3] << "\n"
+        << "</Cells>\n"
+        << "</Piece></UnstructuredGrid>\n";
+    if (appended)
+        out << "<AppendedData encoding=\"base64\">\n_" << blocks[0] << blocks[1] << blocks[2] << blocks[3] << "\n</AppendedData>\n";
+    out << "</VTKFile>\n";
+}
+
+TEST_F(MeshVTKLoaderTest, loadXML_inlineBase64)
+{
+    const std::string filename = boost::filesystem::temp_directory_path().string() + "/MeshVTKLoader_test_inline_base64.vtu";
+    writeBase64VTU(filename, false);
+    testLoad(filename, 5, 0, 0, 0, 0, 2, 0);
+    std::remove(filename.c_str());
+
+    ASSERT_EQ(2u, d_tetrahedra.getValue().size());
+    EXPECT_EQ(4u, d_tetrahedra.getValue()[1][3]);
+    EXPECT_EQ(1.0, d_positions.getValue()[4][2]);
+}
+
+TEST_F(MeshVTKLoaderTest, loadXML_appendedBase64)
+{
+    const std::string filename = boost::filesystem::temp_directory_path().string() + "/MeshVTKLoader_test_appended_base64.vtu";
+    writeBase64VTU(filename, true);
+    testLoad(filename, 5, 0, 0, 0, 0, 2, 0);
+    std::remove(filename.c_str());
+
+    ASSERT_EQ(2u, d_tetrahedra.getValue().size());
+    EXPECT_EQ(4u, d_tetrahedra.getValue()[1][3]);
+    EXPECT_EQ(1.0, d_positions.getValue()[4][2]);
+}
+
 TEST_F(MeshVTKLoaderTest, loadInvalidFilenames)
 {
     EXPECT_MSG_EMIT(Error) ;
@@ -33,6 +33,8 @@
 #include <sofa/helper/decompose.h>
 #include <sofa/core/behavior/RotationMatrix.h>
 #include <sofa/helper/OptionsGroup.h>
+#include <map>
+#include <vector>
 
 namespace sofa
 {
@@ -135,6 +137,15 @@ protected:
     typedef helper::vector<ElementStiffness> VecElementStiffness;
     Data<VecElementStiffness> _elementStiffnesses; ///< Stiffness matrices per element (K_i)
 
+    /// matrix-free storage: one stiffness per distinct rest shape and stiffness coefficient
+    VecElementStiffness _referenceStiffnesses;
+    helper::vector<unsigned int> _elementStiffnessClass; ///< index in _referenceStiffnesses of each element
+    std::map< std::vector<long long>, unsigned int > _stiffnessClassMap; ///< only used while (re)initializing
+    bool _useReferenceStiffnesses;
+
+    /// groups of elements sharing no vertex, processed in parallel by addDForce
+    helper::vector< helper::vector<unsigned int> > _elementColors;
+
     typedef defaulttype::Mat<3, 3, Real> Mat33;
 
 
@@ -173,11 +184,13 @@ public:
     Data< sofa::helper::OptionsGroup > _gatherBsize; ///< use in GPU version
     Data<bool> f_drawing; ///<  draw the forcefield if true
     Data<Real> f_drawPercentageOffset; ///< size of the hexa
+    Data<bool> f_matrixFree; ///< share the stiffness matrix between elements of same rest shape and stiffness instead of storing one per element
     bool needUpdateTopology;
 
 protected:
     HexahedronFEMForceField()
         : _elementStiffnesses(initData(&_elementStiffnesses,"stiffnessMatrices", "Stiffness matrices per element (K_i)"))
+        , _useReferenceStiffnesses(false)
         , _mesh(NULL)
         , _sparseGrid(NULL)
         , _initialPoints(initData(&_initialPoints,"initialPoints", "Initial Position"))
@@ -191,6 +204,7 @@ protected:
         , _gatherBsize(initData(&_gatherBsize,"gatherBsize","number of dof accumulated per threads during the gather operation (Only use in GPU version)"))
         , f_drawing(initData(&f_drawing,true,"drawing"," draw the forcefield if true"))
         , f_drawPercentageOffset(initData(&f_drawPercentageOffset,(Real)0.15,"drawPercentageOffset","size of the hexa"))
+        , f_matrixFree(initData(&f_matrixFree,false,"matrixFree","share the stiffness matrix between elements of same rest shape and stiffness instead of storing one per element (not compatible with updateStiffnessMatrix)"))
         , needUpdateTopology(false)
     {
         data->initPtrData(this);
@@ -264,6 +278,11 @@ public:
 
     const Transformation& getElementRotation(const unsigned elemidx);
 
+    const ElementStiffness& getElementStiffness(const unsigned elemidx) const
+    {
+        return _useReferenceStiffnesses ? _referenceStiffnesses[_elementStiffnessClass[elemidx]] : _elementStiffnesses.getValue()[elemidx];
+    }
+
     void getNodeRotation(Transformation& R, unsigned int nodeIdx)
     {
         core::topology::BaseMeshTopology::HexahedraAroundVertex liste_hexa = _mesh->getHexahedraAroundVertex(nodeIdx);
@@ -370,6 +389,12 @@ protected:
 
     void computeMaterialStiffness(int i);
 
+    /// compute the stiffness of element i from its rotated rest shape, or find its shared reference stiffness
+    void initElementStiffness(int i);
+
+    /// greedy coloring of the elements such that elements of a same color share no vertex
+    void computeElementColors();
+
     void computeForce( Displacement &F, const Displacement &Depl, const ElementStiffness &K );
 
 
@@ -390,6 +415,8 @@ protected:
     void initSmall(int i, const Element&elem);
     virtual void accumulateForceSmall( WDataRefVecDeriv &f, RDataRefVecCoord &p, int i, const Element&elem  );
 
+    void accumulateDForce( WDataRefVecDeriv &df, RDataRefVecCoord &dx, int i, const Element&elem, Real kFactor );
+
     bool _alreadyInit;
 };
 
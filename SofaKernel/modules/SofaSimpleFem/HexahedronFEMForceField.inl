@@ -26,9 +26,11 @@
 #include <sofa/core/visual/VisualParams.h>
 #include <sofa/simulation/Simulation.h>
 #include <sofa/helper/decompose.h>
+#include <sofa/helper/IndexOpenMP.h>
 #include <assert.h>
 #include <iostream>
 #include <set>
+#include <math.h>
 
 
 
@@ -144,6 +146,22 @@ void HexahedronFEMForceField<DataTypes>::reinit()
     _rotatedInitialElements.resize(this->getIndexedElements()->size());
     _initialrotations.resize( this->getIndexedElements()->size() );
 
+    _useReferenceStiffnesses = f_matrixFree.getValue();
+    if (_useReferenceStiffnesses && f_updateStiffnessMatrix.getValue())
+    {
+        serr << "matrixFree is not compatible with updateStiffnessMatrix, one stiffness matrix is stored per element" << sendl;
+        _useReferenceStiffnesses = false;
+    }
+    _referenceStiffnesses.clear();
+    _elementStiffnessClass.clear();
+    _stiffnessClassMap.clear();
+    if (_useReferenceStiffnesses)
+    {
+        _elementStiffnesses.beginEdit()->clear();
+        _elementStiffnesses.endEdit();
+        _elementStiffnessClass.resize(this->getIndexedElements()->size());
+    }
+
     if (f_method.getValue() == "large")
         this->setMethod(LARGE);
     else if (f_method.getValue() == "polar")
@@ -187,6 +205,14 @@ void HexahedronFEMForceField<DataTypes>::reinit()
         break;
     }
     }
+
+    _elementColors.clear();
+    if (_useReferenceStiffnesses)
+    {
+        _stiffnessClassMap.clear();
+        sout << this->getIndexedElements()->size() << " elements share " << _referenceStiffnesses.size() << " stiffness matrices" << sendl;
+        computeElementColors();
+    }
 }
 
 
@@ -262,40 +288,62 @@ void HexahedronFEMForceField<DataTypes>::addDForce (const core::MechanicalParams
     if (_df.size() != _dx.size())
         _df.resize(_dx.size());
 
-    unsigned int i = 0;
-    typename VecElement::const_iterator it;
+    const VecElement& elements = *this->getIndexedElements();
 
-    for(it = this->getIndexedElements()->begin() ; it != this->getIndexedElements()->end() ; ++it, ++i)
+    if (_elementColors.empty())
     {
-        // Transformation R_0_2;
-        // R_0_2.transpose(_rotations[i]);
-
-        Displacement X;
+        for (unsigned int i = 0; i < elements.size(); ++i)
+            accumulateDForce( _df, _dx, i, elements[i], kFactor );
+        return;
+    }
 
-        for(int w=0; w<8; ++w)
+    // elements of a same color share no vertex and can write their forces concurrently
+    for (unsigned int c = 0; c < _elementColors.size(); ++c)
+    {
+        const helper::vector<unsigned int>& color = _elementColors[c];
+        const int nbColorElements = (int)color.size();
+#ifdef _OPENMP
+        #pragma omp parallel for
+#endif
+        for (helper::IndexOpenMP<int>::type j = 0; j < nbColorElements; ++j)
         {
-            Coord x_2;
+            const unsigned int i = color[j];
+            accumulateDForce( _df, _dx, i, elements[i], kFactor );
+        }
+    }
+}
+
+template<class DataTypes>
+void HexahedronFEMForceField<DataTypes>::accumulateDForce( WDataRefVecDeriv &_df, RDataRefVecCoord &_dx, int i, const Element&elem, Real kFactor )
+{
+    // Transformation R_0_2;
+    // R_0_2.transpose(_rotations[i]);
+
+    Displacement X;
+
+    for(int w=0; w<8; ++w)
+    {
+        Coord x_2;
 #ifndef SOFA_NEW_HEXA
-            x_2 = _rotations[i] * _dx[(*it)[_indices[w]]];
+        x_2 = _rotations[i] * _dx[elem[_indices[w]]];
 #else
-            x_2 = _rotations[i] * _dx[(*it)[w]];
+        x_2 = _rotations[i] * _dx[elem[w]];
 #endif
-            X[w*3] = x_2[0];
-            X[w*3+1] = x_2[1];
-            X[w*3+2] = x_2[2];
-        }
+        X[w*3] = x_2[0];
+        X[w*3+1] = x_2[1];
+        X[w*3+2] = x_2[2];
+    }
 
-        Displacement F;
-        computeForce( F, X, _elementStiffnesses.getValue()[i] );
+    Displacement F;
+    computeForce( F, X, getElementStiffness(i) );
 
-        for(int w=0; w<8; ++w)
-        {
+    for(int w=0; w<8; ++w)
+    {
 #ifndef SOFA_NEW_HEXA
-            _df[(*it)[_indices[w]]] -= _rotations[i].multTranspose(Deriv(F[w*3], F[w*3+1], F[w*3+2])) * kFactor;
+        _df[elem[_indices[w]]] -= _rotations[i].multTranspose(Deriv(F[w*3], F[w*3+1], F[w*3+2])) * kFactor;
 #else
-            _df[(*it)[w]] -= _rotations[i].multTranspose(Deriv(F[w*3], F[w*3+1], F[w*3+2])) * kFactor;
+        _df[elem[w]] -= _rotations[i].multTranspose(Deriv(F[w*3], F[w*3+1], F[w*3+2])) * kFactor;
 #endif
-        }
     }
 }
 
@@ -838,6 +886,91 @@ void HexahedronFEMForceField<DataTypes>::computeMaterialStiffness(int i)
     //      W = y *  1   /(2(1+p)) = (U-V)/2
 }
 
+/// append v to key with a relative precision of 1e-6 (exponent and rounded mantissa)
+inline void hexahedronFEMPushRelativeKey( std::vector<long long>& key, double v )
+{
+    int e = 0;
+    const double m = frexp(v, &e);
+    key.push_back(e);
+    key.push_back(llround(m*1e6));
+}
+
+template<class DataTypes>
+void HexahedronFEMForceField<DataTypes>::initElementStiffness(int i)
+{
+    const double stiffnessCoef = _sparseGrid?_sparseGrid->getStiffnessCoef(i):1.0;
+    const helper::fixed_array<Coord,8>& nodes = _rotatedInitialElements[i];
+
+    if (!_useReferenceStiffnesses)
+    {
+        if( _elementStiffnesses.getValue().size() <= (unsigned)i )
+        {
+            _elementStiffnesses.beginEdit()->resize( _elementStiffnesses.getValue().size()+1 );
+        }
+
+        computeElementStiffness( (*_elementStiffnesses.beginEdit())[i], _materialsStiffnesses[i], nodes, i, stiffnessCoef );
+        return;
+    }
+
+    // an element is identified by its rest shape in its own frame, its material and its stiffness coefficient
+    std::vector<long long> key;
+    key.reserve(31);
+    const double size = (nodes[6]-nodes[0]).norm();
+    const double quantum = size > 0 ? size*1e-6 : 1.0;
+    hexahedronFEMPushRelativeKey(key, size);
+    for (int w=1; w<8; ++w)
+        for (int c=0; c<3; ++c)
+            key.push_back(llround((nodes[w][c]-nodes[0][c])/quantum));
+    hexahedronFEMPushRelativeKey(key, _materialsStiffnesses[i][0][0]);
+    hexahedronFEMPushRelativeKey(key, _materialsStiffnesses[i][0][1]);
+    hexahedronFEMPushRelativeKey(key, stiffnessCoef);
+
+    typename std::map< std::vector<long long>, unsigned int >::const_iterator it = _stiffnessClassMap.find(key);
+    if (it != _stiffnessClassMap.end())
+    {
+        _elementStiffnessClass[i] = it->second;
+        return;
+    }
+
+    const unsigned int c = (unsigned int)_referenceStiffnesses.size();
+    _referenceStiffnesses.resize(c+1);
+    computeElementStiffness( _referenceStiffnesses[c], _materialsStiffnesses[i], nodes, i, stiffnessCoef );
+    _stiffnessClassMap[key] = c;
+    _elementStiffnessClass[i] = c;
+}
+
+template<class DataTypes>
+void HexahedronFEMForceField<DataTypes>::computeElementColors()
+{
+    _elementColors.clear();
+    const VecElement& elements = *this->getIndexedElements();
+
+    // bit c of usedColors[p] is set if an element of color c contains the point p
+    helper::vector<unsigned long long> usedColors(this->mstate->getSize(), 0);
+    for (unsigned int e=0; e<elements.size(); ++e)
+    {
+        unsigned long long used = 0;
+        for (int w=0; w<8; ++w)
+        {
+            if ((unsigned)elements[e][w] >= usedColors.size()) usedColors.resize(elements[e][w]+1, 0);
+            used |= usedColors[elements[e][w]];
+        }
+        unsigned int c = 0;
+        while (c < 64 && (used & (1ULL << c))) ++c;
+        if (c == 64)
+        {
+            serr << "Too many element colors, addDForce will not run in parallel" << sendl;
+            _elementColors.clear();
+            return;
+        }
+        for (int w=0; w<8; ++w)
+            usedColors[elements[e][w]] |= (1ULL << c);
+        if (c >= _elementColors.size())
+            _elementColors.resize(c+1);
+        _elementColors[c].push_back(e);
+    }
+}
+
 template<class DataTypes>
 void HexahedronFEMForceField<DataTypes>::computeForce( Displacement &F, const Displacement &Depl, const ElementStiffness &K )
 {
@@ -866,12 +999,7 @@ void HexahedronFEMForceField<DataTypes>::initSmall(int i, const Element &elem)
 #endif
 
 
-    if( _elementStiffnesses.getValue().size() <= (unsigned)i )
-    {
-        _elementStiffnesses.beginEdit()->resize( _elementStiffnesses.getValue().size()+1 );
-    }
-
-    computeElementStiffness( (*_elementStiffnesses.beginEdit())[i], _materialsStiffnesses[i], _rotatedInitialElements[i], i, _sparseGrid?_sparseGrid->getStiffnessCoef(i):1.0 );
+    initElementStiffness(i);
 }
 
 template<class DataTypes>
@@ -900,12 +1028,12 @@ void HexahedronFEMForceField<DataTypes>::accumulateForceSmall ( WDataRefVecDeriv
     }
 
 
-    if(f_updateStiffnessMatrix.getValue())
+    if(f_updateStiffnessMatrix.getValue() && !_useReferenceStiffnesses)
         computeElementStiffness( (*_elementStiffnesses.beginEdit())[i], _materialsStiffnesses[i], deformed, i, _sparseGrid?_sparseGrid->getStiffnessCoef(i):1.0 );
 
 
     Displacement F; //forces
-    computeForce( F, D, _elementStiffnesses.getValue()[i] ); // compute force on element
+    computeForce( F, D, getElementStiffness(i) ); // compute force on element
 
     for(int w=0; w<8; ++w)
 #ifndef SOFA_NEW_HEXA
@@ -960,12 +1088,7 @@ void HexahedronFEMForceField<DataTypes>::initLarge(int i, const Element &elem)
         _rotatedInitialElements[i][w] =  _rotations[i]*_initialPoints.getValue()[elem[w]];
 #endif
 
-    if( _elementStiffnesses.getValue().size() <= (unsigned)i )
-    {
-        _elementStiffnesses.beginEdit()->resize( _elementStiffnesses.getValue().size()+1 );
-    }
-
-    computeElementStiffness( (*_elementStiffnesses.beginEdit())[i], _materialsStiffnesses[i], _rotatedInitialElements[i], i, _sparseGrid?_sparseGrid->getStiffnessCoef(i):1.0 );
+    initElementStiffness(i);
 // 	computeElementStiffness( (*_elementStiffnesses.beginEdit())[i], _materialsStiffnesses[i], _rotatedInitialElements[i], i, i==1?10.0:1.0 );
 
 // 	printMatlab( serr,this->_elementStiffnesses.getValue()[0] );
@@ -1044,13 +1167,13 @@ void HexahedronFEMForceField<DataTypes>::accumulateForceLarge( WDataRefVecDeriv
     }
 
 
-    if(f_updateStiffnessMatrix.getValue())
+    if(f_updateStiffnessMatrix.getValue() && !_useReferenceStiffnesses)
 // 		computeElementStiffness( _elementStiffnesses[i], _materialsStiffnesses[i], deformed );
         computeElementStiffness( (*_elementStiffnesses.beginEdit())[i], _materialsStiffnesses[i], deformed, i, _sparseGrid?_sparseGrid->getStiffnessCoef(i):1.0 );
 
 
     Displacement F; //forces
-    computeForce( F, D, _elementStiffnesses.getValue()[i] ); // compute force on element
+    computeForce( F, D, getElementStiffness(i) ); // compute force on element
 
     for(int w=0; w<8; ++w)
 #ifndef SOFA_NEW_HEXA
@@ -1103,13 +1226,7 @@ void HexahedronFEMForceField<DataTypes>::initPolar(int i, const Element& elem)
     }
 
 
-    if( _elementStiffnesses.getValue().size() <= (unsigned)i )
-    {
-        _elementStiffnesses.beginEdit()->resize( _elementStiffnesses.getValue().size()+1 );
-    }
-
-
-    computeElementStiffness( (*_elementStiffnesses.beginEdit())[i], _materialsStiffnesses[i], _rotatedInitialElements[i], i, _sparseGrid?_sparseGrid->getStiffnessCoef(i):1.0);
+    initElementStiffness(i);
 }
 
 
@@ -1181,13 +1298,13 @@ void HexahedronFEMForceField<DataTypes>::accumulateForcePolar( WDataRefVecDeriv
     //forces
     Displacement F;
 
-    if(f_updateStiffnessMatrix.getValue())
+    if(f_updateStiffnessMatrix.getValue() && !_useReferenceStiffnesses)
 // 		computeElementStiffness( _elementStiffnesses[i], _materialsStiffnesses[i], deformed );
         computeElementStiffness( (*_elementStiffnesses.beginEdit())[i], _materialsStiffnesses[i], deformed, i, _sparseGrid?_sparseGrid->getStiffnessCoef(i):1.0);
 
 
     // compute force on element
-    computeForce( F, D, _elementStiffnesses.getValue()[i] );
+    computeForce( F, D, getElementStiffness(i) );
 
 
     for(int j=0; j<8; ++j)
@@ -1234,7 +1351,7 @@ void HexahedronFEMForceField<DataTypes>::addKToMatrix(const core::MechanicalPara
 
     for(it = this->getIndexedElements()->begin(), e=0 ; it != this->getIndexedElements()->end() ; ++it,++e)
     {
-        const ElementStiffness &Ke = _elementStiffnesses.getValue()[e];
+        const ElementStiffness &Ke = getElementStiffness(e);
 //         const Transformation& Rt = _rotations[e];
 //         Transformation R; R.transpose(Rt);
 
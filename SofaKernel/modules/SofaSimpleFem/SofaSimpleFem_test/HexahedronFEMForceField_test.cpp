@@ -21,6 +21,7 @@
 ******************************************************************************/
 
 #include <SofaSimpleFem/HexahedronFEMForceField.h>
+#include <SofaBaseTopology/RegularGridTopology.h>
 #include <SofaTest/ForceField_test.h>
 
 namespace sofa {
@@ -121,6 +122,72 @@ struct HexahedronFEMForceField_test : public ForceField_test<_HexahedronFEMForce
         EXPECT_EQ(Inherited::force->f_bbox.getValue().minBBox(), Vec3(0,0,0));
         EXPECT_EQ(Inherited::force->f_bbox.getValue().maxBBox(), Vec3(1,1,1.1));
     }
+
+    /// Compare the forces of a deformed grid of 3x2x2 elements computed with one stiffness matrix per element and with shared ones
+    void test_matrixFreeGrid()
+    {
+        simulation::Node::SPtr root = simulation::getSimulation()->createNewGraph("root");
+        typename DOF::SPtr dofs[2];
+        typename ForceType::SPtr forces[2];
+        for (int m=0; m<2; ++m)
+        {
+            simulation::Node::SPtr child = root->createChild(m ? "matrixFree" : "assembled");
+            component::topology::RegularGridTopology::SPtr grid = core::objectmodel::New<component::topology::RegularGridTopology>(4, 3, 3);
+            grid->setPos(0, 3, 0, 2, 0, 2);
+            child->addObject(grid);
+            dofs[m] = core::objectmodel::New<DOF>();
+            child->addObject(dofs[m]);
+            forces[m] = core::objectmodel::New<ForceType>();
+            forces[m]->f_poissonRatio.setValue(0.3);
+            forces[m]->f_youngModulus.setValue(10);
+            forces[m]->setMethod(ForceType::LARGE);
+            forces[m]->f_matrixFree.setValue(m == 1);
+            child->addObject(forces[m]);
+        }
+        sofa::simulation::getSimulation()->init(root.get());
+        ASSERT_EQ(dofs[0]->getSize(), 36u);
+        ASSERT_EQ(dofs[1]->getSize(), 36u);
+
+        // deformation mixing a rotation and a stretch, and the displacement used for the stiffness
+        VecDeriv dx(36);
+        for (int m=0; m<2; ++m)
+        {
+            typename DOF::WriteVecCoord xdof = dofs[m]->writePositions();
+            for (unsigned i=0; i<xdof.size(); ++i)
+            {
+                Vec3 p;
+                DataTypes::get(p[0], p[1], p[2], xdof[i]);
+                DataTypes::set(xdof[i], p[0]*1.1 - 0.2*p[1], 0.2*p[0] + p[1], p[2] + 0.05*sin((Real)i));
+                DataTypes::set(dx[i], 0.01*cos((Real)i), 0.02*sin((Real)(2*i)), -0.01*(Real)(i%3));
+            }
+        }
+
+        core::MechanicalParams mparams;
+        mparams.setKFactor(1.0);
+        VecDeriv f[2], df[2];
+        for (int m=0; m<2; ++m)
+        {
+            core::objectmodel::Data<VecDeriv> fData, dfData, dxData;
+            fData.setValue(VecDeriv(36));
+            dfData.setValue(VecDeriv(36));
+            dxData.setValue(dx);
+            forces[m]->addForce(&mparams, fData, *dofs[m]->read(core::ConstVecCoordId::position()), *dofs[m]->read(core::ConstVecDerivId::velocity()));
+            forces[m]->addDForce(&mparams, dfData, dxData);
+            f[m] = fData.getValue();
+            df[m] = dfData.getValue();
+        }
+
+        for (unsigned i=0; i<36; ++i)
+        {
+            for (unsigned c=0; c<3; ++c)
+            {
+                EXPECT_NEAR(f[1][i][c], f[0][i][c], 1e-8) << "force of vertex " << i;
+                EXPECT_NEAR(df[1][i][c], df[0][i][c], 1e-8) << "force change of vertex " << i;
+            }
+        }
+        EXPECT_GT(f[0][0].norm(), 1e-3);
+        EXPECT_GT(df[0][0].norm(), 1e-5);
+    }
 };
 
 // ========= Define the list of types to instanciate.
@@ -145,6 +212,22 @@ TYPED_TEST( HexahedronFEMForceField_test , extension )
     this->test_valueForce();
 }
 
+TYPED_TEST( HexahedronFEMForceField_test , extensionMatrixFree )
+{
+    this->errorMax *= 100;
+    this->deltaRange = std::make_pair( 1, this->errorMax * 10 );
+    this->debug = false;
+    this->force->f_matrixFree.setValue(true);
+
+    // run test
+    this->test_valueForce();
+}
+
+TYPED_TEST( HexahedronFEMForceField_test , extensionMatrixFreeGrid )
+{
+    this->test_matrixFreeGrid();
+}
+
 TYPED_TEST( HexahedronFEMForceField_test, test_computeBBox )
 {
     ASSERT_NO_THROW(this->test_computeBBox()) ;
@@ -22,6 +22,7 @@
 #include <SofaSimulationGraph/DAGNode.h>
 #include <SofaSimulationCommon/xml/NodeElement.h>
 #include <sofa/helper/Factory.inl>
+#include <algorithm>
 
 namespace sofa
 {
@@ -165,34 +166,31 @@ void* DAGNode::getObject(const sofa::core::objectmodel::ClassInfo& class_info, c
         if (getNbParents()) return getRootContext()->getObject(class_info, tags, dir);
         else dir = SearchDown; // we are the root, search down from here.
     }
+    // untagged searches, by far the most common ones, are answered from the cache
+    const bool cached = tags.empty() && dir != Local;
+    const LookupKey key(&class_info, dir);
+    // read before the search, a change during the search makes the result stale
+    const unsigned revision = getGraphRevision();
+    if (cached)
+    {
+        std::lock_guard<std::mutex> lock(_lookupMutex);
+        std::map<LookupKey, std::pair<unsigned, void*> >::const_iterator it = _objectCache.find(key);
+        if (it != _objectCache.end() && getLookupRevision(dir) <= it->second.first) return it->second.second;
+    }
+
     void *result = NULL;
-#ifdef DEBUG_GETOBJECT
-    std::string cname = class_info.name();
-    if (cname != std::string("N4sofa4core6ShaderE"))
-        std::cout << "DAGNode: search for object of type " << class_info.name() ;
-    std::string gname = "N4sofa9component8topology32TetrahedronSetGeometryAlgorithms";
-    bool isg = cname.length() >= gname.length() && std::string(cname, 0, gname.length()) == gname;
-#endif
     if (dir != SearchParents)
-        for (ObjectIterator it = this->object.begin(); it != this->object.end(); ++it)
+    {
+        const ObjectListPtr local = getLocalObjectList(class_info);
+        for (ObjectList::const_iterator it = local->begin(); it != local->end(); ++it)
         {
-            core::objectmodel::BaseObject* obj = it->get();
-            if (tags.empty() || (obj)->getTags().includes(tags))
+            if (tags.empty() || it->first->getTags().includes(tags))
             {
-#ifdef DEBUG_GETOBJECT
-                if (isg)
-                    std::cout << "DAGNode: testing object " << (obj)->getName() << " of type " << (obj)->getClassName() ;
-#endif
-                result = class_info.dynamicCast(obj);
-                if (result != NULL)
-                {
-#ifdef DEBUG_GETOBJECT
-                    std::cout << "DAGNode: found object " << (obj)->getName() << " of type " << (obj)->getClassName() ;
-#endif
-                    break;
-                }
+                result = it->second;
+                break;
             }
         }
+    }
 
     if (result == NULL)
     {
@@ -221,6 +219,12 @@ void* DAGNode::getObject(const sofa::core::objectmodel::ClassInfo& class_info, c
         }
     }
 
+    if (cached)
+    {
+        std::lock_guard<std::mutex> lock(_lookupMutex);
+        _objectCache[key] = std::make_pair(revision, result);
+    }
+
     return result;
 }
 
@@ -325,19 +329,56 @@ void DAGNode::getObjects(const sofa::core::objectmodel::ClassInfo& class_info, G
     }
 
 
-    switch( dir )
+    if( dir == Local )
+        this->getLocalObjects( class_info, container, tags );
+    else
+        filterObjects( *getObjectList( class_info, dir ), container, tags );
+}
+
+DAGNode::ObjectListPtr DAGNode::getLocalObjectList(const sofa::core::objectmodel::ClassInfo& class_info) const
+{
+    std::lock_guard<std::mutex> lock(_lookupMutex);
+    ObjectListPtr& local = _localObjects[&class_info];
+    if (!local)
     {
-        case Local:
-            this->getLocalObjects( class_info, container, tags );
-            break;
+        std::shared_ptr<ObjectList> objects = std::make_shared<ObjectList>();
+        for (ObjectIterator it = this->object.begin(); it != this->object.end(); ++it)
+        {
+            core::objectmodel::BaseObject* obj = it->get();
+            void* result = class_info.dynamicCast(obj);
+            if (result != NULL)
+                objects->push_back(std::make_pair(obj, result));
+        }
+        local = objects;
+    }
+    return local;
+}
 
+DAGNode::ObjectListPtr DAGNode::getObjectList(const sofa::core::objectmodel::ClassInfo& class_info, SearchDirection dir) const
+{
+    const LookupKey key(&class_info, dir);
+    // read before the search, a change during the search makes the result stale
+    const unsigned revision = getGraphRevision();
+    {
+        std::lock_guard<std::mutex> lock(_lookupMutex);
+        std::map<LookupKey, std::pair<unsigned, ObjectListPtr> >::const_iterator it = _objectListCache.find(key);
+        if (it != _objectListCache.end() && getLookupRevision(dir) <= it->second.first) return it->second.second;
+    }
+
+    // the lock is released during the search, as other nodes are locked in turn
+    std::shared_ptr<ObjectList> objects = std::make_shared<ObjectList>();
+    switch( dir )
+    {
         case SearchUp:
-            this->getLocalObjects( class_info, container, tags ); // add locals then SearchParents
+        {
+            const ObjectListPtr local = getLocalObjectList( class_info ); // add locals then SearchParents
+            objects->assign( local->begin(), local->end() );
+        }
             // no break here, we want to execute the SearchParents code.
         case SearchParents:
         {
             // a visitor executed from top but only run for this' parents will enforce the selected object unicity due even with diamond graph setups
-            GetUpObjectsVisitor vis( (DAGNode*)this, class_info, container, tags);
+            GetUpObjectsVisitor vis( (DAGNode*)this, class_info, *objects );
             getRootContext()->executeVisitor(&vis);
         }
         break;
@@ -345,15 +386,61 @@ void DAGNode::getObjects(const sofa::core::objectmodel::ClassInfo& class_info, G
         case SearchDown:
         {
             // a regular visitor is enforcing the selected object unicity
-            GetDownObjectsVisitor vis(class_info, container, tags);
+            GetDownObjectsVisitor vis( class_info, *objects );
             ((DAGNode*)(this))->executeVisitor(&vis);
             break;
         }
 
+        //case Local:
         //case SearchRoot:
         default:
+        {
+            const ObjectListPtr local = getLocalObjectList( class_info );
+            objects->assign( local->begin(), local->end() );
             break;
+        }
     }
+
+    std::lock_guard<std::mutex> lock(_lookupMutex);
+    _objectListCache[key] = std::make_pair(revision, ObjectListPtr(objects));
+    return objects;
+}
+
+unsigned DAGNode::getLookupRevision(SearchDirection dir) const
+{
+    switch (dir)
+    {
+    case SearchUp:
+    case SearchParents:
+        return getAncestorsRevision();
+    case SearchDown:
+        return getSubtreeRevision();
+    default:
+        return getLocalRevision();
+    }
+}
+
+unsigned DAGNode::getAncestorsRevision() const
+{
+    unsigned revision = getLocalRevision();
+    const LinkParents::Container& parents = l_parents.getValue();
+    for (unsigned int i = 0; i < parents.size(); ++i)
+        revision = std::max(revision, parents[i]->getAncestorsRevision());
+    return revision;
+}
+
+void DAGNode::doAddObject(sofa::core::objectmodel::BaseObject::SPtr obj)
+{
+    Node::doAddObject(obj);
+    std::lock_guard<std::mutex> lock(_lookupMutex);
+    _localObjects.clear();
+}
+
+void DAGNode::doRemoveObject(sofa::core::objectmodel::BaseObject::SPtr obj)
+{
+    Node::doRemoveObject(obj);
+    std::lock_guard<std::mutex> lock(_lookupMutex);
+    _localObjects.clear();
 }
 
 /// Get a list of parent node
@@ -26,6 +26,8 @@
 #include <sofa/simulation/Node.h>
 #include <sofa/core/objectmodel/Link.h>
 #include <sofa/simulation/Visitor.h>
+#include <memory>
+#include <mutex>
 
 namespace sofa
 {
@@ -167,6 +169,11 @@ protected:
     virtual void doAddChild(DAGNode::SPtr node);
     void doRemoveChild(DAGNode::SPtr node);
 
+    // need to clear the local objects index
+    virtual void doAddObject(sofa::core::objectmodel::BaseObject::SPtr obj) override;
+    // need to clear the local objects index
+    virtual void doRemoveObject(sofa::core::objectmodel::BaseObject::SPtr obj) override;
+
 
     /// Execute a recursive action starting from this node.
     void doExecuteVisitor(simulation::Visitor* action, bool precomputedOrder=false) override;
@@ -240,33 +247,63 @@ protected:
     /// @name @internal stuff related to getObjects
     /// @{
 
+    /// objects implementing a class, each with the pointer returned by ClassInfo::dynamicCast
+    typedef helper::vector< std::pair<core::objectmodel::BaseObject*, void*> > ObjectList;
+    typedef std::shared_ptr<const ObjectList> ObjectListPtr;
+    typedef std::pair<const sofa::core::objectmodel::ClassInfo*, SearchDirection> LookupKey;
+
+    /// node's local objects implementing class_info, in the order of the object sequence.
+    /// Built on first request and kept until an object is added to or removed from this node.
+    ObjectListPtr getLocalObjectList( const sofa::core::objectmodel::ClassInfo& class_info ) const;
+
+    /// objects implementing class_info found from this node in the given direction, in the order of getObjects.
+    /// Tags are not filtered, as they can change without notifying the node.
+    /// Kept until the part of the graph searched in that direction changes.
+    ObjectListPtr getObjectList( const sofa::core::objectmodel::ClassInfo& class_info, SearchDirection dir ) const;
+
+    /// graph revision of the last change of the nodes searched from this node in the given direction
+    unsigned getLookupRevision( SearchDirection dir ) const;
+    /// graph revision of the last change of this node or of one of its ancestors
+    unsigned getAncestorsRevision() const;
+
+    /// give the objects of list having the specified tags to container
+    static void filterObjects( const ObjectList& list, DAGNode::GetObjectsCallBack& container, const sofa::core::objectmodel::TagSet& tags )
+    {
+        for (ObjectList::const_iterator it = list.begin(); it != list.end(); ++it)
+            if (tags.empty() || it->first->getTags().includes(tags))
+                container(it->second);
+    }
+
     /// get node's local objects respecting specified class_info and tags
     inline void getLocalObjects( const sofa::core::objectmodel::ClassInfo& class_info, DAGNode::GetObjectsCallBack& container, const sofa::core::objectmodel::TagSet& tags ) const
     {
-        for (DAGNode::ObjectIterator it = this->object.begin(); it != this->object.end(); ++it)
-        {
-            core::objectmodel::BaseObject* obj = it->get();
-            void* result = class_info.dynamicCast(obj);
-            if (result != NULL && (tags.empty() || (obj)->getTags().includes(tags)))
-                container(result);
-        }
+        filterObjects( *getLocalObjectList( class_info ), container, tags );
     }
 
+    /// local objects index, per class
+    mutable std::map<const sofa::core::objectmodel::ClassInfo*, ObjectListPtr> _localObjects;
+    /// getObjects results from this node, per class and direction, with the graph revision they were computed at
+    mutable std::map<LookupKey, std::pair<unsigned, ObjectListPtr> > _objectListCache;
+    /// untagged getObject results from this node, per class and direction, with the graph revision they were computed at
+    mutable std::map<LookupKey, std::pair<unsigned, void*> > _objectCache;
+    /// protects the index and the caches, never held while another node is searched
+    mutable std::mutex _lookupMutex;
+
     /// get all down objects respecting specified class_info and tags
     class GetDownObjectsVisitor : public Visitor
     {
     public:
 
-        GetDownObjectsVisitor(const sofa::core::objectmodel::ClassInfo& class_info, DAGNode::GetObjectsCallBack& container, const sofa::core::objectmodel::TagSet& tags)
+        GetDownObjectsVisitor(const sofa::core::objectmodel::ClassInfo& class_info, DAGNode::ObjectList& objects)
             : Visitor( core::ExecParams::defaultInstance() )
             , _class_info(class_info)
-            , _container(container)
-            , _tags(tags)
+            , _objects(objects)
         {}
 
         virtual Result processNodeTopDown(simulation::Node* node)
         {
-            ((const DAGNode*)node)->getLocalObjects( _class_info, _container, _tags );
+            const DAGNode::ObjectListPtr local = ((const DAGNode*)node)->getLocalObjectList( _class_info );
+            _objects.insert( _objects.end(), local->begin(), local->end() );
             return RESULT_CONTINUE;
         }
 
@@ -282,8 +319,7 @@ protected:
     protected:
 
         const sofa::core::objectmodel::ClassInfo& _class_info;
-        DAGNode::GetObjectsCallBack& _container;
-        const sofa::core::objectmodel::TagSet& _tags;
+        DAGNode::ObjectList& _objects;
     };
 
 
@@ -292,12 +328,11 @@ protected:
     {
     public:
 
-        GetUpObjectsVisitor(DAGNode* searchNode, const sofa::core::objectmodel::ClassInfo& class_info, DAGNode::GetObjectsCallBack& container, const sofa::core::objectmodel::TagSet& tags)
+        GetUpObjectsVisitor(DAGNode* searchNode, const sofa::core::objectmodel::ClassInfo& class_info, DAGNode::ObjectList& objects)
             : Visitor( core::ExecParams::defaultInstance() )
             , _searchNode( searchNode )
             , _class_info(class_info)
-            , _container(container)
-            , _tags(tags)
+            , _objects(objects)
         {}
 
         virtual Result processNodeTopDown(simulation::Node* node)
@@ -305,7 +340,8 @@ protected:
             const DAGNode* dagnode = (const DAGNode*)node;
             if( dagnode->_descendancy.find(_searchNode)!=dagnode->_descendancy.end() ) // searchNode is in the current node descendancy, so the current node is a parent of searchNode
             {
-                dagnode->getLocalObjects( _class_info, _container, _tags );
+                const DAGNode::ObjectListPtr local = dagnode->getLocalObjectList( _class_info );
+                _objects.insert( _objects.end(), local->begin(), local->end() );
                 return RESULT_CONTINUE;
             }
             else // the current node is NOT a parent of searchNode, stop here
@@ -327,8 +363,7 @@ protected:
 
         DAGNode* _searchNode;
         const sofa::core::objectmodel::ClassInfo& _class_info;
-        DAGNode::GetObjectsCallBack& _container;
-        const sofa::core::objectmodel::TagSet& _tags;
+        DAGNode::ObjectList& _objects;
 
     };
     /// @}
@@ -0,0 +1,151 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2018 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#include <SofaSimulationGraph/testing/BaseSimulationTest.h>
+using sofa::helper::testing::BaseSimulationTest ;
+
+#include <SofaSimulationGraph/SimpleApi.h>
+using namespace sofa::simpleapi ;
+
+#include <sofa/simulation/Checkpoint.h>
+using sofa::simulation::Checkpoint ;
+
+#include <sofa/core/behavior/BaseMechanicalState.h>
+#include <sofa/core/behavior/MechanicalState.h>
+#include <sofa/core/objectmodel/BaseData.h>
+#include <sofa/defaulttype/VecTypes.h>
+using sofa::defaulttype::Vec3dTypes ;
+
+#include <SofaComponentBase/initComponentBase.h>
+#include <SofaDeformable/initDeformable.h>
+#include <SofaImplicitOdeSolver/initImplicitODESolver.h>
+
+namespace sofa {
+
+struct Checkpoint_test : public BaseSimulationTest
+{
+    void checkRollback()
+    {
+        EXPECT_MSG_NOEMIT(Error, Warning);
+        SceneInstance si("R");
+        Node::SPtr A = createChild(si.root, "A");
+        core::objectmodel::BaseObject::SPtr dofs = createObject(A, "MechanicalObject", {{"position", "1 2 3 4 5 6"}});
+        core::objectmodel::BaseData* position = dofs->findData("position");
+        ASSERT_NE(position, nullptr);
+
+        si.root->setTime(1.0);
+        Checkpoint checkpoint;
+        checkpoint.save(si.root.get());
+        EXPECT_FALSE(checkpoint.empty());
+        EXPECT_GT(checkpoint.getNbData(), 0u);
+
+        // rewinding several times from the same checkpoint
+        for (int i = 0; i < 3; ++i)
+        {
+            position->read("0 0 0 0 0 0");
+            si.root->setTime(2.0 + i);
+            checkpoint.restore(si.root.get());
+            EXPECT_EQ(position->getValueString(), "1 2 3 4 5 6");
+            EXPECT_EQ(si.root->getTime(), 1.0);
+        }
+
+        // Data that were not modified since the last restore are left untouched
+        const int counter = position->getCounter();
+        checkpoint.restore(si.root.get());
+        EXPECT_EQ(position->getCounter(), counter);
+
+        // objects created after the checkpoint are ignored
+        core::objectmodel::BaseObject::SPtr other = createObject(A, "MechanicalObject", {{"name", "other"}, {"position", "7 8 9"}});
+        checkpoint.restore(si.root.get());
+        EXPECT_EQ(other->findData("position")->getValueString(), "7 8 9");
+    }
+
+    typedef Vec3dTypes::VecCoord VecCoord;
+    typedef Vec3dTypes::VecDeriv VecDeriv;
+    typedef core::behavior::MechanicalState<Vec3dTypes> MState;
+
+    /// N steps, save, M steps, restore, M steps again: the second run must end
+    /// in exactly the same state as the first one
+    void checkDeterministicReplay()
+    {
+        EXPECT_MSG_NOEMIT(Error, Warning);
+        sofa::component::initComponentBase();
+        sofa::component::initDeformable();
+        sofa::component::initImplicitODESolver();
+
+        SceneInstance si("R");
+        si.root->setGravity(defaulttype::Vector3(0, -9.81, 0));
+        si.root->setDt(0.01);
+        createObject(si.root, "EulerImplicitSolver", {{"rayleighStiffness", "0.1"}, {"rayleighMass", "0.1"}});
+        createObject(si.root, "CGLinearSolver", {{"iterations", "100"}, {"tolerance", "1e-12"}, {"threshold", "1e-20"}});
+        createObject(si.root, "MechanicalObject", {{"name", "dofs"}, {"position", "0 0 0  1 0 0  2 0.5 0  3 0.2 0.4"}});
+        createObject(si.root, "UniformMass", {{"totalMass", "4"}});
+        createObject(si.root, "StiffSpringForceField", {{"spring", "0 1 100 1 1  1 2 100 1 1.1  2 3 100 1 0.9  0 3 50 1 3"}});
+        si.initScene();
+
+        MState* dofs = dynamic_cast<MState*>(si.root->getMechanicalState());
+        ASSERT_NE(dofs, nullptr);
+
+        const int N = 10, M = 15;
+        for (int i = 0; i < N; ++i)
+            si.simulate(0.01);
+
+        Checkpoint checkpoint;
+        checkpoint.save(si.root.get());
+        const double savedTime = si.root->getTime();
+
+        for (int i = 0; i < M; ++i)
+            si.simulate(0.01);
+        const VecCoord x = dofs->read(core::ConstVecCoordId::position())->getValue();
+        const VecDeriv v = dofs->read(core::ConstVecDerivId::velocity())->getValue();
+        const double time = si.root->getTime();
+
+        checkpoint.restore(si.root.get());
+        EXPECT_EQ(si.root->getTime(), savedTime);
+        EXPECT_NE(dofs->read(core::ConstVecCoordId::position())->getValue()[3], x[3]);
+
+        for (int i = 0; i < M; ++i)
+            si.simulate(0.01);
+        const VecCoord& x2 = dofs->read(core::ConstVecCoordId::position())->getValue();
+        const VecDeriv& v2 = dofs->read(core::ConstVecDerivId::velocity())->getValue();
+
+        EXPECT_EQ(si.root->getTime(), time);
+        ASSERT_EQ(x.size(), x2.size());
+        ASSERT_EQ(v.size(), v2.size());
+        for (size_t i = 0; i < x.size(); ++i)
+        {
+            EXPECT_EQ(x[i], x2[i]) << "position " << i;
+            EXPECT_EQ(v[i], v2[i]) << "velocity " << i;
+        }
+    }
+};
+
+TEST_F( Checkpoint_test, rollback)
+{
+    this->checkRollback() ;
+}
+
+TEST_F( Checkpoint_test, deterministicReplay)
+{
+    this->checkDeterministicReplay() ;
+}
+
+}// namespace sofa
@@ -364,6 +364,111 @@ Expected output: RABCDEEDCBAR
     }
 
 
+    static std::string getObjectsNames( Node::SPtr node, core::objectmodel::BaseContext::SearchDirection dir, const core::objectmodel::TagSet& tags = core::objectmodel::TagSet() )
+    {
+        helper::vector<Dummy*> list;
+        node->getContext()->get<Dummy>(&list, tags, dir);
+        std::string names;
+        for (size_t i=0; i<list.size(); ++i)
+            names += list[i]->getName();
+        return names;
+    }
+
+    /// the cached lookups must follow the graph changes
+    void getObjectsCache()
+    {
+        Node::SPtr A = clearScene();
+        A->setName("A");
+
+        Node::SPtr B = A->createChild("B");
+        Node::SPtr C = A->createChild("C");
+        Node::SPtr D = B->createChild("D");
+        C->addChild(D);
+
+        Dummy::SPtr a = sofa::core::objectmodel::New<Dummy>("a");
+        A->addObject(a);
+        Dummy::SPtr b = sofa::core::objectmodel::New<Dummy>("b");
+        B->addObject(b);
+        Dummy::SPtr c = sofa::core::objectmodel::New<Dummy>("c");
+        C->addObject(c);
+        Dummy::SPtr d = sofa::core::objectmodel::New<Dummy>("d");
+        D->addObject(d);
+
+        for (int i=0; i<2; ++i) // computed, then cached
+        {
+            EXPECT_EQ( "abcd", getObjectsNames(A, core::objectmodel::BaseContext::SearchDown) );
+            EXPECT_EQ( "dabc", getObjectsNames(D, core::objectmodel::BaseContext::SearchUp) );
+            EXPECT_EQ( "abc", getObjectsNames(D, core::objectmodel::BaseContext::SearchParents) );
+            EXPECT_EQ( "d", getObjectsNames(D, core::objectmodel::BaseContext::Local) );
+            EXPECT_EQ( a.get(), A->getContext()->get<Dummy>(core::objectmodel::BaseContext::SearchDown) );
+        }
+
+        Dummy::SPtr e = sofa::core::objectmodel::New<Dummy>("e");
+        D->addObject(e);
+        EXPECT_EQ( "abcde", getObjectsNames(A, core::objectmodel::BaseContext::SearchDown) );
+        EXPECT_EQ( "deabc", getObjectsNames(D, core::objectmodel::BaseContext::SearchUp) );
+
+        B->removeObject(b);
+        C->moveObject(e);
+        EXPECT_EQ( "aced", getObjectsNames(A, core::objectmodel::BaseContext::SearchDown) );
+        EXPECT_EQ( "dace", getObjectsNames(D, core::objectmodel::BaseContext::SearchUp) );
+        EXPECT_EQ( "d", getObjectsNames(D, core::objectmodel::BaseContext::Local) );
+
+        // tags can change without notifying the graph
+        e->addTag(core::objectmodel::Tag("t"));
+        EXPECT_EQ( "e", getObjectsNames(A, core::objectmodel::BaseContext::SearchDown, core::objectmodel::Tag("t")) );
+        EXPECT_EQ( e.get(), A->getContext()->get<Dummy>(core::objectmodel::Tag("t"), core::objectmodel::BaseContext::SearchDown) );
+
+        A->removeObject(a);
+        EXPECT_EQ( d.get(), A->getContext()->get<Dummy>(core::objectmodel::BaseContext::SearchDown) );
+    }
+
+    /// a change only invalidates the lookups of the nodes searching through the changed node
+    void getObjectsCacheRevisions()
+    {
+        Node::SPtr A = clearScene();
+        A->setName("A");
+
+        Node::SPtr B = A->createChild("B");
+        Node::SPtr C = A->createChild("C");
+        Node::SPtr D = B->createChild("D");
+
+        Dummy::SPtr a = sofa::core::objectmodel::New<Dummy>("a");
+        A->addObject(a);
+        Dummy::SPtr c = sofa::core::objectmodel::New<Dummy>("c");
+        C->addObject(c);
+
+        EXPECT_EQ( "ac", getObjectsNames(A, core::objectmodel::BaseContext::SearchDown) );
+        EXPECT_EQ( "ca", getObjectsNames(C, core::objectmodel::BaseContext::SearchUp) );
+        EXPECT_EQ( "c", getObjectsNames(C, core::objectmodel::BaseContext::SearchDown) );
+
+        const unsigned revisionA = A->getSubtreeRevision();
+        const unsigned subtreeRevisionC = C->getSubtreeRevision();
+        const unsigned localRevisionC = C->getLocalRevision();
+        const unsigned localRevisionD = D->getLocalRevision();
+
+        Dummy::SPtr b = sofa::core::objectmodel::New<Dummy>("b");
+        B->addObject(b);
+
+        // the ancestors of B see the change, its sibling C and its child D do not
+        EXPECT_LT( revisionA, A->getSubtreeRevision() );
+        EXPECT_EQ( A->getSubtreeRevision(), B->getSubtreeRevision() );
+        EXPECT_EQ( subtreeRevisionC, C->getSubtreeRevision() );
+        EXPECT_EQ( localRevisionC, C->getLocalRevision() );
+        EXPECT_EQ( localRevisionD, D->getLocalRevision() );
+
+        EXPECT_EQ( "abc", getObjectsNames(A, core::objectmodel::BaseContext::SearchDown) );
+        EXPECT_EQ( "ca", getObjectsNames(C, core::objectmodel::BaseContext::SearchUp) );
+        EXPECT_EQ( "c", getObjectsNames(C, core::objectmodel::BaseContext::SearchDown) );
+        EXPECT_EQ( "ab", getObjectsNames(D, core::objectmodel::BaseContext::SearchUp) );
+
+        // moving D changes its ancestors, hence its upward lookups
+        C->moveChild(D);
+        EXPECT_LT( localRevisionD, D->getLocalRevision() );
+        EXPECT_EQ( "ac", getObjectsNames(D, core::objectmodel::BaseContext::SearchUp) );
+    }
+
+
 };
 
 
@@ -410,5 +515,17 @@ TEST_F(DAG_test, getObject)
     getObject();
 }
 
+TEST_F(DAG_test, getObjectsCache)
+{
+    EXPECT_MSG_NOEMIT(Error) ;
+    getObjectsCache();
+}
+
+TEST_F(DAG_test, getObjectsCacheRevisions)
+{
+    EXPECT_MSG_NOEMIT(Error) ;
+    getObjectsCacheRevisions();
+}
+
 
 }// namespace sofa
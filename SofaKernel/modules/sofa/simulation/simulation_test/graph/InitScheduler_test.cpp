@@ -0,0 +1,280 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2018 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#include <SofaSimulationGraph/testing/BaseSimulationTest.h>
+using sofa::helper::testing::BaseSimulationTest ;
+
+#include <SofaSimulationGraph/SimpleApi.h>
+using namespace sofa::simpleapi ;
+
+#include <sofa/simulation/InitScheduler.h>
+using sofa::simulation::InitScheduler ;
+
+#include <sofa/simulation/InitVisitor.h>
+#include <sofa/core/DataEngine.h>
+#include <SofaSimulationTree/GNode.h>
+#include <algorithm>
+#include <mutex>
+
+namespace sofa {
+
+namespace {
+
+/// Records the calls to init and bwdInit
+class InitRecorder : public core::objectmodel::BaseObject
+{
+public:
+    SOFA_CLASS(InitRecorder, core::objectmodel::BaseObject);
+
+    Data<int> d_value;
+
+    InitRecorder(const std::string& name, helper::vector<std::string>* log, std::mutex* logMutex)
+        : d_value(initData(&d_value, 0, "value", "value"))
+        , log(log)
+        , logMutex(logMutex)
+    {
+        this->setName(name);
+    }
+
+    void init() override
+    {
+        std::lock_guard<std::mutex> lock(*logMutex);
+        log->push_back(getName());
+    }
+
+    void bwdInit() override
+    {
+        std::lock_guard<std::mutex> lock(*logMutex);
+        log->push_back("~" + getName());
+    }
+
+protected:
+    helper::vector<std::string>* log;
+    std::mutex* logMutex;
+};
+
+/// Copies its input to its output
+class CopyEngine : public core::DataEngine
+{
+public:
+    SOFA_CLASS(CopyEngine, core::DataEngine);
+
+    Data<int> d_input;
+    Data<int> d_output;
+
+    void init() override
+    {
+        addInput(&d_input);
+        addOutput(&d_output);
+        setDirtyValue();
+    }
+
+    void update() override
+    {
+        const int value = d_input.getValue();
+        cleanDirty();
+        d_output.setValue(value);
+    }
+
+protected:
+    CopyEngine()
+        : d_input(initData(&d_input, 0, "input", "input"))
+        , d_output(initData(&d_output, 0, "output", "copy of the input"))
+    {}
+};
+
+}
+
+struct InitScheduler_test : public BaseSimulationTest
+{
+    helper::vector<std::string> log;
+    std::mutex logMutex;
+
+    /* R
+     * |\
+     * A B----.
+     *   |    |
+     *   C    D
+     * with the value of b1 linked to the one of a2
+     */
+    Node::SPtr createScene(Node::SPtr root)
+    {
+        Node::SPtr A = createChild(root, "A");
+        Node::SPtr B = createChild(root, "B");
+        Node::SPtr C = createChild(B, "C");
+        Node::SPtr D = createChild(B, "D");
+
+        InitRecorder::SPtr a1 = core::objectmodel::New<InitRecorder>("a1", &log, &logMutex);
+        InitRecorder::SPtr a2 = core::objectmodel::New<InitRecorder>("a2", &log, &logMutex);
+        InitRecorder::SPtr b1 = core::objectmodel::New<InitRecorder>("b1", &log, &logMutex);
+        InitRecorder::SPtr c1 = core::objectmodel::New<InitRecorder>("c1", &log, &logMutex);
+        InitRecorder::SPtr d1 = core::objectmodel::New<InitRecorder>("d1", &log, &logMutex);
+        A->addObject(a1);
+        A->addObject(a2);
+        B->addObject(b1);
+        C->addObject(c1);
+        D->addObject(d1);
+        b1->d_value.setParent(&a2->d_value);
+        return root;
+    }
+
+    size_t position(const std::string& name) const
+    {
+        return std::find(log.begin(), log.end(), name) - log.begin();
+    }
+
+    void checkSequentialOrder()
+    {
+        EXPECT_MSG_NOEMIT(Error, Warning);
+        {
+            SceneInstance si("R");
+            createScene(si.root)->execute<simulation::InitVisitor>(core::ExecParams::defaultInstance());
+        }
+        const helper::vector<std::string> expected = log;
+        log.clear();
+
+        SceneInstance si("R");
+        InitScheduler scheduler;
+        scheduler.setParallel(false);
+        scheduler.init(createScene(si.root).get());
+        EXPECT_EQ(expected, log);
+        EXPECT_EQ(5u, scheduler.getComponents().size());
+    }
+
+    /// the tree traversal runs the bwdInit of a subtree before the init of the next sibling
+    void checkTreeSequentialOrder()
+    {
+        EXPECT_MSG_NOEMIT(Error, Warning);
+        createScene(core::objectmodel::New<simulation::tree::GNode>("R"))->execute<simulation::InitVisitor>(core::ExecParams::defaultInstance());
+        const helper::vector<std::string> expected = log;
+        EXPECT_LT(position("~a1"), position("b1"));
+        log.clear();
+
+        InitScheduler scheduler;
+        scheduler.setParallel(false);
+        scheduler.init(createScene(core::objectmodel::New<simulation::tree::GNode>("R")).get());
+        EXPECT_EQ(expected, log);
+        EXPECT_EQ(5u, scheduler.getComponents().size());
+        EXPECT_EQ(4u, scheduler.getNbDependencies());
+    }
+
+    void checkParallelDependencies()
+    {
+        EXPECT_MSG_NOEMIT(Error, Warning);
+        SceneInstance si("R");
+        InitScheduler scheduler;
+        scheduler.init(createScene(si.root).get());
+        ASSERT_EQ(10u, log.size());
+
+        // a1 -> a2 (same node), a2 -> b1 (Data link), b1 -> c1 and b1 -> d1 (hierarchy)
+        EXPECT_EQ(4u, scheduler.getNbDependencies());
+        EXPECT_LT(position("a1"), position("a2"));
+        EXPECT_LT(position("a2"), position("b1"));
+        EXPECT_LT(position("b1"), position("c1"));
+        EXPECT_LT(position("b1"), position("d1"));
+
+        // bwdInit in the reverse order, after all the init
+        EXPECT_LT(position("d1"), position("~d1"));
+        EXPECT_LT(position("c1"), position("~d1"));
+        EXPECT_LT(position("~c1"), position("~b1"));
+        EXPECT_LT(position("~d1"), position("~b1"));
+        EXPECT_LT(position("~b1"), position("~a2"));
+        EXPECT_LT(position("~a2"), position("~a1"));
+
+        EXPECT_EQ(5u, scheduler.getComponents().size());
+        EXPECT_FALSE(scheduler.getInitCriticalPath().empty());
+        EXPECT_LE(scheduler.getCriticalPathTime(), scheduler.getTotalComponentTime());
+    }
+
+    /// reading the output of e2 updates e2 then e1, whose output r1 reads
+    void checkChainedEngineReaders()
+    {
+        EXPECT_MSG_NOEMIT(Error, Warning);
+        SceneInstance si("R");
+        Node::SPtr A = createChild(si.root, "A");
+        Node::SPtr B = createChild(si.root, "B");
+        Node::SPtr C = createChild(si.root, "C");
+        Node::SPtr D = createChild(si.root, "D");
+
+        CopyEngine::SPtr e1 = core::objectmodel::New<CopyEngine>();
+        CopyEngine::SPtr e2 = core::objectmodel::New<CopyEngine>();
+        InitRecorder::SPtr r1 = core::objectmodel::New<InitRecorder>("r1", &log, &logMutex);
+        InitRecorder::SPtr r2 = core::objectmodel::New<InitRecorder>("r2", &log, &logMutex);
+        A->addObject(e1);
+        B->addObject(e2);
+        C->addObject(r1);
+        D->addObject(r2);
+        e1->d_input.setValue(3);
+        e2->d_input.setParent(&e1->d_output);
+        r1->d_value.setParent(&e1->d_output);
+        r2->d_value.setParent(&e2->d_output);
+
+        InitScheduler scheduler;
+        scheduler.init(si.root.get());
+
+        // e1 -> e2, e1 -> r1, e2 -> r2 (Data links), e2 -> r1 and r1 -> r2 (readers of e1)
+        EXPECT_EQ(5u, scheduler.getNbDependencies());
+        EXPECT_LT(position("r1"), position("r2"));
+        EXPECT_EQ(3, r1->d_value.getValue());
+        EXPECT_EQ(3, r2->d_value.getValue());
+    }
+
+    void checkSimulationInit()
+    {
+        EXPECT_MSG_NOEMIT(Error);
+        SceneInstance si("R");
+        createScene(si.root);
+        si.simulation->d_parallelInit.setValue(true);
+        si.simulation->init(si.root.get());
+        si.simulation->d_parallelInit.setValue(false);
+
+        // the default animation and visual loops are added to the scene
+        EXPECT_EQ(7u, si.simulation->getInitScheduler().getComponents().size());
+        EXPECT_NE(log.end(), std::find(log.begin(), log.end(), "~a1"));
+    }
+};
+
+TEST_F( InitScheduler_test, sequentialOrder)
+{
+    this->checkSequentialOrder() ;
+}
+
+TEST_F( InitScheduler_test, treeSequentialOrder)
+{
+    this->checkTreeSequentialOrder() ;
+}
+
+TEST_F( InitScheduler_test, parallelDependencies)
+{
+    this->checkParallelDependencies() ;
+}
+
+TEST_F( InitScheduler_test, chainedEngineReaders)
+{
+    this->checkChainedEngineReaders() ;
+}
+
+TEST_F( InitScheduler_test, simulationInit)
+{
+    this->checkSimulationInit() ;
+}
+
+}// namespace sofa
@@ -0,0 +1,252 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2018 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#include <SofaSimulationGraph/testing/BaseSimulationTest.h>
+using sofa::helper::testing::BaseSimulationTest ;
+
+#include <SofaSimulationGraph/SimpleApi.h>
+using namespace sofa::simpleapi ;
+
+#include <sofa/simulation/MechanicalExecutionPlan.h>
+using sofa::simulation::MechanicalExecutionPlan ;
+
+#include <sofa/simulation/VectorOperations.h>
+using sofa::simulation::common::VectorOperations ;
+
+#include <sofa/simulation/MechanicalOperations.h>
+using sofa::simulation::common::MechanicalOperations ;
+
+#include <sofa/core/behavior/MechanicalState.h>
+#include <sofa/core/behavior/ProjectiveConstraintSet.h>
+#include <sofa/defaulttype/VecTypes.h>
+using sofa::defaulttype::Vec3dTypes ;
+
+#include <SofaDeformable/initDeformable.h>
+
+#include <sofa/core/ExecParams.h>
+#include <sofa/core/MultiVecId.h>
+
+namespace sofa {
+
+/// Projects out the motion of the first point, enough to check where the plans
+/// apply the projective constraints.
+class ProjectFirstPoint : public core::behavior::ProjectiveConstraintSet<Vec3dTypes>
+{
+public:
+    SOFA_CLASS(ProjectFirstPoint, SOFA_TEMPLATE(core::behavior::ProjectiveConstraintSet, Vec3dTypes));
+
+    virtual void projectResponse(const core::MechanicalParams*, DataVecDeriv& dx) override
+    {
+        helper::WriteAccessor<DataVecDeriv> v = dx;
+        if (!v.empty()) v[0] = Deriv();
+    }
+    virtual void projectVelocity(const core::MechanicalParams* mparams, DataVecDeriv& v) override
+    {
+        projectResponse(mparams, v);
+    }
+    virtual void projectPosition(const core::MechanicalParams*, DataVecCoord&) override {}
+    virtual void projectJacobianMatrix(const core::MechanicalParams*, DataMatrixDeriv&) override {}
+};
+
+struct MechanicalExecutionPlan_test : public BaseSimulationTest
+{
+    /* R
+     * |\
+     * A B   each with a MechanicalObject
+     */
+    void createScene(SceneInstance& si)
+    {
+        Node::SPtr A = createChild(si.root, "A");
+        Node::SPtr B = createChild(si.root, "B");
+        createObject(A, "MechanicalObject", {{"position", "1 2 3 4 5 6"}});
+        createObject(B, "MechanicalObject", {{"position", "1 1 1"}});
+    }
+
+    typedef Vec3dTypes::VecDeriv VecDeriv;
+    typedef core::behavior::MechanicalState<Vec3dTypes> MState;
+
+    /* R       MechanicalObject, springs, ProjectFirstPoint
+     * |
+     * M       MechanicalObject mapping the points 1 and 2 of R, springs
+     */
+    void createMappedScene(SceneInstance& si)
+    {
+        sofa::component::initDeformable();
+        createObject(si.root, "MechanicalObject", {{"name", "dofs"}, {"position", "0 0 0  1 0 0  2 0.5 0"}});
+        createObject(si.root, "StiffSpringForceField", {{"spring", "0 1 10 0 0.8  1 2 10 0 1.2  0 2 4 0 2"}});
+        si.root->addObject(core::objectmodel::New<ProjectFirstPoint>());
+
+        Node::SPtr M = createChild(si.root, "M");
+        createObject(M, "MechanicalObject", {{"name", "dofs"}});
+        createObject(M, "SubsetMapping", {{"indices", "1 2"}});
+        createObject(M, "StiffSpringForceField", {{"spring", "0 1 5 0 0.5"}});
+        si.initScene();
+    }
+
+    struct MappedResults
+    {
+        VecDeriv force, projectedForce, mappedForce, mappedDx, df, projectedDf;
+    };
+
+    static VecDeriv read(Node* node, core::ConstVecDerivId v)
+    {
+        MState* state = dynamic_cast<MState*>(node->getMechanicalState());
+        return state->read(v)->getValue();
+    }
+
+    /// runs the force, df, dx propagation and projection calls of an implicit step
+    MappedResults runMappedScene(Node* root, bool plan)
+    {
+        MechanicalExecutionPlan::SetEnabled(plan);
+        Node* M = root->getChild("M");
+        MappedResults res;
+
+        core::MechanicalParams mparams;
+        mparams.setKFactor(1.0);
+        MechanicalOperations mop(&mparams, root);
+
+        mop.propagateXAndV(core::VecCoordId::position(), core::VecDerivId::velocity());
+        mop.computeForce(core::VecDerivId::force());
+        res.force = read(root, core::ConstVecDerivId::force());
+        res.mappedForce = read(M, core::ConstVecDerivId::force());
+        mop.projectResponse(core::VecDerivId::force());
+        res.projectedForce = read(root, core::ConstVecDerivId::force());
+
+        {
+            MState* state = dynamic_cast<MState*>(root->getMechanicalState());
+            helper::WriteAccessor< Data<VecDeriv> > dx = *state->write(core::VecDerivId::dx());
+            dx[0] = Vec3dTypes::Deriv(0.1, 0, 0);
+            dx[1] = Vec3dTypes::Deriv(0, 0.2, 0);
+            dx[2] = Vec3dTypes::Deriv(0.1, 0.1, 0.3);
+        }
+        mop.propagateDx(core::VecDerivId::dx());
+        res.mappedDx = read(M, core::ConstVecDerivId::dx());
+        mop.computeDf(core::VecDerivId::dforce());
+        res.df = read(root, core::ConstVecDerivId::dforce());
+        mop.projectResponse(core::VecDerivId::dforce());
+        res.projectedDf = read(root, core::ConstVecDerivId::dforce());
+
+        MechanicalExecutionPlan::SetEnabled(true);
+        return res;
+    }
+
+    static void expectNear(const VecDeriv& a, const VecDeriv& b, const char* name)
+    {
+        ASSERT_EQ(a.size(), b.size()) << name;
+        for (std::size_t i = 0; i < a.size(); ++i)
+            EXPECT_LT((a[i] - b[i]).norm(), 1e-12) << name << "[" << i << "]: " << a[i] << " != " << b[i];
+    }
+
+    void checkMappedScene()
+    {
+        EXPECT_MSG_NOEMIT(Error, Warning);
+        SceneInstance si("R");
+        createMappedScene(si);
+        ASSERT_NE(si.root->getMechanicalExecutionPlan(core::ExecParams::defaultInstance()), nullptr);
+
+        MappedResults visitors = runMappedScene(si.root.get(), false);
+        MappedResults plan = runMappedScene(si.root.get(), true);
+
+        // the mapped springs contribute, the projection removes the first point
+        ASSERT_EQ(visitors.mappedDx.size(), 2u);
+        EXPECT_EQ(visitors.mappedDx[1], Vec3dTypes::Deriv(0.1, 0.1, 0.3));
+        EXPECT_GT(visitors.mappedForce[0].norm(), 0);
+        EXPECT_GT(visitors.force[0].norm(), 0);
+        EXPECT_EQ(visitors.projectedForce[0], Vec3dTypes::Deriv());
+        EXPECT_EQ(visitors.projectedDf[0], Vec3dTypes::Deriv());
+
+        expectNear(plan.force, visitors.force, "force");
+        expectNear(plan.mappedForce, visitors.mappedForce, "mapped force");
+        expectNear(plan.projectedForce, visitors.projectedForce, "projected force");
+        expectNear(plan.mappedDx, visitors.mappedDx, "mapped dx");
+        expectNear(plan.df, visitors.df, "df");
+        expectNear(plan.projectedDf, visitors.projectedDf, "projected df");
+    }
+
+    SReal dotPosition(Node* root)
+    {
+        const core::ExecParams* params = core::ExecParams::defaultInstance();
+        VectorOperations vop(params, root);
+        vop.v_dot(core::ConstVecCoordId::position(), core::ConstVecCoordId::position());
+        return vop.finish();
+    }
+
+    void checkReplay()
+    {
+        EXPECT_MSG_NOEMIT(Error, Warning);
+        SceneInstance si("R");
+        createScene(si);
+
+        MechanicalExecutionPlan* plan = si.root->getMechanicalExecutionPlan(core::ExecParams::defaultInstance());
+        ASSERT_NE(plan, nullptr);
+        EXPECT_EQ(plan->getNbNodes(), 3u);
+
+        EXPECT_EQ(dotPosition(si.root.get()), 94);
+        MechanicalExecutionPlan::SetEnabled(false);
+        EXPECT_EQ(dotPosition(si.root.get()), 94);
+        MechanicalExecutionPlan::SetEnabled(true);
+
+        VectorOperations vop(core::ExecParams::defaultInstance(), si.root.get());
+        core::MultiVecCoordId x(core::VecCoordId::position());
+        vop.v_teq(x, 2);
+        EXPECT_EQ(dotPosition(si.root.get()), 4*94);
+    }
+
+    void checkInvalidation()
+    {
+        EXPECT_MSG_NOEMIT(Error, Warning);
+        SceneInstance si("R");
+        createScene(si);
+        const core::ExecParams* params = core::ExecParams::defaultInstance();
+
+        unsigned revision = Node::getGraphRevision();
+        Node::SPtr C = createChild(si.root, "C");
+        EXPECT_NE(Node::getGraphRevision(), revision);
+        ASSERT_NE(si.root->getMechanicalExecutionPlan(params), nullptr);
+        EXPECT_EQ(si.root->getMechanicalExecutionPlan(params)->getNbNodes(), 4u);
+
+        C->setActive(false);
+        EXPECT_EQ(si.root->getMechanicalExecutionPlan(params)->getNbNodes(), 3u);
+        C->setActive(true);
+
+        // a node with several parents is left to the visitors
+        si.root->getChild("A")->addChild(C);
+        EXPECT_EQ(si.root->getMechanicalExecutionPlan(params), nullptr);
+        EXPECT_EQ(dotPosition(si.root.get()), 94);
+    }
+};
+
+TEST_F( MechanicalExecutionPlan_test, replay)
+{
+    this->checkReplay() ;
+}
+
+TEST_F( MechanicalExecutionPlan_test, invalidation)
+{
+    this->checkInvalidation() ;
+}
+
+TEST_F( MechanicalExecutionPlan_test, mappingAndProjectiveConstraint)
+{
+    this->checkMappedScene() ;
+}
+
+}// namespace sofa
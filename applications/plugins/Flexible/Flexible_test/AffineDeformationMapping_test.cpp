@@ -160,4 +160,81 @@ namespace sofa {
         ASSERT_TRUE( this->runTest(1e-15));
     }
 
+    // test case: same, with the parallel jacobian products (applyJT loops over parents)
+    TYPED_TEST( AffineLinearDeformationMappings_test , AffineStrainDeformationPatchTest_parallel)
+    {
+        this->mapping->findData("parallel")->read("1");
+        ASSERT_TRUE( this->runTest(1e-15));
+    }
+
+    /// Compare the assembled jacobian with the sum of the jacobian blocks at the columns of their parents
+    template<class Mapping>
+    void checkAssembledJacobian(Mapping* mapping)
+    {
+        enum { Nin = Mapping::SparseMatrixEigen::Nin, Nout = Mapping::SparseMatrixEigen::Nout };
+        const typename Mapping::VecVRef& index = mapping->f_index.getValue();
+        typename Mapping::SparseMatrix& blocks = mapping->getJacobianBlocks();
+        const defaulttype::BaseMatrix* J = (*mapping->getJs())[0];
+        const size_t nbParents = (size_t)J->colSize()/Nin;
+
+        ASSERT_EQ( (size_t)J->rowSize(), blocks.size()*Nout );
+        for(size_t i=0; i<blocks.size(); i++)
+            for(size_t p=0; p<nbParents; p++)
+            {
+                typename Mapping::MatBlock expected;
+                for(size_t j=0; j<blocks[i].size(); j++) if( index[i][j]==p ) expected += blocks[i][j].getJ();
+                for(unsigned r=0; r<Nout; r++)
+                    for(unsigned c=0; c<Nin; c++)
+                        EXPECT_NEAR( expected[r][c], J->element(i*Nout+r,p*Nin+c), 1e-12 ) << "child "<<i<<" parent "<<p;
+            }
+    }
+
+    // test case: the jacobian values refreshed in place (cached pattern) match a full rebuild,
+    // for unsorted parents, and for duplicated or out of range parents (which cannot use the cached pattern)
+    TYPED_TEST( AffineLinearDeformationMappings_test , cachedJacobianPattern)
+    {
+        typedef TypeParam Mapping;
+        typedef typename Mapping::Real Real;
+        typedef defaulttype::Vec<3,Real> Gradient;
+        typedef defaulttype::Mat<3,3,Real> Hessian;
+
+        sofa::simulation::getSimulation()->init(this->root.get());
+        Mapping* mapping = dynamic_cast<Mapping*>(this->mapping);
+        ASSERT_TRUE( mapping!=NULL );
+        mapping->assemble.setValue(true);
+
+        helper::vector<typename Mapping::Coord> pos(4);
+        for(size_t i=0; i<pos.size(); i++) pos[i] = typename Mapping::Coord((Real)(5*i),0,0);
+        Hessian identity; identity.identity();
+        helper::vector<Hessian> F0(pos.size(),identity);
+
+        helper::vector<helper::vector<unsigned int> > index(pos.size());
+        helper::vector<helper::vector<Real> > w(pos.size());
+        helper::vector<helper::vector<Gradient> > dw(pos.size());
+        helper::vector<helper::vector<Hessian> > ddw(pos.size());
+        const unsigned distinct[4][2] = {{1,0},{0,1},{1,0},{0,1}};
+        for(size_t i=0; i<pos.size(); i++)
+            for(size_t j=0; j<2; j++)
+            {
+                index[i].push_back(distinct[i][j]);
+                w[i].push_back( j ? (Real)(0.25*i) : (Real)(1.-0.25*i) );
+                dw[i].push_back( Gradient( j ? (Real)0.05 : (Real)-0.05, (Real)0.01*i, 0 ) );
+                ddw[i].push_back( Hessian() );
+            }
+
+        // full rebuild, then values refreshed in place
+        mapping->resizeOut(pos,index,w,dw,ddw,F0);
+        checkAssembledJacobian(mapping);
+        mapping->reinit();
+        checkAssembledJacobian(mapping);
+
+        // duplicated and out of range parents
+        index[2][0] = index[2][1];
+        index[3][1] = 5;
+        mapping->resizeOut(pos,index,w,dw,ddw,F0);
+        checkAssembledJacobian(mapping);
+        mapping->reinit();
+        checkAssembledJacobian(mapping);
+    }
+
 } // namespace sofa
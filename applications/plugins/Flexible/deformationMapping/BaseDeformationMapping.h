@@ -217,9 +217,8 @@ public:
 
 
 
-    ///@brief Update \see f_index_parentToChild from \see f_index
-//    void updateIndex();
-//    void updateIndex(const size_t parentSize, const size_t childSize);
+    ///@brief Update the parent to child index (\see parentToChildBegin and \see parentToChild) from \see f_index
+    void updateIndex(const size_t parentSize);
     void resizeOut(); /// automatic resizing (of output model and jacobian blocks) when input samples have changed. Recomputes weights from shape function component.
     virtual void resizeOut(const helper::vector<Coord>& position0, helper::vector<helper::vector<unsigned int> > index,helper::vector<helper::vector<Real> > w, helper::vector<helper::vector<defaulttype::Vec<spatial_dimensions,Real> > > dw, helper::vector<helper::vector<defaulttype::Mat<spatial_dimensions,spatial_dimensions,Real> > > ddw, helper::vector<defaulttype::Mat<spatial_dimensions,spatial_dimensions,Real> > F0); /// resizing given custom positions and weights
 
@@ -273,9 +272,9 @@ public:
     virtual const VecVRef& getChildToParentIndex() { return  f_index.getValue(); }
     ///@brief Get parent indices of the i-th child
         virtual const VRef& getChildToParentIndex( int i) { return  f_index.getValue()[i]; }
-    ///@brief Get a structure storing parent to child indices as a const reference
-//    ///@see f_index_parentToChild to know how to properly use it
-//    virtual const vector<VRef>& getParentToChildIndex() { return f_index_parentToChild; }
+    ///@brief Get the children influenced by parent p, as (child index, jacobian block index) pairs stored in [ getParentToChildIndex()[getParentToChildBegin()[p]], getParentToChildIndex()[getParentToChildBegin()[p+1]] [
+    const helper::vector<unsigned int>& getParentToChildBegin() const { return parentToChildBegin; }
+    const helper::vector<std::pair<unsigned int,unsigned int> >& getParentToChildIndex() const { return parentToChild; }
     ///@brief Get a pointer to the shape function where the weights are computed
     virtual BaseShapeFunction* getShapeFunction() { return _shapeFunction; }
     ///@brief Get parent's influence weights on each child
@@ -316,10 +315,6 @@ public:
     BaseShapeFunction* _shapeFunction;      ///< Where the weights are computed
     engine::BaseGaussPointSampler* _sampler;
     Data<VecVRef > f_index;            ///< Store child to parent relationship. index[i][j] is the index of the j-th parent influencing child i.
-//    vector<VRef> f_index_parentToChild;     ///< Store parent to child relationship.
-//                                            /**< @warning For each parent i, child index <b>and parent index (again)</b> are stored.
-//                                                 @warning Therefore to get access to parent's child index only you have to perform a loop over index[i] with an offset of size 2.
-//                                             */
     Data<VecVReal >       f_w;         ///< Influence weights of the parents for each child
     Data<VecVGradient >   f_dw;        ///< Influence weight gradients
     Data<VecVHessian >    f_ddw;       ///< Influence weight hessians
@@ -355,6 +350,17 @@ public:
 protected :
     bool missingInformationDirty;  ///< tells if pos or F need to be updated (to speed up visualization)
     bool KdTreeDirty;              ///< tells if kdtree need to be updated (to speed up closest point search)
+    bool JacobianDirty;            ///< tells if eigenJacobian values need to be updated (when jacobian blocks are not constant)
+    bool JacobianPatternDirty;     ///< tells if the sparsity pattern of eigenJacobian need to be rebuilt (otherwise only its values are refreshed)
+    bool JacobianPatternUnique;    ///< tells if the parents of each child are distinct and in range, so that each jacobian block has its own slot in eigenJacobian (required to refresh the values in place)
+
+    /** Transposed (parent to child) index, in compressed row format, built from f_index when resizing.
+        Children influenced by parent p are parentToChild[k] for k in [parentToChildBegin[p],parentToChildBegin[p+1][,
+        stored as (child index, jacobian block index) pairs.
+        It allows to parallelize applyJT and applyDJT over the parents, without concurrent writes.
+    */
+    helper::vector<unsigned int> parentToChildBegin;
+    helper::vector<std::pair<unsigned int,unsigned int> > parentToChild;
 
     SparseMatrix jacobian;   ///< Jacobian of the mapping
     virtual void initJacobianBlocks()=0;
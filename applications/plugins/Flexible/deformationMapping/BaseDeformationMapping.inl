@@ -61,6 +61,9 @@ BaseDeformationMappingT<JacobianBlockType>::BaseDeformationMappingT (core::State
     , f_pos0 ( initData ( &f_pos0,"restPosition","initial spatial positions of children" ) )
     , missingInformationDirty(true)
     , KdTreeDirty(true)
+    , JacobianDirty(true)
+    , JacobianPatternDirty(true)
+    , JacobianPatternUnique(false)
     , triangles(0)
     , extTriangles(0)
     , extvertPosIdx(0)
@@ -87,82 +90,33 @@ BaseDeformationMappingT<JacobianBlockType>::BaseDeformationMappingT (core::State
     showDeformationGradientStyle.setValue(styleOptions);
 }
 
-/*
 template <class JacobianBlockType>
-void BaseDeformationMappingT<JacobianBlockType>::updateIndex(const size_t parentSize, const size_t childSize)
+void BaseDeformationMappingT<JacobianBlockType>::updateIndex(const size_t parentSize)
 {
-    if(this->f_printLog.getValue())
-        std::cout<<this->getName()<< "::" << SOFA_CLASS_METHOD <<std::endl;
-
-    this->f_index_parentToChild.clear();
-    this->f_index_parentToChild.resize(parentSize);
-
     const VecVRef& index = this->f_index.getValue();
 
-    //Check size just in case
-    if(childSize != index.size())
-    {
-        std::cout << SOFA_CLASS_METHOD << " f_index has wrong size" << std::endl;
-        serr << "index size : " << index.size() << sendl;
-        serr << "child size : " << childSize << sendl;
-        exit(EXIT_FAILURE);
-    }
-
-    //Go through f_index and use its value to update f_index_parentToChild
+    // count children per parent
+    parentToChildBegin.assign(parentSize+1,0);
+    JacobianPatternUnique=true;
     for(size_t i=0; i<index.size(); ++i)
-    {
-        for(size_t j=0; j< index[i].size(); j++ )
+        for(size_t j=0; j<index[i].size(); j++)
         {
-            int parentIndex = index[i][j];
-            this->f_index_parentToChild[parentIndex].push_back(i); //Add child index
-            this->f_index_parentToChild[parentIndex].push_back(j); //Add parent index
+            if( index[i][j]>=parentSize ) { serr<<SOFA_CLASS_METHOD<<" : parent index "<<index[i][j]<<" of child "<<i<<" is out of range"<<sendl; JacobianPatternUnique=false; continue; }
+            for(size_t k=0; k<j; k++) if( index[i][k]==index[i][j] ) JacobianPatternUnique=false;
+            parentToChildBegin[index[i][j]+1]++;
         }
-    }
-}
-
-template <class JacobianBlockType>
-void BaseDeformationMappingT<JacobianBlockType>::updateIndex()
-{    
-    if(this->f_printLog.getValue())
-    {
-        std::cout<<this->getName()<< "::" << SOFA_CLASS_METHOD <<std::endl;
-    }
-
-    int parentSize = this->getFromSize();
-    int childSize = this->getToSize();
-    this->f_index_parentToChild.clear();
-    this->f_index_parentToChild.resize(parentSize);
-
-    if(this->f_printLog.getValue())
-    {
-        std::cout << "parent size : " << parentSize << std::endl;
-        std::cout << "child size : " << childSize << std::endl;
-    }
-
-
-    const VecVRef& index = this->f_index.getValue();
-
-    //Check size just in case
-    if( (unsigned)childSize != index.size() )
-    {
-        std::cout << SOFA_CLASS_METHOD << " f_index has wrong size" << std::endl;
-        serr << "index size : " << index.size() << sendl;
-        serr << "child size : " << childSize << sendl;
-        exit(EXIT_FAILURE);
-    }
+    for(size_t p=0; p<parentSize; ++p) parentToChildBegin[p+1]+=parentToChildBegin[p];
 
-    //Go through f_index and use its value to update f_index_parentToChild
+    // fill (child,block) pairs, in increasing child order for each parent
+    parentToChild.resize(parentToChildBegin[parentSize]);
+    helper::vector<unsigned int> fill(parentToChildBegin.begin(),parentToChildBegin.end()-1);
     for(size_t i=0; i<index.size(); ++i)
-    {
-        for(size_t j=0; j< index[i].size(); j++ )
-        {
-            int parentIndex = index[i][j];
-            this->f_index_parentToChild[parentIndex].push_back(i); //Add child index
-            this->f_index_parentToChild[parentIndex].push_back(j); //Add parent index
-        }
-    }
+        for(size_t j=0; j<index[i].size(); j++)
+            if( index[i][j]<parentSize )
+                parentToChild[fill[index[i][j]]++] = std::make_pair((unsigned int)i,(unsigned int)j);
+
+    this->JacobianPatternDirty=true;
 }
-*/
 
 template <class JacobianBlockType>
 void BaseDeformationMappingT<JacobianBlockType>::resizeAll(const InVecCoord& p0, const OutVecCoord& c0, const VecCoord& x0, const VecVRef& index, const VecVReal& w, const VecVGradient& dw, const VecVHessian& ddw, const VMaterialToSpatial& F0)
@@ -203,7 +157,7 @@ void BaseDeformationMappingT<JacobianBlockType>::resizeAll(const InVecCoord& p0,
     for(size_t i=0; i<cSize; ++i)
         wa_F0[i] = F0[i];
 
-//    updateIndex(p0.size(), c0.size());
+    updateIndex(p0.size());
 
     initJacobianBlocks(p0, c0);
 }
@@ -295,7 +249,7 @@ void BaseDeformationMappingT<JacobianBlockType>::resizeOut()
         serr << "ShapeFunction<"<<ShapeFunctionType::Name()<<"> component not found" << sendl;
     }
 
-//    updateIndex();
+    updateIndex(this->getFromSize());
 
     // init jacobians
     initJacobianBlocks();
@@ -351,7 +305,7 @@ void BaseDeformationMappingT<JacobianBlockType>::resizeOut(const helper::vector<
 
     sout<<size <<" custom gauss points imported"<<sendl;
 
-//    updateIndex();
+    updateIndex(this->getFromSize());
 
     // init jacobians
     initJacobianBlocks();
@@ -417,19 +371,68 @@ void BaseDeformationMappingT<JacobianBlockType>::updateJ()
     //helper::ReadAccessor<Data<OutVecCoord> > out (*this->toModel->read(core::ConstVecCoordId::position()));
     const VecVRef& index = this->f_index.getValue();
 
-    SparseMatrixEigen& J = eigenJacobian;
+    enum { Nin = SparseMatrixEigen::Nin, Nout = SparseMatrixEigen::Nout };
+    typename SparseMatrixEigen::CompressedMatrix& J = eigenJacobian.compressedMatrix;
+
+    // Full blocks (including zero entries) are stored, so the sparsity pattern only depends on f_index.
+    // When it did not change, the values are overwritten in place, without reallocation nor sorting.
+    // This requires a slot per block, i.e. distinct and valid parents for each child (otherwise blocks are merged below).
+    if( !JacobianPatternDirty && JacobianPatternUnique && (size_t)J.rows()==jacobian.size()*Nout && (size_t)J.cols()==in.size()*Nin && (size_t)J.nonZeros()==parentToChild.size()*Nout*Nin )
+    {
+#ifdef _OPENMP
+#pragma omp parallel for if (this->d_parallel.getValue())
+#endif
+        for(helper::IndexOpenMP<unsigned int>::type i=0; i<jacobian.size(); i++)
+        {
+            for(size_t j=0; j<jacobian[i].size(); j++)
+            {
+                // position of the block in the row = number of parents of child i with a lower index
+                size_t rank=0;
+                for(size_t k=0; k<jacobian[i].size(); k++) if( index[i][k]<index[i][j] ) rank++;
+
+                const MatBlock b = jacobian[i][j].getJ();
+                for( unsigned r=0; r<Nout; r++ )
+                {
+                    OutReal* v = J.valuePtr() + J.outerIndexPtr()[i*Nout+r] + rank*Nin;
+                    for( unsigned c=0; c<Nin; c++ ) v[c] = b[r][c];
+                }
+            }
+        }
+        this->JacobianDirty=false;
+        return;
+    }
 
-    J.resizeBlocks(jacobian.size(),in.size());
+    eigenJacobian.resizeBlocks(jacobian.size(),in.size());
+    J.reserve(parentToChild.size()*Nout*Nin);
 
-    for( size_t i=0 ; i<this->maskTo->size() ; ++i)
+    helper::vector<unsigned> cols;
+    helper::vector<MatBlock> blocks;
+    for( size_t i=0 ; i<jacobian.size() ; ++i)
     {
-        J.beginBlockRow(i);
-        for(size_t j=0; j<jacobian[i].size(); j++)
-            J.createBlock( index[i][j], jacobian[i][j].getJ());
-        J.endBlockRow();
+        helper::vector<unsigned> p = helper::sortedPermutation(helper::vector<unsigned>(index[i].begin(),index[i].begin()+jacobian[i].size())); // blocks in ascending column order
+
+        // skip out of range parents and sum the blocks of duplicated parents, so that columns are strictly increasing
+        cols.clear(); blocks.clear();
+        for(size_t j=0; j<p.size(); j++)
+        {
+            const unsigned col = index[i][p[j]];
+            if( col>=in.size() ) continue;
+            if( !cols.empty() && cols.back()==col ) blocks.back() += jacobian[i][p[j]].getJ();
+            else { cols.push_back(col); blocks.push_back(jacobian[i][p[j]].getJ()); }
+        }
+
+        for( unsigned r=0; r<Nout; r++ )
+        {
+            J.startVec(i*Nout+r);
+            for(size_t j=0; j<cols.size(); j++)
+                for( unsigned c=0; c<Nin; c++ )
+                    J.insertBack(i*Nout+r, cols[j]*Nin+c) = blocks[j][r][c];
+        }
     }
 
-    J.compress();
+    J.finalize();
+    this->JacobianPatternDirty=false;
+    this->JacobianDirty=false;
 
     //    maskedEigenJacobian.resize(0,0);
 }
@@ -499,7 +502,7 @@ void BaseDeformationMappingT<JacobianBlockType>::apply(OutVecCoord& out, const I
         }
     }
 
-    if(this->assemble.getValue() && ( !BlockType::constant ) )  eigenJacobian.resize(0,0); // J needs to be updated later where the dof mask can be activated
+    if(this->assemble.getValue() && ( !BlockType::constant ) )  this->JacobianDirty=true; // J needs to be updated later where the dof mask can be activated
 
     this->missingInformationDirty=true; this->KdTreeDirty=true; // need to update spatial positions of defo grads if needed for visualization
 }
@@ -509,14 +512,17 @@ void BaseDeformationMappingT<JacobianBlockType>::applyJ(OutVecDeriv& out, const
 {
     if(this->assemble.getValue())
     {
-        if( !eigenJacobian.rows() ) updateJ();
+        if( this->JacobianDirty || !eigenJacobian.rows() ) updateJ();
         eigenJacobian.mult(out,in);
     }
     else
     {
         const VecVRef& indices = this->f_index.getValue();
 
-        for( size_t i=0 ; i<this->maskTo->size() ; ++i)
+#ifdef _OPENMP
+#pragma omp parallel for if (this->d_parallel.getValue())
+#endif
+        for(helper::IndexOpenMP<unsigned int>::type i=0 ; i<this->maskTo->size() ; ++i)
         {
             if( !this->maskTo->isActivated() || this->maskTo->getEntry(i) )
             {
@@ -538,10 +544,10 @@ void BaseDeformationMappingT<JacobianBlockType>::apply(const core::MechanicalPar
     const InVecCoord& in = dIn.getValue();
     const VecVRef& indices = this->f_index.getValue();
 
+    std::stringstream tmp ; // only written by the thread handling the first child
 #ifdef _OPENMP
 #pragma omp parallel for if (this->d_parallel.getValue())
 #endif
-    std::stringstream tmp ;
     for(helper::IndexOpenMP<unsigned int>::type i=0; i<jacobian.size(); i++)
     {
         out[i]=OutCoord();
@@ -559,7 +565,7 @@ void BaseDeformationMappingT<JacobianBlockType>::apply(const core::MechanicalPar
 
     msg_info_when(!tmp.str().empty()) << tmp.str() ;
 
-    if(this->assemble.getValue() && ( !BlockType::constant ) ) eigenJacobian.resize(0,0); // J needs to be updated later where the dof mask can be activated
+    if(this->assemble.getValue() && ( !BlockType::constant ) ) this->JacobianDirty=true; // J needs to be updated later where the dof mask can be activated
 
     this->missingInformationDirty=true; this->KdTreeDirty=true; // need to update spatial positions of defo grads if needed for visualization
 }
@@ -571,7 +577,7 @@ void BaseDeformationMappingT<JacobianBlockType>::applyJ(const core::MechanicalPa
 {
     if(this->assemble.getValue())
     {
-        if( !eigenJacobian.rows() ) updateJ();
+        if( this->JacobianDirty || !eigenJacobian.rows() ) updateJ();
 
         //        if( this->maskTo->isActivated() )
         //        {
@@ -587,7 +593,10 @@ void BaseDeformationMappingT<JacobianBlockType>::applyJ(const core::MechanicalPa
         const InVecDeriv& in = dIn.getValue();
         const VecVRef& indices = this->f_index.getValue();
 
-        for( size_t i=0 ; i<this->maskTo->size() ; ++i)
+#ifdef _OPENMP
+#pragma omp parallel for if (this->d_parallel.getValue())
+#endif
+        for(helper::IndexOpenMP<unsigned int>::type i=0 ; i<this->maskTo->size() ; ++i)
         {
             if( !this->maskTo->isActivated() || this->maskTo->getEntry(i) )
             {
@@ -609,7 +618,7 @@ void BaseDeformationMappingT<JacobianBlockType>::applyJT(const core::MechanicalP
 {
     if(this->assemble.getValue())
     {
-        if( !eigenJacobian.rows() ) updateJ();
+        if( this->JacobianDirty || !eigenJacobian.rows() ) updateJ();
 
         //        if( this->maskTo->isActivated() )
         //        {
@@ -623,16 +632,35 @@ void BaseDeformationMappingT<JacobianBlockType>::applyJT(const core::MechanicalP
     {
         InVecDeriv& in = *dIn.beginEdit();
         const OutVecDeriv& out = dOut.getValue();
-        const VecVRef& indices = this->f_index.getValue();
 
-        for( size_t i=0 ; i<this->maskTo->size() ; ++i)
+        if( this->d_parallel.getValue() && parentToChildBegin.size()==in.size()+1 )
         {
-            if( this->maskTo->getEntry(i) )
+            // several children write in the same parent: loop over the parents using the transposed index to avoid concurrent writes
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+            for(helper::IndexOpenMP<unsigned int>::type p=0; p<in.size(); p++)
             {
-                for(size_t j=0; j<jacobian[i].size(); j++)
+                for(size_t k=parentToChildBegin[p]; k<parentToChildBegin[p+1]; k++)
                 {
-                    size_t index=indices[i][j];
-                    jacobian[i][j].addMultTranspose(in[index],out[i]);
+                    const unsigned int i=parentToChild[k].first;
+                    if( this->maskTo->getEntry(i) ) jacobian[i][parentToChild[k].second].addMultTranspose(in[p],out[i]);
+                }
+            }
+        }
+        else
+        {
+            const VecVRef& indices = this->f_index.getValue();
+
+            for( size_t i=0 ; i<this->maskTo->size() ; ++i)
+            {
+                if( this->maskTo->getEntry(i) )
+                {
+                    for(size_t j=0; j<jacobian[i].size(); j++)
+                    {
+                        size_t index=indices[i][j];
+                        jacobian[i][j].addMultTranspose(in[index],out[i]);
+                    }
                 }
             }
         }
@@ -668,34 +696,34 @@ void BaseDeformationMappingT<JacobianBlockType>::applyDJT(const core::Mechanical
             K.addMult(parentForceData,parentDisplacementData,mparams->kFactor());
             K.resize(0,0); // forgot about this matrix
         }
-        else
+        else if( this->d_parallel.getValue() && parentToChildBegin.size()==parentForce.size()+1 )
         {
-
-        const VecVRef& indices = this->f_index.getValue();
-        for( size_t i=0 ; i<this->maskTo->size() ; ++i)
-        {
-            if( this->maskTo->getEntry(i) )
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+            for(helper::IndexOpenMP<unsigned int>::type p=0; p<parentForce.size(); p++)
             {
-                for(size_t j=0; j<jacobian[i].size(); j++)
+                for(size_t k=parentToChildBegin[p]; k<parentToChildBegin[p+1]; k++)
                 {
-                    size_t index=indices[i][j];
-                    jacobian[i][j].addDForce(parentForce[index],parentDisplacement[index],childForce[i], mparams->kFactor());
+                    const unsigned int i=parentToChild[k].first;
+                    if( this->maskTo->getEntry(i) ) jacobian[i][parentToChild[k].second].addDForce(parentForce[p],parentDisplacement[p],childForce[i], mparams->kFactor());
                 }
             }
         }
-
-//#ifdef _OPENMP
-//#pragma omp parallel for if (this->d_parallel.getValue())
-//#endif
-//            for(helper::IndexOpenMP<unsigned int>::type i=0; i<this->f_index_parentToChild.size(); i++)
-//            {
-//                for(size_t j=0; j<this->f_index_parentToChild[i].size(); j+=2)
-//                {
-//                    size_t indexc=this->f_index_parentToChild[i][j];
-//                    jacobian[indexc][this->f_index_parentToChild[i][j+1]].addDForce(parentForce[i],parentDisplacement[i],childForce[indexc], mparams->kFactor());
-//                }
-//            }
-
+        else
+        {
+            const VecVRef& indices = this->f_index.getValue();
+            for( size_t i=0 ; i<this->maskTo->size() ; ++i)
+            {
+                if( this->maskTo->getEntry(i) )
+                {
+                    for(size_t j=0; j<jacobian[i].size(); j++)
+                    {
+                        size_t index=indices[i][j];
+                        jacobian[i][j].addDForce(parentForce[index],parentDisplacement[index],childForce[i], mparams->kFactor());
+                    }
+                }
+            }
         }
     }
 }
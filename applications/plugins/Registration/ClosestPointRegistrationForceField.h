@@ -128,6 +128,7 @@ protected :
     Data<bool> projectToPlane; ///< project closest points in the plane defined by the normal.
     Data<bool> rejectBorders; ///< ignore border vertices.
     Data<bool> rejectOutsideBbox; ///< ignore source points outside bounding box of target points.
+    Data<Real> rebuildTolerance; ///< k-d trees are rebuilt only when a point moved more than this distance since the last build.
     defaulttype::BoundingBox targetBbox;
 
     // source mesh data
@@ -136,6 +137,7 @@ protected :
     helper::vector< distanceSet >  closestSource; // CacheSize-closest target points from source
     helper::vector< distanceToPoint > cacheThresh_max;	helper::vector< distanceToPoint > cacheThresh_min; VecCoord previousX; // storage for cache acceleration
     KDT sourceKdTree;
+    VecCoord sourceKdTreePositions; // source positions at the last k-d tree build
     helper::vector< bool > sourceBorder;
     helper::vector< bool > sourceIgnored;  // flag ignored vertices
     helper::vector< bool > targetIgnored;  // flag ignored vertices
@@ -147,6 +149,8 @@ protected :
     Data< helper::vector< tri > > targetTriangles; ///< Triangles of the target mesh.
     helper::vector< distanceSet >  closestTarget; // CacheSize-closest source points from target
     KDT targetKdTree;
+    VecCoord targetKdTreePositions; // target positions at the last k-d tree build
+    int targetCounter; // targetPositions counter at the last update
     helper::vector< bool > targetBorder;
     void initTarget();  // built k-d tree and identify border vertices
 
@@ -156,6 +160,7 @@ protected :
     Data<bool> theCloserTheStiffer; ///< Modify stiffness according to distance
 
     void detectBorder(helper::vector<bool> &border,const helper::vector< tri > &triangles);
+    bool updateKdTree(KDT& tree, VecCoord& treePositions, const VecCoord& positions); // rebuild tree if positions moved more than rebuildTolerance, returns true if rebuilt
 };
 
 
@@ -70,11 +70,13 @@ ClosestPointRegistrationForceField<DataTypes>::ClosestPointRegistrationForceFiel
     , projectToPlane(initData(&projectToPlane,true,"projectToPlane","project closest points in the plane defined by the normal."))
     , rejectBorders(initData(&rejectBorders,true,"rejectBorders","ignore border vertices."))
     , rejectOutsideBbox(initData(&rejectOutsideBbox,false,"rejectOutsideBbox","ignore source points outside bounding box of target points."))
+    , rebuildTolerance(initData(&rebuildTolerance,(Real)0,"rebuildTolerance","k-d trees are rebuilt only when a point moved more than this distance since the last build (0 = rebuild at each change, for exact closest points)."))
     , sourceTriangles(initData(&sourceTriangles,"sourceTriangles","Triangles of the source mesh."))
     , sourceNormals(initData(&sourceNormals,"sourceNormals","Normals of the source mesh."))
     , targetPositions(initData(&targetPositions,"position","Vertices of the target mesh."))
     , targetNormals(initData(&targetNormals,"normals","Normals of the target mesh."))
     , targetTriangles(initData(&targetTriangles,"triangles","Triangles of the target mesh."))
+    , targetCounter(-1)
     , showArrowSize(initData(&showArrowSize,0.01f,"showArrowSize","size of the axis."))
     , drawMode(initData(&drawMode,0,"drawMode","The way springs will be drawn:\n- 0: Line\n- 1:Cylinder\n- 2: Arrow."))
     , drawColorMap(initData(&drawColorMap,false,"drawColorMap","Hue mapping of distances to closest point"))
@@ -140,12 +142,29 @@ void ClosestPointRegistrationForceField<DataTypes>::detectBorder(vector<bool> &b
 }
 
 
+template<class DataTypes>
+bool ClosestPointRegistrationForceField<DataTypes>::updateKdTree(KDT& tree, VecCoord& treePositions, const VecCoord& positions)
+{
+    // small displacements keep the tree valid, up to the tolerance (closest points remain approximately closest)
+    if(treePositions.size()==positions.size() && !tree.isEmpty())
+    {
+        const Real tol2 = rebuildTolerance.getValue()*rebuildTolerance.getValue();
+        bool moved=false;
+        for(unsigned int i=0;i<positions.size() && !moved;++i) if((positions[i]-treePositions[i]).norm2()>tol2) moved=true;
+        if(!moved) return false;
+    }
+
+    treePositions.assign(positions.begin(),positions.end());
+    if(positions.size()) tree.build(positions);
+    return true;
+}
+
 template<class DataTypes>
 void ClosestPointRegistrationForceField<DataTypes>::initSource()
 {
     // build k-d tree
     const VecCoord&  p = this->mstate->read(core::ConstVecCoordId::position())->getValue();
-    if(p.size()) sourceKdTree.build(p);
+    updateKdTree(sourceKdTree,sourceKdTreePositions,p);
 
     // detect border
     if(sourceBorder.size()!=p.size()) { sourceBorder.resize(p.size()); detectBorder(sourceBorder,sourceTriangles.getValue()); }
@@ -154,13 +173,21 @@ void ClosestPointRegistrationForceField<DataTypes>::initSource()
 template<class DataTypes>
 void ClosestPointRegistrationForceField<DataTypes>::initTarget()
 {
-    // build k-d tree
+    if(targetCounter==targetPositions.getCounter()) return;
+    targetCounter=targetPositions.getCounter();
+
     const VecCoord&  p = targetPositions.getValue();
-    if(p.size()) targetKdTree.build(p);
 
-    // updatebbox
+    // updatebbox (even when the tree is kept, the points may have moved within the tolerance)
+    targetBbox = defaulttype::BoundingBox();
     for(unsigned int i=0;i<p.size();++i)    targetBbox.include(p[i]);
 
+    // build k-d tree
+    if(!updateKdTree(targetKdTree,targetKdTreePositions,p)) return;
+
+    // cached closest points refer to the previous tree
+    for(unsigned int i=0;i<closestSource.size();++i) closestSource[i].clear();
+
     // detect border
     if(targetBorder.size()!=p.size()) { targetBorder.resize(p.size()); detectBorder(targetBorder,targetTriangles.getValue()); }
 }
@@ -177,7 +204,8 @@ void ClosestPointRegistrationForceField<DataTypes>::updateClosestPoints()
 
     distanceSet emptyset;
     if(nbs!=closestSource.size()) {initSource();  closestSource.resize(nbs);	closestSource.fill(emptyset); cacheThresh_max.resize(nbs); cacheThresh_min.resize(nbs); previousX.assign(x.begin(),x.end());}
-    if(nbt!=closestTarget.size()) {initTarget();  closestTarget.resize(nbt);	closestTarget.fill(emptyset);}
+    if(nbt!=closestTarget.size()) {closestTarget.resize(nbt);	closestTarget.fill(emptyset);}
+    initTarget(); // rebuilt only if target points moved
 
     this->sourceIgnored.resize(nbs); sourceIgnored.fill(false);
     this->targetIgnored.resize(nbt); targetIgnored.fill(false);
@@ -187,23 +215,27 @@ void ClosestPointRegistrationForceField<DataTypes>::updateClosestPoints()
     // closest target points from source points
     if(blendingFactor.getValue()<1) {
 
-        //unsigned int count=0;
+        const bool rejectOutside = rejectOutsideBbox.getValue();
+        const unsigned int n = cacheSize.getValue();
 #ifdef _OPENMP
 #pragma omp parallel for
 #endif
         for(int i=0;i<(int)nbs;i++)
-            if(rejectOutsideBbox.getValue() && !targetBbox.contains(x[i])) sourceIgnored[i]=true;
-            else targetKdTree.getNClosestCached(closestSource[i], cacheThresh_max[i], cacheThresh_min[i], this->previousX[i], x[i], this->targetPositions.getValue(), this->cacheSize.getValue());
+            if(!rejectOutside || targetBbox.contains(x[i]))
+                targetKdTree.getNClosestCached(closestSource[i], cacheThresh_max[i], cacheThresh_min[i], this->previousX[i], x[i], tp, n);
+
+        // flags are set sequentially (concurrent writes in a vector<bool> are not safe)
+        if(rejectOutside) for(unsigned int i=0;i<nbs;i++) if(!targetBbox.contains(x[i])) sourceIgnored[i]=true;
     }
     // closest source points from target points
     if(blendingFactor.getValue()>0)
     {
-        initSource();
+        initSource(); // rebuilt only if source points moved
 #ifdef _OPENMP
 #pragma omp parallel for
 #endif
         for(int i=0;i<(int)nbt;i++)
-            sourceKdTree.getNClosest(closestTarget[i],tp[i], this->mstate->read(core::ConstVecCoordId::position())->getValue(),1);
+            sourceKdTree.getNClosest(closestTarget[i],tp[i],x,1);
     }
 
 
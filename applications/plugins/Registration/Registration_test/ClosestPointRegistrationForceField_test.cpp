@@ -0,0 +1,105 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2018 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+
+#include <SofaTest/Sofa_test.h>
+#include <Registration/ClosestPointRegistrationForceField.h>
+#include <SofaBaseMechanics/MechanicalObject.h>
+#include <SceneCreator/SceneCreator.h>
+#include <SofaSimulationGraph/DAGSimulation.h>
+#include <sofa/simulation/Node.h>
+
+namespace sofa {
+namespace {
+
+using namespace modeling;
+using core::objectmodel::New;
+typedef defaulttype::Vec3dTypes DataTypes;
+typedef DataTypes::Coord Coord;
+typedef DataTypes::VecCoord VecCoord;
+typedef component::container::MechanicalObject<DataTypes> MechanicalObject;
+
+/// Gives access to the closest point state
+class TestedForceField : public component::forcefield::ClosestPointRegistrationForceField<DataTypes>
+{
+public:
+    SOFA_CLASS(TestedForceField,SOFA_TEMPLATE(component::forcefield::ClosestPointRegistrationForceField,DataTypes));
+    using Inherit1::updateClosestPoints;
+    using Inherit1::targetBbox;
+    using Inherit1::sourceIgnored;
+    using Inherit1::targetPositions;
+};
+
+struct ClosestPointRegistrationForceField_test : public Sofa_test<>
+{
+    simulation::Node::SPtr root;
+    MechanicalObject::SPtr source;
+    TestedForceField::SPtr forceField;
+
+    void SetUp()
+    {
+        simulation::Simulation* simulation;
+        sofa::simulation::setSimulation(simulation = new sofa::simulation::graph::DAGSimulation());
+        root = simulation->createNewGraph("root");
+
+        source = addNew<MechanicalObject>(root);
+        source->resize(1);
+        source->writePositions()[0] = Coord(1.5,0.5,0.5);
+
+        forceField = addNew<TestedForceField>(root);
+        forceField->findData("rejectOutsideBbox")->read("1");
+        forceField->findData("rebuildTolerance")->read("1");
+        forceField->findData("blendingFactor")->read("0");
+        setTarget(Coord());
+
+        sofa::simulation::getSimulation()->init(root.get());
+    }
+
+    void TearDown()
+    {
+        if(root) sofa::simulation::getSimulation()->unload(root);
+    }
+
+    /// unit tetrahedron corner translated by t
+    void setTarget(const Coord& t)
+    {
+        VecCoord p(4,t);
+        p[1][0]+=1; p[2][1]+=1; p[3][2]+=1;
+        forceField->targetPositions.setValue(p);
+    }
+};
+
+// the target moves less than rebuildTolerance: the k-d tree is kept, but the bounding box must follow the target
+TEST_F( ClosestPointRegistrationForceField_test, movingTargetUpdatesBbox )
+{
+    forceField->updateClosestPoints();
+    ASSERT_EQ( forceField->sourceIgnored.size(), 1u );
+    EXPECT_TRUE( forceField->sourceIgnored[0] );
+
+    setTarget(Coord(0.6,0,0));
+    forceField->updateClosestPoints();
+    EXPECT_NEAR( forceField->targetBbox.minBBox()[0], 0.6, 1e-12 );
+    EXPECT_NEAR( forceField->targetBbox.maxBBox()[0], 1.6, 1e-12 );
+    EXPECT_FALSE( forceField->sourceIgnored[0] );
+}
+
+}
+} // namespace sofa
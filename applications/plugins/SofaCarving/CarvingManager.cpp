@@ -29,6 +29,7 @@
 #include <sofa/simulation/AnimateEndEvent.h>
 
 #include <sofa/core/topology/TopologicalMapping.h>
+#include <sofa/core/topology/BaseMeshTopology.h>
 #include <sofa/helper/gl/template.h>
 #include <SofaUserInteraction/TopologicalChangeManager.h>
 #include <sofa/helper/AdvancedTimer.h>
@@ -57,10 +58,13 @@ CarvingManager::CarvingManager()
 , keySwitchEvent( initData(&keySwitchEvent, '4', "keySwitch", "key to activate this object until the key is pressed again") )
 , mouseEvent( initData(&mouseEvent, true, "mouseEvent", "Activate carving with middle mouse button") )
 , omniEvent( initData(&omniEvent, true, "omniEvent", "Activate carving with omni button") )
+, carvingPeriod( initData(&carvingPeriod, (unsigned int)1, "carvingPeriod", "Number of steps during which carved elements are accumulated before being removed together.\nGrouping removals avoids propagating a cascade of topological changes at each step (1 = remove at each step)") )
 , modelTool(NULL)
 , modelSurface(NULL)
 , intersectionMethod(NULL)
 , detectionNP(NULL)
+, pendingSteps(0)
+, pendingRevision(0)
 {
     this->f_listening.setValue(true);
 }
@@ -116,6 +120,54 @@ void CarvingManager::init()
 
 void CarvingManager::reset()
 {
+    pendingElems.clear();
+    pendingSteps = 0;
+}
+
+int CarvingManager::getSurfaceRevision() const
+{
+    core::topology::BaseMeshTopology* topo = (modelSurface ? modelSurface->getContext()->getMeshTopology() : NULL);
+    if (!topo) return 0;
+    // getRevision() stays 0 for topologies which do not maintain it, the
+    // element counts still move when elements are removed or added
+    unsigned int revision = (unsigned int)topo->getRevision();
+    const int counts[4] = { topo->getNbPoints(), topo->getNbTriangles(), topo->getNbQuads(), topo->getNbTetrahedra() };
+    for (unsigned int i=0; i<4; ++i)
+        revision = revision*31u + (unsigned int)counts[i];
+    return (int)revision;
+}
+
+void CarvingManager::flushCarving()
+{
+    if (pendingElems.empty() || modelSurface == NULL)
+    {
+        pendingSteps = 0;
+        return;
+    }
+
+    // indices are only valid as long as the surface topology did not change
+    if (getSurfaceRevision() != pendingRevision)
+    {
+        pendingElems.clear();
+        pendingSteps = 0;
+        return;
+    }
+
+    sofa::helper::AdvancedTimer::stepBegin("CarveElems");
+    helper::vector<int> elemsToRemove;
+    elemsToRemove.reserve(pendingElems.size());
+    elemsToRemove.insert(elemsToRemove.end(), pendingElems.begin(), pendingElems.end());
+    pendingElems.clear();
+    pendingSteps = 0;
+
+    removeElements(elemsToRemove);
+    sofa::helper::AdvancedTimer::stepEnd("CarveElems");
+}
+
+void CarvingManager::removeElements(const helper::vector<int>& elems)
+{
+    static TopologicalChangeManager manager;
+    manager.removeItemsFromCollisionModel(modelSurface, elems);
 }
 
 void CarvingManager::doCarve()
@@ -160,24 +212,37 @@ void CarvingManager::doCarve()
         ncontacts = contacts->size();
     }
 
-    int nbelems = 0;
-
-    helper::vector<int> elemsToRemove;
+    helper::vector<int> carvedElems;
+    carvedElems.reserve(ncontacts);
     for (unsigned int j=0; j < ncontacts; ++j)
     {
         const ContactVector::value_type& c = (*contacts)[j];
         int triangleIdx = (c.elem.first.getCollisionModel()==modelSurface ? c.elem.first.getIndex():c.elem.second.getIndex());
 
-		elemsToRemove.push_back(triangleIdx);
+        carvedElems.push_back(triangleIdx);
     }
-    sofa::helper::AdvancedTimer::stepBegin("CarveElems");
-    if (!elemsToRemove.empty())
+
+    addCarvedElements(carvedElems);
+
+    detectionNP->setInstance(NULL);
+}
+
+void CarvingManager::addCarvedElements(const helper::vector<int>& elems)
+{
+    if (pendingElems.empty())
+        pendingRevision = getSurfaceRevision();
+    else if (getSurfaceRevision() != pendingRevision)
     {
-		static TopologicalChangeManager manager;
-		nbelems += manager.removeItemsFromCollisionModel(modelSurface, elemsToRemove);
+        // the topology was modified by someone else, pending indices are no longer valid
+        pendingElems.clear();
+        pendingSteps = 0;
+        pendingRevision = getSurfaceRevision();
     }
 
-    detectionNP->setInstance(NULL);
+    pendingElems.insert(elems.begin(), elems.end());
+
+    if (!pendingElems.empty() && ++pendingSteps >= carvingPeriod.getValue())
+        flushCarving();
 }
 
 void CarvingManager::handleEvent(sofa::core::objectmodel::Event* event)
@@ -223,6 +288,8 @@ void CarvingManager::handleEvent(sofa::core::objectmodel::Event* event)
     {
         if (active.getValue())
             doCarve();
+        else if (!pendingElems.empty())
+            flushCarving();
     }
 }
 
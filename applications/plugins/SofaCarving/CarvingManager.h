@@ -34,6 +34,7 @@
 #include <sofa/core/objectmodel/HapticDeviceEvent.h>
 
 #include <fstream>
+#include <set>
 
 namespace sofa
 {
@@ -68,6 +69,7 @@ public:
     Data < char > keySwitchEvent; ///< key to activate this object until the key is pressed again
     Data < bool > mouseEvent; ///< Activate carving with middle mouse button
     Data < bool > omniEvent; ///< Activate carving with omni button
+    Data < unsigned int > carvingPeriod; ///< Number of steps during which carved elements are accumulated before being removed together
     
 protected:
     ToolModel* modelTool;
@@ -75,6 +77,13 @@ protected:
     core::collision::Intersection* intersectionMethod;
     core::collision::NarrowPhaseDetection* detectionNP;
 
+    /// elements detected as carved but not removed yet, sorted and without duplicates
+    std::set<int> pendingElems;
+    /// number of carving steps accumulated in pendingElems
+    unsigned int pendingSteps;
+    /// state of the surface topology when pendingElems was filled
+    int pendingRevision;
+
 
     CarvingManager();
 
@@ -88,6 +97,19 @@ public:
 
     virtual void doCarve();
 
+    /// Remove all pending elements in one single topological change
+    virtual void flushCarving();
+
+protected:
+    /// Combination of the revision and of the element counts of the surface topology
+    int getSurfaceRevision() const;
+
+    /// Accumulate the elements carved during one step, and remove them once carvingPeriod steps were accumulated
+    void addCarvedElements(const helper::vector<int>& elems);
+
+    /// Apply the topological removal of the given surface elements
+    virtual void removeElements(const helper::vector<int>& elems);
+
 };
 
 } // namespace collision
@@ -0,0 +1,126 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2018 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+
+#include <SofaTest/Sofa_test.h>
+#include <SofaCarving/CarvingManager.h>
+#include <SofaBaseCollision/SphereModel.h>
+#include <SofaBaseTopology/MeshTopology.h>
+#include <SofaSimulationGraph/DAGSimulation.h>
+#include <sofa/simulation/Node.h>
+
+namespace sofa {
+namespace {
+
+using core::objectmodel::New;
+
+/// Records the removals instead of changing the topology
+class TestedCarvingManager : public component::collision::CarvingManager
+{
+public:
+    SOFA_CLASS(TestedCarvingManager,component::collision::CarvingManager);
+
+    helper::vector< helper::vector<int> > removals;
+
+    void setSurface(core::CollisionModel* surface) { modelSurface = surface; }
+    using CarvingManager::addCarvedElements;
+
+protected:
+    virtual void removeElements(const helper::vector<int>& elems) override { removals.push_back(elems); }
+};
+
+struct CarvingManager_test : public Sofa_test<>
+{
+    simulation::Node::SPtr root;
+    component::topology::MeshTopology::SPtr topology;
+    TestedCarvingManager::SPtr carving;
+
+    void SetUp()
+    {
+        simulation::Simulation* simulation;
+        sofa::simulation::setSimulation(simulation = new sofa::simulation::graph::DAGSimulation());
+        root = simulation->createNewGraph("root");
+
+        topology = New<component::topology::MeshTopology>();
+        for (int i=0; i<4; ++i) topology->addPoint(i,0,0);
+        topology->addTriangle(0,1,2);
+        root->addObject(topology);
+
+        component::collision::SphereModel::SPtr surface = New<component::collision::SphereModel>();
+        root->addObject(surface);
+
+        carving = New<TestedCarvingManager>();
+        carving->setSurface(surface.get());
+        carving->carvingPeriod.setValue(3);
+    }
+
+    void TearDown()
+    {
+        if(root) sofa::simulation::getSimulation()->unload(root);
+    }
+
+    static helper::vector<int> elems(int a, int b=-1)
+    {
+        helper::vector<int> e(1,a);
+        if (b>=0) e.push_back(b);
+        return e;
+    }
+};
+
+TEST_F( CarvingManager_test, removalsAreGroupedOverCarvingPeriod )
+{
+    carving->addCarvedElements(elems(5,2));
+    carving->addCarvedElements(elems(2,7));
+    EXPECT_TRUE( carving->removals.empty() );
+
+    carving->addCarvedElements(elems(0));
+    ASSERT_EQ( carving->removals.size(), 1u );
+    helper::vector<int> expected;
+    expected.push_back(0); expected.push_back(2); expected.push_back(5); expected.push_back(7);
+    EXPECT_EQ( carving->removals[0], expected );
+
+    // the period starts again after a removal
+    carving->addCarvedElements(elems(1));
+    carving->addCarvedElements(elems(3));
+    EXPECT_EQ( carving->removals.size(), 1u );
+}
+
+TEST_F( CarvingManager_test, pendingElementsDroppedOnSurfaceChange )
+{
+    carving->addCarvedElements(elems(1));
+    topology->addTriangle(1,2,3); // modified by another component: index 1 may now be another element
+    carving->addCarvedElements(elems(4));
+    carving->addCarvedElements(elems(6));
+    carving->addCarvedElements(elems(8));
+    ASSERT_EQ( carving->removals.size(), 1u );
+    helper::vector<int> expected;
+    expected.push_back(4); expected.push_back(6); expected.push_back(8);
+    EXPECT_EQ( carving->removals[0], expected );
+
+    // flushing pending elements after a change removes nothing
+    carving->addCarvedElements(elems(0));
+    topology->addTriangle(0,2,3);
+    carving->flushCarving();
+    EXPECT_EQ( carving->removals.size(), 1u );
+}
+
+}
+} // namespace sofa
@@ -755,14 +755,10 @@ static PyObject * Data_getLinkPath(PyObject * self, PyObject * /*args*/)
 }
 
 
-/// returns a pointer to the Data
-static PyObject * Data_getValueVoidPtr(PyObject * self, PyObject * /*args*/)
+/// returns a tuple( pointer, shape tuple, type name) describing the given value of the Data
+static PyObject * getValueVoidPtrTuple(BaseData* data, void* dataValueVoidPtr)
 {
-    BaseData* data = get_basedata( self );
-
     const AbstractTypeInfo *typeinfo = data->getValueTypeInfo();
-    void* dataValueVoidPtr = const_cast<void*>(data->getValueVoidPtr()); /// data->beginEditVoidPtr();
-    //TODO(PR:304) warning a endedit should be necessary somewhere (when releasing the python variable?)
     void* valueVoidPtr = typeinfo->getValuePtr(dataValueVoidPtr);
 
     /// N-dimensional arrays
@@ -798,6 +794,31 @@ static PyObject * Data_getValueVoidPtr(PyObject * self, PyObject * /*args*/)
 }
 
 
+/// returns a pointer to the Data, for reading only (see SofaNumpy.as_numpy)
+static PyObject * Data_getValueVoidPtr(PyObject * self, PyObject * /*args*/)
+{
+    BaseData* data = get_basedata( self );
+    return getValueVoidPtrTuple( data, const_cast<void*>(data->getValueVoidPtr()) );
+}
+
+
+/// returns a pointer to the Data, for writing. Data_endEditVoidPtr must be called once done (see SofaNumpy.edit_data)
+/// The counter is incremented and the outputs are set dirty, as with beginEdit in c++.
+static PyObject * Data_beginEditVoidPtr(PyObject * self, PyObject * /*args*/)
+{
+    BaseData* data = get_basedata( self );
+    return getValueVoidPtrTuple( data, data->beginEditVoidPtr() );
+}
+
+
+static PyObject * Data_endEditVoidPtr(PyObject * self, PyObject * /*args*/)
+{
+    BaseData* data = get_basedata( self );
+    data->endEditVoidPtr();
+    Py_RETURN_NONE;
+}
+
+
 /// returns the number of times the Data was modified
 static PyObject * Data_getCounter(PyObject * self, PyObject * args)
 {
@@ -867,7 +888,9 @@ SP_CLASS_METHOD(Data,setParent)
 SP_CLASS_METHOD_DOC(Data,getParentPath, "Returns the string containing the path to the field's parent. Return empty string if there is not parent")
 SP_CLASS_METHOD_DOC(Data,hasParent, "Indicate if the string is linked to an other data field (its parent).")
 SP_CLASS_METHOD(Data,getLinkPath)
-SP_CLASS_METHOD(Data,getValueVoidPtr)
+SP_CLASS_METHOD_DOC(Data,getValueVoidPtr, "Returns (pointer, shape, type name) of the value, for read-only access without copy (see SofaNumpy.as_numpy).")
+SP_CLASS_METHOD_DOC(Data,beginEditVoidPtr, "Returns (pointer, shape, type name) of the value, for write access without copy. endEditVoidPtr must be called once done (see SofaNumpy.edit_data).")
+SP_CLASS_METHOD(Data,endEditVoidPtr)
 SP_CLASS_METHOD(Data,getCounter)
 SP_CLASS_METHOD(Data,isDirty)
 SP_CLASS_METHOD(Data,getAsACreateObjectParameter)
@@ -45,3 +45,10 @@ def createScene(rootNode):
     #good API design.
     ASSERT_EQ(field.getSize(), 0)
     ASSERT_GT(field.getValue(0), 6.0)
+
+    ### Raw pointer access (used by SofaNumpy): editing increments the counter
+    t = field.getCounter()
+    ptr, shape, typename = field.beginEditVoidPtr()
+    field.endEditVoidPtr()
+    ASSERT_NEQ(field.getCounter(), t)
+    ASSERT_EQ(ptr, field.getValueVoidPtr()[0])
@@ -3,6 +3,7 @@
 import Sofa
 import ctypes
 import numpy
+from contextlib import contextmanager
 
 # TODO add more basic types
 # check that type sizes are equivalent with c++ sizes
@@ -22,11 +23,7 @@ ctypeFromName = {
 }
 
 
-def as_numpy( data ):
-    '''maps data content as a numpy array'''
-
-    ptr, shape, typename = data.getValueVoidPtr()
-
+def _as_numpy( ptr, shape, typename ):
     type = ctypeFromName.get(typename,None)
     if not type: raise Exception("can't map data of type " + typename)
 
@@ -42,10 +39,44 @@ def as_numpy( data ):
     # return numpy.ctypeslib.as_array(array, shape)
 
 
+def as_numpy( data, read_only=False ):
+    '''maps data content as a numpy array (no copy).
+
+    Writing in the array does not notify the data (counter, dirty outputs): use edit_data for that.
+    The view remains valid as long as the data is not resized.'''
+
+    ptr, shape, typename = data.getValueVoidPtr()
+    array = _as_numpy(ptr, shape, typename)
+    if read_only: array.flags.writeable = False
+    return array
+
+
+@contextmanager
+def edit_data( data ):
+    '''maps data content as a writable numpy array (no copy), between data beginEdit/endEdit.
+
+    The data counter is incremented and its outputs are set dirty, as with a c++ WriteAccessor:
+
+        with edit_data( mstate.findData('force') ) as f:
+            f[:] += 1
+    '''
+
+    ptr, shape, typename = data.beginEditVoidPtr()
+    try:
+        yield _as_numpy(ptr, shape, typename)
+    finally:
+        data.endEditVoidPtr()
+
+
 # convenience
-def numpy_data(obj, name):
+def numpy_data(obj, name, read_only=False):
+    data = obj.findData(name)
+    return as_numpy(data, read_only)
+
+
+def edit_numpy_data(obj, name):
     data = obj.findData(name)
-    return as_numpy(data)
+    return edit_data(data)
 
 
 def vec_as_numpy( (ptr, size, typename) ):
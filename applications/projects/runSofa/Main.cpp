@@ -33,6 +33,7 @@ using std::vector;
 #include <sofa/helper/ArgumentParser.h>
 #include <SofaSimulationCommon/common.h>
 #include <sofa/simulation/Node.h>
+#include <sofa/simulation/MemoryFootprintVisitor.h>
 #include <sofa/helper/system/PluginManager.h>
 #include <sofa/simulation/config.h> // #defines SOFA_HAVE_DAG (or not)
 #include <SofaSimulationCommon/init.h>
@@ -191,6 +192,9 @@ int main(int argc, char** argv)
     bool computationTimeAtBegin = false;
     unsigned int computationTimeSampling=0; ///< Frequency of display of the computation time statistics, in number of animation steps. 0 means never.
     string    computationTimeOutputType="stdout";
+    string    memoryReport="";
+    bool parallelInit = false;
+    bool initReport = false;
 
     string gui = "";
     string verif = "";
@@ -222,6 +226,9 @@ int main(int argc, char** argv)
     argParser->addArgument(po::value<bool>(&computationTimeAtBegin)->default_value(false)->implicit_value(true),    "computationTimeAtBegin,b", "Output computation time statistics of the init (at the begin of the simulation)");
     argParser->addArgument(po::value<unsigned int>(&computationTimeSampling)->default_value(0),                     "computationTimeSampling", "Frequency of display of the computation time statistics, in number of animation steps. 0 means never.");
     argParser->addArgument(po::value<std::string>(&computationTimeOutputType)->default_value("stdout"),             "computationTimeOutputType,o", "Output type for the computation time statistics: either stdout, json or ljson");
+    argParser->addArgument(po::value<std::string>(&memoryReport)->default_value("")->implicit_value("text"),        "memoryReport", "Print the memory footprint of the components when the simulation is closed: either text or json");
+    argParser->addArgument(po::value<bool>(&parallelInit)->default_value(false)->implicit_value(true),              "parallelInit", "Initialize concurrently the components which do not depend on each other");
+    argParser->addArgument(po::value<bool>(&initReport)->default_value(false)->implicit_value(true),                "initReport", "Print the time spent in the init of each component");
     argParser->addArgument(po::value<std::string>(&gui)->default_value(""),                                         "gui,g", gui_help.c_str());
     argParser->addArgument(po::value<std::vector<std::string>>(&plugins),                                           "load,l", "load given plugins");
     argParser->addArgument(po::value<bool>(&noAutoloadPlugins)->default_value(false)->implicit_value(true),         "noautoload", "disable plugins autoloading");
@@ -402,11 +409,15 @@ int main(int argc, char** argv)
         sofa::helper::AdvancedTimer::begin("Init");
     }
 
+    sofa::simulation::getSimulation()->d_parallelInit.setValue(parallelInit);
+    sofa::simulation::getSimulation()->d_initTimings.setValue(initReport);
     sofa::simulation::getSimulation()->init(groot.get());
     if( computationTimeAtBegin )
     {
         msg_info("") << sofa::helper::AdvancedTimer::end("Init", groot.get());
     }
+    if (initReport)
+        sofa::simulation::getSimulation()->getInitScheduler().printReport(std::cout);
     GUIManager::SetScene(groot,fileName.c_str(), temporaryFile);
 
 
@@ -442,6 +453,13 @@ int main(int argc, char** argv)
         sofa::simulation::getSimulation()->exportXML(groot.get(), xmlname.c_str());
     }
 
+    if (groot!=NULL && !memoryReport.empty())
+    {
+        sofa::simulation::MemoryFootprintVisitor memoryVisitor(sofa::core::ExecParams::defaultInstance());
+        memoryVisitor.execute(groot.get());
+        memoryVisitor.printReport(std::cout, memoryReport);
+    }
+
     if (groot!=NULL)
         sofa::simulation::getSimulation()->unload(groot);
 
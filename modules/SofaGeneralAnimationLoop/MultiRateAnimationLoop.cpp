@@ -0,0 +1,339 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2018 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#include <SofaGeneralAnimationLoop/MultiRateAnimationLoop.h>
+#include <sofa/core/visual/VisualParams.h>
+#include <sofa/core/ObjectFactory.h>
+#include <sofa/core/MechanicalParams.h>
+#include <sofa/simulation/MechanicalVisitor.h>
+#include <sofa/simulation/VectorOperations.h>
+#include <sofa/simulation/AnimateBeginEvent.h>
+#include <sofa/simulation/AnimateEndEvent.h>
+#include <sofa/simulation/IntegrateBeginEvent.h>
+#include <sofa/simulation/IntegrateEndEvent.h>
+#include <sofa/simulation/UpdateMappingEndEvent.h>
+#include <sofa/simulation/UpdateBoundingBoxVisitor.h>
+#include <sofa/simulation/PropagateEventVisitor.h>
+#include <sofa/simulation/BehaviorUpdatePositionVisitor.h>
+#include <sofa/simulation/UpdateContextVisitor.h>
+#include <sofa/simulation/UpdateMappingVisitor.h>
+#include <sofa/helper/IndexOpenMP.h>
+#include <algorithm>
+#include <map>
+#include <math.h>
+#include <iostream>
+
+
+using namespace sofa::simulation;
+
+namespace sofa
+{
+
+namespace component
+{
+
+namespace animationloop
+{
+
+int MultiRateAnimationLoopClass = core::RegisterObject("Multirate animation loop, each solver subtree is integrated with its own time step.")
+        .add< MultiRateAnimationLoop >()
+        ;
+
+SOFA_DECL_CLASS(MultiRateAnimationLoop);
+
+MultiRateAnimationLoop::MultiRateAnimationLoop(simulation::Node* gnode)
+    : Inherit(gnode)
+    , nodes( initData(&nodes,"nodes", "names of the solver subtrees with their own time step") )
+    , dts( initData(&dts,"dts", "time step of each subtree listed in nodes, other subtrees use the animation time step") )
+    , coupling( initData(&coupling,"coupling", "coupling forces between subtrees: hold (evaluated once per step) or update (evaluated before each substep)") )
+    , parallel( initData(&parallel,false,"parallel", "integrate the subtrees concurrently (only with held coupling forces)") )
+    , stepForce( core::MultiVecDerivId::null() )
+    , couplingForce( core::MultiVecDerivId::null() )
+    , sharedSubtreesWarned(false)
+{
+    helper::OptionsGroup couplingOptions(2,"hold","update");
+    couplingOptions.setSelectedItem(0);
+    coupling.setValue(couplingOptions);
+}
+
+MultiRateAnimationLoop::~MultiRateAnimationLoop()
+{
+}
+
+void MultiRateAnimationLoop::init()
+{
+    Inherit::init();
+    if (nodes.getValue().size() != dts.getValue().size())
+        serr << "nodes and dts should have the same size, unmatched entries are ignored" << sendl;
+    if (parallel.getValue() && coupling.getValue().getSelectedId() != 0)
+        serr << "subtrees can only be integrated in parallel with held coupling forces, they will be integrated sequentially" << sendl;
+}
+
+void MultiRateAnimationLoop::cleanup()
+{
+    simulation::common::VectorOperations vop(core::ExecParams::defaultInstance(), this->getContext());
+    if (!stepForce.isNull())
+        vop.v_free(stepForce, true, true);
+    if (!couplingForce.isNull())
+        vop.v_free(couplingForce, true, true);
+    Inherit::cleanup();
+}
+
+void MultiRateAnimationLoop::collectSubtrees(simulation::Node* node, SReal dt)
+{
+    if (!node->solver.empty())
+    {
+        for (unsigned int i=0; i<subtrees.size(); ++i)
+            if (subtrees[i].node == node) return;
+
+        Subtree subtree;
+        subtree.node = node;
+        subtree.nbSteps = 1;
+        const helper::vector<std::string>& names = nodes.getValue();
+        const helper::vector<SReal>& steps = dts.getValue();
+        for (unsigned int i=0; i<names.size() && i<steps.size(); ++i)
+        {
+            if (names[i] == node->getName() && steps[i] > 0)
+                subtree.nbSteps = std::max(1, (int)floor(dt/steps[i] + 0.5));
+        }
+        subtrees.push_back(subtree);
+        return;
+    }
+
+    for (unsigned int i=0; i<node->interactionForceField.size(); ++i)
+    {
+        core::behavior::BaseInteractionForceField* ff = node->interactionForceField[i];
+        if (std::find(couplings.begin(), couplings.end(), ff) == couplings.end())
+            couplings.push_back(ff);
+    }
+    for (unsigned int i=0; i<node->child.size(); ++i)
+        collectSubtrees(node->child[i].get(), dt);
+}
+
+bool MultiRateAnimationLoop::independentSubtrees() const
+{
+    std::map<const simulation::Node*, unsigned int> nodeOwner;
+    std::map<const core::behavior::BaseMechanicalState*, unsigned int> stateOwner;
+    helper::vector< helper::vector<simulation::Node*> > subtreeNodes(subtrees.size());
+    for (unsigned int s=0; s<subtrees.size(); ++s)
+    {
+        helper::vector<simulation::Node*> stack(1, subtrees[s].node);
+        while (!stack.empty())
+        {
+            simulation::Node* node = stack.back();
+            stack.pop_back();
+            std::map<const simulation::Node*, unsigned int>::const_iterator it = nodeOwner.find(node);
+            if (it != nodeOwner.end())
+            {
+                if (it->second != s) return false;
+                continue; // reached twice from the same subtree
+            }
+            nodeOwner[node] = s;
+            subtreeNodes[s].push_back(node);
+            if (node->mechanicalState)
+            {
+                if (stateOwner.count(node->mechanicalState) && stateOwner[node->mechanicalState] != s) return false;
+                stateOwner[node->mechanicalState] = s;
+            }
+            for (unsigned int i=0; i<node->child.size(); ++i)
+                stack.push_back(node->child[i].get());
+        }
+    }
+
+    // the forces of an interaction force field inside a subtree are accumulated by its integration
+    for (unsigned int s=0; s<subtrees.size(); ++s)
+    {
+        for (unsigned int n=0; n<subtreeNodes[s].size(); ++n)
+        {
+            simulation::Node* node = subtreeNodes[s][n];
+            for (unsigned int i=0; i<node->interactionForceField.size(); ++i)
+            {
+                core::behavior::BaseInteractionForceField* ff = node->interactionForceField[i];
+                const core::behavior::BaseMechanicalState* states[2] = { ff->getMechModel1(), ff->getMechModel2() };
+                for (int k=0; k<2; ++k)
+                {
+                    std::map<const core::behavior::BaseMechanicalState*, unsigned int>::const_iterator it = stateOwner.find(states[k]);
+                    if (it == stateOwner.end() || it->second != s) return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+void MultiRateAnimationLoop::accumulateCouplingForces(const core::ExecParams* params, SReal dt)
+{
+    simulation::MechanicalVOpVisitor(params, couplingForce).setMapped(true).execute(this->gnode);
+    core::MechanicalParams mparams(*params);
+    mparams.setDt(dt);
+    for (unsigned int i=0; i<couplings.size(); ++i)
+        couplings[i]->addForce(&mparams, couplingForce);
+}
+
+void MultiRateAnimationLoop::integrateSubtree(const core::ExecParams* params, const Subtree& subtree, SReal startTime, SReal dt, bool holdCoupling)
+{
+    simulation::Node* node = subtree.node;
+    const SReal h = dt / subtree.nbSteps;
+    for (int k = 0; k < subtree.nbSteps; ++k)
+    {
+        node->setTime(startTime + k*h);
+        node->setDt(h);
+        node->execute<UpdateSimulationContextVisitor>(params);
+
+        if (!holdCoupling && !couplings.empty())
+            accumulateCouplingForces(params, h);
+
+        // the external forces of the subtree are cleared at the end of each integration
+        simulation::MechanicalVOpVisitor(params, core::VecDerivId::externalForce(), stepForce, couplingForce, 1.0).setMapped(true).execute(node);
+
+        simulation::MechanicalIntegrationVisitor act(params, h);
+        act.setTags(this->getTags());
+        act.execute(node);
+    }
+}
+
+void MultiRateAnimationLoop::step(const sofa::core::ExecParams* params, SReal dt)
+{
+    if (dt == 0)
+        dt = this->gnode->getDt();
+
+
+    sofa::helper::AdvancedTimer::stepBegin("AnimationStep");
+#ifdef SOFA_DUMP_VISITOR_INFO
+    simulation::Visitor::printNode("Step");
+#endif
+
+    {
+        AnimateBeginEvent ev ( dt );
+        PropagateEventVisitor act ( params, &ev );
+        this->gnode->execute ( act );
+    }
+
+    SReal startTime = this->gnode->getTime();
+
+    BehaviorUpdatePositionVisitor beh(params , dt);
+    this->gnode->execute ( beh );
+
+    // First we reset the constraints
+    sofa::simulation::MechanicalResetConstraintVisitor(params).execute(this->getContext());
+    // Then do collision detection and response creation
+    computeCollision(params);
+
+    // contact responses may have added nodes or interaction force fields
+    subtrees.clear();
+    couplings.clear();
+    collectSubtrees(this->gnode, dt);
+    // with updated coupling forces the slower subtrees see the faster ones at the end of the step
+    std::stable_sort(subtrees.begin(), subtrees.end());
+
+    const bool holdCoupling = (coupling.getValue().getSelectedId() == 0);
+
+    {
+        IntegrateBeginEvent evBegin;
+        PropagateEventVisitor eventPropagation( params, &evBegin);
+        eventPropagation.execute(this->getContext());
+    }
+
+    {
+        // new states may have been added by the contact responses
+        simulation::common::VectorOperations vop(params, this->getContext());
+        vop.v_realloc(stepForce, true, true);
+        vop.v_realloc(couplingForce, true, true);
+
+        // the external forces set by the other components are kept for all the substeps
+        simulation::MechanicalVOpVisitor(params, stepForce).setMapped(true).execute(this->gnode);
+        simulation::MechanicalVOpVisitor(params, stepForce, stepForce, core::ConstVecDerivId::externalForce(), 1.0).setMapped(true).execute(this->gnode);
+
+        if (holdCoupling && !couplings.empty())
+            accumulateCouplingForces(params, dt);
+        else
+            simulation::MechanicalVOpVisitor(params, couplingForce).setMapped(true).execute(this->gnode);
+    }
+
+    bool concurrent = false;
+    if (parallel.getValue() && holdCoupling && subtrees.size() > 1)
+    {
+        concurrent = independentSubtrees();
+        if (!concurrent && !sharedSubtreesWarned)
+        {
+            serr << "the solver subtrees share nodes or mechanical states, they will be integrated sequentially" << sendl;
+            sharedSubtreesWarned = true;
+        }
+    }
+
+    const int nbSubtrees = (int)subtrees.size();
+    if (concurrent)
+    {
+#ifdef _OPENMP
+        #pragma omp parallel for schedule(dynamic,1)
+#endif
+        for (helper::IndexOpenMP<int>::type i = 0; i < nbSubtrees; ++i)
+            integrateSubtree(params, subtrees[i], startTime, dt, true);
+    }
+    else
+    {
+        for (int i = 0; i < nbSubtrees; ++i)
+            integrateSubtree(params, subtrees[i], startTime, dt, holdCoupling);
+    }
+
+    {
+        IntegrateEndEvent evEnd;
+        PropagateEventVisitor eventPropagation( params, &evEnd);
+        eventPropagation.execute(this->getContext());
+    }
+
+    this->gnode->setTime ( startTime + dt );
+    this->gnode->execute<UpdateSimulationContextVisitor>(params);  // propagate time and dt
+
+    {
+        AnimateEndEvent ev ( dt );
+        PropagateEventVisitor act ( params, &ev );
+        this->gnode->execute ( act );
+    }
+
+    sofa::helper::AdvancedTimer::stepBegin("UpdateMapping");
+    //Visual Information update: Ray Pick add a MechanicalMapping used as VisualMapping
+    this->gnode->execute<UpdateMappingVisitor>(params);
+    sofa::helper::AdvancedTimer::step("UpdateMappingEndEvent");
+    {
+        UpdateMappingEndEvent ev ( dt );
+        PropagateEventVisitor act ( params , &ev );
+        this->gnode->execute ( act );
+    }
+    sofa::helper::AdvancedTimer::stepEnd("UpdateMapping");
+
+#ifndef SOFA_NO_UPDATE_BBOX
+    sofa::helper::AdvancedTimer::stepBegin("UpdateBBox");
+    this->gnode->execute<UpdateBoundingBoxVisitor>(params);
+    sofa::helper::AdvancedTimer::stepEnd("UpdateBBox");
+#endif
+#ifdef SOFA_DUMP_VISITOR_INFO
+    simulation::Visitor::printCloseNode("Step");
+#endif
+
+    sofa::helper::AdvancedTimer::stepEnd("AnimationStep");
+}
+
+} // namespace animationloop
+
+} // namespace component
+
+} // namespace sofa
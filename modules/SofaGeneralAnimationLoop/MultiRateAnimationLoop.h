@@ -0,0 +1,122 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2018 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#ifndef SOFA_COMPONENT_ANIMATIONLOOP_MULTIRATEANIMATIONLOOP_H
+#define SOFA_COMPONENT_ANIMATIONLOOP_MULTIRATEANIMATIONLOOP_H
+#include "config.h"
+
+#include <sofa/core/behavior/BaseAnimationLoop.h>
+#include <sofa/core/behavior/BaseInteractionForceField.h>
+#include <sofa/simulation/CollisionAnimationLoop.h>
+#include <sofa/helper/OptionsGroup.h>
+#include <sofa/helper/vector.h>
+
+namespace sofa
+{
+
+namespace component
+{
+
+namespace animationloop
+{
+
+/** Animation loop integrating each solver subtree with its own time step.
+ *
+ * A solver subtree is the topmost node holding an OdeSolver. Subtrees listed
+ * in nodes are integrated with the matching time step of dts, rounded so that
+ * an integer number of substeps fits in the animation step. Other subtrees
+ * use the animation step. Collision detection is done once per animation step.
+ *
+ * Interaction force fields outside the subtrees couple them. Their forces are
+ * accumulated in a dedicated vector, either once per animation step and held
+ * during the substeps, or again before each substep from the current state of
+ * the other subtrees. The external forces set before the integration (e.g. at
+ * AnimateBegin) are saved and applied, with the coupling forces, at each
+ * substep of their subtree.
+ *
+ * With held coupling forces a substep only reads the saved vectors and writes
+ * the states of its own subtree, so the subtrees can be integrated
+ * concurrently. This is only done when no node or mechanical state is shared
+ * by two subtrees and the interaction force fields inside a subtree only act
+ * on its own states, otherwise they are integrated sequentially.
+ */
+class SOFA_GENERAL_ANIMATION_LOOP_API MultiRateAnimationLoop : public sofa::simulation::CollisionAnimationLoop
+{
+public:
+    typedef sofa::simulation::CollisionAnimationLoop Inherit;
+    SOFA_CLASS(MultiRateAnimationLoop, sofa::simulation::CollisionAnimationLoop);
+protected:
+    MultiRateAnimationLoop(simulation::Node* gnode);
+
+    virtual ~MultiRateAnimationLoop();
+public:
+    virtual void init() override;
+    virtual void cleanup() override;
+
+    virtual void step (const sofa::core::ExecParams* params, SReal dt) override;
+
+    /// Construction method called by ObjectFactory.
+    template<class T>
+    static typename T::SPtr create(T*, BaseContext* context, BaseObjectDescription* arg)
+    {
+        simulation::Node* gnode = dynamic_cast<simulation::Node*>(context);
+        typename T::SPtr obj = sofa::core::objectmodel::New<T>(gnode);
+        if (context) context->addObject(obj);
+        if (arg) obj->parse(arg);
+        return obj;
+    }
+
+    Data< helper::vector<std::string> > nodes; ///< names of the solver subtrees with their own time step
+    Data< helper::vector<SReal> > dts; ///< time step of each subtree listed in nodes
+    Data< helper::OptionsGroup > coupling; ///< coupling forces between subtrees: hold (evaluated once per step) or update (evaluated before each substep)
+    Data<bool> parallel; ///< integrate the subtrees concurrently (only with held coupling forces)
+
+protected:
+    struct Subtree
+    {
+        simulation::Node* node;
+        int nbSteps;
+
+        /// faster subtrees first
+        bool operator<(const Subtree& s) const { return nbSteps > s.nbSteps; }
+    };
+
+    helper::vector<Subtree> subtrees;
+    helper::vector<core::behavior::BaseInteractionForceField*> couplings;
+    core::MultiVecDerivId stepForce; ///< external forces set before the integration, applied at each substep
+    core::MultiVecDerivId couplingForce; ///< forces of the interaction force fields coupling the subtrees
+    bool sharedSubtreesWarned;
+
+    /// find the solver subtrees and the interaction force fields coupling them
+    void collectSubtrees(simulation::Node* node, SReal dt);
+    /// true if the subtrees share no node or mechanical state and can be integrated concurrently
+    bool independentSubtrees() const;
+    void accumulateCouplingForces(const core::ExecParams* params, SReal dt);
+    void integrateSubtree(const core::ExecParams* params, const Subtree& subtree, SReal startTime, SReal dt, bool holdCoupling);
+};
+
+} // namespace animationloop
+
+} // namespace component
+
+} // namespace sofa
+
+#endif /* SOFA_COMPONENT_ANIMATIONLOOP_MULTIRATEANIMATIONLOOP_H */
@@ -0,0 +1,159 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2018 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#include <SofaGeneralAnimationLoop/MultiRateAnimationLoop.h>
+using sofa::component::animationloop::MultiRateAnimationLoop ;
+
+#include <sofa/core/behavior/OdeSolver.h>
+#include <SofaBaseMechanics/MechanicalObject.h>
+#include <SofaDeformable/StiffSpringForceField.h>
+
+#include <SofaSimulationGraph/DAGSimulation.h>
+using sofa::simulation::Node ;
+
+#include <SofaTest/Sofa_test.h>
+
+namespace
+{
+
+typedef sofa::defaulttype::Vec3dTypes DataTypes ;
+typedef DataTypes::Deriv Deriv ;
+typedef DataTypes::VecDeriv VecDeriv ;
+typedef sofa::component::container::MechanicalObject<DataTypes> MechanicalObject3 ;
+typedef sofa::component::interactionforcefield::StiffSpringForceField<DataTypes> StiffSpringForceField3 ;
+
+/// Records the time, the time step and the external force of its state at each integration, without moving it
+class RecordingSolver : public sofa::core::behavior::OdeSolver
+{
+public:
+    SOFA_CLASS(RecordingSolver, sofa::core::behavior::OdeSolver) ;
+
+    std::vector<SReal> times ;
+    std::vector<SReal> dts ;
+    std::vector<Deriv> externalForces ;
+
+    virtual void solve(const sofa::core::ExecParams*, SReal dt, sofa::core::MultiVecCoordId, sofa::core::MultiVecDerivId) override
+    {
+        times.push_back(this->getContext()->getTime()) ;
+        dts.push_back(dt) ;
+        MechanicalObject3* dofs = dynamic_cast<MechanicalObject3*>(this->getContext()->getMechanicalState()) ;
+        const VecDeriv& f = dofs->read(sofa::core::ConstVecDerivId::externalForce())->getValue() ;
+        externalForces.push_back(f.empty() ? Deriv() : f[0]) ;
+    }
+} ;
+
+class MultiRateAnimationLoop_test : public sofa::Sofa_test<>
+{
+public:
+    Node::SPtr root ;
+    MultiRateAnimationLoop::SPtr loop ;
+    RecordingSolver::SPtr solvers[2] ;
+    MechanicalObject3::SPtr dofs[2] ;
+
+    void TearDown()
+    {
+        if (root)
+            sofa::simulation::getSimulation()->unload(root) ;
+    }
+
+    /// A fast subtree with 4 substeps and a slow one with a single step, coupled by a stretched spring
+    void createScene(const std::string& coupling, bool parallel)
+    {
+        root = sofa::simulation::getSimulation()->createNewGraph("root") ;
+        root->setDt(0.1) ;
+        loop = sofa::core::objectmodel::New<MultiRateAnimationLoop>(root.get()) ;
+        loop->nodes.setValue(sofa::helper::vector<std::string>(1, "fast")) ;
+        loop->dts.setValue(sofa::helper::vector<SReal>(1, 0.025)) ;
+        loop->coupling.beginEdit()->setSelectedItem(coupling) ;
+        loop->coupling.endEdit() ;
+        loop->parallel.setValue(parallel) ;
+        root->addObject(loop) ;
+
+        const char* names[2] = { "fast", "slow" } ;
+        for (int i=0; i<2; ++i)
+        {
+            Node::SPtr child = root->createChild(names[i]) ;
+            solvers[i] = sofa::core::objectmodel::New<RecordingSolver>() ;
+            child->addObject(solvers[i]) ;
+            dofs[i] = sofa::core::objectmodel::New<MechanicalObject3>() ;
+            child->addObject(dofs[i]) ;
+        }
+
+        StiffSpringForceField3::SPtr spring = sofa::core::objectmodel::New<StiffSpringForceField3>(dofs[0].get(), dofs[1].get()) ;
+        spring->addSpring(0, 0, 10.0, 0.0, 1.0) ;
+        root->addObject(spring) ;
+
+        sofa::simulation::getSimulation()->init(root.get()) ;
+
+        for (int i=0; i<2; ++i)
+        {
+            MechanicalObject3::WriteVecCoord x = dofs[i]->writePositions() ;
+            x.resize(1) ;
+            DataTypes::set(x[0], 2.0*i, 0.0, 0.0) ;
+        }
+    }
+
+    void checkStep(const std::string& coupling, bool parallel)
+    {
+        EXPECT_MSG_NOEMIT(Error) ;
+        createScene(coupling, parallel) ;
+
+        // external forces set by another component before the integration, e.g. at AnimateBegin
+        dofs[0]->write(sofa::core::VecDerivId::externalForce())->setValue(VecDeriv(1, Deriv(0, 1, 0))) ;
+        dofs[1]->write(sofa::core::VecDerivId::externalForce())->setValue(VecDeriv(1, Deriv(0, 0, 2))) ;
+
+        sofa::simulation::getSimulation()->animate(root.get(), 0.1) ;
+
+        // the stretched spring pulls the states toward each other
+        const Deriv expected[2] = { Deriv(10, 1, 0), Deriv(-10, 0, 2) } ;
+        const unsigned nbSteps[2] = { 4, 1 } ;
+        for (int i=0; i<2; ++i)
+        {
+            const RecordingSolver& solver = *solvers[i] ;
+            ASSERT_EQ(solver.times.size(), nbSteps[i]) ;
+            for (unsigned k=0; k<nbSteps[i]; ++k)
+            {
+                EXPECT_NEAR(solver.dts[k], 0.1/nbSteps[i], 1e-12) ;
+                EXPECT_NEAR(solver.times[k], k*0.1/nbSteps[i], 1e-12) ;
+                for (int c=0; c<3; ++c)
+                    EXPECT_NEAR(solver.externalForces[k][c], expected[i][c], 1e-12) << "substep " << k << " of subtree " << i ;
+            }
+        }
+        EXPECT_NEAR(root->getTime(), 0.1, 1e-12) ;
+    }
+} ;
+
+TEST_F(MultiRateAnimationLoop_test, holdCoupling)
+{
+    checkStep("hold", false) ;
+}
+
+TEST_F(MultiRateAnimationLoop_test, holdCouplingParallel)
+{
+    checkStep("hold", true) ;
+}
+
+TEST_F(MultiRateAnimationLoop_test, updateCoupling)
+{
+    checkStep("update", false) ;
+}
+
+}
@@ -724,6 +724,11 @@ public:
 
 /// Linear system solver using Thomas Algorithm for Block Tridiagonal matrices
 ///
+/// With cyclicReduction enabled, the system is instead factorized and solved by
+/// block cyclic reduction: the odd blocks of each level are eliminated
+/// independently, which lets the factorization, the solve and the
+/// computation of J M^-1 J^t (one solve per constraint row) run in parallel.
+///
 /// References:
 /// Conte, S.D., and deBoor, C. (1972). Elementary Numerical Analysis. McGraw-Hill, New York
 /// http://en.wikipedia.org/wiki/Tridiagonal_matrix_algorithm
@@ -777,6 +782,26 @@ public:
     Vector Y;
 
     Data<int> f_blockSize; ///< dimension of the blocks in the matrix
+    Data<bool> f_cyclicReduction; ///< Factorize and solve with the parallel block cyclic reduction instead of the sequential Thomas algorithm
+
+    typedef defaulttype::Vec<Matrix::BSIZE,Real> CyclicReductionVec;
+
+    /// One level of the block cyclic reduction
+    struct CyclicReductionLevel
+    {
+        helper::vector<BlocType> A, B, C; ///< diagonal, lower and upper blocks of the reduced system
+        helper::vector<BlocType> Ainv; ///< inverse of the diagonal blocks eliminated at this level (odd indices)
+        helper::vector<BlocType> alpha, gamma; ///< B*Ainv and C*Ainv of the eliminated neighbours (even indices)
+    };
+
+    /// Right-hand sides and solutions of every level, for one solve
+    struct CyclicReductionWork
+    {
+        helper::vector< helper::vector<CyclicReductionVec> > rhs, x;
+    };
+
+    helper::vector<CyclicReductionLevel> crLevels;
+    CyclicReductionWork crWork;
 protected:
     BTDLinearSolver()
         : f_verbose( initData(&f_verbose,false,"verbose","Dump system state at each iteration") )
@@ -785,6 +810,8 @@ protected:
         , verification(initData(&verification, false,"verification", "verification of the subpartSolve"))
         , test_perf(initData(&test_perf, false,"test_perf", "verification of performance"))
         , f_blockSize( initData(&f_blockSize,6,"blockSize","dimension of the blocks in the matrix") )
+        , f_cyclicReduction( initData(&f_cyclicReduction,false,"cyclicReduction","Factorize and solve with the parallel block cyclic reduction instead of the sequential Thomas algorithm") )
+        , thomasMatrix(NULL)
     {
         Index bsize = Matrix::getSubMatrixDim(0);
         if (bsize > 0)
@@ -801,6 +828,19 @@ public:
 
     void invert(Matrix& M) override;
 
+    /// Thomas factorization, used by the default solve, subpartSolve and Minv blocks
+    void factorizeThomas(Matrix& M);
+    /// Run the Thomas factorization postponed by invert() when using cyclic reduction, if any
+    void factorizePostponedThomas();
+
+    /// Block cyclic reduction factorization
+    void factorizeCyclicReduction(Matrix& M);
+
+    void initCyclicReductionWork(CyclicReductionWork& work) const;
+
+    /// Solve from work.rhs[0] into work.x[0]
+    void solveCyclicReduction(CyclicReductionWork& work, bool parallel) const;
+
     void computeMinvBlock(Index i, Index j);
 
     double getMinvElement(Index i, Index j);
@@ -839,10 +879,15 @@ public:
     template<class RMatrix, class JMatrix>
     bool addJMInvJt(RMatrix& result, JMatrix& J, double fact);
 
+    /// J M^-1 J^t computed with one cyclic reduction solve per row of J, in parallel
+    template<class RMatrix, class JMatrix>
+    bool addJMInvJtCyclicReduction(RMatrix& result, JMatrix& J, double fact);
+
 
 
 private:
 
+    Matrix* thomasMatrix; // matrix whose Thomas factorization is postponed until Minv blocks are needed
 
     Index _indMaxNonNullForce; // point with non null force which index is the greatest and for which globalAccumulate was not proceed
 
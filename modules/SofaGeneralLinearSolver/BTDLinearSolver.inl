@@ -23,6 +23,7 @@
 #define SOFA_COMPONENT_LINEARSOLVER_BTDLINEARSOLVER_INL
 
 #include "BTDLinearSolver.h"
+#include <sofa/helper/IndexOpenMP.h>
 
 
 namespace sofa
@@ -117,6 +118,36 @@ void BTDLinearSolver<Matrix,Vector>::invert(SubMatrix& Inv, const BlocType& m)
 
 template<class Matrix, class Vector>
 void BTDLinearSolver<Matrix,Vector>::invert(Matrix& M)
+{
+    thomasMatrix = NULL;
+    if (f_cyclicReduction.getValue())
+    {
+        factorizeCyclicReduction(M);
+        if (!subpartSolve.getValue())
+        {
+            // Minv blocks are only computed if getMinvElement is called
+            thomasMatrix = &M;
+            return;
+        }
+    }
+    else
+        crLevels.clear();
+    factorizeThomas(M);
+}
+
+template<class Matrix, class Vector>
+void BTDLinearSolver<Matrix,Vector>::factorizePostponedThomas()
+{
+    if (thomasMatrix != NULL)
+    {
+        Matrix* M = thomasMatrix;
+        thomasMatrix = NULL;
+        factorizeThomas(*M);
+    }
+}
+
+template<class Matrix, class Vector>
+void BTDLinearSolver<Matrix,Vector>::factorizeThomas(Matrix& M)
 {
 
     msg_info_when(this->f_verbose.getValue()) << "BTDLinearSolver, invert Matrix = "<< M ;
@@ -203,6 +234,183 @@ void BTDLinearSolver<Matrix,Vector>::invert(Matrix& M)
 
 
 
+/// Block cyclic reduction
+///
+/// At each level the odd blocks are eliminated from the equations of their
+/// even neighbours, which only involves independent block operations:
+///
+///     alpha_k = B_k inv(A_k-1)              gamma_k = C_k inv(A_k+1)
+///     A'_k = A_k - alpha_k C_k-1 - gamma_k B_k+1
+///     B'_k = - alpha_k B_k-1                C'_k = - gamma_k C_k+1
+///     b'_k = b_k - alpha_k b_k-1 - gamma_k b_k+1
+///
+/// The even blocks form the next level, until a single block remains. The
+/// odd unknowns are then recovered level by level, again independently:
+///
+///     x_k = inv(A_k) (b_k - B_k x_k-1 - C_k x_k+1)
+///
+template<class Matrix, class Vector>
+void BTDLinearSolver<Matrix,Vector>::factorizeCyclicReduction(Matrix& M)
+{
+    const Index bsize = Matrix::getSubMatrixDim(f_blockSize.getValue());
+    const Index nb = M.rowSize() / bsize;
+    crLevels.clear();
+    if (nb == 0) return;
+
+    unsigned nbLevels = 1;
+    for (Index m = nb; m > 1; m = (m+1)/2)
+        ++nbLevels;
+    crLevels.resize(nbLevels);
+
+    {
+        CyclicReductionLevel& level = crLevels[0];
+        level.A.resize(nb);
+        level.B.resize(nb);
+        level.C.resize(nb);
+        for (Index i=0; i<nb; ++i)
+        {
+            level.A[i] = M.asub(i,i,bsize,bsize);
+            if (i > 0)
+                level.B[i] = M.asub(i,i-1,bsize,bsize);
+            if (i < nb-1)
+                level.C[i] = M.asub(i,i+1,bsize,bsize);
+        }
+    }
+
+    for (unsigned l=0; l<nbLevels; ++l)
+    {
+        CyclicReductionLevel& cur = crLevels[l];
+        const Index m = (Index)cur.A.size();
+        cur.Ainv.resize(m);
+
+        if (m == 1)
+        {
+            SubMatrix inv;
+            invert(inv, cur.A[0]);
+            cur.Ainv[0] = inv;
+            break;
+        }
+
+        const Index nbOdd = m/2;
+#ifdef _OPENMP
+        #pragma omp parallel for if (nbOdd > 64)
+#endif
+        for (typename helper::IndexOpenMP<Index>::type i=0; i<nbOdd; ++i)
+        {
+            const Index k = 2*i+1;
+            SubMatrix inv;
+            invert(inv, cur.A[k]);
+            cur.Ainv[k] = inv;
+        }
+
+        CyclicReductionLevel& next = crLevels[l+1];
+        const Index mc = (m+1)/2;
+        cur.alpha.resize(m);
+        cur.gamma.resize(m);
+        next.A.resize(mc);
+        next.B.resize(mc);
+        next.C.resize(mc);
+#ifdef _OPENMP
+        #pragma omp parallel for if (mc > 64)
+#endif
+        for (typename helper::IndexOpenMP<Index>::type kc=0; kc<mc; ++kc)
+        {
+            const Index k = 2*kc;
+            BlocType Ak = cur.A[k];
+            if (k > 0)
+            {
+                cur.alpha[k] = cur.B[k]*cur.Ainv[k-1];
+                Ak -= cur.alpha[k]*cur.C[k-1];
+                next.B[kc].clear();
+                if (k > 1)
+                    next.B[kc] -= cur.alpha[k]*cur.B[k-1];
+            }
+            if (k < m-1)
+            {
+                cur.gamma[k] = cur.C[k]*cur.Ainv[k+1];
+                Ak -= cur.gamma[k]*cur.B[k+1];
+                next.C[kc].clear();
+                if (k+1 < m-1)
+                    next.C[kc] -= cur.gamma[k]*cur.C[k+1];
+            }
+            next.A[kc] = Ak;
+        }
+    }
+}
+
+template<class Matrix, class Vector>
+void BTDLinearSolver<Matrix,Vector>::initCyclicReductionWork(CyclicReductionWork& work) const
+{
+    work.rhs.resize(crLevels.size());
+    work.x.resize(crLevels.size());
+    for (unsigned l=0; l<crLevels.size(); ++l)
+    {
+        work.rhs[l].resize(crLevels[l].A.size());
+        work.x[l].resize(crLevels[l].A.size());
+    }
+}
+
+template<class Matrix, class Vector>
+void BTDLinearSolver<Matrix,Vector>::solveCyclicReduction(CyclicReductionWork& work, bool parallel) const
+{
+    const unsigned nbLevels = (unsigned)crLevels.size();
+    if (nbLevels == 0) return;
+
+    // reduction of the right-hand side
+    for (unsigned l=0; l+1<nbLevels; ++l)
+    {
+        const CyclicReductionLevel& cur = crLevels[l];
+        const helper::vector<CyclicReductionVec>& rhs = work.rhs[l];
+        helper::vector<CyclicReductionVec>& rhsNext = work.rhs[l+1];
+        const Index m = (Index)cur.A.size();
+        const Index mc = (m+1)/2;
+#ifdef _OPENMP
+        #pragma omp parallel for if (parallel && mc > 64)
+#else
+        SOFA_UNUSED(parallel);
+#endif
+        for (typename helper::IndexOpenMP<Index>::type kc=0; kc<mc; ++kc)
+        {
+            const Index k = 2*kc;
+            CyclicReductionVec v = rhs[k];
+            if (k > 0)
+                v -= cur.alpha[k]*rhs[k-1];
+            if (k < m-1)
+                v -= cur.gamma[k]*rhs[k+1];
+            rhsNext[kc] = v;
+        }
+    }
+
+    work.x[nbLevels-1][0] = crLevels[nbLevels-1].Ainv[0]*work.rhs[nbLevels-1][0];
+
+    // back substitution of the eliminated unknowns
+    for (int l=(int)nbLevels-2; l>=0; --l)
+    {
+        const CyclicReductionLevel& cur = crLevels[l];
+        const helper::vector<CyclicReductionVec>& rhs = work.rhs[l];
+        const helper::vector<CyclicReductionVec>& xNext = work.x[l+1];
+        helper::vector<CyclicReductionVec>& x = work.x[l];
+        const Index m = (Index)cur.A.size();
+#ifdef _OPENMP
+        #pragma omp parallel for if (parallel && m > 128)
+#else
+        SOFA_UNUSED(parallel);
+#endif
+        for (typename helper::IndexOpenMP<Index>::type k=0; k<m; ++k)
+        {
+            if ((k & 1) == 0)
+            {
+                x[k] = xNext[k/2];
+                continue;
+            }
+            CyclicReductionVec v = rhs[k] - cur.B[k]*xNext[(k-1)/2];
+            if (k < m-1)
+                v -= cur.C[k]*xNext[(k+1)/2];
+            x[k] = cur.Ainv[k]*v;
+        }
+    }
+}
+
 ///
 ///                    [ inva0-l0(Minv10)     Minv10t          Minv20t      Minv30t ]
 /// Minv = Uinv Linv = [  (Minv11)(-l0t)  inva1-l1(Minv21)     Minv21t      Minv31t ]
@@ -325,6 +533,7 @@ template<class Matrix, class Vector>
 double BTDLinearSolver<Matrix,Vector>::getMinvElement(Index i, Index j)
 {
     const Index bsize = Matrix::getSubMatrixDim(f_blockSize.getValue());
+    factorizePostponedThomas();
     if (i < j)
     {
         // lower diagonal
@@ -343,6 +552,19 @@ void BTDLinearSolver<Matrix,Vector>::solve (Matrix& /*M*/, Vector& x, Vector& b)
     const Index nb = b.size() / bsize;
     if (nb == 0) return;
 
+    if (f_cyclicReduction.getValue() && !crLevels.empty() && (Index)crLevels[0].A.size() == nb)
+    {
+        initCyclicReductionWork(crWork);
+        for (Index i=0; i<nb; ++i)
+            crWork.rhs[0][i] = b.asub(i,bsize);
+        solveCyclicReduction(crWork, true);
+        for (Index i=0; i<nb; ++i)
+            x.asub(i,bsize) = crWork.x[0][i];
+
+        msg_info_when(this->f_verbose.getValue()) << "solve, solution = "<<x;
+        return;
+    }
+
     x.asub(0,bsize) = alpha_inv[0] * b.asub(0,bsize);
     for (Index i=1; i<nb; ++i)
     {
@@ -796,6 +1018,12 @@ template<class Matrix, class Vector>
 template<class RMatrix, class JMatrix>
 bool BTDLinearSolver<Matrix,Vector>::addJMInvJt(RMatrix& result, JMatrix& J, double fact)
 {
+    if (f_cyclicReduction.getValue() && !crLevels.empty() && !f_verbose.getValue())
+        return addJMInvJtCyclicReduction(result, J, fact);
+
+    // Minv is only sized once the postponed factorization is done
+    factorizePostponedThomas();
+
     //const Index Jrows = J.rowSize();
     const Index Jcols = J.colSize();
     if (Jcols != Minv.rowSize())
@@ -862,6 +1090,69 @@ bool BTDLinearSolver<Matrix,Vector>::addJMInvJt(RMatrix& result, JMatrix& J, dou
     return true;
 }
 
+template<class Matrix, class Vector>
+template<class RMatrix, class JMatrix>
+bool BTDLinearSolver<Matrix,Vector>::addJMInvJtCyclicReduction(RMatrix& result, JMatrix& J, double fact)
+{
+    const Index bsize = Matrix::getSubMatrixDim(f_blockSize.getValue());
+    const Index nb = (Index)crLevels[0].A.size();
+    if (J.colSize() != nb*bsize)
+    {
+        serr << "BTDLinearSolver::addJMInvJt ERROR: incompatible J matrix size." << sendl;
+        return false;
+    }
+
+    std::vector<typename JMatrix::LineConstIterator> lines;
+    for (typename JMatrix::LineConstIterator jit = J.begin(), jitend = J.end(); jit != jitend; ++jit)
+        lines.push_back(jit);
+    const Index nbLines = (Index)lines.size();
+
+    // M^-1 J^t, one independent solve per constraint row
+    helper::vector< helper::vector<CyclicReductionVec> > MinvJt(nbLines);
+#ifdef _OPENMP
+    #pragma omp parallel for
+#endif
+    for (typename helper::IndexOpenMP<Index>::type r=0; r<nbLines; ++r)
+    {
+        CyclicReductionWork work;
+        initCyclicReductionWork(work);
+        for (typename JMatrix::LElementConstIterator it = lines[r]->second.begin(), itend = lines[r]->second.end(); it != itend; ++it)
+            work.rhs[0][it->first / bsize][it->first % bsize] = (Real)it->second;
+        solveCyclicReduction(work, false);
+        MinvJt[r].swap(work.x[0]);
+    }
+
+    // upper triangle of J M^-1 J^t
+    helper::vector< helper::vector<double> > W(nbLines);
+#ifdef _OPENMP
+    #pragma omp parallel for
+#endif
+    for (typename helper::IndexOpenMP<Index>::type r1=0; r1<nbLines; ++r1)
+    {
+        W[r1].resize(nbLines-r1);
+        for (Index r2=r1; r2<nbLines; ++r2)
+        {
+            double acc = 0.0;
+            for (typename JMatrix::LElementConstIterator it = lines[r1]->second.begin(), itend = lines[r1]->second.end(); it != itend; ++it)
+                acc += it->second * MinvJt[r2][it->first / bsize][it->first % bsize];
+            W[r1][r2-r1] = acc * fact;
+        }
+    }
+
+    for (Index r1=0; r1<nbLines; ++r1)
+    {
+        const Index row1 = lines[r1]->first;
+        for (Index r2=r1; r2<nbLines; ++r2)
+        {
+            const Index row2 = lines[r2]->first;
+            result.add(row1,row2,W[r1][r2-r1]);
+            if (row1!=row2)
+                result.add(row2,row1,W[r1][r2-r1]);
+        }
+    }
+    return true;
+}
+
 #ifndef SOFA_FLOAT
 template<> const char* BTDMatrix<1,double>::Name() { return "BTDMatrix1d"; }
 template<> const char* BTDMatrix<2,double>::Name() { return "BTDMatrix2d"; }
@@ -0,0 +1,66 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2018 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#define SOFA_COMPONENT_LINEARSOLVER_MIXEDPRECISIONCGLINEARSOLVER_CPP
+#include <SofaGeneralLinearSolver/MixedPrecisionCGLinearSolver.inl>
+
+#include <sofa/core/ObjectFactory.h>
+
+namespace sofa
+{
+
+namespace component
+{
+
+namespace linearsolver
+{
+
+using namespace sofa::defaulttype;
+
+
+SOFA_DECL_CLASS(MixedPrecisionCGLinearSolver)
+
+int MixedPrecisionCGLinearSolverClass = core::RegisterObject("Conjugate gradient with single precision inner iterations and double precision iterative refinement")
+#ifndef SOFA_FLOAT
+        .add< MixedPrecisionCGLinearSolver< CompressedRowSparseMatrix<double>, FullVector<double> > >(true)
+        .add< MixedPrecisionCGLinearSolver< CompressedRowSparseMatrix<Mat<2,2,double> >, FullVector<double> > >()
+        .add< MixedPrecisionCGLinearSolver< CompressedRowSparseMatrix<Mat<3,3,double> >, FullVector<double> > >()
+        .add< MixedPrecisionCGLinearSolver< CompressedRowSparseMatrix<Mat<4,4,double> >, FullVector<double> > >()
+        .add< MixedPrecisionCGLinearSolver< CompressedRowSparseMatrix<Mat<6,6,double> >, FullVector<double> > >()
+        .add< MixedPrecisionCGLinearSolver< CompressedRowSparseMatrix<Mat<8,8,double> >, FullVector<double> > >()
+#endif
+        .addAlias("MixedPrecisionCGSolver")
+        ;
+
+#ifndef SOFA_FLOAT
+template class SOFA_GENERAL_LINEAR_SOLVER_API MixedPrecisionCGLinearSolver< CompressedRowSparseMatrix<double>, FullVector<double> >;
+template class SOFA_GENERAL_LINEAR_SOLVER_API MixedPrecisionCGLinearSolver< CompressedRowSparseMatrix<Mat<2,2,double> >, FullVector<double> >;
+template class SOFA_GENERAL_LINEAR_SOLVER_API MixedPrecisionCGLinearSolver< CompressedRowSparseMatrix<Mat<3,3,double> >, FullVector<double> >;
+template class SOFA_GENERAL_LINEAR_SOLVER_API MixedPrecisionCGLinearSolver< CompressedRowSparseMatrix<Mat<4,4,double> >, FullVector<double> >;
+template class SOFA_GENERAL_LINEAR_SOLVER_API MixedPrecisionCGLinearSolver< CompressedRowSparseMatrix<Mat<6,6,double> >, FullVector<double> >;
+template class SOFA_GENERAL_LINEAR_SOLVER_API MixedPrecisionCGLinearSolver< CompressedRowSparseMatrix<Mat<8,8,double> >, FullVector<double> >;
+#endif
+
+} // namespace linearsolver
+
+} // namespace component
+
+} // namespace sofa
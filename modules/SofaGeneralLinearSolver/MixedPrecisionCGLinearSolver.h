@@ -0,0 +1,132 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2018 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#ifndef SOFA_COMPONENT_LINEARSOLVER_MIXEDPRECISIONCGLINEARSOLVER_H
+#define SOFA_COMPONENT_LINEARSOLVER_MIXEDPRECISIONCGLINEARSOLVER_H
+#include "config.h"
+
+#include <SofaBaseLinearSolver/MatrixLinearSolver.h>
+#include <SofaBaseLinearSolver/CompressedRowSparseMatrix.h>
+#include <SofaBaseLinearSolver/FullVector.h>
+
+#include <sofa/helper/map.h>
+#include <sofa/helper/vector.h>
+
+#include <math.h>
+
+
+namespace sofa
+{
+
+namespace component
+{
+
+namespace linearsolver
+{
+
+/// Conjugate gradient solver with single precision inner iterations and
+/// double precision iterative refinement.
+///
+/// The assembled system is copied once per factorization into a scalar float
+/// CSR matrix. Each refinement step computes the true residual r = b - Ax
+/// with the double matrix, solves A d = r approximately with float CG
+/// (half the memory traffic per SpMV) and updates x += d in double, so the
+/// final accuracy is the one of the double precision solver.
+template<class TMatrix, class TVector>
+class MixedPrecisionCGLinearSolver : public sofa::component::linearsolver::MatrixLinearSolver<TMatrix, TVector>
+{
+public:
+    SOFA_CLASS(SOFA_TEMPLATE2(MixedPrecisionCGLinearSolver,TMatrix,TVector),SOFA_TEMPLATE2(sofa::component::linearsolver::MatrixLinearSolver,TMatrix,TVector));
+
+    typedef TMatrix Matrix;
+    typedef TVector Vector;
+    typedef sofa::component::linearsolver::MatrixLinearSolver<TMatrix,TVector> Inherit;
+
+    Data<unsigned> f_maxIter; ///< maximum number of float CG iterations per refinement step
+    Data<SReal> f_tolerance; ///< desired accuracy of the solution (ratio of the true residual norm over the norm of b)
+    Data<SReal> f_innerTolerance; ///< residual reduction asked to the float CG at each refinement step
+    Data<unsigned> f_maxRefinements; ///< maximum number of double precision refinement steps
+    Data<SReal> f_smallDenominatorThreshold; ///< minimum value of the denominator in the conjugate gradient solution
+    Data<bool> f_warmStart; ///< Use previous solution as initial solution
+    Data<bool> f_verbose; ///< Dump system state at each refinement step
+    Data<unsigned> f_nbRefinements; ///< output: number of refinement steps done by the last solve
+    Data<unsigned> f_nbIterations; ///< output: total number of float CG iterations done by the last solve
+    Data<std::map < std::string, sofa::helper::vector<SReal> > > f_graph; ///< Graph of true residuals at each refinement step
+
+protected:
+
+    MixedPrecisionCGLinearSolver();
+
+public:
+    void init() override;
+    void reinit() override;
+
+    void resetSystem() override;
+
+    /// Build the single precision copy of the system matrix
+    void invert(Matrix& M) override;
+
+    /// Solve Mx=b
+    void solve (Matrix& M, Vector& x, Vector& b) override;
+
+    MatrixInvertData * createInvertData() override
+    {
+        return new MixedPrecisionCGLinearSolverInvertData();
+    }
+
+protected:
+
+    /// Scalar float CSR copy of the system and work vectors of the inner solve
+    class MixedPrecisionCGLinearSolverInvertData : public MatrixInvertData
+    {
+    public :
+        int size;
+        helper::vector<int> rowBegin;
+        helper::vector<int> colsIndex;
+        helper::vector<float> colsValue;
+        helper::vector<float> r, d, p, q;
+    };
+
+    /// q = A p with the float matrix
+    void mulFloat(const MixedPrecisionCGLinearSolverInvertData* data, const helper::vector<float>& p, helper::vector<float>& q) const;
+
+    /// Approximately solve A d = r in single precision, returns the number of iterations
+    unsigned solveFloat(MixedPrecisionCGLinearSolverInvertData* data, double innerTolerance);
+};
+
+#if defined(SOFA_EXTERN_TEMPLATE) && !defined(SOFA_COMPONENT_LINEARSOLVER_MIXEDPRECISIONCGLINEARSOLVER_CPP)
+#ifndef SOFA_FLOAT
+extern template class SOFA_GENERAL_LINEAR_SOLVER_API MixedPrecisionCGLinearSolver< CompressedRowSparseMatrix<double>, FullVector<double> >;
+extern template class SOFA_GENERAL_LINEAR_SOLVER_API MixedPrecisionCGLinearSolver< CompressedRowSparseMatrix<defaulttype::Mat<2,2,double> >, FullVector<double> >;
+extern template class SOFA_GENERAL_LINEAR_SOLVER_API MixedPrecisionCGLinearSolver< CompressedRowSparseMatrix<defaulttype::Mat<3,3,double> >, FullVector<double> >;
+extern template class SOFA_GENERAL_LINEAR_SOLVER_API MixedPrecisionCGLinearSolver< CompressedRowSparseMatrix<defaulttype::Mat<4,4,double> >, FullVector<double> >;
+extern template class SOFA_GENERAL_LINEAR_SOLVER_API MixedPrecisionCGLinearSolver< CompressedRowSparseMatrix<defaulttype::Mat<6,6,double> >, FullVector<double> >;
+extern template class SOFA_GENERAL_LINEAR_SOLVER_API MixedPrecisionCGLinearSolver< CompressedRowSparseMatrix<defaulttype::Mat<8,8,double> >, FullVector<double> >;
+#endif
+#endif
+
+} // namespace linearsolver
+
+} // namespace component
+
+} // namespace sofa
+
+#endif
@@ -0,0 +1,310 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2018 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#ifndef SOFA_COMPONENT_LINEARSOLVER_MIXEDPRECISIONCGLINEARSOLVER_INL
+#define SOFA_COMPONENT_LINEARSOLVER_MIXEDPRECISIONCGLINEARSOLVER_INL
+
+#include <SofaGeneralLinearSolver/MixedPrecisionCGLinearSolver.h>
+#include <sofa/helper/AdvancedTimer.h>
+
+#include <iostream>
+
+namespace sofa
+{
+
+namespace component
+{
+
+namespace linearsolver
+{
+
+template<class TMatrix, class TVector>
+MixedPrecisionCGLinearSolver<TMatrix,TVector>::MixedPrecisionCGLinearSolver()
+    : f_maxIter( initData(&f_maxIter,(unsigned)25,"iterations","Maximum number of single precision CG iterations per refinement step") )
+    , f_tolerance( initData(&f_tolerance,(SReal)1e-5,"tolerance","Desired accuracy of the solution (ratio of the true residual norm over the norm of b)") )
+    , f_innerTolerance( initData(&f_innerTolerance,(SReal)1e-3,"innerTolerance","Residual reduction asked to the single precision CG at each refinement step") )
+    , f_maxRefinements( initData(&f_maxRefinements,(unsigned)10,"refinements","Maximum number of double precision refinement steps") )
+    , f_smallDenominatorThreshold( initData(&f_smallDenominatorThreshold,(SReal)1e-12,"threshold","Minimum value of the denominator in the single precision CG, relative to the squared residual norm") )
+    , f_warmStart( initData(&f_warmStart,false,"warmStart","Use previous solution as initial solution") )
+    , f_verbose( initData(&f_verbose,false,"verbose","Dump system state at each refinement step") )
+    , f_nbRefinements( initData(&f_nbRefinements,(unsigned)0,"nbRefinements","Output: number of refinement steps done by the last solve") )
+    , f_nbIterations( initData(&f_nbIterations,(unsigned)0,"nbIterations","Output: total number of single precision CG iterations done by the last solve") )
+    , f_graph( initData(&f_graph,"graph","Graph of true residuals at each refinement step") )
+{
+    f_graph.setWidget("graph");
+    f_nbRefinements.setReadOnly(true);
+    f_nbIterations.setReadOnly(true);
+
+    f_maxIter.setRequired(true);
+    f_tolerance.setRequired(true);
+}
+
+template<class TMatrix, class TVector>
+void MixedPrecisionCGLinearSolver<TMatrix,TVector>::init()
+{
+    if(f_verbose.getValue())
+    {
+        this->f_printLog.setValue(true);
+    }
+
+    if(f_tolerance.getValue() < 0.0)
+    {
+        msg_warning() << "'tolerance' must be a positive value" << msgendl
+                      << "default value used: 1e-5";
+        f_tolerance.setValue(1e-5);
+    }
+    if(f_innerTolerance.getValue() <= 0.0 || f_innerTolerance.getValue() >= 1.0)
+    {
+        msg_warning() << "'innerTolerance' must be in ]0,1[" << msgendl
+                      << "default value used: 1e-3";
+        f_innerTolerance.setValue(1e-3);
+    }
+}
+
+template<class TMatrix, class TVector>
+void MixedPrecisionCGLinearSolver<TMatrix,TVector>::reinit()
+{
+    if(f_verbose.getValue())
+    {
+        this->f_printLog.setValue(true);
+    }
+}
+
+template<class TMatrix, class TVector>
+void MixedPrecisionCGLinearSolver<TMatrix,TVector>::resetSystem()
+{
+    f_graph.beginEdit()->clear();
+    f_graph.endEdit();
+
+    Inherit::resetSystem();
+}
+
+template<class TMatrix, class TVector>
+void MixedPrecisionCGLinearSolver<TMatrix,TVector>::invert(Matrix& M)
+{
+    typedef typename Matrix::traits traits;
+    enum { NL = Matrix::NL, NC = Matrix::NC };
+
+    MixedPrecisionCGLinearSolverInvertData * data = (MixedPrecisionCGLinearSolverInvertData *) this->getMatrixInvertData(&M);
+
+    sofa::helper::AdvancedTimer::stepBegin("MixedPrecisionCG-convert");
+
+    M.compress();
+    const int n = M.rowSize();
+    const typename Matrix::VecIndex& rowIndex = M.getRowIndex();
+    const typename Matrix::VecIndex& rowBegin = M.getRowBegin();
+    const typename Matrix::VecIndex& colsIndex = M.getColsIndex();
+    const typename Matrix::VecBloc& colsValue = M.getColsValue();
+
+    // expand the blocs of the double matrix into scalar float rows
+    data->size = n;
+    data->rowBegin.assign(n+1, 0);
+    for (unsigned xi=0; xi<rowIndex.size(); ++xi)
+    {
+        const int nbCols = (rowBegin[xi+1] - rowBegin[xi]) * NC;
+        for (int l=0; l<NL; ++l)
+            data->rowBegin[rowIndex[xi]*NL+l+1] = nbCols;
+    }
+    for (int i=0; i<n; ++i)
+        data->rowBegin[i+1] += data->rowBegin[i];
+
+    data->colsIndex.resize(data->rowBegin[n]);
+    data->colsValue.resize(data->rowBegin[n]);
+    for (unsigned xi=0; xi<rowIndex.size(); ++xi)
+    {
+        for (int l=0; l<NL; ++l)
+        {
+            int pos = data->rowBegin[rowIndex[xi]*NL+l];
+            for (int k=rowBegin[xi]; k<rowBegin[xi+1]; ++k)
+                for (int c=0; c<NC; ++c, ++pos)
+                {
+                    data->colsIndex[pos] = colsIndex[k]*NC+c;
+                    data->colsValue[pos] = (float)traits::v(colsValue[k],l,c);
+                }
+        }
+    }
+
+    data->r.resize(n);
+    data->d.resize(n);
+    data->p.resize(n);
+    data->q.resize(n);
+
+    sofa::helper::AdvancedTimer::stepEnd("MixedPrecisionCG-convert");
+}
+
+template<class TMatrix, class TVector>
+void MixedPrecisionCGLinearSolver<TMatrix,TVector>::mulFloat(const MixedPrecisionCGLinearSolverInvertData* data, const helper::vector<float>& p, helper::vector<float>& q) const
+{
+    for (int i=0; i<data->size; ++i)
+    {
+        float s = 0.0f;
+        for (int k=data->rowBegin[i]; k<data->rowBegin[i+1]; ++k)
+            s += data->colsValue[k] * p[data->colsIndex[k]];
+        q[i] = s;
+    }
+}
+
+template<class TMatrix, class TVector>
+unsigned MixedPrecisionCGLinearSolver<TMatrix,TVector>::solveFloat(MixedPrecisionCGLinearSolverInvertData* data, double innerTolerance)
+{
+    const int n = data->size;
+    helper::vector<float>& r = data->r;
+    helper::vector<float>& d = data->d;
+    helper::vector<float>& p = data->p;
+    helper::vector<float>& q = data->q;
+
+    // reductions are accumulated in double, they do not add memory traffic
+    double rho = 0.0;
+    for (int i=0; i<n; ++i)
+    {
+        d[i] = 0.0f;
+        p[i] = r[i];
+        rho += (double)r[i]*r[i];
+    }
+    const double rho0 = rho;
+    const double stopRho = innerTolerance*innerTolerance*rho0;
+    const double threshold = f_smallDenominatorThreshold.getValue()*rho0;
+
+    unsigned nb_iter = 0;
+    while (nb_iter < f_maxIter.getValue() && rho > stopRho)
+    {
+        mulFloat(data, p, q);
+        double den = 0.0;
+        for (int i=0; i<n; ++i)
+            den += (double)p[i]*q[i];
+        if (fabs(den) <= threshold)
+            break;
+        ++nb_iter;
+
+        const float alpha = (float)(rho/den);
+        double rho_1 = 0.0;
+        for (int i=0; i<n; ++i)
+        {
+            d[i] += alpha*p[i];
+            r[i] -= alpha*q[i];
+            rho_1 += (double)r[i]*r[i];
+        }
+        const float beta = (float)(rho_1/rho);
+        for (int i=0; i<n; ++i)
+            p[i] = r[i] + beta*p[i];
+        rho = rho_1;
+    }
+    return nb_iter;
+}
+
+/// Solve Mx=b
+template<class TMatrix, class TVector>
+void MixedPrecisionCGLinearSolver<TMatrix,TVector>::solve(Matrix& M, Vector& x, Vector& b)
+{
+    MixedPrecisionCGLinearSolverInvertData * data = (MixedPrecisionCGLinearSolverInvertData *) this->getMatrixInvertData(&M);
+    const int n = data->size;
+    const bool verbose = f_verbose.getValue();
+
+    std::map < std::string, sofa::helper::vector<SReal> >& graph = *f_graph.beginEdit();
+    sofa::helper::vector<SReal>& graph_error = graph[(this->isMultiGroup()) ? this->currentNode->getName()+std::string("-Error") : std::string("Error")];
+    graph_error.clear();
+
+    typename Inherit::TempVectorContainer vtmp(this, core::ExecParams::defaultInstance(), M, x, b);
+    Vector& r = *vtmp.createTempVector();
+
+    /// Compute the initial residual r
+    if( f_warmStart.getValue() )
+    {
+        r = M * x;
+        r.eq( b, r, -1.0 );   // initial residual r = b - Ax;
+    }
+    else
+    {
+        x.clear();
+        r = b;
+    }
+
+    const double normb = b.norm();
+    unsigned nbRefinements = 0;
+    unsigned nbIterations = 0;
+    const char* endcond = "refinements";
+
+    double err = (normb > 0.0) ? r.norm()/normb : 0.0;
+    graph_error.push_back(err);
+
+    while (err > f_tolerance.getValue())
+    {
+        if (nbRefinements >= f_maxRefinements.getValue())
+            break;
+
+        // inner solve on the normalized residual, so that float keeps its full range
+        const double normr = r.norm();
+        const double invNormr = 1.0/normr;
+        for (int i=0; i<n; ++i)
+            data->r[i] = (float)(r[i]*invNormr);
+
+        const unsigned nb_iter = solveFloat(data, f_innerTolerance.getValue());
+        nbIterations += nb_iter;
+        if (nb_iter == 0)
+        {
+            endcond = "threshold";
+            break;
+        }
+
+        for (int i=0; i<n; ++i)
+            x[i] += data->d[i]*normr;
+        ++nbRefinements;
+
+        /// True residual in double precision
+        r = M * x;
+        r.eq( b, r, -1.0 );
+
+        const double prevErr = err;
+        err = r.norm()/normb;
+        graph_error.push_back(err);
+
+        msg_info_when(verbose) << "refinement " << nbRefinements << ": " << nb_iter << " iterations, error = " << err;
+
+        if (err >= prevErr)
+        {
+            msg_warning() << "iterative refinement stagnates at error " << err << ", the single precision matrix may be too ill-conditioned";
+            endcond = "stagnation";
+            break;
+        }
+    }
+    if (err <= f_tolerance.getValue())
+        endcond = "tolerance";
+
+    f_graph.endEdit();
+    f_nbRefinements.setValue(nbRefinements);
+    f_nbIterations.setValue(nbIterations);
+
+    sofa::helper::AdvancedTimer::valSet("MixedPrecisionCG refinements", nbRefinements);
+    sofa::helper::AdvancedTimer::valSet("MixedPrecisionCG iterations", nbIterations);
+
+    dmsg_info() << "solve, nbRefinements = " << nbRefinements << " nbIterations = " << nbIterations << " stop because of " << endcond;
+    dmsg_info_when( verbose ) << "solve, solution = " << x;
+
+    vtmp.deleteTempVector(&r);
+}
+
+} // namespace linearsolver
+
+} // namespace component
+
+} // namespace sofa
+
+#endif // SOFA_COMPONENT_LINEARSOLVER_MIXEDPRECISIONCGLINEARSOLVER_INL
@@ -0,0 +1,108 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2018 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#include <SofaGeneralLinearSolver/BTDLinearSolver.h>
+using sofa::component::linearsolver::BTDLinearSolver ;
+using sofa::component::linearsolver::BTDMatrix ;
+using sofa::component::linearsolver::BlockVector ;
+
+#include <SofaTest/Sofa_test.h>
+
+#include <cstdlib>
+
+namespace
+{
+
+typedef BTDMatrix<6,double> Matrix ;
+typedef BlockVector<6,double> Vector ;
+typedef BTDLinearSolver<Matrix,Vector> Solver ;
+
+class BTDLinearSolver_test : public sofa::Sofa_test<>
+{
+public:
+    /// A random diagonally dominant block-tridiagonal system, large enough for the
+    /// first reduction levels to go through the parallel loops
+    void fillRandomSystem(Matrix& M, Vector& b, int nbBlocks)
+    {
+        std::srand(42) ;
+        const int n = 6*nbBlocks ;
+        M.resize(n,n) ;
+        b.resize(n) ;
+        for (int bi=0; bi<nbBlocks; ++bi)
+        {
+            for (int bj=bi-1; bj<=bi+1; ++bj)
+            {
+                if (bj < 0 || bj >= nbBlocks) continue ;
+                Matrix::Bloc& bloc = M.bloc(bi,bj) ;
+                for (int i=0; i<6; ++i)
+                    for (int j=0; j<6; ++j)
+                        bloc[i][j] = (double)std::rand()/RAND_MAX - 0.5 ;
+                if (bi == bj)
+                    for (int i=0; i<6; ++i)
+                        bloc[i][i] += 20.0 ;
+            }
+            for (int i=0; i<6; ++i)
+                b[6*bi+i] = (double)std::rand()/RAND_MAX - 0.5 ;
+        }
+    }
+
+    void solveWith(bool cyclicReduction, Matrix& M, Vector& b, Vector& x)
+    {
+        Solver::SPtr solver = sofa::core::objectmodel::New<Solver>() ;
+        solver->f_cyclicReduction.setValue(cyclicReduction) ;
+        solver->invert(M) ;
+        x.resize(b.size()) ;
+        solver->solve(M, x, b) ;
+    }
+
+    void checkCyclicReductionMatchesThomas(int nbBlocks)
+    {
+        Matrix M ;
+        Vector b ;
+        fillRandomSystem(M, b, nbBlocks) ;
+
+        Vector xThomas, xCR ;
+        solveWith(false, M, b, xThomas) ;
+        solveWith(true, M, b, xCR) ;
+
+        for (int i=0; i<b.size(); ++i)
+            EXPECT_NEAR(xThomas[i], xCR[i], 1e-10) << "nbBlocks=" << nbBlocks << " i=" << i ;
+
+        // residual of the cyclic reduction solution
+        for (int bi=0; bi<nbBlocks; ++bi)
+        {
+            Vector::Bloc r = b.asub(bi,6) ;
+            for (int bj=std::max(bi-1,0); bj<=std::min(bi+1,nbBlocks-1); ++bj)
+                r -= M.bloc(bi,bj) * xCR.asub(bj,6) ;
+            EXPECT_LT(r.norm(), 1e-10) << "nbBlocks=" << nbBlocks << " block " << bi ;
+        }
+    }
+};
+
+TEST_F(BTDLinearSolver_test, cyclicReductionMatchesThomas)
+{
+    checkCyclicReductionMatchesThomas(1) ;
+    checkCyclicReductionMatchesThomas(2) ;
+    checkCyclicReductionMatchesThomas(7) ;
+    checkCyclicReductionMatchesThomas(300) ;
+}
+
+}
@@ -0,0 +1,154 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2018 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#include <SofaGeneralLinearSolver/MixedPrecisionCGLinearSolver.h>
+using sofa::component::linearsolver::MixedPrecisionCGLinearSolver ;
+using sofa::component::linearsolver::CompressedRowSparseMatrix ;
+using sofa::component::linearsolver::FullVector ;
+
+#include <SofaBaseMechanics/MechanicalObject.h>
+typedef sofa::component::container::MechanicalObject<sofa::defaulttype::Vec3Types> MechanicalObject3 ;
+
+#include <SofaSimulationGraph/DAGSimulation.h>
+using sofa::simulation::Node ;
+
+#include <SofaSimulationCommon/SceneLoaderXML.h>
+using sofa::simulation::SceneLoaderXML ;
+using sofa::core::ExecParams ;
+
+#include <SofaTest/Sofa_test.h>
+
+namespace
+{
+
+typedef MixedPrecisionCGLinearSolver< CompressedRowSparseMatrix<double>, FullVector<double> > MixedPrecisionCG ;
+
+/// The same spring grid falling under gravity, solved by the mixed precision CG and by the double precision CG
+std::string systemNode(const std::string& name, const std::string& solver)
+{
+    return
+            "   <Node name='" + name + "'>                                                          \n"
+            "       <EulerImplicitSolver rayleighStiffness='0' rayleighMass='0'/>                     \n"
+            "       " + solver + "                                                                   \n"
+            "       <RegularGridTopology n='4 4 4' min='0 0 0' max='3 3 3'/>                          \n"
+            "       <MechanicalObject name='dofs'/>                                                  \n"
+            "       <UniformMass totalMass='1'/>                                                     \n"
+            "       <MeshSpringForceField linesStiffness='100'/>                                     \n"
+            "       <FixedConstraint indices='0 1 2 3'/>                                             \n"
+            "   </Node>                                                                              \n" ;
+}
+
+class MixedPrecisionCGLinearSolver_test : public sofa::Sofa_test<>
+{
+public:
+    Node::SPtr root ;
+
+    void TearDown()
+    {
+        if (root)
+            sofa::simulation::getSimulation()->unload(root) ;
+    }
+
+    void checkSameSolutionAsDoubleCG()
+    {
+        EXPECT_MSG_NOEMIT(Error) ;
+        std::stringstream scene ;
+        scene << "<?xml version='1.0'?>                                                           \n"
+                 "<Node name='Root' gravity='0 -9.81 0' dt='0.01'>                                \n"
+                 "   <DefaultAnimationLoop/>                                                      \n"
+              << systemNode("mixed", "<MixedPrecisionCGLinearSolver name='solver' iterations='25' tolerance='1e-10' innerTolerance='1e-3' refinements='50'/>")
+              << systemNode("double", "<CGLinearSolver template='CompressedRowSparseMatrixd' iterations='1000' tolerance='1e-20' threshold='1e-30'/>")
+              << "</Node>                                                                         \n" ;
+
+        root = SceneLoaderXML::loadFromMemory("testscene", scene.str().c_str(), scene.str().size()) ;
+        ASSERT_NE(root.get(), nullptr) ;
+        root->init(ExecParams::defaultInstance()) ;
+        sofa::simulation::getSimulation()->animate(root.get(), 0.01) ;
+
+        MixedPrecisionCG* solver = NULL ;
+        root->getChild("mixed")->get(solver) ;
+        ASSERT_NE(solver, nullptr) ;
+
+        // the true residual computed in double precision reached the tolerance
+        EXPECT_GT(solver->f_nbRefinements.getValue(), 0u) ;
+        EXPECT_LE(solver->f_nbRefinements.getValue(), 50u) ;
+        const sofa::helper::vector<SReal>& error = solver->f_graph.getValue().at("Error") ;
+        ASSERT_FALSE(error.empty()) ;
+        EXPECT_LE(error.back(), 1e-10) ;
+
+        MechanicalObject3* mixedDofs = NULL ;
+        MechanicalObject3* doubleDofs = NULL ;
+        root->getChild("mixed")->get(mixedDofs) ;
+        root->getChild("double")->get(doubleDofs) ;
+        ASSERT_NE(mixedDofs, nullptr) ;
+        ASSERT_NE(doubleDofs, nullptr) ;
+
+        const MechanicalObject3::VecCoord& x = mixedDofs->read(sofa::core::ConstVecCoordId::position())->getValue() ;
+        const MechanicalObject3::VecCoord& xref = doubleDofs->read(sofa::core::ConstVecCoordId::position())->getValue() ;
+        const MechanicalObject3::VecCoord& x0 = doubleDofs->read(sofa::core::ConstVecCoordId::restPosition())->getValue() ;
+        ASSERT_EQ(x.size(), xref.size()) ;
+        double displacement = 0.0 ;
+        for (unsigned i=0; i<x.size(); ++i)
+        {
+            displacement = std::max(displacement, (xref[i]-x0[i]).norm()) ;
+            for (unsigned c=0; c<3; ++c)
+                EXPECT_NEAR(x[i][c], xref[i][c], 1e-8) << "position of vertex " << i ;
+        }
+        EXPECT_GT(displacement, 1e-5) ;
+    }
+
+    void checkGraphScatteredFallback()
+    {
+        // there is no stored matrix to convert in a matrix-free system, the default assembled template is used instead
+        EXPECT_MSG_EMIT(Warning) ;
+        std::stringstream scene ;
+        scene << "<?xml version='1.0'?>                                                           \n"
+                 "<Node name='Root' gravity='0 -9.81 0' dt='0.01'>                                \n"
+                 "   <DefaultAnimationLoop/>                                                      \n"
+              << systemNode("mixed", "<MixedPrecisionCGLinearSolver name='solver' template='GraphScattered' tolerance='1e-10' refinements='50'/>")
+              << "</Node>                                                                         \n" ;
+
+        root = SceneLoaderXML::loadFromMemory("testscene", scene.str().c_str(), scene.str().size()) ;
+        ASSERT_NE(root.get(), nullptr) ;
+        root->init(ExecParams::defaultInstance()) ;
+
+        MixedPrecisionCG* solver = NULL ;
+        root->getChild("mixed")->get(solver) ;
+        ASSERT_NE(solver, nullptr) ;
+        EXPECT_EQ(solver->getTemplateName(), MixedPrecisionCG::templateName()) ;
+
+        sofa::simulation::getSimulation()->animate(root.get(), 0.01) ;
+        EXPECT_GT(solver->f_nbRefinements.getValue(), 0u) ;
+        EXPECT_LE(solver->f_graph.getValue().at("Error").back(), 1e-10) ;
+    }
+};
+
+TEST_F(MixedPrecisionCGLinearSolver_test, sameSolutionAsDoubleCG)
+{
+    checkSameSolutionAsDoubleCG() ;
+}
+
+TEST_F(MixedPrecisionCGLinearSolver_test, graphScatteredFallback)
+{
+    checkGraphScatteredFallback() ;
+}
+
+}
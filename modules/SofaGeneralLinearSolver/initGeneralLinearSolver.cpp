@@ -40,6 +40,7 @@ void initGeneralLinearSolver()
 }
 
 SOFA_LINK_CLASS(MinResLinearSolver)
+SOFA_LINK_CLASS(MixedPrecisionCGLinearSolver)
 SOFA_LINK_CLASS(CholeskySolver)
 SOFA_LINK_CLASS(BTDLinearSolver)
 
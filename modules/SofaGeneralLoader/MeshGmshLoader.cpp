@@ -22,8 +22,14 @@
 #include <sofa/core/ObjectFactory.h>
 #include <SofaGeneralLoader/MeshGmshLoader.h>
 #include <sofa/core/visual/VisualParams.h>
+#include <sofa/helper/io/MemoryMappedFile.h>
+#include <sofa/helper/io/FastTextParser.h>
+#include <sofa/helper/system/thread/CTime.h>
 #include <iostream>
 #include <fstream>
+#include <cstring>
+#include <algorithm>
+#include <map>
 
 namespace sofa
 {
@@ -68,7 +74,39 @@ bool MeshGmshLoader::load()
     {
         gmshFormat = 2;
         string line;
-        std::getline(file, line); // we don't care about this line (2 0 8)
+        std::getline(file, line); // version file-type data-size (2 0 8)
+        std::istringstream formatReader(line);
+        double versionNumber = 0;
+        int fileType = 0, dataSize = 8;
+        formatReader >> versionNumber >> fileType >> dataSize;
+        if (versionNumber >= 4)
+        {
+            file.close();
+            if (versionNumber < 4.1)
+            {
+                serr << "Error: MeshGmshLoader: Gmsh " << versionNumber << " files are not supported, save the mesh in version 4.1 or 2." << sendl;
+                return false;
+            }
+            const helper::system::thread::ctime_t start = helper::system::thread::CTime::getRefTime();
+            helper::io::MemoryMappedFile mapped(filename);
+            if (!mapped.isOpen())
+            {
+                serr << "Cannot read file '" << m_filename << "'." << sendl;
+                return false;
+            }
+            fileRead = readGmsh4(mapped.data(), mapped.data() + mapped.size(), fileType == 1, dataSize);
+            const double seconds = (double)(helper::system::thread::CTime::getRefTime() - start)
+                    / (double)helper::system::thread::CTime::getRefTicksPerSec();
+            sout << "Read " << mapped.size() << " bytes in " << seconds << " s ("
+                 << (seconds > 0 ? (double)mapped.size() / seconds / 1e6 : 0.0) << " MB/s)" << sendl;
+            return fileRead;
+        }
+        if (fileType != 0)
+        {
+            serr << "Error: MeshGmshLoader: binary Gmsh " << versionNumber << " files are not supported, save the mesh in binary version 4.1 or in ascii." << sendl;
+            file.close();
+            return false;
+        }
         std::getline(file, cmd); // end Version
         std::istringstream endMeshReader(cmd);
         string endMesh;
@@ -188,18 +226,9 @@ bool MeshGmshLoader::readGmsh(std::ifstream &file, const unsigned int gmshFormat
 
     file >> nelems; //Loading number of Element
 
-    helper::vector<Edge>& my_edges = *(d_edges.beginEdit());
-    helper::vector<Triangle>& my_triangles = *(d_triangles.beginEdit());
-    helper::vector<Quad>& my_quads = *(d_quads.beginEdit());
-    helper::vector<Tetrahedron>& my_tetrahedra = *(d_tetrahedra.beginEdit());
-    helper::vector<Hexahedron>& my_hexahedra = *(d_hexahedra.beginEdit());
-
-    helper::vector<HighOrderEdgePosition >& my_highOrderEdgePositions = *(d_highOrderEdgePositions.beginEdit());
-
-    helper::vector< sofa::core::loader::PrimitiveGroup>& my_edgesGroups = *(d_edgesGroups.beginEdit());
-    helper::vector< sofa::core::loader::PrimitiveGroup>& my_trianglesGroups = *(d_trianglesGroups.beginEdit());
-    helper::vector< sofa::core::loader::PrimitiveGroup>& my_tetrahedraGroups = *(d_tetrahedraGroups.beginEdit());
-    helper::vector< sofa::core::loader::PrimitiveGroup>& my_hexahedraGroups = *(d_hexahedraGroups.beginEdit());
+    {
+    ElementArrays arrays(this);
+    helper::vector <unsigned int> nodes;
 
     for (unsigned int i=0; i<nelems; ++i) // for each elem
     {
@@ -259,12 +288,7 @@ bool MeshGmshLoader::readGmsh(std::ifstream &file, const unsigned int gmshFormat
         }
         //store real index of node and not line index
 
-        helper::vector <unsigned int> nodes;
         nodes.resize (nnodes);
-        const unsigned int edgesInQuadraticTriangle[3][2] = {{0,1}, {1,2}, {2,0}};
-        const unsigned int edgesInQuadraticTetrahedron[6][2] = {{0,1}, {1,2}, {0,2},{0,3},{2,3},{1,3}};
-        std::set<Edge> edgeSet;
-        size_t j;
         for (int n=0; n<nnodes; ++n)
         {
             int t = 0;
@@ -273,116 +297,30 @@ bool MeshGmshLoader::readGmsh(std::ifstream &file, const unsigned int gmshFormat
             //sout << "nodes[" << n << "] = " << nodes[n] << sendl;
         }
 
-        switch (etype)
+        if (addElement(etype, nodes, tag, arrays))
         {
-        case 1: // Line
-            addInGroup(my_edgesGroups,tag,my_edges.size());
-            addEdge(&my_edges, Edge(nodes[0], nodes[1]));
-            ++nlines;
-            break;
-        case 2: // Triangle
-            addInGroup(my_trianglesGroups,tag,my_triangles.size());
-            addTriangle(&my_triangles, Triangle(nodes[0], nodes[1], nodes[2]));
-            ++ntris;
-            break;
-        case 3: // Quad
-            addQuad(&my_quads, Quad(nodes[0], nodes[1], nodes[2], nodes[3]));
-            ++nquads;
-            break;
-        case 4: // Tetra
-            addInGroup(my_tetrahedraGroups,tag,my_tetrahedra.size());
-            addTetrahedron(&my_tetrahedra, Tetrahedron(nodes[0], nodes[1], nodes[2], nodes[3]));
-            ++ntetrahedra;
-            break;
-        case 5: // Hexa
-            addInGroup(my_hexahedraGroups,tag,my_hexahedra.size());
-            addHexahedron(&my_hexahedra,Hexahedron(nodes[0], nodes[1], nodes[2], nodes[3],nodes[4],nodes[5],nodes[6],nodes[7]));
-            ++ncubes;
-            break;
-        case 8: // quadratic edge
-            addInGroup(my_edgesGroups,tag,my_edges.size());
-            addEdge(&my_edges, Edge(nodes[0], nodes[1]));
-            {
-                HighOrderEdgePosition hoep;
-                hoep[0]= nodes[2];
-                hoep[1]=my_edges.size()-1;
-                hoep[2]=1;
-                hoep[3]=1;
-                my_highOrderEdgePositions.push_back(hoep);
-            }
-            ++nlines;
-            break;
-        case 9: // quadratic triangle
-            addInGroup(my_trianglesGroups,tag,my_triangles.size());
-            addTriangle(&my_triangles, Triangle(nodes[0], nodes[1], nodes[2]));
-            {
-                HighOrderEdgePosition hoep;
-                for(j=0;j<3;++j) {
-                    size_t v0=std::min( nodes[edgesInQuadraticTriangle[j][0]],
-                        nodes[edgesInQuadraticTriangle[j][1]]);
-                    size_t v1=std::max( nodes[edgesInQuadraticTriangle[j][0]],
-                        nodes[edgesInQuadraticTriangle[j][1]]);
-                    Edge e(v0,v1);
-                    if (edgeSet.find(e)==edgeSet.end()) {
-                        edgeSet.insert(e);
-                        addEdge(&my_edges, v0, v1);
-                        hoep[0]= nodes[j+3];
-                        hoep[1]=my_edges.size()-1;
-                        hoep[2]=1;
-                        hoep[3]=1;
-                        my_highOrderEdgePositions.push_back(hoep);
-                    }
-                }
-            }
-            ++ntris;
-            break;
-        case 11: // quadratic tetrahedron
-            addInGroup(my_tetrahedraGroups,tag,my_tetrahedra.size());
-            addTetrahedron(&my_tetrahedra, Tetrahedron(nodes[0], nodes[1], nodes[2], nodes[3]));
+            switch (etype)
             {
-                HighOrderEdgePosition hoep;
-                for(j=0;j<6;++j) {
-                    size_t v0=std::min( nodes[edgesInQuadraticTetrahedron[j][0]],
-                        nodes[edgesInQuadraticTetrahedron[j][1]]);
-                    size_t v1=std::max( nodes[edgesInQuadraticTetrahedron[j][0]],
-                        nodes[edgesInQuadraticTetrahedron[j][1]]);
-                    Edge e(v0,v1);
-                    if (edgeSet.find(e)==edgeSet.end()) {
-                        edgeSet.insert(e);
-                        addEdge(&my_edges, v0, v1);
-                        hoep[0]= nodes[j+4];
-                        hoep[1]=my_edges.size()-1;
-                        hoep[2]=1;
-                        hoep[3]=1;
-                        my_highOrderEdgePositions.push_back(hoep);
-                    }
-                }
+            case 1: case 8: ++nlines; break;
+            case 2: case 9: ++ntris; break;
+            case 3: ++nquads; break;
+            case 4: case 11: ++ntetrahedra; break;
+            case 5: ++ncubes; break;
             }
-            ++ntetrahedra;
-            break;
-        default:
+        }
+        else
+        {
             //if the type is not handled, skip rest of the line
             string tmp;
             std::getline(file, tmp);
         }
     }
 
-    normalizeGroup(my_edgesGroups);
-    normalizeGroup(my_trianglesGroups);
-    normalizeGroup(my_tetrahedraGroups);
-    normalizeGroup(my_hexahedraGroups);
-
-    d_edgesGroups.endEdit();
-    d_trianglesGroups.endEdit();
-    d_tetrahedraGroups.endEdit();
-    d_hexahedraGroups.endEdit();
-
-    d_edges.endEdit();
-    d_triangles.endEdit();
-    d_quads.endEdit();
-    d_tetrahedra.endEdit();
-    d_hexahedra.endEdit();
-    d_highOrderEdgePositions.endEdit();
+    normalizeGroup(arrays.edgesGroups.wref());
+    normalizeGroup(arrays.trianglesGroups.wref());
+    normalizeGroup(arrays.tetrahedraGroups.wref());
+    normalizeGroup(arrays.hexahedraGroups.wref());
+    }
 
     file >> cmd;
     if (cmd != "$ENDELM" && cmd!="$EndElements")
@@ -406,6 +344,416 @@ bool MeshGmshLoader::readGmsh(std::ifstream &file, const unsigned int gmshFormat
 }
 
 
+MeshGmshLoader::ElementArrays::ElementArrays(MeshGmshLoader* loader)
+    : edges(loader->d_edges)
+    , triangles(loader->d_triangles)
+    , quads(loader->d_quads)
+    , tetrahedra(loader->d_tetrahedra)
+    , hexahedra(loader->d_hexahedra)
+    , highOrderEdgePositions(loader->d_highOrderEdgePositions)
+    , edgesGroups(loader->d_edgesGroups)
+    , trianglesGroups(loader->d_trianglesGroups)
+    , tetrahedraGroups(loader->d_tetrahedraGroups)
+    , hexahedraGroups(loader->d_hexahedraGroups)
+{
+}
+
+bool MeshGmshLoader::addElement(int etype, const helper::vector<unsigned int>& nodes, int tag, ElementArrays& arrays)
+{
+    helper::vector<Edge>& my_edges = arrays.edges.wref();
+    helper::vector<Triangle>& my_triangles = arrays.triangles.wref();
+    helper::vector<Quad>& my_quads = arrays.quads.wref();
+    helper::vector<Tetrahedron>& my_tetrahedra = arrays.tetrahedra.wref();
+    helper::vector<Hexahedron>& my_hexahedra = arrays.hexahedra.wref();
+    helper::vector<HighOrderEdgePosition >& my_highOrderEdgePositions = arrays.highOrderEdgePositions.wref();
+
+    const unsigned int edgesInQuadraticTriangle[3][2] = {{0,1}, {1,2}, {2,0}};
+    const unsigned int edgesInQuadraticTetrahedron[6][2] = {{0,1}, {1,2}, {0,2},{0,3},{2,3},{1,3}};
+    std::set<Edge> edgeSet;
+    size_t j;
+
+    switch (etype)
+    {
+    case 1: // Line
+        addInGroup(arrays.edgesGroups.wref(),tag,my_edges.size());
+        addEdge(&my_edges, Edge(nodes[0], nodes[1]));
+        break;
+    case 2: // Triangle
+        addInGroup(arrays.trianglesGroups.wref(),tag,my_triangles.size());
+        addTriangle(&my_triangles, Triangle(nodes[0], nodes[1], nodes[2]));
+        break;
+    case 3: // Quad
+        addQuad(&my_quads, Quad(nodes[0], nodes[1], nodes[2], nodes[3]));
+        break;
+    case 4: // Tetra
+        addInGroup(arrays.tetrahedraGroups.wref(),tag,my_tetrahedra.size());
+        addTetrahedron(&my_tetrahedra, Tetrahedron(nodes[0], nodes[1], nodes[2], nodes[3]));
+        break;
+    case 5: // Hexa
+        addInGroup(arrays.hexahedraGroups.wref(),tag,my_hexahedra.size());
+        addHexahedron(&my_hexahedra,Hexahedron(nodes[0], nodes[1], nodes[2], nodes[3],nodes[4],nodes[5],nodes[6],nodes[7]));
+        break;
+    case 8: // quadratic edge
+        addInGroup(arrays.edgesGroups.wref(),tag,my_edges.size());
+        addEdge(&my_edges, Edge(nodes[0], nodes[1]));
+        {
+            HighOrderEdgePosition hoep;
+            hoep[0]= nodes[2];
+            hoep[1]=my_edges.size()-1;
+            hoep[2]=1;
+            hoep[3]=1;
+            my_highOrderEdgePositions.push_back(hoep);
+        }
+        break;
+    case 9: // quadratic triangle
+        addInGroup(arrays.trianglesGroups.wref(),tag,my_triangles.size());
+        addTriangle(&my_triangles, Triangle(nodes[0], nodes[1], nodes[2]));
+        {
+            HighOrderEdgePosition hoep;
+            for(j=0;j<3;++j) {
+                size_t v0=std::min( nodes[edgesInQuadraticTriangle[j][0]],
+                    nodes[edgesInQuadraticTriangle[j][1]]);
+                size_t v1=std::max( nodes[edgesInQuadraticTriangle[j][0]],
+                    nodes[edgesInQuadraticTriangle[j][1]]);
+                Edge e(v0,v1);
+                if (edgeSet.find(e)==edgeSet.end()) {
+                    edgeSet.insert(e);
+                    addEdge(&my_edges, v0, v1);
+                    hoep[0]= nodes[j+3];
+                    hoep[1]=my_edges.size()-1;
+                    hoep[2]=1;
+                    hoep[3]=1;
+                    my_highOrderEdgePositions.push_back(hoep);
+                }
+            }
+        }
+        break;
+    case 11: // quadratic tetrahedron
+        addInGroup(arrays.tetrahedraGroups.wref(),tag,my_tetrahedra.size());
+        addTetrahedron(&my_tetrahedra, Tetrahedron(nodes[0], nodes[1], nodes[2], nodes[3]));
+        {
+            HighOrderEdgePosition hoep;
+            for(j=0;j<6;++j) {
+                size_t v0=std::min( nodes[edgesInQuadraticTetrahedron[j][0]],
+                    nodes[edgesInQuadraticTetrahedron[j][1]]);
+                size_t v1=std::max( nodes[edgesInQuadraticTetrahedron[j][0]],
+                    nodes[edgesInQuadraticTetrahedron[j][1]]);
+                Edge e(v0,v1);
+                if (edgeSet.find(e)==edgeSet.end()) {
+                    edgeSet.insert(e);
+                    addEdge(&my_edges, v0, v1);
+                    hoep[0]= nodes[j+4];
+                    hoep[1]=my_edges.size()-1;
+                    hoep[2]=1;
+                    hoep[3]=1;
+                    my_highOrderEdgePositions.push_back(hoep);
+                }
+            }
+        }
+        break;
+    default:
+        return false;
+    }
+    return true;
+}
+
+namespace
+{
+
+/// Number of nodes of the Gmsh element types, 0 if unknown
+int gmshNbNodes(int etype)
+{
+    switch (etype)
+    {
+    case 1: return 2;   // line
+    case 2: return 3;   // triangle
+    case 3: return 4;   // quad
+    case 4: return 4;   // tetrahedron
+    case 5: return 8;   // hexahedron
+    case 6: return 6;   // prism
+    case 7: return 5;   // pyramid
+    case 8: return 3;   // quadratic line
+    case 9: return 6;   // quadratic triangle
+    case 10: return 9;  // quadratic quad
+    case 11: return 10; // quadratic tetrahedron
+    case 12: return 27; // quadratic hexahedron
+    case 13: return 18; // quadratic prism
+    case 14: return 14; // quadratic pyramid
+    case 15: return 1;  // point
+    case 16: return 8;  // serendipity quad
+    case 17: return 20; // serendipity hexahedron
+    default: return 0;
+    }
+}
+
+/// Reads the values of a Gmsh 4.1 file, in ascii or binary (native endianness)
+struct Gmsh4Reader
+{
+    const char* p;
+    const char* end;
+    bool binary;
+    int dataSize; // size of size_t values in binary files
+    bool ok;
+
+    Gmsh4Reader(const char* begin, const char* e, bool b, int s) : p(begin), end(e), binary(b), dataSize(s), ok(true) {}
+
+    void skipSpaces()
+    {
+        while (p != end && (helper::io::fasttext::isBlank(*p) || *p == '\n')) ++p;
+    }
+
+    template<class T>
+    T readBinary()
+    {
+        T v = T();
+        if (end - p < (std::ptrdiff_t)sizeof(T)) { ok = false; p = end; return v; }
+        std::memcpy(&v, p, sizeof(T));
+        p += sizeof(T);
+        return v;
+    }
+
+    int readInt()
+    {
+        if (binary) return readBinary<int>();
+        skipSpaces();
+        int v = 0;
+        if (!helper::io::fasttext::parseInt(p, end, v)) ok = false;
+        return v;
+    }
+
+    uint64_t readSize()
+    {
+        if (binary) return (dataSize == 4) ? (uint64_t)readBinary<uint32_t>() : readBinary<uint64_t>();
+        skipSpaces();
+        uint64_t v = 0;
+        const char* q = p;
+        while (p != end && *p >= '0' && *p <= '9') { v = v*10 + (uint64_t)(*p - '0'); ++p; }
+        if (p == q) ok = false;
+        return v;
+    }
+
+    double readDouble()
+    {
+        if (binary) return readBinary<double>();
+        skipSpaces();
+        double v = 0;
+        if (!helper::io::fasttext::parseReal(p, end, v)) ok = false;
+        return v;
+    }
+
+    /// Name of the next section ("Nodes" for $Nodes), empty at the end of the file
+    std::string nextSection()
+    {
+        skipSpaces();
+        if (p == end || *p != '$') { p = end; return std::string(); }
+        ++p;
+        std::string name = helper::io::fasttext::readToken(p, end);
+        p = helper::io::fasttext::nextLine(p, end);
+        return name;
+    }
+
+    /// Check the end of the current section
+    bool endSection(const std::string& name)
+    {
+        return nextSection() == "End" + name;
+    }
+
+    /// Skip the current section, without parsing it
+    void skipSection(const std::string& name)
+    {
+        const std::string tag = "$End" + name;
+        p = std::search(p, end, tag.begin(), tag.end());
+        p = helper::io::fasttext::nextLine(p, end);
+    }
+};
+
+} // namespace
+
+bool MeshGmshLoader::readGmsh4(const char* begin, const char* end, bool binary, int dataSize)
+{
+    sout << "Reading Gmsh file: 4.1 " << (binary ? "binary" : "ascii") << sendl;
+
+    if (binary && dataSize != 4 && dataSize != 8)
+    {
+        serr << "Error: MeshGmshLoader: unsupported data size " << dataSize << sendl;
+        return false;
+    }
+
+    Gmsh4Reader in(begin, end, binary, dataSize);
+    if (in.nextSection() != "MeshFormat")
+        return false;
+    in.p = helper::io::fasttext::nextLine(in.p, end); // version file-type data-size
+    if (binary)
+    {
+        if (in.readBinary<int>() != 1)
+        {
+            serr << "Error: MeshGmshLoader: binary file written with another endianness" << sendl;
+            return false;
+        }
+    }
+    if (!in.endSection("MeshFormat"))
+        return false;
+
+    const unsigned int noNode = (unsigned int)-1;
+    std::vector<unsigned int> pmap; // map from node tags to position indices
+    std::map< std::pair<int,int>, int > physicalTags; // physical tag of the entities, per (dimension, entity tag)
+    bool nodesRead = false, elementsRead = false;
+
+    for (std::string section = in.nextSection(); !section.empty() && in.ok; section = in.nextSection())
+    {
+        if (section == "Entities")
+        {
+            uint64_t nbEntities[4];
+            for (int dim = 0; dim < 4; ++dim)
+                nbEntities[dim] = in.readSize();
+            for (int dim = 0; dim < 4 && in.ok; ++dim)
+            {
+                for (uint64_t e = 0; e < nbEntities[dim] && in.ok; ++e)
+                {
+                    const int entityTag = in.readInt();
+                    for (int c = 0; c < (dim == 0 ? 3 : 6); ++c)
+                        in.readDouble(); // point, or bounding box
+                    const uint64_t nbPhysicalTags = in.readSize();
+                    for (uint64_t t = 0; t < nbPhysicalTags && in.ok; ++t)
+                    {
+                        const int physicalTag = in.readInt();
+                        if (t == 0) physicalTags[std::make_pair(dim, entityTag)] = physicalTag;
+                    }
+                    if (dim > 0)
+                    {
+                        const uint64_t nbBounding = in.readSize();
+                        for (uint64_t t = 0; t < nbBounding && in.ok; ++t)
+                            in.readInt();
+                    }
+                }
+            }
+            if (!in.ok || !in.endSection("Entities"))
+            {
+                serr << "Error: MeshGmshLoader: invalid $Entities section" << sendl;
+                return false;
+            }
+        }
+        else if (section == "Nodes")
+        {
+            const uint64_t nbBlocks = in.readSize();
+            const uint64_t nbNodes = in.readSize();
+            in.readSize(); // min tag
+            const uint64_t maxTag = in.readSize();
+            if (!in.ok || maxTag > ((uint64_t)1 << 32))
+                break;
+
+            helper::WriteOnlyAccessor< Data< helper::vector<sofa::defaulttype::Vector3> > > my_positions = d_positions;
+            my_positions.resize((std::size_t)nbNodes);
+            pmap.assign((std::size_t)maxTag + 1, noNode);
+
+            uint64_t k = 0;
+            for (uint64_t b = 0; b < nbBlocks && in.ok; ++b)
+            {
+                const int entityDim = in.readInt();
+                in.readInt(); // entity tag
+                const int parametric = in.readInt();
+                const uint64_t nbInBlock = in.readSize();
+                if (k + nbInBlock > nbNodes) { in.ok = false; break; }
+                for (uint64_t i = 0; i < nbInBlock; ++i)
+                {
+                    const uint64_t tag = in.readSize();
+                    if (tag < pmap.size()) pmap[(std::size_t)tag] = (unsigned int)(k + i);
+                }
+                for (uint64_t i = 0; i < nbInBlock; ++i)
+                {
+                    const double x = in.readDouble();
+                    const double y = in.readDouble();
+                    const double z = in.readDouble();
+                    if (parametric)
+                        for (int u = 0; u < entityDim; ++u) in.readDouble();
+                    my_positions[(std::size_t)(k + i)] = sofa::defaulttype::Vector3(x, y, z);
+                }
+                k += nbInBlock;
+            }
+            if (!in.ok || !in.endSection("Nodes"))
+            {
+                serr << "Error: MeshGmshLoader: invalid $Nodes section" << sendl;
+                return false;
+            }
+            nodesRead = true;
+        }
+        else if (section == "Elements")
+        {
+            const uint64_t nbBlocks = in.readSize();
+            in.readSize(); // number of elements
+            in.readSize(); // min tag
+            in.readSize(); // max tag
+
+            ElementArrays arrays(this);
+            helper::vector<unsigned int> nodes;
+            for (uint64_t b = 0; b < nbBlocks && in.ok; ++b)
+            {
+                const int entityDim = in.readInt();
+                const int entityTag = in.readInt();
+                const int etype = in.readInt();
+                const uint64_t nbInBlock = in.readSize();
+                const int nnodes = gmshNbNodes(etype);
+                if (nnodes == 0)
+                {
+                    serr << "Error: MeshGmshLoader: unsupported element type " << etype << sendl;
+                    return false;
+                }
+
+                switch (etype)
+                {
+                case 2: case 9: arrays.triangles.wref().reserve(arrays.triangles.size() + (std::size_t)nbInBlock); break;
+                case 4: case 11: arrays.tetrahedra.wref().reserve(arrays.tetrahedra.size() + (std::size_t)nbInBlock); break;
+                case 5: arrays.hexahedra.wref().reserve(arrays.hexahedra.size() + (std::size_t)nbInBlock); break;
+                }
+
+                // elements are grouped by physical tag, as in version 2 files
+                std::map< std::pair<int,int>, int >::const_iterator physical = physicalTags.find(std::make_pair(entityDim, entityTag));
+                const int groupTag = (physical != physicalTags.end()) ? physical->second : entityTag;
+
+                nodes.resize(nnodes);
+                for (uint64_t e = 0; e < nbInBlock && in.ok; ++e)
+                {
+                    const uint64_t elementTag = in.readSize();
+                    for (int n = 0; n < nnodes; ++n)
+                    {
+                        const uint64_t t = in.readSize();
+                        nodes[n] = (t < pmap.size()) ? pmap[(std::size_t)t] : noNode;
+                        if (nodes[n] == noNode && in.ok)
+                        {
+                            msg_error() << "Node " << t << " of element " << elementTag << " is not in the $Nodes section.";
+                            return false;
+                        }
+                    }
+                    addElement(etype, nodes, groupTag, arrays);
+                }
+            }
+
+            normalizeGroup(arrays.edgesGroups.wref());
+            normalizeGroup(arrays.trianglesGroups.wref());
+            normalizeGroup(arrays.tetrahedraGroups.wref());
+            normalizeGroup(arrays.hexahedraGroups.wref());
+
+            if (!in.ok || !in.endSection("Elements"))
+            {
+                serr << "Error: MeshGmshLoader: invalid $Elements section" << sendl;
+                return false;
+            }
+            elementsRead = true;
+        }
+        else
+        {
+            in.skipSection(section);
+        }
+    }
+
+    if (!nodesRead || !elementsRead)
+    {
+        serr << "Error: MeshGmshLoader: $Nodes and $Elements sections expected" << sendl;
+        return false;
+    }
+    return true;
+}
+
 } // namespace loader
 
 } // namespace component
@@ -52,6 +52,32 @@ protected:
 
     bool readGmsh(std::ifstream &file, const unsigned int gmshFormat);
 
+    /// Gmsh 4.1 files, ascii or binary. The positions and elements are read
+    /// from the mapped file straight into the Data of the loader. The elements
+    /// are grouped by the first physical tag of their entity, read from the
+    /// $Entities section, or by entity tag if the entity has no physical group.
+    bool readGmsh4(const char* begin, const char* end, bool binary, int dataSize);
+
+    /// Elements and groups of the loader, edited during the whole reading
+    struct ElementArrays
+    {
+        helper::WriteAccessor< Data< helper::vector<Edge> > > edges;
+        helper::WriteAccessor< Data< helper::vector<Triangle> > > triangles;
+        helper::WriteAccessor< Data< helper::vector<Quad> > > quads;
+        helper::WriteAccessor< Data< helper::vector<Tetrahedron> > > tetrahedra;
+        helper::WriteAccessor< Data< helper::vector<Hexahedron> > > hexahedra;
+        helper::WriteAccessor< Data< helper::vector<HighOrderEdgePosition> > > highOrderEdgePositions;
+        helper::WriteAccessor< Data< helper::vector<sofa::core::loader::PrimitiveGroup> > > edgesGroups;
+        helper::WriteAccessor< Data< helper::vector<sofa::core::loader::PrimitiveGroup> > > trianglesGroups;
+        helper::WriteAccessor< Data< helper::vector<sofa::core::loader::PrimitiveGroup> > > tetrahedraGroups;
+        helper::WriteAccessor< Data< helper::vector<sofa::core::loader::PrimitiveGroup> > > hexahedraGroups;
+
+        ElementArrays(MeshGmshLoader* loader);
+    };
+
+    /// Add an element of the given Gmsh type, returns false if the type is not handled
+    bool addElement(int etype, const helper::vector<unsigned int>& nodes, int tag, ElementArrays& arrays);
+
     void addInGroup(helper::vector< sofa::core::loader::PrimitiveGroup>& group,int tag,int eid);
 
     void normalizeGroup(helper::vector< sofa::core::loader::PrimitiveGroup>& group);
@@ -22,12 +22,21 @@
 #include <sofa/core/ObjectFactory.h>
 #include <SofaGeneralLoader/MeshSTLLoader.h>
 #include <sofa/core/visual/VisualParams.h>
+#include <sofa/helper/io/MemoryMappedFile.h>
+#include <sofa/helper/io/FastTextParser.h>
+#include <sofa/helper/IndexOpenMP.h>
 
 #include <iostream>
 #include <fstream>
 #include <cstdio>
+#include <cstring>
+#include <iterator>
 #include <sstream>
 #include <string>
+#include <unordered_map>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 namespace sofa
 {
@@ -39,6 +48,7 @@ namespace loader
 {
 
 using namespace sofa::defaulttype;
+using namespace sofa::helper::io;
 
 SOFA_DECL_CLASS(MeshSTLLoader)
 
@@ -46,11 +56,138 @@ int MeshSTLLoaderClass = core::RegisterObject("Specific mesh loader for STL file
         .add< MeshSTLLoader >()
         ;
 
+namespace
+{
+
+typedef core::topology::Topology::index_type index_type;
+
+/// Hash of the exact bits of a float position
+struct Vec3fHash
+{
+    std::size_t operator()(const Vec3f& v) const
+    {
+        uint64_t h = 14695981039346656037ULL;
+        for (int i = 0; i < 3; ++i)
+        {
+            uint32_t bits;
+            std::memcpy(&bits, &v[i], sizeof(bits));
+            h = (h ^ bits) * 1099511628211ULL;
+        }
+        return (std::size_t)(h ^ (h >> 32));
+    }
+};
+
+/// Exact comparison, Vec::operator== uses a tolerance
+struct Vec3fEqual
+{
+    bool operator()(const Vec3f& a, const Vec3f& b) const
+    {
+        return a[0] == b[0] && a[1] == b[1] && a[2] == b[2];
+    }
+};
+
+/// Merges the duplicated positions of the facets
+class STLPositionMerger
+{
+public:
+    STLPositionMerger(helper::vector<Vector3>& positions, bool useMap, std::size_t nbVertices)
+        : m_positions(positions), m_useMap(useMap)
+    {
+        if (m_useMap) m_map.reserve(nbVertices / 4);
+    }
+
+    template<class TVec>
+    index_type add(const TVec& vertex)
+    {
+        if (m_useMap)
+        {
+            Vec3f key(vertex);
+            for (int i = 0; i < 3; ++i)
+                if (key[i] == 0.0f) key[i] = 0.0f; // -0 and +0 are the same position
+            std::pair<Map::iterator,bool> it = m_map.insert(std::make_pair(key, (index_type)m_positions.size()));
+            if (it.second)
+                m_positions.push_back(Vector3(vertex));
+            return it.first->second;
+        }
+
+        for (std::size_t k=0; k<m_positions.size(); ++k)
+            if ( (vertex[0] == m_positions[k][0]) && (vertex[1] == m_positions[k][1])  && (vertex[2] == m_positions[k][2]))
+                return static_cast<index_type>(k);
+        m_positions.push_back(Vector3(vertex));
+        return static_cast<index_type>(m_positions.size()-1);
+    }
+
+private:
+    typedef std::unordered_map< Vec3f, index_type, Vec3fHash, Vec3fEqual > Map;
+    helper::vector<Vector3>& m_positions;
+    bool m_useMap;
+    Map m_map;
+};
+
+/// Result of the parsing of a range of lines of an ascii STL file
+struct STLChunk
+{
+    helper::vector<Vector3> normals;
+    helper::vector<Vector3> vertices;
+    helper::vector<unsigned int> facetEnds; ///< number of vertices of the chunk read before each endfacet
+    bool ended; ///< endsolid was found in this chunk
+
+    STLChunk() : ended(false) {}
+};
+
+void readSTLVector(const char*& p, const char* end, Vector3& v)
+{
+    for (int i = 0; i < 3; ++i)
+    {
+        p = fasttext::skipBlanks(p, end);
+        double value = 0.0;
+        fasttext::parseReal(p, end, value);
+        v[i] = (SReal)value;
+    }
+}
+
+void parseSTLChunk(const char* p, const char* end, STLChunk& chunk)
+{
+    while (p != end)
+    {
+        const char* eol = fasttext::lineEnd(p, end);
+        const char* q = fasttext::skipBlanks(p, eol);
+
+        if (fasttext::matchToken(q, eol, "vertex"))
+        {
+            Vector3 vertex;
+            readSTLVector(q, eol, vertex);
+            chunk.vertices.push_back(vertex);
+        }
+        else if (fasttext::matchToken(q, eol, "facet"))
+        {
+            Vector3 normal;
+            fasttext::readToken(q, eol); // "normal"
+            readSTLVector(q, eol, normal);
+            chunk.normals.push_back(normal);
+        }
+        else if (fasttext::matchToken(q, eol, "endfacet"))
+        {
+            chunk.facetEnds.push_back((unsigned int)chunk.vertices.size());
+        }
+        else if (fasttext::matchToken(q, eol, "endsolid") || fasttext::matchToken(q, eol, "end"))
+        {
+            chunk.ended = true;
+            return;
+        }
+
+        p = (eol == end) ? end : eol + 1;
+    }
+}
+
+} // namespace
+
 //Base VTK Loader
 MeshSTLLoader::MeshSTLLoader() : MeshLoader()
     , _headerSize(initData(&_headerSize, 80u, "headerSize","Size of the header binary file (just before the number of facet)."))
     , _forceBinary(initData(&_forceBinary, false, "forceBinary","Force reading in binary mode. Even in first keyword of the file is solid."))
     , d_mergePositionUsingMap(initData(&d_mergePositionUsingMap, true, "mergePositionUsingMap","Since positions are duplicated in a STL, they have to be merged. Using a map to do so will temporarily duplicate memory but should be more efficient. Disable it if memory is really an issue."))
+    , d_binaryCache(initData(&d_binaryCache, false, "binaryCache","Write the loaded mesh in a binary file next to the STL file and read it instead of the STL file as long as its content does not change."))
 {
 }
 
@@ -58,138 +195,98 @@ MeshSTLLoader::MeshSTLLoader() : MeshLoader()
 
 bool MeshSTLLoader::load()
 {
-    const char* filename = m_filename.getFullPath().c_str();
-    std::ifstream file(filename);
-    if (!file.good())
+    const std::string filename = m_filename.getFullPath();
+    MemoryMappedFile file;
+    if (!file.open(filename))
     {
-        file.close();
         serr << "Cannot read file '" << m_filename << "'." << sendl;
         return false;
     }
 
-    if( _forceBinary.getValue() )
-        return this->readBinarySTL(filename); // -- Reading binary file
+    uint64_t cacheKey = 0;
+    std::string cacheOptions;
+    if (d_binaryCache.getValue())
+    {
+        cacheKey = file.hash();
+        std::ostringstream options;
+        options << "headerSize=" << _headerSize.getValue() << " forceBinary=" << _forceBinary.getValue()
+                << " mergePositionUsingMap=" << d_mergePositionUsingMap.getValue();
+        cacheOptions = options.str();
+        if (readBinaryCache(filename, cacheKey, cacheOptions))
+            return true;
+    }
 
-    std::string test;
-    file >> test;
+    const char* begin = file.data();
+    const char* end = begin + file.size();
+    const char* p = begin;
 
-    if ( test == "solid" )
-        return this->readSTL(file);
+    bool fileRead;
+    if( !_forceBinary.getValue() && fasttext::readToken(p, end) == "solid" )
+        fileRead = this->readSTL(begin, end);
     else
+        fileRead = this->readBinarySTL(begin, end); // -- Reading binary file
+    file.close();
+
+    if (fileRead && d_binaryCache.getValue())
+        writeBinaryCache(filename, cacheKey, cacheOptions);
+
+    return fileRead;
+}
+
+
+bool MeshSTLLoader::readBinarySTL(const char *filename)
+{
+    MemoryMappedFile file(filename);
+    if (!file.isOpen())
     {
-        file.close(); // no longer need for an ascii-open file
-        return this->readBinarySTL(filename); // -- Reading binary file
+        serr << "Cannot read file '" << filename << "'." << sendl;
+        return false;
     }
+    return readBinarySTL(file.data(), file.data() + file.size());
 }
 
 
-bool MeshSTLLoader::readBinarySTL(const char *filename)
+bool MeshSTLLoader::readBinarySTL(const char* begin, const char* end)
 {
     dmsg_info() << "Reading binary STL file..." ;
 
-    std::ifstream dataFile (filename, std::ios::in | std::ios::binary);
+    const std::size_t facetSize = 12 /*normal*/ + 3 * 12 /*points*/ + 2 /*attribute*/;
+    const std::size_t headerSize = _headerSize.getValue();
+    const std::size_t length = (std::size_t)(end - begin);
+
+    // Skipping header file
+    uint32_t nbrFacet = 0;
+    if (length >= headerSize + 4)
+        std::memcpy(&nbrFacet, begin + headerSize, 4);
+    if (length < headerSize + 4 || (length - headerSize - 4) / facetSize < nbrFacet)
+    {
+        serr << "Truncated binary STL file: " << nbrFacet << " facets announced in " << length << " bytes." << sendl;
+        return false;
+    }
 
     helper::vector<sofa::defaulttype::Vector3>& my_positions = *(this->d_positions.beginWriteOnly());
     helper::vector<sofa::defaulttype::Vector3>& my_normals = *(this->d_normals.beginWriteOnly());
     helper::vector<Triangle >& my_triangles = *(this->d_triangles.beginWriteOnly());
 
-    std::map< sofa::defaulttype::Vec3f, core::topology::Topology::index_type > my_map;
-    core::topology::Topology::index_type positionCounter = 0;
-    bool useMap = d_mergePositionUsingMap.getValue();
-
-
-
-    // Skipping header file
-    char buffer[256];
-    dataFile.read(buffer, _headerSize.getValue());
-//    sout << "Header binary file: "<< buffer << sendl;
-
-    uint32_t nbrFacet;
-    dataFile.read((char*)&nbrFacet, 4);
-
+    my_positions.clear();
     my_triangles.resize( nbrFacet ); // exact size
     my_normals.resize( nbrFacet ); // exact size
     my_positions.reserve( nbrFacet * 3 ); // max size
 
-#ifndef NDEBUG
-    {
-    // checking that the file is large enough to contain the given nb of facets
-    // store current pos in file
-    std::streampos pos = dataFile.tellg();
-    // get length of file
-    dataFile.seekg(0, std::ios::end);
-    std::streampos length = dataFile.tellg();
-    // restore pos in file
-    dataFile.seekg(pos);
-    // check for length
-    assert( length >= _headerSize.getValue() + 4 + nbrFacet * (12 /*normal*/ + 3 * 12 /*points*/ + 2 /*attribute*/ ) );
-    }
-#endif
-
-    // temporaries
-    sofa::defaulttype::Vec3f vertex, normal;
+    STLPositionMerger merger(my_positions, d_mergePositionUsingMap.getValue(), 3 * (std::size_t)nbrFacet);
 
-    // Parsing facets
-    for (uint32_t i = 0; i<nbrFacet; ++i)
+    // Parsing facets, straight from the file content
+    const char* facet = begin + headerSize + 4;
+    for (uint32_t i = 0; i<nbrFacet; ++i, facet += facetSize)
     {
-        Triangle& the_tri = my_triangles[i];
+        float values[12];
+        std::memcpy(values, facet, sizeof(values)); // normal then vertices
 
-        // Normal:
-        dataFile.read((char*)&normal[0], 4);
-        dataFile.read((char*)&normal[1], 4);
-        dataFile.read((char*)&normal[2], 4);
-        my_normals[i] = normal;
+        my_normals[i] = Vec3f(values[0], values[1], values[2]);
 
-        // Vertices:
+        Triangle& the_tri = my_triangles[i];
         for (size_t j = 0; j<3; ++j)
-        {
-            dataFile.read((char*)&vertex[0], 4);
-            dataFile.read((char*)&vertex[1], 4);
-            dataFile.read((char*)&vertex[2], 4);
-
-
-            if( useMap )
-            {
-                auto it = my_map.find( vertex );
-                if( it == my_map.end() )
-                {
-                    the_tri[j] = positionCounter;
-                    my_map[vertex] = positionCounter++;
-                    my_positions.push_back(vertex);
-                }
-                else
-                {
-                    the_tri[j] = it->second;
-                }
-            }
-            else
-            {
-                bool find = false;
-                for (size_t k=0; k<my_positions.size(); ++k)
-                    if ( (vertex[0] == my_positions[k][0]) && (vertex[1] == my_positions[k][1])  && (vertex[2] == my_positions[k][2]))
-                    {
-                        find = true;
-                        the_tri[j] = static_cast<core::topology::Topology::PointID>(k);
-                        break;
-                    }
-
-                if (!find)
-                {
-                    my_positions.push_back(vertex);
-                    the_tri[j] = my_positions.size()-1;
-                }
-            }
-
-        }
-
-        // Attribute byte count
-        uint16_t count;
-        dataFile.read((char*)&count, 2);
-
-        // Security: // checked once before reading in debug mode
-//        position = dataFile.tellg();
-//        if (position == length)
-//            break;
+            the_tri[j] = merger.add(Vec3f(values[3+3*j], values[4+3*j], values[5+3*j]));
     }
 
     this->d_positions.endEdit();
@@ -204,108 +301,80 @@ bool MeshSTLLoader::readBinarySTL(const char *filename)
 
 bool MeshSTLLoader::readSTL(std::ifstream& dataFile)
 {
-    dmsg_info() << "Reading STL file..." ;
-
-    // Init
-    std::string buffer;
-    std::string name; // name of the solid, needed?
+    dataFile.seekg(0, std::ios::beg);
+    const std::string content((std::istreambuf_iterator<char>(dataFile)), std::istreambuf_iterator<char>());
+    dataFile.close();
+    return readSTL(content.data(), content.data() + content.size());
+}
 
-    helper::vector<sofa::defaulttype::Vector3>& my_positions = *(d_positions.beginEdit());
-    helper::vector<sofa::defaulttype::Vector3>& my_normals = *(d_normals.beginEdit());
-    helper::vector<Triangle >& my_triangles = *(d_triangles.beginEdit());
 
+bool MeshSTLLoader::readSTL(const char* begin, const char* end, std::size_t nbChunks)
+{
+    dmsg_info() << "Reading STL file..." ;
 
-    std::map< sofa::defaulttype::Vec3f, core::topology::Topology::index_type > my_map;
-    core::topology::Topology::index_type positionCounter = 0;
-    bool useMap = d_mergePositionUsingMap.getValue();
+    // Skip the header line, "solid name"
+    begin = fasttext::nextLine(begin, end);
 
+    // Parse ranges of lines concurrently, positions are merged afterwards in file order
+    if (nbChunks == 0)
+    {
+        nbChunks = 1;
+#ifdef _OPENMP
+        if (end - begin > (1<<20))
+            nbChunks = 4 * (std::size_t)omp_get_max_threads();
+#endif
+    }
+    const helper::vector<const char*> bounds = fasttext::splitLines(begin, end, nbChunks);
+    helper::vector<STLChunk> chunks(bounds.size() - 1);
 
-    // get length of file:
-    dataFile.seekg(0, std::ios::end);
-    std::streampos length = dataFile.tellg();
-    dataFile.seekg(0, std::ios::beg);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic,1)
+#endif
+    for (helper::IndexOpenMP<int>::type c = 0; c < (int)chunks.size(); ++c)
+        parseSTLChunk(bounds[c], bounds[c+1], chunks[c]);
 
-    // Reading header
-    dataFile >> buffer >> name;
+    // nothing after endsolid is read
+    std::size_t nbUsedChunks = chunks.size();
+    for (std::size_t c = 0; c < chunks.size(); ++c)
+        if (chunks[c].ended) { nbUsedChunks = c+1; break; }
 
-    Triangle the_tri;
-    size_t cpt = 0;
-    std::streampos position = 0;
+    helper::vector<sofa::defaulttype::Vector3>& my_positions = *(d_positions.beginWriteOnly());
+    helper::vector<sofa::defaulttype::Vector3>& my_normals = *(d_normals.beginWriteOnly());
+    helper::vector<Triangle >& my_triangles = *(d_triangles.beginWriteOnly());
 
-    // Parsing facets
-    while (position < length)
-    {
-        sofa::defaulttype::Vector3 normal, vertex;
+    my_positions.clear();
+    my_normals.clear();
+    my_triangles.clear();
 
-        std::getline(dataFile, buffer);
-        std::stringstream line;
-        line << buffer;
+    std::size_t nbVertices = 0;
+    for (std::size_t c = 0; c < nbUsedChunks; ++c)
+        nbVertices += chunks[c].vertices.size();
 
-        std::string bufferWord;
-        line >> bufferWord;
+    STLPositionMerger merger(my_positions, d_mergePositionUsingMap.getValue(), nbVertices);
 
-        if (bufferWord == "facet")
-        {
-            line >> bufferWord >> normal[0] >> normal[1] >> normal[2];
-            my_normals.push_back(normal);
-        }
-        else if (bufferWord == "vertex")
-        {
-            line >> vertex[0] >> vertex[1] >> vertex[2];
-
-            if( useMap )
-            {
-                auto it = my_map.find( vertex );
-                if( it == my_map.end() )
-                {
-                    the_tri[cpt] = positionCounter;
-                    my_map[vertex] = positionCounter++;
-                    my_positions.push_back(vertex);
-                }
-                else
-                {
-                    the_tri[cpt] = it->second;
-                }
-            }
-            else
-            {
-
-                bool find = false;
-                for (size_t i=0; i<my_positions.size(); ++i)
-                    if ( (vertex[0] == my_positions[i][0]) && (vertex[1] == my_positions[i][1])  && (vertex[2] == my_positions[i][2]))
-                    {
-                        find = true;
-                        the_tri[cpt] = static_cast<core::topology::Topology::PointID>(i);
-                        break;
-                    }
-
-                if (!find)
-                {
-                    my_positions.push_back(vertex);
-                    the_tri[cpt] = static_cast<core::topology::Topology::PointID>(my_positions.size()-1);
-                }
-            }
-            cpt++;
-        }
-        else if (bufferWord == "endfacet")
-        {
-            my_triangles.push_back(the_tri);
-            cpt = 0;
-        }
-        else if (bufferWord == "endsolid" || bufferWord == "end")
+    // merged index of each vertex of the file, a facet is made of the three vertices before its endfacet
+    helper::vector<index_type> vertexIds;
+    vertexIds.reserve(nbVertices);
+    for (std::size_t c = 0; c < nbUsedChunks; ++c)
+    {
+        STLChunk& chunk = chunks[c];
+        const std::size_t vertexOffset = vertexIds.size();
+        for (std::size_t i = 0; i < chunk.vertices.size(); ++i)
+            vertexIds.push_back(merger.add(chunk.vertices[i]));
+        my_normals.insert(my_normals.end(), chunk.normals.begin(), chunk.normals.end());
+        for (std::size_t f = 0; f < chunk.facetEnds.size(); ++f)
         {
-            break;
+            const std::size_t last = vertexOffset + chunk.facetEnds[f];
+            if (last < 3) continue;
+            my_triangles.push_back(Triangle(vertexIds[last-3], vertexIds[last-2], vertexIds[last-1]));
         }
-
-        position = dataFile.tellg();
+        helper::vector<Vector3>().swap(chunk.vertices);
     }
 
     d_positions.endEdit();
     d_triangles.endEdit();
     d_normals.endEdit();
 
-    dataFile.close();
-
     dmsg_info() << "done!" ;
 
     return true;
@@ -319,5 +388,3 @@ bool MeshSTLLoader::readSTL(std::ifstream& dataFile)
 } // namespace component
 
 } // namespace sofa
-
-
@@ -55,15 +55,19 @@ protected:
 
     // ascii
     bool readSTL(std::ifstream& file);
+    /// nbChunks: number of line ranges parsed concurrently, 0 to choose it from the buffer size and the number of threads
+    bool readSTL(const char* begin, const char* end, std::size_t nbChunks = 0);
 
     // binary
     bool readBinarySTL(const char* filename);
+    bool readBinarySTL(const char* begin, const char* end);
 
 public:
     //Add Data here
     Data <unsigned int> _headerSize; ///< Size of the header binary file (just before the number of facet).
     Data <bool> _forceBinary; ///< Force reading in binary mode. Even in first keyword of the file is solid.
     Data <bool> d_mergePositionUsingMap; ///< Since positions are duplicated in a STL, they have to be merged. Using a map to do so will temporarily duplicate memory but should be more efficient. Disable it if memory is really an issue.
+    Data <bool> d_binaryCache; ///< Write the loaded mesh in a binary file next to the STL file and read it instead of the STL file as long as its content does not change.
 
 };
 
@@ -0,0 +1,190 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2018 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#include <SofaGeneralLoader/MeshGmshLoader.h>
+using sofa::component::loader::MeshGmshLoader ;
+
+#include <sofa/helper/testing/BaseTest.h>
+using sofa::helper::testing::BaseTest ;
+
+#include <boost/filesystem.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+namespace sofa
+{
+namespace meshgmshloader_test
+{
+
+/// Writes the values of a Gmsh 4.1 file, in ascii or binary
+class Gmsh4Writer
+{
+public:
+    Gmsh4Writer(bool binary) : m_binary(binary) {}
+
+    void line(const std::string& text) { m_out << text << "\n"; }
+    void newLine() { if (!m_binary) m_out << "\n"; }
+    void size(uint64_t v) { write(v); }
+    void integer(int v) { write(v); }
+    void real(double v) { write(v); }
+
+    std::string str() const { return m_out.str(); }
+
+private:
+    template<class T>
+    void write(T v)
+    {
+        if (m_binary) m_out.write((const char*)&v, sizeof(v));
+        else m_out << v << " ";
+    }
+
+    bool m_binary;
+    std::ostringstream m_out;
+};
+
+/** Two tetrahedra in two volumes of the same physical group and a triangle on
+ * a surface without physical group. The node tags are not contiguous.
+ * A missing node tag can be given to the second tetrahedron.
+ */
+std::string gmsh4(bool binary, int missingNode = 0)
+{
+    Gmsh4Writer out(binary);
+    out.line("$MeshFormat");
+    out.line(binary ? "4.1 1 8" : "4.1 0 8");
+    if (binary) { out.integer(1); out.line(""); }
+    out.line("$EndMeshFormat");
+    out.line("$PhysicalNames");
+    out.line("1");
+    out.line("3 7 \"body\"");
+    out.line("$EndPhysicalNames");
+
+    out.line("$Entities");
+    out.size(0); out.size(0); out.size(1); out.size(2); out.newLine();
+    // surface 1, no physical group, no boundary
+    out.integer(1); for (int i = 0; i < 6; ++i) out.real(i < 3 ? 0 : 1);
+    out.size(0); out.size(0); out.newLine();
+    // volumes 1 and 2, physical group 7, bounded by the surface 1
+    for (int v = 1; v <= 2; ++v)
+    {
+        out.integer(v); for (int i = 0; i < 6; ++i) out.real(i < 3 ? 0 : 1);
+        out.size(1); out.integer(7); out.size(1); out.integer(1); out.newLine();
+    }
+    out.line(binary ? "\n$EndEntities" : "$EndEntities");
+
+    out.line("$Nodes");
+    out.size(2); out.size(5); out.size(1); out.size(10); out.newLine();
+    out.integer(2); out.integer(1); out.integer(0); out.size(3); out.newLine();
+    out.size(1); out.size(2); out.size(3); out.newLine();
+    out.real(0); out.real(0); out.real(0); out.newLine();
+    out.real(1); out.real(0); out.real(0); out.newLine();
+    out.real(0); out.real(1); out.real(0); out.newLine();
+    out.integer(3); out.integer(1); out.integer(0); out.size(2); out.newLine();
+    out.size(4); out.size(10); out.newLine();
+    out.real(0); out.real(0); out.real(1); out.newLine();
+    out.real(1); out.real(1); out.real(1); out.newLine();
+    out.line(binary ? "\n$EndNodes" : "$EndNodes");
+
+    out.line("$Elements");
+    out.size(3); out.size(3); out.size(1); out.size(3); out.newLine();
+    out.integer(2); out.integer(1); out.integer(2); out.size(1); out.newLine();
+    out.size(1); out.size(1); out.size(2); out.size(3); out.newLine();
+    out.integer(3); out.integer(1); out.integer(4); out.size(1); out.newLine();
+    out.size(2); out.size(1); out.size(2); out.size(3); out.size(4); out.newLine();
+    out.integer(3); out.integer(2); out.integer(4); out.size(1); out.newLine();
+    out.size(3); out.size(2); out.size(3); out.size(4); out.size(missingNode ? missingNode : 10); out.newLine();
+    out.line(binary ? "\n$EndElements" : "$EndElements");
+    return out.str();
+}
+
+struct MeshGmshLoader_test : public BaseTest,
+                             public MeshGmshLoader
+{
+    std::string filename;
+
+    void TearDown()
+    {
+        if (!filename.empty())
+            std::remove(filename.c_str());
+    }
+
+    void testLoad(bool binary)
+    {
+        filename = boost::filesystem::temp_directory_path().string()
+                + (binary ? "/MeshGmshLoader_test_binary.msh" : "/MeshGmshLoader_test_ascii.msh");
+        {
+            const std::string content = gmsh4(binary);
+            std::ofstream out(filename.c_str(), std::ios::out | std::ios::binary);
+            out.write(content.data(), content.size());
+        }
+        setFilename(filename);
+        ASSERT_TRUE(load());
+
+        const helper::vector<defaulttype::Vector3>& positions = d_positions.getValue();
+        ASSERT_EQ(5u, positions.size());
+        EXPECT_EQ(defaulttype::Vector3(1,1,1), positions[4]);
+
+        ASSERT_EQ(1u, d_triangles.getValue().size());
+        EXPECT_EQ(2u, d_triangles.getValue()[0][2]);
+
+        const helper::vector<Tetrahedron>& tetrahedra = d_tetrahedra.getValue();
+        ASSERT_EQ(2u, tetrahedra.size());
+        EXPECT_EQ(0u, tetrahedra[0][0]);
+        EXPECT_EQ(3u, tetrahedra[0][3]);
+        EXPECT_EQ(1u, tetrahedra[1][0]);
+        EXPECT_EQ(4u, tetrahedra[1][3]);
+
+        // both volumes are in the physical group 7
+        ASSERT_EQ(1u, d_tetrahedraGroups.getValue().size());
+        EXPECT_EQ(0, d_tetrahedraGroups.getValue()[0].p0);
+        EXPECT_EQ(2, d_tetrahedraGroups.getValue()[0].nbp);
+        ASSERT_EQ(1u, d_trianglesGroups.getValue().size());
+        EXPECT_EQ(1, d_trianglesGroups.getValue()[0].nbp);
+    }
+};
+
+TEST_F(MeshGmshLoader_test, loadGmsh4Ascii)
+{
+    testLoad(false);
+}
+
+TEST_F(MeshGmshLoader_test, loadGmsh4Binary)
+{
+    testLoad(true);
+}
+
+TEST_F(MeshGmshLoader_test, missingNode)
+{
+    EXPECT_MSG_EMIT(Error) ;
+
+    for (int binary = 0; binary < 2; ++binary)
+    {
+        // 5 is in the range of the node tags, 11 out of it
+        std::string content = gmsh4(binary != 0, 5);
+        EXPECT_FALSE(readGmsh4(content.data(), content.data() + content.size(), binary != 0, 8));
+        content = gmsh4(binary != 0, 11);
+        EXPECT_FALSE(readGmsh4(content.data(), content.data() + content.size(), binary != 0, 8));
+    }
+}
+
+} // namespace meshgmshloader_test
+} // namespace sofa
@@ -0,0 +1,228 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2018 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+
+#include <SofaTest/Sofa_test.h>
+
+#include <SofaGeneralLoader/MeshSTLLoader.h>
+using sofa::component::loader::MeshSTLLoader ;
+
+#include <boost/filesystem.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace sofa
+{
+namespace meshstlloader_test
+{
+
+using sofa::defaulttype::Vector3 ;
+
+std::string tempdir = boost::filesystem::temp_directory_path().string() ;
+
+/// Two facets of a square, the positions of the diagonal are shared
+const float squareFacets[2][12] = {
+    { 0,0,1,  0,0,0,  1,0,0,  1,1,0 },
+    { 0,0,1,  0,0,0,  1,1,0,  0,1,0 }
+};
+
+/// facets: the normal and the three vertices of each facet
+std::string asciiSTL(const float* facets, std::size_t nbFacets)
+{
+    std::ostringstream out;
+    out << "solid test\n";
+    for (std::size_t f = 0; f < nbFacets; ++f)
+    {
+        const float* v = facets + 12*f;
+        out << "  facet normal " << v[0] << " " << v[1] << " " << v[2] << "\n"
+            << "    outer loop\n";
+        for (int j = 0; j < 3; ++j)
+            out << "      vertex " << v[3+3*j] << " " << v[4+3*j] << " " << v[5+3*j] << "\n";
+        out << "    endloop\n"
+            << "  endfacet\n";
+    }
+    out << "endsolid test\n";
+    return out.str();
+}
+
+std::string binarySTL(const float* facets, std::size_t nbFacets)
+{
+    std::string content(80, ' ');
+    const uint32_t n = (uint32_t)nbFacets;
+    content.append((const char*)&n, 4);
+    for (std::size_t f = 0; f < nbFacets; ++f)
+    {
+        content.append((const char*)(facets + 12*f), 12*sizeof(float));
+        content.append(2, '\0');
+    }
+    return content;
+}
+
+void writeFile(const std::string& filename, const std::string& content)
+{
+    std::ofstream out(filename.c_str(), std::ios::out | std::ios::binary);
+    out.write(content.data(), content.size());
+}
+
+class MeshSTLLoader_test : public ::testing::Test, public MeshSTLLoader
+{
+public:
+    std::vector<std::string> files;
+
+    void TearDown()
+    {
+        for (std::size_t i = 0; i < files.size(); ++i)
+            std::remove(files[i].c_str());
+    }
+
+    void checkSquare()
+    {
+        const helper::vector<Vector3>& positions = d_positions.getValue();
+        ASSERT_EQ((size_t)4, positions.size());
+        EXPECT_EQ(Vector3(1,1,0), positions[2]);
+        ASSERT_EQ((size_t)2, d_triangles.getValue().size());
+        EXPECT_EQ(0u, d_triangles.getValue()[1][0]);
+        EXPECT_EQ(2u, d_triangles.getValue()[1][1]);
+        EXPECT_EQ(3u, d_triangles.getValue()[1][2]);
+        ASSERT_EQ((size_t)2, d_normals.getValue().size());
+        EXPECT_EQ(Vector3(0,0,1), d_normals.getValue()[1]);
+    }
+};
+
+/** MeshSTLLoader::readSTL()
+ */
+TEST_F(MeshSTLLoader_test, ReadAscii)
+{
+    const std::string stl = asciiSTL(squareFacets[0], 2);
+    ASSERT_TRUE(readSTL(stl.data(), stl.data() + stl.size()));
+    checkSquare();
+}
+
+/** MeshSTLLoader::readBinarySTL()
+ */
+TEST_F(MeshSTLLoader_test, ReadBinary)
+{
+    const std::string stl = binarySTL(squareFacets[0], 2);
+    ASSERT_TRUE(readBinarySTL(stl.data(), stl.data() + stl.size()));
+    checkSquare();
+
+    // a facet is missing
+    d_positions.setValue(helper::vector<Vector3>());
+    EXPECT_FALSE(readBinarySTL(stl.data(), stl.data() + stl.size() - 1));
+}
+
+/** MeshSTLLoader::readSTL()
+ * A file parsed in several chunks, whatever the number of threads
+ */
+TEST_F(MeshSTLLoader_test, ReadAsciiInChunks)
+{
+    const std::size_t nbFacets = 10000;
+    std::vector<float> facets(12*nbFacets);
+    for (std::size_t k = 0; k < nbFacets; ++k)
+    {
+        const float values[12] = { 0,0,1,  (float)k,0,0,  (float)k+1,0,0,  (float)k,1,0 };
+        std::memcpy(&facets[12*k], values, sizeof(values));
+    }
+    const std::string stl = asciiSTL(facets.data(), nbFacets);
+    ASSERT_TRUE(readSTL(stl.data(), stl.data() + stl.size(), 7));
+
+    // the bottom row and the top row without its last point
+    const helper::vector<Vector3>& positions = d_positions.getValue();
+    EXPECT_EQ(2*nbFacets + 1, positions.size());
+    ASSERT_EQ(nbFacets, d_triangles.getValue().size());
+    ASSERT_EQ(nbFacets, d_normals.getValue().size());
+    for (std::size_t k = 0; k < nbFacets; ++k)
+    {
+        const Triangle& t = d_triangles.getValue()[k];
+        ASSERT_EQ(Vector3(k,0,0), positions[t[0]]) << "facet " << k;
+        ASSERT_EQ(Vector3(k+1,0,0), positions[t[1]]) << "facet " << k;
+        ASSERT_EQ(Vector3(k,1,0), positions[t[2]]) << "facet " << k;
+    }
+}
+
+/** MeshSTLLoader::load()
+ * Ascii and binary files, read again from the binary cache
+ */
+TEST_F(MeshSTLLoader_test, LoadWithBinaryCache)
+{
+    const std::string ascii = tempdir + "/MeshSTLLoader_test_ascii.stl";
+    const std::string binary = tempdir + "/MeshSTLLoader_test_binary.stl";
+    files.push_back(ascii);
+    files.push_back(binary);
+    files.push_back(getBinaryCacheFilename(ascii));
+    files.push_back(getBinaryCacheFilename(binary));
+    writeFile(ascii, asciiSTL(squareFacets[0], 2));
+    writeFile(binary, binarySTL(squareFacets[0], 2));
+
+    const std::string filenames[2] = { ascii, binary };
+    for (int i = 0; i < 2; ++i)
+    {
+        d_binaryCache.setValue(true);
+        setFilename(filenames[i]);
+        ASSERT_TRUE(load());
+        checkSquare();
+        EXPECT_TRUE(boost::filesystem::exists(getBinaryCacheFilename(filenames[i])));
+
+        // read from the cache
+        d_positions.setValue(helper::vector<Vector3>());
+        d_triangles.setValue(helper::vector<Triangle>());
+        d_normals.setValue(helper::vector<Vector3>());
+        ASSERT_TRUE(load());
+        checkSquare();
+    }
+}
+
+/** MeshSTLLoader::load()
+ * A truncated binary cache is ignored and the mesh read from the STL file replaces
+ * the outputs the cache had already filled
+ */
+TEST_F(MeshSTLLoader_test, LoadWithTruncatedBinaryCache)
+{
+    const std::string ascii = tempdir + "/MeshSTLLoader_test_truncated.stl";
+    const std::string cache = getBinaryCacheFilename(ascii);
+    files.push_back(ascii);
+    files.push_back(cache);
+    writeFile(ascii, asciiSTL(squareFacets[0], 2));
+
+    d_binaryCache.setValue(true);
+    setFilename(ascii);
+    ASSERT_TRUE(load());
+    checkSquare();
+
+    // the groups at the end of the cache are missing
+    std::ifstream in(cache.c_str(), std::ios::in | std::ios::binary);
+    const std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+    ASSERT_GT(content.size(), (std::size_t)4);
+    writeFile(cache, content.substr(0, content.size() - 4));
+
+    d_positions.setValue(helper::vector<Vector3>());
+    d_triangles.setValue(helper::vector<Triangle>());
+    d_normals.setValue(helper::vector<Vector3>());
+    ASSERT_TRUE(load());
+    checkSquare();
+}
+
+} // namespace meshstlloader_test
+} // namespace sofa
@@ -0,0 +1,200 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2018 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+
+#include <SofaTest/Sofa_test.h>
+#include <SofaGeneralMeshCollision/TriangleOctree.h>
+#include <SofaMeshCollision/RayTriangleIntersection.h>
+#include <sofa/helper/RandomGenerator.h>
+
+#include <algorithm>
+#include <set>
+
+namespace sofa {
+namespace {
+
+using component::collision::TriangleOctreeRoot;
+using component::collision::RayTriangleIntersection;
+using defaulttype::Vector3;
+typedef TriangleOctreeRoot::traceResult traceResult;
+
+struct TriangleOctree_test : public Sofa_test<>
+{
+    TriangleOctreeRoot::SeqTriangles triangles;
+    TriangleOctreeRoot::VecCoord positions;
+    helper::RandomGenerator random;
+
+    void SetUp()
+    {
+        random.initSeed(7);
+
+        // a bumpy grid of n*n points
+        const int n = 20;
+        for (int i=0; i<n; ++i)
+            for (int j=0; j<n; ++j)
+                positions.push_back(Vector3(i-n/2, j-n/2, random.random<double>(-0.5,0.5)));
+        for (int i=0; i<n-1; ++i)
+            for (int j=0; j<n-1; ++j)
+            {
+                const int a = i*n+j, b = a+n;
+                triangles.push_back(TriangleOctreeRoot::Tri(a, b, a+1));
+                triangles.push_back(TriangleOctreeRoot::Tri(a+1, b, b+1));
+            }
+    }
+
+    Vector3 randomVector(double vmax)
+    {
+        return Vector3(random.random<double>(-vmax,vmax), random.random<double>(-vmax,vmax), random.random<double>(-vmax,vmax));
+    }
+
+    /// random rays crossing the grid from above
+    void randomRays(helper::vector<Vector3>& origins, helper::vector<Vector3>& directions, int nb)
+    {
+        for (int i=0; i<nb; ++i)
+        {
+            origins.push_back(randomVector(8) + Vector3(0,0,20));
+            directions.push_back(randomVector(0.3) - Vector3(0,0,1));
+        }
+    }
+
+    /// all triangles intersected by a ray, sorted by index
+    std::set<int> bruteForceTraceAll(const Vector3& origin, const Vector3& direction, double& nearest, int& nearestTid) const
+    {
+        RayTriangleIntersection intersection;
+        std::set<int> res;
+        nearestTid = -1;
+        for (unsigned int t=0; t<triangles.size(); ++t)
+        {
+            SReal d, u, v;
+            if (!intersection.NewComputation(positions[triangles[t][0]], positions[triangles[t][1]], positions[triangles[t][2]], origin, direction, d, u, v)) continue;
+            res.insert(t);
+            if (nearestTid<0 || d<nearest) { nearest = d; nearestTid = t; }
+        }
+        return res;
+    }
+
+    /// triangles whose bounding box intersects the given box
+    helper::vector<int> bruteForceBBox(const Vector3& bbmin, const Vector3& bbmax) const
+    {
+        helper::vector<int> res;
+        for (unsigned int t=0; t<triangles.size(); ++t)
+        {
+            bool in = true;
+            for (int c=0; c<3; ++c)
+            {
+                const double pmin = std::min(positions[triangles[t][0]][c], std::min(positions[triangles[t][1]][c], positions[triangles[t][2]][c]));
+                const double pmax = std::max(positions[triangles[t][0]][c], std::max(positions[triangles[t][1]][c], positions[triangles[t][2]][c]));
+                if (pmin > bbmax[c] || pmax < bbmin[c]) in = false;
+            }
+            if (in) res.push_back(t);
+        }
+        return res;
+    }
+
+    /// the flat octrees have the same nodes, storing the same triangles (in any order)
+    void expectSameOctree(const TriangleOctreeRoot& a, const TriangleOctreeRoot& b) const
+    {
+        ASSERT_EQ(a.flatNodes.size(), b.flatNodes.size());
+        for (unsigned int i=0; i<a.flatNodes.size(); ++i)
+        {
+            const TriangleOctreeRoot::FlatNode& na = a.flatNodes[i];
+            const TriangleOctreeRoot::FlatNode& nb = b.flatNodes[i];
+            EXPECT_EQ(na.corner, nb.corner) << "node " << i;
+            EXPECT_EQ(na.size, nb.size) << "node " << i;
+            for (int c=0; c<8; ++c) EXPECT_EQ(na.child[c], nb.child[c]) << "node " << i;
+            std::multiset<int> oa(a.flatObjects.begin()+na.objectsBegin, a.flatObjects.begin()+na.objectsEnd);
+            std::multiset<int> ob(b.flatObjects.begin()+nb.objectsBegin, b.flatObjects.begin()+nb.objectsEnd);
+            EXPECT_TRUE(oa == ob) << "node " << i;
+        }
+    }
+};
+
+TEST_F( TriangleOctree_test, refitMatchesFreshBuild )
+{
+    TriangleOctreeRoot refitted;
+    refitted.buildOctree(&triangles, &positions);
+
+    // small moves keep most triangles in their cells, large moves relocate some of them far away
+    for (unsigned int i=0; i<positions.size(); ++i) positions[i] += randomVector(0.05);
+    for (unsigned int i=0; i<positions.size(); i+=37) positions[i] += randomVector(50);
+    refitted.refitOctree();
+
+    TriangleOctreeRoot built;
+    built.buildOctree(&triangles, &positions);
+    expectSameOctree(refitted, built);
+
+    // moving back prunes the cells left empty
+    for (unsigned int i=0; i<positions.size(); i+=37) positions[i] = Vector3(positions[i][0]*0.5, positions[i][1]*0.5, 0);
+    refitted.refitOctree();
+    built.buildOctree();
+    expectSameOctree(refitted, built);
+}
+
+TEST_F( TriangleOctree_test, batchQueriesMatchBruteForce )
+{
+    TriangleOctreeRoot octree;
+    octree.buildOctree(&triangles, &positions);
+
+    helper::vector<Vector3> origins, directions;
+    randomRays(origins, directions, 200);
+
+    helper::vector<traceResult> nearest, nearestSequential;
+    octree.traceBatch(origins, directions, nearest, true);
+    octree.traceBatch(origins, directions, nearestSequential, false);
+    helper::vector< helper::vector<traceResult> > all;
+    octree.traceAllBatch(origins, directions, all, true);
+
+    ASSERT_EQ(nearest.size(), origins.size());
+    ASSERT_EQ(all.size(), origins.size());
+    for (unsigned int i=0; i<origins.size(); ++i)
+    {
+        double t = 0; int tid;
+        std::set<int> expected = bruteForceTraceAll(origins[i], directions[i], t, tid);
+
+        EXPECT_TRUE(nearest[i] == nearestSequential[i]) << "ray " << i;
+        ASSERT_EQ(nearest[i].tid < 0, tid < 0) << "ray " << i;
+        if (tid >= 0)
+        {
+            EXPECT_NEAR(nearest[i].t, t, 1e-10) << "ray " << i;
+        }
+
+        std::set<int> found;
+        for (unsigned int j=0; j<all[i].size(); ++j) found.insert(all[i][j].tid);
+        EXPECT_TRUE(found == expected) << "ray " << i;
+    }
+
+    helper::vector<Vector3> bbmins, bbmaxs;
+    for (int i=0; i<100; ++i)
+    {
+        Vector3 c = randomVector(10), h = randomVector(2);
+        for (int k=0; k<3; ++k) h[k] = std::abs(h[k]);
+        bbmins.push_back(c-h);
+        bbmaxs.push_back(c+h);
+    }
+    helper::vector< helper::vector<int> > boxes;
+    octree.bboxAllCandidatesBatch(bbmins, bbmaxs, boxes, true);
+    ASSERT_EQ(boxes.size(), bbmins.size());
+    for (unsigned int i=0; i<bbmins.size(); ++i)
+        EXPECT_EQ(boxes[i], bruteForceBBox(bbmins[i], bbmaxs[i])) << "box " << i;
+}
+
+}
+} // namespace sofa
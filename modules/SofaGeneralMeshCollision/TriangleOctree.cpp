@@ -31,8 +31,10 @@
 #include <sofa/core/ObjectFactory.h>
 #include <vector>
 #include <sofa/helper/system/thread/CTime.h>
+#include <sofa/helper/IndexOpenMP.h>
 
 #include <cmath>
+#include <algorithm>
 #include <sofa/helper/system/gl.h>
 
 
@@ -84,12 +86,13 @@ void TriangleOctree::draw (const core::visual::VisualParams* vparams)
 #endif /* SOFA_NO_OPENGL */
 }
 
-void TriangleOctree::insert (double _x, double _y, double _z,
+TriangleOctree* TriangleOctree::insert (double _x, double _y, double _z,
         double inc, int t)
 {
     if (inc >= size)
     {
         objects.push_back (t);
+        return this;
     }
     else
     {
@@ -107,7 +110,7 @@ void TriangleOctree::insert (double _x, double _y, double _z,
                         z + dz * size2, size2);
         }
 
-        childVec[i]->insert (_x, _y, _z, inc, t);
+        return childVec[i]->insert (_x, _y, _z, inc, t);
     }
 }
 
@@ -785,6 +788,23 @@ void TriangleOctree::traceAllStart(defaulttype::Vector3 origin, defaulttype::Vec
 }
 
 
+/// test if the bounding box of a triangle intersects the given box
+static inline bool triangleBBoxIntersects(const TriangleOctreeRoot::VecCoord& pos, const TriangleOctreeRoot::Tri& tri,
+        const defaulttype::Vector3 & bbmin, const defaulttype::Vector3 & bbmax)
+{
+    defaulttype::Vector3 tmin = pos[tri[0]];
+    defaulttype::Vector3 tmax = tmin;
+    for (int j=1; j<3; ++j)
+    {
+        defaulttype::Vector3 p = pos[tri[j]];
+        for (int c=0; c<3; ++c)
+                if (p[c] < tmin[c]) tmin[c] = p[c]; else if (p[c] > tmax[c]) tmax[c] = p[c];
+    }
+    return ( tmin[0] <= bbmax[0] && tmax[0] >= bbmin[0] &&
+            tmin[1] <= bbmax[1] && tmax[1] >= bbmin[1] &&
+            tmin[2] <= bbmax[2] && tmax[2] >= bbmin[2]);
+}
+
 void TriangleOctree::bbAllTriangles(const defaulttype::Vector3 & bbmin,
         const defaulttype::Vector3 & bbmax,
         std::set<int>& results)
@@ -794,17 +814,7 @@ void TriangleOctree::bbAllTriangles(const defaulttype::Vector3 & bbmin,
     for (unsigned int i = 0; i < objects.size (); i++)
     {
         int t = objects[i];
-        defaulttype::Vector3 tmin = pos[tri[t][0]];
-        defaulttype::Vector3 tmax = tmin;
-        for (int j=1; j<3; ++j)
-        {
-            defaulttype::Vector3 p = pos[tri[t][j]];
-            for (int c=0; c<3; ++c)
-                    if (p[c] < tmin[c]) tmin[c] = p[c]; else if (p[c] > tmax[c]) tmax[c] = p[c];
-        }
-        if ( tmin[0] <= bbmax[0] && tmax[0] >= bbmin[0] &&
-                tmin[1] <= bbmax[1] && tmax[1] >= bbmin[1] &&
-                tmin[2] <= bbmax[2] && tmax[2] >= bbmin[2])
+        if (triangleBBoxIntersects(pos, tri[t], bbmin, bbmax))
         {
             results.insert(t);
         }
@@ -860,54 +870,263 @@ void TriangleOctreeRoot::buildOctree()
     if (octreeRoot) delete octreeRoot;
     octreeRoot = new TriangleOctree(this);
 
+    triangleCells.clear();
+    triangleNodes.clear();
+    triangleCells.resize(octreeTriangles->size());
+    triangleNodes.resize(octreeTriangles->size());
+
     // for each triangle add it to the octree
     for (size_t i = 0; i < octreeTriangles->size(); i++)
     {
         fillOctree (i);
     }
+
+    flattenOctree();
+}
+
+void TriangleOctreeRoot::refitOctree()
+{
+    if (!this->octreeTriangles || !this->octreePos) return;
+    const int nbTriangles = (int)octreeTriangles->size();
+    if (!octreeRoot || (int)triangleCells.size() != nbTriangles)
+    {
+        buildOctree();
+        return;
+    }
+
+    // the cells are computed in parallel, only the triangles changing of cells modify the octree
+    helper::vector<TriangleCells> newCells(nbTriangles);
+#ifdef _OPENMP
+    #pragma omp parallel for
+#endif
+    for (helper::IndexOpenMP<int>::type i = 0; i < nbTriangles; i++)
+    {
+        calcTriangleCells(i, newCells[i]);
+    }
+
+    bool changed = false;
+    for (int i = 0; i < nbTriangles; i++)
+    {
+        if (newCells[i] == triangleCells[i]) continue;
+        removeTriangle(i);
+        triangleCells[i] = newCells[i];
+        insertTriangle(i, newCells[i]);
+        changed = true;
+    }
+
+    if (changed)
+    {
+        // the cells left by the moved triangles are removed so the octree does not grow with the refits
+        pruneEmptyNodes(octreeRoot);
+        flattenOctree();
+    }
+}
+
+bool TriangleOctreeRoot::pruneEmptyNodes(TriangleOctree* node)
+{
+    bool empty = node->objects.empty();
+    bool leaf = true;
+    for (int i = 0; i < 8; i++)
+    {
+        if (!node->childVec[i]) continue;
+        if (pruneEmptyNodes(node->childVec[i]))
+        {
+            delete node->childVec[i];
+            node->childVec[i] = NULL;
+        }
+        else
+        {
+            empty = false;
+            leaf = false;
+        }
+    }
+    node->is_leaf = leaf;
+    return empty;
 }
 
 int TriangleOctreeRoot::fillOctree (int tId, int /*d*/, defaulttype::Vector3 /*v*/)
 {
-    defaulttype::Vector3 center;
-    defaulttype::Vector3 corner (-cubeSize, -cubeSize, -cubeSize);
+    calcTriangleCells(tId, triangleCells[tId]);
+    insertTriangle(tId, triangleCells[tId]);
+    return 0;
+}
 
+void TriangleOctreeRoot::calcTriangleCells(int tId, TriangleCells& cells) const
+{
     double bb[6];
     double bbsize;
     calcTriangleAABB(tId, bb, bbsize);
 
+    cells = TriangleCells();
+    if (!(bb[0] >= -CUBE_SIZE && bb[2] >= -CUBE_SIZE && bb[4] >= -CUBE_SIZE
+        && bb[1] <= CUBE_SIZE && bb[3] <= CUBE_SIZE && bb[5] <= CUBE_SIZE))
+        return;
+
     // computes the depth of the bounding box in a octree
     int d1 = (int)((log10( (double) CUBE_SIZE * 2/ bbsize ) / log10( (double)2) ));
     // computes the size of the octree box that can store the bounding box
     int divs = (1 << (d1));
     double inc = (double) (2 * CUBE_SIZE) / divs;
-    if (bb[0] >= -CUBE_SIZE && bb[2] >= -CUBE_SIZE && bb[4] >= -CUBE_SIZE
-        && bb[1] <= CUBE_SIZE && bb[3] <= CUBE_SIZE && bb[5] <= CUBE_SIZE)
-        for (double x1 =
-                (((int)((bb[0] + CUBE_SIZE) / inc)) * inc - CUBE_SIZE);
-                x1 <= bb[1]; x1 += inc)
-        {
+    cells.inc = inc;
+    for (int c = 0; c < 3; c++)
+    {
+        cells.begin[c] = (int)((bb[2*c] + CUBE_SIZE) / inc);
+        cells.end[c] = cells.begin[c];
+        while ((cells.end[c]+1) * inc - CUBE_SIZE <= bb[2*c+1])
+            ++cells.end[c];
+    }
+}
 
-            for (double y1 =
-                    ((int)((bb[2] + CUBE_SIZE) / inc)) * inc - CUBE_SIZE;
-                    y1 <= bb[3]; y1 += inc)
+void TriangleOctreeRoot::insertTriangle(int tId, const TriangleCells& cells)
+{
+    helper::vector<TriangleOctree*>& nodes = triangleNodes[tId];
+    nodes.clear();
+    const double inc = cells.inc;
+    for (int ix = cells.begin[0]; ix <= cells.end[0]; ++ix)
+    {
+        for (int iy = cells.begin[1]; iy <= cells.end[1]; ++iy)
+        {
+            for (int iz = cells.begin[2]; iz <= cells.end[2]; ++iz)
             {
+                nodes.push_back(octreeRoot->insert (ix * inc - CUBE_SIZE, iy * inc - CUBE_SIZE, iz * inc - CUBE_SIZE, inc, tId));
+            }
+        }
+    }
+}
 
+void TriangleOctreeRoot::removeTriangle(int tId)
+{
+    helper::vector<TriangleOctree*>& nodes = triangleNodes[tId];
+    for (size_t i = 0; i < nodes.size(); ++i)
+    {
+        helper::vector<int>& objects = nodes[i]->objects;
+        helper::vector<int>::iterator it = std::find(objects.begin(), objects.end(), tId);
+        if (it != objects.end())
+            objects.erase(it);
+    }
+    nodes.clear();
+}
 
-                for (double z1 =
-                        ((int)((bb[4] + CUBE_SIZE) / inc)) * inc - CUBE_SIZE;
-                        z1 <= bb[5]; z1 += inc)
-                {
-                    octreeRoot->insert (x1, y1, z1, inc, tId);
+void TriangleOctreeRoot::flattenOctree()
+{
+    flatNodes.clear();
+    flatObjects.clear();
+    if (octreeRoot)
+        flattenNode(octreeRoot);
+}
 
-                }
+int TriangleOctreeRoot::flattenNode(const TriangleOctree* node)
+{
+    const int index = (int)flatNodes.size();
+    flatNodes.resize(index+1);
+    {
+        FlatNode& n = flatNodes[index];
+        n.corner = defaulttype::Vector3(node->x, node->y, node->z);
+        n.size = node->size;
+        n.objectsBegin = (unsigned int)flatObjects.size();
+        flatObjects.insert(flatObjects.end(), node->objects.begin(), node->objects.end());
+        n.objectsEnd = (unsigned int)flatObjects.size();
+    }
+    // children are added after their parent, the reference on flatNodes[index] must not be kept
+    for (int i = 0; i < 8; i++)
+    {
+        int child = (node->childVec[i] ? flattenNode(node->childVec[i]) : -1);
+        flatNodes[index].child[i] = child;
+    }
+    return index;
+}
+
+void TriangleOctreeRoot::traceBatch(const helper::vector<defaulttype::Vector3>& origins, const helper::vector<defaulttype::Vector3>& directions,
+        helper::vector<traceResult>& results, bool parallel)
+{
+    const int nbRays = (int)origins.size();
+    results.clear();
+    results.resize(nbRays);
+    if (!octreeRoot) return;
+
+#ifdef _OPENMP
+    #pragma omp parallel for if (parallel)
+#else
+    SOFA_UNUSED(parallel);
+#endif
+    for (helper::IndexOpenMP<int>::type i = 0; i < nbRays; i++)
+    {
+        results[i].tid = octreeRoot->trace(origins[i], directions[i], results[i]);
+    }
+}
+
+void TriangleOctreeRoot::traceAllBatch(const helper::vector<defaulttype::Vector3>& origins, const helper::vector<defaulttype::Vector3>& directions,
+        helper::vector< helper::vector<traceResult> >& results, bool parallel)
+{
+    const int nbRays = (int)origins.size();
+    results.clear();
+    results.resize(nbRays);
+    if (!octreeRoot) return;
+
+#ifdef _OPENMP
+    #pragma omp parallel for if (parallel)
+#else
+    SOFA_UNUSED(parallel);
+#endif
+    for (helper::IndexOpenMP<int>::type i = 0; i < nbRays; i++)
+    {
+        octreeRoot->traceAll(origins[i], directions[i], results[i]);
+    }
+}
+
+void TriangleOctreeRoot::bboxAllCandidatesBatch(const helper::vector<defaulttype::Vector3>& bbmins, const helper::vector<defaulttype::Vector3>& bbmaxs,
+        helper::vector< helper::vector<int> >& results, bool parallel) const
+{
+    const int nbBoxes = (int)bbmins.size();
+    results.clear();
+    results.resize(nbBoxes);
+    if (flatNodes.empty()) return;
+
+    const VecCoord& pos = *octreePos;
+    const SeqTriangles& tri = *octreeTriangles;
+
+#ifdef _OPENMP
+    #pragma omp parallel for if (parallel)
+#else
+    SOFA_UNUSED(parallel);
+#endif
+    for (helper::IndexOpenMP<int>::type b = 0; b < nbBoxes; b++)
+    {
+        const defaulttype::Vector3& bbmin = bbmins[b];
+        const defaulttype::Vector3& bbmax = bbmaxs[b];
+        helper::vector<int>& res = results[b];
+        helper::vector<int> stack;
+        stack.push_back(0);
+        while (!stack.empty())
+        {
+            const FlatNode& node = flatNodes[stack.back()];
+            stack.pop_back();
+            for (unsigned int i = node.objectsBegin; i < node.objectsEnd; i++)
+            {
+                int t = flatObjects[i];
+                if (triangleBBoxIntersects(pos, tri[t], bbmin, bbmax))
+                    res.push_back(t);
             }
+            defaulttype::Vector3 c = node.corner + defaulttype::Vector3(node.size/2, node.size/2, node.size/2);
+            int dx0 = (bbmin[0] > c[0]) ? 1 : 0;    int dx1 = (bbmax[0] >= c[0]) ? 1 : 0;
+            int dy0 = (bbmin[1] > c[1]) ? 1 : 0;    int dy1 = (bbmax[1] >= c[1]) ? 1 : 0;
+            int dz0 = (bbmin[2] > c[2]) ? 1 : 0;    int dz1 = (bbmax[2] >= c[2]) ? 1 : 0;
+            for (int dx = dx0; dx <= dx1; ++dx)
+                for (int dy = dy0; dy <= dy1; ++dy)
+                    for (int dz = dz0; dz <= dz1; ++dz)
+                    {
+                        int child = node.child[dx * 4 + dy * 2 + dz];
+                        if (child >= 0)
+                            stack.push_back(child);
+                    }
         }
-    return 0;
-
+        // a triangle can be stored in several cells
+        std::sort(res.begin(), res.end());
+        res.erase(std::unique(res.begin(), res.end()), res.end());
+    }
 }
 
-void TriangleOctreeRoot::calcTriangleAABB(int tId, double* bb, double& size)
+void TriangleOctreeRoot::calcTriangleAABB(int tId, double* bb, double& size) const
 {
     Tri t = (*octreeTriangles)[tId];
     Coord p1 = (*octreePos)[t[0]];
@@ -46,41 +46,7 @@ namespace component
 namespace collision
 {
 
-class TriangleOctree;
-
-class SOFA_GENERAL_MESH_COLLISION_API TriangleOctreeRoot
-{
-public:
-    typedef sofa::core::topology::BaseMeshTopology::SeqTriangles SeqTriangles;
-    typedef sofa::core::topology::BaseMeshTopology::Triangle Tri;
-    typedef sofa::defaulttype::Vec3Types::VecCoord VecCoord;
-    typedef sofa::defaulttype::Vec3Types::Coord Coord;
-    /// the triangles used as input to construct the octree
-    const SeqTriangles* octreeTriangles;
-    /// the positions of vertices used as input to construct the octree
-    const VecCoord* octreePos;
-    /// the first node of the octree
-    TriangleOctree* octreeRoot;
-    /// the size of the octree cube
-    int cubeSize;
-
-    TriangleOctreeRoot();
-    ~TriangleOctreeRoot();
-
-    void buildOctree();
-    void buildOctree(const sofa::core::topology::BaseMeshTopology::SeqTriangles* triangles, const sofa::defaulttype::Vec3Types::VecCoord* pos)
-    {
-        this->octreeTriangles = triangles;
-        this->octreePos = pos;
-        buildOctree();
-    }
-
-protected:
-    /// used to add a triangle  to the octree
-    int fillOctree (int t, int d = 0, defaulttype::Vector3 v = defaulttype::Vector3 (0, 0, 0));
-    /// used to compute the Bounding Box for each triangle
-    void calcTriangleAABB(int t, double* bb, double& size);
-};
+class TriangleOctreeRoot;
 
 class SOFA_GENERAL_MESH_COLLISION_API TriangleOctree
 {
@@ -166,8 +132,104 @@ protected:
     void bbAllTriangles (const defaulttype::Vector3 & bbmin,
             const defaulttype::Vector3 & bbmax, std::set<int>& results);
 
-    void insert (double _x, double _y, double _z, double _inc, int t);
+    /// returns the node in which the triangle was stored
+    TriangleOctree* insert (double _x, double _y, double _z, double _inc, int t);
+
+};
 
+class SOFA_GENERAL_MESH_COLLISION_API TriangleOctreeRoot
+{
+public:
+    typedef sofa::core::topology::BaseMeshTopology::SeqTriangles SeqTriangles;
+    typedef sofa::core::topology::BaseMeshTopology::Triangle Tri;
+    typedef sofa::defaulttype::Vec3Types::VecCoord VecCoord;
+    typedef sofa::defaulttype::Vec3Types::Coord Coord;
+    /// the triangles used as input to construct the octree
+    const SeqTriangles* octreeTriangles;
+    /// the positions of vertices used as input to construct the octree
+    const VecCoord* octreePos;
+    /// the first node of the octree
+    TriangleOctree* octreeRoot;
+    /// the size of the octree cube
+    int cubeSize;
+
+    typedef TriangleOctree::traceResult traceResult;
+
+    /// a node of the octree stored in a flat array, children are given by their index in the array (-1 if none)
+    struct FlatNode
+    {
+        defaulttype::Vector3 corner;
+        double size;
+        int child[8];
+        /// range of the triangles of this node in flatObjects
+        unsigned int objectsBegin, objectsEnd;
+    };
+    /// the nodes of the octree in depth-first order, updated after each build or refit
+    helper::vector<FlatNode> flatNodes;
+    /// the triangles stored in the nodes of flatNodes
+    helper::vector<int> flatObjects;
+
+    TriangleOctreeRoot();
+    ~TriangleOctreeRoot();
+
+    void buildOctree();
+    void buildOctree(const sofa::core::topology::BaseMeshTopology::SeqTriangles* triangles, const sofa::defaulttype::Vec3Types::VecCoord* pos)
+    {
+        this->octreeTriangles = triangles;
+        this->octreePos = pos;
+        buildOctree();
+    }
+
+    /// Update the octree after the vertices moved, only the triangles changing of cells are reinserted
+    /// and the cells left empty are removed.
+    /// The octree is fully rebuilt if the number of triangles changed.
+    void refitOctree();
+
+    /// Find the nearest triangle intersecting each ray (the tid of a result is -1 if not found)
+    void traceBatch(const helper::vector<defaulttype::Vector3>& origins, const helper::vector<defaulttype::Vector3>& directions,
+            helper::vector<traceResult>& results, bool parallel = true);
+
+    /// Find all triangles intersecting each ray
+    void traceAllBatch(const helper::vector<defaulttype::Vector3>& origins, const helper::vector<defaulttype::Vector3>& directions,
+            helper::vector< helper::vector<traceResult> >& results, bool parallel = true);
+
+    /// Find all triangles whose bounding box intersects each given box, using the flat node array
+    void bboxAllCandidatesBatch(const helper::vector<defaulttype::Vector3>& bbmins, const helper::vector<defaulttype::Vector3>& bbmaxs,
+            helper::vector< helper::vector<int> >& results, bool parallel = true) const;
+
+protected:
+    /// the range of cells of the octree covering the bounding box of a triangle
+    struct TriangleCells
+    {
+        TriangleCells() : inc(0) { for (int i=0; i<3; ++i) { begin[i] = 0; end[i] = -1; } }
+        double inc;
+        int begin[3], end[3];
+        bool operator==(const TriangleCells& c) const
+        {
+            return inc == c.inc
+                    && begin[0] == c.begin[0] && begin[1] == c.begin[1] && begin[2] == c.begin[2]
+                    && end[0] == c.end[0] && end[1] == c.end[1] && end[2] == c.end[2];
+        }
+        bool operator!=(const TriangleCells& c) const { return !(*this == c); }
+    };
+    /// the cells covered by each triangle when it was inserted
+    helper::vector<TriangleCells> triangleCells;
+    /// the nodes storing each triangle
+    helper::vector< helper::vector<TriangleOctree*> > triangleNodes;
+
+    /// used to add a triangle  to the octree
+    int fillOctree (int t, int d = 0, defaulttype::Vector3 v = defaulttype::Vector3 (0, 0, 0));
+    /// used to compute the Bounding Box for each triangle
+    void calcTriangleAABB(int t, double* bb, double& size) const;
+    /// used to compute the cells of the octree covering a triangle
+    void calcTriangleCells(int t, TriangleCells& cells) const;
+    void insertTriangle(int t, const TriangleCells& cells);
+    void removeTriangle(int t);
+    /// delete the children of node storing no triangle, returns true if node itself is empty
+    bool pruneEmptyNodes(TriangleOctree* node);
+    /// update flatNodes and flatObjects from the pointer-based octree
+    void flattenOctree();
+    int flattenNode(const TriangleOctree* node);
 };
 
 } // namespace collision
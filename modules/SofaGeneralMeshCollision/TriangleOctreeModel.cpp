@@ -88,15 +88,18 @@ void TriangleOctreeModel::draw (const core::visual::VisualParams* vparams)
 void TriangleOctreeModel::computeBoundingTree(int maxDepth)
 {
     const helper::vector<topology::Triangle>& tri = *triangles;
-    if(octreeRoot)
-    {
-        delete octreeRoot;
-        octreeRoot=NULL;
-    }
 
     CubeModel* cubeModel = createPrevious<CubeModel>();
     updateFromTopology();
 
+    // the octree is only updated for the triangles that moved to other cells
+    if(octreeRoot)
+    {
+        this->octreeTriangles = &this->getTriangles();
+        this->octreePos = &this->getX();
+        refitOctree();
+    }
+
     if (!isMoving() && !cubeModel->empty()) return; // No need to recompute BBox if immobile
     int size2=mstate->getSize();
     pNorms.resize(size2);
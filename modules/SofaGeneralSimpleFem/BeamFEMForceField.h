@@ -204,6 +204,7 @@ protected:
     Data<Real> _radiusInner; ///< inner radius of the section for hollow beams
     Data< VecIndex > _list_segment; ///< apply the forcefield to a subset list of beam segments. If no segment defined, forcefield applies to the whole topology
     Data< bool> _useSymmetricAssembly; ///< use symmetric assembly of the matrix K
+    Data< bool> _parallel; ///< process beams concurrently in addForce, addDForce and addKToMatrix
     bool _partial_list_segment;
 
     bool _updateStiffnessMatrix;
@@ -224,6 +225,18 @@ protected:
     sofa::core::topology::BaseMeshTopology* _topology;
     BeamFFEdgeHandler* edgeHandler;
 
+    /// groups of beams sharing no node, processed concurrently when parallel is set
+    helper::vector<VecIndex> _beamColors;
+    int _beamColorsRevision; ///< topology revision _beamColors was computed for, -1 if outdated
+
+    typedef defaulttype::Mat<6, 6, Real> Block;
+    /// -k*K of each processed beam split in 6x6 blocks (aa, ab, ba, bb), filled by addKToMatrix
+    helper::vector<Block> _beamBlocks;
+    /// (row id, value id) of each beam block in the compressed matrix it was last added to
+    helper::vector< std::pair<int,int> > _blockIndexCache;
+    const defaulttype::BaseMatrix* _blockIndexMatrix;
+    unsigned int _blockIndexOffset;
+
 
     BeamFEMForceField();
     BeamFEMForceField(Real poissonRatio, Real youngModulus, Real radius, Real radiusInner);
@@ -250,6 +263,8 @@ public:
 
     void draw(const core::visual::VisualParams* vparams) override;
     void computeBBox(const core::ExecParams* params, bool onlyVisible) override;
+    /// Adds the beam data, the stiffness blocks and assembly caches, which the Data footprints do not count
+    size_t getMemoryFootprint() const override;
 
     void setBeam(unsigned int i, double E, double L, double nu, double r, double rInner);
     void initBeams(unsigned int size);
@@ -258,6 +273,17 @@ protected:
 
     void drawElement(int i, std::vector< defaulttype::Vector3 >* points, const VecCoord& x);
 
+    /// number of beams the forcefield applies to (listSegment or the whole topology)
+    unsigned int getNbProcessedBeams() const
+    {
+        return _partial_list_segment ? (unsigned int)_list_segment.getValue().size() : (unsigned int)_indexedElements->size();
+    }
+
+    void updateBeamColors();
+    void computeStiffnessBlocks(Real k);
+    template<class TBlocMatrix>
+    void addBlocksToMatrix(TBlocMatrix* mat, unsigned int offset);
+
     //void computeStrainDisplacement( StrainDisplacement &J, Coord a, Coord b, Coord c, Coord d );
     Real peudo_determinant_for_coef ( const defaulttype::Mat<2, 3, Real>&  M );
 
@@ -275,9 +301,9 @@ protected:
     //vector<Quat> _beamQuat;
     void initLarge(int i, Index a, Index b);
     //void computeRotationLarge( Transformation &r, const Vector &p, Index a, Index b);
-    void accumulateForceLarge( VecDeriv& f, const VecCoord& x, int i, Index a, Index b);
+    void accumulateForceLarge( VecDeriv& f, const VecCoord& x, const VecCoord& x0, BeamInfo& beam, Index a, Index b);
     //void accumulateDampingLarge( Vector& f, Index elementIndex );
-    void applyStiffnessLarge( VecDeriv& f, const VecDeriv& x, int i, Index a, Index b, double fact=1.0);
+    void applyStiffnessLarge( VecDeriv& f, const VecDeriv& x, const BeamInfo& beam, Index a, Index b, double fact=1.0);
 
     //sofa::helper::vector< sofa::helper::vector <Real> > subMatrix(unsigned int fr, unsigned int lr, unsigned int fc, unsigned int lc);
 };
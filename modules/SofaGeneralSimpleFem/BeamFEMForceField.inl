@@ -27,13 +27,16 @@
 #include <sofa/core/visual/VisualParams.h>
 #include <sofa/core/topology/BaseMeshTopology.h>
 #include <SofaBaseTopology/GridTopology.h>
+#include <SofaBaseLinearSolver/CompressedRowSparseMatrix.h>
 #include <sofa/simulation/Simulation.h>
 #include <sofa/helper/gl/template.h>
 #include <sofa/helper/gl/Axis.h>
 #include <sofa/helper/rmath.h>
+#include <sofa/helper/IndexOpenMP.h>
 #include <assert.h>
 #include <iostream>
 #include <set>
+#include <algorithm>
 #include <sofa/helper/system/gl.h>
 #include <sofa/core/behavior/MechanicalState.h>
 #include <sofa/defaulttype/VecTypes.h>
@@ -66,10 +69,14 @@ BeamFEMForceField<DataTypes>::BeamFEMForceField()
     , _radiusInner(initData(&_radiusInner,(Real)0.0,"radiusInner","inner radius of the section for hollow beams"))
     , _list_segment(initData(&_list_segment,"listSegment", "apply the forcefield to a subset list of beam segments. If no segment defined, forcefield applies to the whole topology"))
     , _useSymmetricAssembly(initData(&_useSymmetricAssembly,false,"useSymmetricAssembly","use symmetric assembly of the matrix K"))
+    , _parallel(initData(&_parallel,false,"parallel","process beams concurrently (OpenMP) in addForce, addDForce and addKToMatrix"))
     , _partial_list_segment(false)
     , _updateStiffnessMatrix(true)
     , _assembling(false)
     , edgeHandler(NULL)
+    , _beamColorsRevision(-1)
+    , _blockIndexMatrix(NULL)
+    , _blockIndexOffset(0)
 {
     edgeHandler = new BeamFFEdgeHandler(this, &beamsData);
 
@@ -89,10 +96,14 @@ BeamFEMForceField<DataTypes>::BeamFEMForceField(Real poissonRatio, Real youngMod
     , _radiusInner(initData(&_radiusInner,(Real)radiusInner,"radiusInner","inner radius of the section for hollow beams"))
     , _list_segment(initData(&_list_segment,"listSegment", "apply the forcefield to a subset list of beam segments. If no segment defined, forcefield applies to the whole topology"))
     , _useSymmetricAssembly(initData(&_useSymmetricAssembly,false,"useSymmetricAssembly","use symmetric assembly of the matrix K"))
+    , _parallel(initData(&_parallel,false,"parallel","process beams concurrently (OpenMP) in addForce, addDForce and addKToMatrix"))
     , _partial_list_segment(false)
     , _updateStiffnessMatrix(true)
     , _assembling(false)
     , edgeHandler(NULL)
+    , _beamColorsRevision(-1)
+    , _blockIndexMatrix(NULL)
+    , _blockIndexOffset(0)
 {
     edgeHandler = new BeamFFEdgeHandler(this, &beamsData);
 
@@ -179,6 +190,8 @@ void BeamFEMForceField<DataTypes>::reinit()
     initBeams( n );
     for (unsigned int i=0; i<n; ++i)
         reinitBeam(i);
+    _beamColorsRevision = -1;
+    _blockIndexMatrix = NULL;
     msg_info() << "reinit OK, "<<n<<" elements." ;
 }
 
@@ -224,38 +237,49 @@ void BeamFEMForceField<DataTypes>::addForce(const sofa::core::MechanicalParams*
 {
     VecDeriv& f = *(dataF.beginEdit());
     const VecCoord& p=dataX.getValue();
+    const VecCoord& x0 = this->mstate->read(core::ConstVecCoordId::restPosition())->getValue();
     f.resize(p.size());
 
-    //// First compute each node rotation
-    typename VecElement::const_iterator it;
+    // the beam rotations are updated here, take the container once instead of once per beam
+    helper::vector<BeamInfo>& bd = *(beamsData.beginEdit());
+    const VecElement& elements = *_indexedElements;
 
-    if (_partial_list_segment)
-    {
+    if (_parallel.getValue())
+        updateBeamColors();
 
-        for (unsigned int j=0; j<_list_segment.getValue().size(); j++)
+    if (_parallel.getValue() && !_beamColors.empty())
+    {
+        // beams of a same color share no node and can accumulate their forces concurrently
+        for (unsigned int c = 0; c < _beamColors.size(); ++c)
         {
-            unsigned int i = _list_segment.getValue()[j];
-            Element edge= (*_indexedElements)[i];
-            Index a = edge[0];
-            Index b = edge[1];
-            initLarge(i,a,b);
-            accumulateForceLarge( f, p, i, a, b );
+            const VecIndex& color = _beamColors[c];
+            const int nbColorBeams = (int)color.size();
+#ifdef _OPENMP
+            #pragma omp parallel for
+#endif
+            for (helper::IndexOpenMP<int>::type j = 0; j < nbColorBeams; ++j)
+            {
+                const unsigned int i = color[j];
+                accumulateForceLarge( f, p, x0, bd[i], elements[i][0], elements[i][1] );
+            }
         }
     }
-    else
+    else if (_partial_list_segment)
     {
-        unsigned int i;
-        for(it=_indexedElements->begin(),i=0; it!=_indexedElements->end(); ++it,++i)
+        const VecIndex& list = _list_segment.getValue();
+        for (unsigned int j=0; j<list.size(); j++)
         {
-
-            Index a = (*it)[0];
-            Index b = (*it)[1];
-
-            initLarge(i,a,b);
-            accumulateForceLarge( f, p, i, a, b );
+            unsigned int i = list[j];
+            accumulateForceLarge( f, p, x0, bd[i], elements[i][0], elements[i][1] );
         }
     }
+    else
+    {
+        for (unsigned int i=0; i<elements.size(); ++i)
+            accumulateForceLarge( f, p, x0, bd[i], elements[i][0], elements[i][1] );
+    }
 
+    beamsData.endEdit();
     dataF.endEdit();
 }
 
@@ -268,34 +292,83 @@ void BeamFEMForceField<DataTypes>::addDForce(const sofa::core::MechanicalParams
 
     df.resize(dx.size());
 
-    if (_partial_list_segment)
+    const helper::vector<BeamInfo>& bd = beamsData.getValue();
+    const VecElement& elements = *_indexedElements;
+
+    if (_parallel.getValue())
+        updateBeamColors();
+
+    if (_parallel.getValue() && !_beamColors.empty())
     {
-        for (unsigned int j=0; j<_list_segment.getValue().size(); j++)
+        for (unsigned int c = 0; c < _beamColors.size(); ++c)
         {
-            unsigned int i = _list_segment.getValue()[j];
-            Element edge= (*_indexedElements)[i];
-            Index a = edge[0];
-            Index b = edge[1];
-
-            applyStiffnessLarge(df, dx, i, a, b, kFactor);
+            const VecIndex& color = _beamColors[c];
+            const int nbColorBeams = (int)color.size();
+#ifdef _OPENMP
+            #pragma omp parallel for
+#endif
+            for (helper::IndexOpenMP<int>::type j = 0; j < nbColorBeams; ++j)
+            {
+                const unsigned int i = color[j];
+                applyStiffnessLarge( df, dx, bd[i], elements[i][0], elements[i][1], kFactor );
+            }
         }
     }
-    else
+    else if (_partial_list_segment)
     {
-        typename VecElement::const_iterator it;
-        unsigned int i = 0;
-        for(it = _indexedElements->begin() ; it != _indexedElements->end() ; ++it, ++i)
+        const VecIndex& list = _list_segment.getValue();
+        for (unsigned int j=0; j<list.size(); j++)
         {
-            Index a = (*it)[0];
-            Index b = (*it)[1];
-
-            applyStiffnessLarge(df, dx, i, a, b, kFactor);
+            unsigned int i = list[j];
+            applyStiffnessLarge( df, dx, bd[i], elements[i][0], elements[i][1], kFactor );
         }
     }
+    else
+    {
+        for (unsigned int i=0; i<elements.size(); ++i)
+            applyStiffnessLarge( df, dx, bd[i], elements[i][0], elements[i][1], kFactor );
+    }
 
     datadF.endEdit();
 }
 
+template<class DataTypes>
+void BeamFEMForceField<DataTypes>::updateBeamColors()
+{
+    const int revision = _topology->getRevision();
+    if (_beamColorsRevision == revision) return;
+    _beamColorsRevision = revision;
+    _beamColors.clear();
+
+    const VecElement& elements = *_indexedElements;
+    const unsigned int nbBeams = getNbProcessedBeams();
+    const VecIndex& list = _list_segment.getValue();
+
+    // bit c of usedColors[p] is set if a beam of color c contains the point p
+    helper::vector<unsigned long long> usedColors(this->mstate->getSize(), 0);
+    for (unsigned int j=0; j<nbBeams; ++j)
+    {
+        const unsigned int i = _partial_list_segment ? list[j] : j;
+        const Index a = elements[i][0];
+        const Index b = elements[i][1];
+        if (std::max(a,b) >= usedColors.size()) usedColors.resize(std::max(a,b)+1, 0);
+        const unsigned long long used = usedColors[a] | usedColors[b];
+        unsigned int c = 0;
+        while (c < 64 && (used & (1ULL << c))) ++c;
+        if (c == 64)
+        {
+            serr << "Too many beam colors, forces will not be computed in parallel" << sendl;
+            _beamColors.clear();
+            return;
+        }
+        usedColors[a] |= (1ULL << c);
+        usedColors[b] |= (1ULL << c);
+        if (c >= _beamColors.size())
+            _beamColors.resize(c+1);
+        _beamColors[c].push_back(i);
+    }
+}
+
 template<class DataTypes>
 typename BeamFEMForceField<DataTypes>::Real BeamFEMForceField<DataTypes>::peudo_determinant_for_coef ( const defaulttype::Mat<2, 3, Real>&  M )
 {
@@ -421,14 +494,10 @@ void BeamFEMForceField<DataTypes>::initLarge(int i, Index a, Index b)
 }
 
 template<class DataTypes>
-void BeamFEMForceField<DataTypes>::accumulateForceLarge( VecDeriv& f, const VecCoord & x, int i, Index a, Index b )
+void BeamFEMForceField<DataTypes>::accumulateForceLarge( VecDeriv& f, const VecCoord & x, const VecCoord& x0, BeamInfo& beam, Index a, Index b )
 {
-    const VecCoord& x0 = this->mstate->read(core::ConstVecCoordId::restPosition())->getValue();
-
-    beamQuat(i)= x[a].getOrientation();
-    beamQuat(i).normalize();
-
-    beamsData.endEdit();
+    beam.quat = x[a].getOrientation();
+    beam.quat.normalize();
 
     defaulttype::Vec<3,Real> u, P1P2, P1P2_0;
     // local displacement
@@ -469,7 +538,7 @@ void BeamFEMForceField<DataTypes>::accumulateForceLarge( VecDeriv& f, const VecC
     depl[9] = u[0]; depl[10]= u[1]; depl[11]= u[2];
 
     // this computation can be optimised: (we know that half of "depl" is null)
-    Displacement force = beamsData.getValue()[i]._k_loc * depl;
+    Displacement force = beam._k_loc * depl;
 
 
     // Apply lambda transpose (we use the rotation value of point a for the beam)
@@ -487,13 +556,13 @@ void BeamFEMForceField<DataTypes>::accumulateForceLarge( VecDeriv& f, const VecC
 }
 
 template<class DataTypes>
-void BeamFEMForceField<DataTypes>::applyStiffnessLarge(VecDeriv& df, const VecDeriv& dx, int i, Index a, Index b, double fact)
+void BeamFEMForceField<DataTypes>::applyStiffnessLarge(VecDeriv& df, const VecDeriv& dx, const BeamInfo& beam, Index a, Index b, double fact)
 {
     //const VecCoord& x = this->mstate->read(core::ConstVecCoordId::position())->getValue();
 
     Displacement local_depl;
     defaulttype::Vec<3,Real> u;
-    defaulttype::Quat& q = beamQuat(i); //x[a].getOrientation();
+    defaulttype::Quat q = beam.quat; //x[a].getOrientation();
     q.normalize();
 
     u = q.inverseRotate(getVCenter(dx[a]));
@@ -516,7 +585,7 @@ void BeamFEMForceField<DataTypes>::applyStiffnessLarge(VecDeriv& df, const VecDe
     local_depl[10] = u[1];
     local_depl[11] = u[2];
 
-    Displacement local_force = beamsData.getValue()[i]._k_loc * local_depl;
+    Displacement local_force = beam._k_loc * local_depl;
 
     Vec3 fa1 = q.rotate(defaulttype::Vec3d(local_force[0],local_force[1] ,local_force[2] ));
     Vec3 fa2 = q.rotate(defaulttype::Vec3d(local_force[3],local_force[4] ,local_force[5] ));
@@ -535,118 +604,167 @@ void BeamFEMForceField<DataTypes>::addKToMatrix(const sofa::core::MechanicalPara
     Real k = (Real)mparams->kFactorIncludingRayleighDamping(this->rayleighStiffness.getValue());
     defaulttype::BaseMatrix* mat = r.matrix;
 
-    if (r)
-    {
-        unsigned int i=0;
+    if (!r) return;
 
-        unsigned int &offset = r.offset;
+    const unsigned int offset = r.offset;
 
-        if (_partial_list_segment)
+    computeStiffnessBlocks(k);
+
+    // aligned 6x6 block matrices get whole blocks instead of 144 scalar insertions per beam
+    if (offset % 6 == 0)
+    {
+        if (linearsolver::CompressedRowSparseMatrix<defaulttype::Mat<6,6,double> > * crsmat = dynamic_cast<linearsolver::CompressedRowSparseMatrix<defaulttype::Mat<6,6,double> > * >(mat))
+        {
+            addBlocksToMatrix(crsmat, offset);
+            return;
+        }
+        else if (linearsolver::CompressedRowSparseMatrix<defaulttype::Mat<6,6,float> > * crsmat = dynamic_cast<linearsolver::CompressedRowSparseMatrix<defaulttype::Mat<6,6,float> > * >(mat))
         {
+            addBlocksToMatrix(crsmat, offset);
+            return;
+        }
+    }
 
-            for (unsigned int j=0; j<_list_segment.getValue().size(); j++)
-            {
+    const VecElement& elements = *_indexedElements;
+    const VecIndex& list = _list_segment.getValue();
+    const unsigned int nbBeams = getNbProcessedBeams();
+    for (unsigned int j=0; j<nbBeams; ++j)
+    {
+        const unsigned int i = _partial_list_segment ? list[j] : j;
+        const Index node[2] = { elements[i][0], elements[i][1] };
+        for (int n=0; n<4; ++n)
+        {
+            const Block& block = _beamBlocks[4*j+n];
+            const int row = offset + node[n/2]*6;
+            const int col = offset + node[n%2]*6;
+            for (int x1=0; x1<6; ++x1)
+                for (int y1=0; y1<6; ++y1)
+                    mat->add(row+x1, col+y1, block[x1][y1]);
+        }
+    }
+}
 
-                i = _list_segment.getValue()[j];
-                Element edge= (*_indexedElements)[i];
-                Index a = edge[0];
-                Index b = edge[1];
-
-                Displacement local_depl;
-                defaulttype::Vec3d u;
-                defaulttype::Quat& q = beamQuat(i); //x[a].getOrientation();
-                q.normalize();
-                Transformation R,Rt;
-                q.toMatrix(R);
-                Rt.transpose(R);
-                const StiffnessMatrix& K0 = beamsData.getValue()[i]._k_loc;
-                StiffnessMatrix K;
-                for (int x1=0; x1<12; x1+=3)
-                    for (int y1=0; y1<12; y1+=3)
-                    {
-                        defaulttype::Mat<3,3,Real> m;
-                        K0.getsub(x1,y1, m);
-                        m = R*m*Rt;
-                        K.setsub(x1,y1, m);
-                    }
-                int index[12];
-                for (int x1=0; x1<6; x1++)
-                    index[x1] = offset+a*6+x1;
-                for (int x1=0; x1<6; x1++)
-                    index[6+x1] = offset+b*6+x1;
-                for (int x1=0; x1<12; ++x1)
-                    for (int y1=0; y1<12; ++y1)
-                        mat->add(index[x1], index[y1], - K(x1,y1)*k);
+template<class DataTypes>
+void BeamFEMForceField<DataTypes>::computeStiffnessBlocks(Real k)
+{
+    const helper::vector<BeamInfo>& bd = beamsData.getValue();
+    const VecIndex& list = _list_segment.getValue();
+    const bool exploitSymmetry = _useSymmetricAssembly.getValue();
+    const int nbBeams = (int)getNbProcessedBeams();
+    _beamBlocks.resize(4*nbBeams);
+
+    // each beam only writes its own blocks
+#ifdef _OPENMP
+    #pragma omp parallel for if (_parallel.getValue())
+#endif
+    for (helper::IndexOpenMP<int>::type j = 0; j < nbBeams; ++j)
+    {
+        const unsigned int i = _partial_list_segment ? list[j] : j;
+        defaulttype::Quat q = bd[i].quat; //x[a].getOrientation();
+        q.normalize();
+        Transformation R,Rt;
+        q.toMatrix(R);
+        Rt.transpose(R);
+        const StiffnessMatrix& K0 = bd[i]._k_loc;
+        StiffnessMatrix K;
+
+        if (exploitSymmetry) {
+            for (int x1=0; x1<12; x1+=3) {
+                for (int y1=x1; y1<12; y1+=3)
+                {
+                    defaulttype::Mat<3,3,Real> m;
+                    K0.getsub(x1,y1, m);
+                    m = R*m*Rt;
+
+                    for (int x2=0; x2<3; x2++)
+                        for (int y2=0; y2<3; y2++) {
+                            K.elems[x2+x1][y2+y1] += m[x2][y2];
+                            K.elems[y2+y1][x2+x1] += m[x2][y2];
+                        }
+                    if (x1 == y1)
+                        for (int x2=0; x2<3; x2++)
+                            for (int y2=0; y2<3; y2++)
+                                K.elems[x2+x1][y2+y1] *= double(0.5);
 
+                }
+            }
+        } else  {
+            for (int x1=0; x1<12; x1+=3) {
+                for (int y1=0; y1<12; y1+=3)
+                {
+                    defaulttype::Mat<3,3,Real> m;
+                    K0.getsub(x1,y1, m);
+                    m = R*m*Rt;
+                    K.setsub(x1,y1, m);
+                }
             }
-
         }
-        else
+
+        for (int n=0; n<4; ++n)
         {
-            typename VecElement::const_iterator it;
-            for(it = _indexedElements->begin() ; it != _indexedElements->end() ; ++it, ++i)
-            {
-                Index a = (*it)[0];
-                Index b = (*it)[1];
-
-
-                //Displacement local_depl;
-                //defaulttype::Vec3d u;
-                defaulttype::Quat& q = beamQuat(i); //x[a].getOrientation();
-                q.normalize();
-                Transformation R,Rt;
-                q.toMatrix(R);
-                Rt.transpose(R);
-                const StiffnessMatrix& K0 = beamsData.getValue()[i]._k_loc;
-                StiffnessMatrix K;
-                bool exploitSymmetry = _useSymmetricAssembly.getValue();
-
-                if (exploitSymmetry) {
-                    for (int x1=0; x1<12; x1+=3) {
-                        for (int y1=x1; y1<12; y1+=3)
-                        {
-                            defaulttype::Mat<3,3,Real> m;
-                            K0.getsub(x1,y1, m);
-                            m = R*m*Rt;
-
-                            for (int i=0; i<3; i++)
-                                for (int j=0; j<3; j++) {
-                                    K.elems[i+x1][j+y1] += m[i][j];
-                                    K.elems[j+y1][i+x1] += m[i][j];
-                                }
-                            if (x1 == y1)
-                                for (int i=0; i<3; i++)
-                                    for (int j=0; j<3; j++)
-                                        K.elems[i+x1][j+y1] *= double(0.5);
+            Block& block = _beamBlocks[4*j+n];
+            K.getsub((n/2)*6, (n%2)*6, block);
+            block *= -k;
+        }
+    }
+}
 
-                        }
-                    }
-                } else  {
-                    for (int x1=0; x1<12; x1+=3) {
-                        for (int y1=0; y1<12; y1+=3)
-                        {
-                            defaulttype::Mat<3,3,Real> m;
-                            K0.getsub(x1,y1, m);
-                            m = R*m*Rt;
-                            K.setsub(x1,y1, m);
-                        }
-                    }
-                }
+template<class DataTypes>
+template<class TBlocMatrix>
+void BeamFEMForceField<DataTypes>::addBlocksToMatrix(TBlocMatrix* mat, unsigned int offset)
+{
+    typedef typename TBlocMatrix::Bloc MatBlock;
+    typedef typename TBlocMatrix::VecIndex MatVecIndex;
+
+    const VecElement& elements = *_indexedElements;
+    const VecIndex& list = _list_segment.getValue();
+    const unsigned int nbBeams = getNbProcessedBeams();
+    const int offd6 = offset/6;
+
+    // The matrix keeps its structure from one assembly to the next, so the block
+    // positions found last time are reused. They are checked against the current
+    // structure before being used and looked up again if it changed.
+    if (_blockIndexMatrix != mat || _blockIndexOffset != offset || _blockIndexCache.size() != 4*nbBeams)
+    {
+        _blockIndexCache.assign(4*nbBeams, std::make_pair(-1,-1));
+        _blockIndexMatrix = mat;
+        _blockIndexOffset = offset;
+    }
 
-                int index[12];
-                for (int x1=0; x1<6; x1++)
-                    index[x1] = offset+a*6+x1;
-                for (int x1=0; x1<6; x1++)
-                    index[6+x1] = offset+b*6+x1;
-                for (int x1=0; x1<12; ++x1)
-                    for (int y1=0; y1<12; ++y1)
-                        mat->add(index[x1], index[y1], - K(x1,y1)*k);
+    const MatVecIndex& rowIndex = mat->getRowIndex();
+    const MatVecIndex& rowBegin = mat->getRowBegin();
+    const MatVecIndex& colsIndex = mat->getColsIndex();
 
+    for (unsigned int j=0; j<nbBeams; ++j)
+    {
+        const unsigned int i = _partial_list_segment ? list[j] : j;
+        const int node[2] = { offd6 + (int)elements[i][0], offd6 + (int)elements[i][1] };
+        for (int n=0; n<4; ++n)
+        {
+            const int bi = node[n/2];
+            const int bj = node[n%2];
+            std::pair<int,int>& id = _blockIndexCache[4*j+n];
+            if (id.first < 0 || id.first >= (int)rowIndex.size() || rowIndex[id.first] != bi
+                || id.second < rowBegin[id.first] || id.second >= rowBegin[id.first+1] || colsIndex[id.second] != bj)
+            {
+                id = std::make_pair(-1,-1);
+                typename MatVecIndex::const_iterator row = std::lower_bound(rowIndex.begin(), rowIndex.end(), bi);
+                if (row != rowIndex.end() && *row == bi)
+                {
+                    const int rowId = (int)(row - rowIndex.begin());
+                    typename MatVecIndex::const_iterator colEnd = colsIndex.begin() + rowBegin[rowId+1];
+                    typename MatVecIndex::const_iterator col = std::lower_bound(colsIndex.begin() + rowBegin[rowId], colEnd, bj);
+                    if (col != colEnd && *col == bj)
+                        id = std::make_pair(rowId, (int)(col - colsIndex.begin()));
+                }
             }
-        }
 
+            if (id.second >= 0)
+                mat->colsValue[id.second] += MatBlock(_beamBlocks[4*j+n]);
+            else // not in the compressed structure yet, stored as a temporary block until the next compress()
+                *mat->wbloc(bi, bj, true) += MatBlock(_beamBlocks[4*j+n]);
+        }
     }
-
 }
 
 
@@ -675,6 +793,19 @@ void BeamFEMForceField<DataTypes>::draw(const core::visual::VisualParams* vparam
     vparams->drawTool()->drawLines(points[2], 1, defaulttype::Vec<4,float>(0,0,1,1));
 }
 
+template<class DataTypes>
+size_t BeamFEMForceField<DataTypes>::getMemoryFootprint() const
+{
+    size_t bytes = Inherit1::getMemoryFootprint();
+    // BeamInfo has no type info, the Data of the beams is not counted by the base class
+    bytes += beamsData.getValue().size() * sizeof(BeamInfo);
+    bytes += _beamBlocks.size() * sizeof(Block);
+    bytes += _blockIndexCache.size() * sizeof(std::pair<int,int>);
+    for (unsigned int c = 0; c < _beamColors.size(); ++c)
+        bytes += _beamColors[c].size() * sizeof(Index);
+    return bytes;
+}
+
 template<class DataTypes>
 void BeamFEMForceField<DataTypes>::computeBBox(const core::ExecParams* params, bool onlyVisible)
 {
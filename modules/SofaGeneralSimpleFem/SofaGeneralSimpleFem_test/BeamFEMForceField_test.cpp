@@ -0,0 +1,263 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2018 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#include <SofaGeneralSimpleFem/BeamFEMForceField.h>
+#include <SofaBaseLinearSolver/CompressedRowSparseMatrix.h>
+#include <SofaBaseLinearSolver/SingleMatrixAccessor.h>
+#include <sofa/core/MechanicalParams.h>
+
+#include <sofa/simulation/MemoryFootprintVisitor.h>
+using sofa::simulation::MemoryFootprintVisitor ;
+
+#include <SofaSimulationGraph/DAGSimulation.h>
+using sofa::simulation::Node ;
+
+#include <SofaSimulationCommon/SceneLoaderXML.h>
+using sofa::simulation::SceneLoaderXML ;
+using sofa::core::ExecParams ;
+
+#include <SofaTest/Sofa_test.h>
+
+#include <cmath>
+
+namespace
+{
+
+using sofa::defaulttype::Rigid3dTypes ;
+using sofa::defaulttype::Vec3d ;
+using sofa::defaulttype::Quat ;
+using sofa::component::linearsolver::CompressedRowSparseMatrix ;
+using sofa::component::linearsolver::SingleMatrixAccessor ;
+
+typedef sofa::component::forcefield::BeamFEMForceField<Rigid3dTypes> BeamFEMForceField ;
+typedef Rigid3dTypes::VecCoord VecCoord ;
+typedef Rigid3dTypes::VecDeriv VecDeriv ;
+
+static const unsigned nbNodes = 30 ;
+
+/// A chain of beams along x, with two more beams from the first node so that the
+/// parallel loops need three colors
+std::string beamNode(const std::string& name, bool parallel)
+{
+    std::stringstream position, lines ;
+    for (unsigned i=0; i<nbNodes; ++i)
+        position << i << " 0 0 0 0 0 1 " ;
+    for (unsigned i=0; i+1<nbNodes; ++i)
+        lines << i << " " << i+1 << " " ;
+    lines << "0 10 0 20" ;
+
+    return
+            "   <Node name='" + name + "'>                                                          \n"
+            "       <MechanicalObject template='Rigid3d' name='dofs' position='" + position.str() + "'/> \n"
+            "       <Mesh name='lines' lines='" + lines.str() + "'/>                                   \n"
+            "       <BeamFEMForceField name='FEM' poissonRatio='0.3' radius='0.1' youngModulus='1e6'"
+            "                          parallel='" + (parallel ? "1" : "0") + "'/>                    \n"
+            "   </Node>                                                                              \n" ;
+}
+
+class BeamFEMForceField_test : public sofa::Sofa_test<>
+{
+public:
+    Node::SPtr root ;
+
+    void TearDown()
+    {
+        if (root)
+            sofa::simulation::getSimulation()->unload(root) ;
+    }
+
+    void loadScene()
+    {
+        std::stringstream scene ;
+        scene << "<?xml version='1.0'?>                                                           \n"
+                 "<Node name='Root' gravity='0 0 0' dt='0.01'>                                    \n"
+                 "   <DefaultAnimationLoop/>                                                      \n"
+              << beamNode("serial", false)
+              << beamNode("parallel", true)
+              << "</Node>                                                                         \n" ;
+
+        root = SceneLoaderXML::loadFromMemory("testscene", scene.str().c_str(), scene.str().size()) ;
+        ASSERT_NE(root.get(), nullptr) ;
+        root->init(ExecParams::defaultInstance()) ;
+    }
+
+    BeamFEMForceField* forceField(const std::string& nodeName)
+    {
+        BeamFEMForceField* ff = NULL ;
+        root->getChild(nodeName)->get(ff) ;
+        return ff ;
+    }
+
+    /// bent and twisted configuration of the chain
+    VecCoord deformedPositions()
+    {
+        VecCoord x(nbNodes) ;
+        for (unsigned i=0; i<nbNodes; ++i)
+        {
+            x[i].getCenter() = Vec3d(i, 0.05*std::sin(0.3*i), 0.02*std::cos(0.7*i)) ;
+            x[i].getOrientation() = Quat(Vec3d(1,0.2,0.1), 0.03*i) ;
+        }
+        return x ;
+    }
+
+    void checkSameForces()
+    {
+        EXPECT_MSG_NOEMIT(Error) ;
+        loadScene() ;
+        BeamFEMForceField* serial = forceField("serial") ;
+        BeamFEMForceField* parallel = forceField("parallel") ;
+        ASSERT_NE(serial, nullptr) ;
+        ASSERT_NE(parallel, nullptr) ;
+
+        sofa::core::MechanicalParams mparams ;
+        mparams.setKFactor(2.0) ;
+
+        const VecDeriv zero(nbNodes) ;
+        sofa::core::objectmodel::Data<VecCoord> x(deformedPositions()) ;
+        sofa::core::objectmodel::Data<VecDeriv> v(zero) ;
+        sofa::core::objectmodel::Data<VecDeriv> fSerial(zero), fParallel(zero) ;
+        serial->addForce(&mparams, fSerial, x, v) ;
+        parallel->addForce(&mparams, fParallel, x, v) ;
+
+        VecDeriv dxValue(nbNodes) ;
+        for (unsigned i=0; i<nbNodes; ++i)
+            dxValue[i] = Rigid3dTypes::Deriv(Vec3d(0.01*i, -0.02, 0.03*std::sin((double)i)), Vec3d(0.01, 0.02*std::cos((double)i), -0.01)) ;
+        sofa::core::objectmodel::Data<VecDeriv> dx(dxValue) ;
+        sofa::core::objectmodel::Data<VecDeriv> dfSerial(zero), dfParallel(zero) ;
+        serial->addDForce(&mparams, dfSerial, dx) ;
+        parallel->addDForce(&mparams, dfParallel, dx) ;
+
+        double maxForce = 0.0 ;
+        for (unsigned i=0; i<nbNodes; ++i)
+        {
+            for (unsigned c=0; c<6; ++c)
+            {
+                maxForce = std::max(maxForce, std::abs(fSerial.getValue()[i][c])) ;
+                EXPECT_NEAR(fParallel.getValue()[i][c], fSerial.getValue()[i][c], 1e-8) << "force on node " << i ;
+                EXPECT_NEAR(dfParallel.getValue()[i][c], dfSerial.getValue()[i][c], 1e-8) << "force derivative on node " << i ;
+            }
+        }
+        EXPECT_GT(maxForce, 1.0) ;
+    }
+
+    /// The 6x6 block path of addKToMatrix, with cached block positions on the second
+    /// assembly, gives the same matrix as the scalar path
+    void checkBlockAssembly()
+    {
+        EXPECT_MSG_NOEMIT(Error) ;
+        loadScene() ;
+        BeamFEMForceField* ff = forceField("serial") ;
+        ASSERT_NE(ff, nullptr) ;
+
+        sofa::core::MechanicalParams mparams ;
+        mparams.setKFactor(2.0) ;
+        const VecDeriv zero(nbNodes) ;
+        sofa::core::objectmodel::Data<VecCoord> x(deformedPositions()) ;
+        sofa::core::objectmodel::Data<VecDeriv> v(zero), f(zero) ;
+        ff->addForce(&mparams, f, x, v) ;
+
+        const int n = 6*nbNodes ;
+        CompressedRowSparseMatrix<double> scalarMatrix ;
+        scalarMatrix.resize(n, n) ;
+        SingleMatrixAccessor scalarAccessor(&scalarMatrix) ;
+        ff->addKToMatrix(&mparams, &scalarAccessor) ;
+        scalarMatrix.compress() ;
+
+        CompressedRowSparseMatrix< sofa::defaulttype::Mat<6,6,double> > blockMatrix ;
+        blockMatrix.resize(n, n) ;
+        SingleMatrixAccessor blockAccessor(&blockMatrix) ;
+        for (int assembly=0; assembly<2; ++assembly)
+        {
+            blockMatrix.clear() ;
+            ff->addKToMatrix(&mparams, &blockAccessor) ;
+            blockMatrix.compress() ;
+
+            double maxValue = 0.0 ;
+            for (int i=0; i<n; ++i)
+                for (int j=0; j<n; ++j)
+                {
+                    maxValue = std::max(maxValue, std::abs((double)scalarMatrix.element(i,j))) ;
+                    ASSERT_NEAR(blockMatrix.element(i,j), scalarMatrix.element(i,j), 1e-6) << "assembly " << assembly << " (" << i << "," << j << ")" ;
+                }
+            EXPECT_GT(maxValue, 1.0) ;
+        }
+    }
+    /// The report counts the beams, whose Data has no type info, and the assembly buffers
+    void checkMemoryFootprint()
+    {
+        EXPECT_MSG_NOEMIT(Error) ;
+        loadScene() ;
+        BeamFEMForceField* ff = forceField("serial") ;
+        ASSERT_NE(ff, nullptr) ;
+        const size_t nbBeams = nbNodes + 1 ;
+        const size_t beamsBytes = nbBeams * sizeof(sofa::defaulttype::Mat<12,12,double>) ;
+        const size_t initialBytes = ff->getMemoryFootprint() ;
+        EXPECT_GE(initialBytes, beamsBytes) ;
+
+        sofa::core::MechanicalParams mparams ;
+        const int n = 6*nbNodes ;
+        CompressedRowSparseMatrix< sofa::defaulttype::Mat<6,6,double> > blockMatrix ;
+        blockMatrix.resize(n, n) ;
+        SingleMatrixAccessor blockAccessor(&blockMatrix) ;
+        ff->addKToMatrix(&mparams, &blockAccessor) ;
+        EXPECT_GE(ff->getMemoryFootprint(), initialBytes + 4*nbBeams*sizeof(sofa::defaulttype::Mat<6,6,double>)) ;
+
+        MemoryFootprintVisitor visitor(ExecParams::defaultInstance()) ;
+        root->execute(visitor) ;
+
+        const sofa::helper::vector<MemoryFootprintVisitor::Entry>& objects = visitor.getObjects() ;
+        const MemoryFootprintVisitor::Entry* entry = NULL ;
+        size_t objectsBytes = 0 ;
+        for (size_t i=0; i<objects.size(); ++i)
+        {
+            objectsBytes += objects[i].bytes ;
+            if (objects[i].path == ff->getPathName())
+                entry = &objects[i] ;
+        }
+        ASSERT_NE(entry, nullptr) ;
+        EXPECT_EQ(ff->getMemoryFootprint(), entry->bytes) ;
+        EXPECT_GE(visitor.getTotal(), objectsBytes) ;
+
+        // the root node counts its descendants
+        const sofa::helper::vector<MemoryFootprintVisitor::Entry>& nodes = visitor.getNodes() ;
+        ASSERT_FALSE(nodes.empty()) ;
+        EXPECT_EQ("/", nodes[0].path) ;
+        EXPECT_EQ(visitor.getTotal(), nodes[0].bytes) ;
+        EXPECT_GE(nodes[0].bytes, 2*beamsBytes) ;
+    }
+};
+
+TEST_F(BeamFEMForceField_test, parallelForcesMatchSerial)
+{
+    checkSameForces() ;
+}
+
+TEST_F(BeamFEMForceField_test, blockAssemblyMatchesScalar)
+{
+    checkBlockAssembly() ;
+}
+
+TEST_F(BeamFEMForceField_test, memoryFootprint)
+{
+    checkMemoryFootprint() ;
+}
+
+}
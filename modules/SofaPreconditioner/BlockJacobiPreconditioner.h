@@ -49,6 +49,12 @@ class BlockJacobiPreconditionerInternalData
 
 
 /// Linear solver based on a NxN bloc diagonal matrix (i.e. block Jacobi preconditioner)
+///
+/// Only the diagonal blocks are assembled, from the force fields of the
+/// mechanical graph, so it can precondition a matrix-free (GraphScattered)
+/// solver. The inverted blocks are stored in structure of arrays layout and
+/// both the inversion and the application loop over contiguous blocks, in
+/// parallel when OpenMP is enabled.
 template<class TMatrix, class TVector>
 class BlockJacobiPreconditioner : public sofa::component::linearsolver::MatrixLinearSolver<TMatrix,TVector>
 {
@@ -59,6 +65,9 @@ public:
     typedef TVector Vector;
     typedef sofa::component::linearsolver::MatrixLinearSolver<TMatrix,TVector> Inherit;
     typedef typename TMatrix::Bloc SubMatrix;
+    typedef typename TMatrix::Real Real;
+    typedef typename TVector::Real VReal;
+    enum { BSIZE = TMatrix::BSIZE };
 
     Data<bool> f_verbose; ///< Dump system state at each iteration
 protected:
@@ -67,6 +76,11 @@ public:
     void solve (Matrix& M, Vector& x, Vector& b) override;
     void invert(Matrix& M) override;
 
+    MatrixInvertData * createInvertData() override
+    {
+        return new BlockJacobiPreconditionerInvertData();
+    }
+
     BlockJacobiPreconditionerInternalData<TVector> internalData; ///< not use in CPU
 
     /// Pre-construction check method called by ObjectFactory.
@@ -82,11 +96,34 @@ public:
         return templateName(this);
     }
 
+    /// The 3x3 blocks instance keeps the vector name used by existing scenes,
+    /// the other block sizes are told apart by their matrix name.
     static std::string templateName(const BlockJacobiPreconditioner<TMatrix,TVector>* = NULL)
     {
-        return TVector::Name();
+        if (BSIZE == 3)
+            return TVector::Name();
+        return TMatrix::Name();
     }
 
+protected:
+    /// number of blocks processed together by the batch kernels
+    enum { BATCH = 64 };
+
+    /// Entry (i,j) of the inverse of block b is stored at values[(i*BSIZE+j)*nbBlocks + b]
+    class BlockJacobiPreconditionerInvertData : public MatrixInvertData
+    {
+    public :
+        int size;     ///< number of scalar rows
+        int nbBlocks; ///< number of diagonal blocks, the last one may be incomplete
+        helper::vector<Real> values;
+
+        BlockJacobiPreconditionerInvertData() : size(0), nbBlocks(0) {}
+    };
+
+    /// Gauss-Jordan inversion without pivoting of blocks [b0,b1), returns the number of blocks with a null pivot
+    static int invertBatch(Real* values, int nbBlocks, int b0, int b1, const Real* scale, char* singular);
+    /// z = A^-1 r for the complete blocks [b0,b1)
+    static void applyBatch(const Real* values, int nbBlocks, int b0, int b1, VReal* z, const VReal* r);
 };
 
 } // namespace linearsolver
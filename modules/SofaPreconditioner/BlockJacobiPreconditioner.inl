@@ -34,7 +34,10 @@
 #include "sofa/helper/system/thread/CTime.h"
 #include <sofa/core/objectmodel/BaseContext.h>
 #include <sofa/core/behavior/LinearSolver.h>
+#include <sofa/helper/IndexOpenMP.h>
 #include <math.h>
+#include <algorithm>
+#include <limits>
 
 namespace sofa
 {
@@ -54,14 +57,180 @@ BlockJacobiPreconditioner<TMatrix,TVector>::BlockJacobiPreconditioner()
 template<class TMatrix, class TVector>
 void BlockJacobiPreconditioner<TMatrix,TVector>::solve (Matrix& M, Vector& z, Vector& r)
 {
-    M.mul(z,r);
+    BlockJacobiPreconditionerInvertData* data = (BlockJacobiPreconditionerInvertData*) this->getMatrixInvertData(&M);
+    const int n = data->size;
+    const int nbBlocks = data->nbBlocks;
+    const int nbComplete = n / BSIZE;
+
+    z.resize(n);
+    if (n == 0) return;
+
+    const Real* values = &data->values[0];
+    VReal* zp = z.ptr();
+    const VReal* rp = r.ptr();
+
+    const int nbBatches = (nbComplete + BATCH-1) / BATCH;
+#ifdef _OPENMP
+    #pragma omp parallel for if (nbBatches > 1)
+#endif
+    for (helper::IndexOpenMP<int>::type c = 0; c < nbBatches; ++c)
+        applyBatch(values, nbBlocks, c*BATCH, std::min(nbComplete, (int)(c+1)*BATCH), zp, rp);
+
+    if (nbComplete < nbBlocks)
+    {
+        // incomplete last block
+        const int b = nbComplete;
+        const int sz = n - b*BSIZE;
+        for (int i=0; i<sz; ++i)
+        {
+            VReal sum = 0;
+            for (int j=0; j<sz; ++j)
+                sum += (VReal)values[(i*BSIZE+j)*nbBlocks+b] * rp[b*BSIZE+j];
+            zp[b*BSIZE+i] = sum;
+        }
+    }
 }
 
 template<class TMatrix, class TVector>
 void BlockJacobiPreconditioner<TMatrix,TVector>::invert(Matrix& M)
 {
-    M.invert();
-    if (f_verbose.getValue()) sout<<M<<sendl;
+    BlockJacobiPreconditionerInvertData* data = (BlockJacobiPreconditionerInvertData*) this->getMatrixInvertData(&M);
+    const int n = M.rowSize();
+    const int nbBlocks = (n + BSIZE-1) / BSIZE;
+    data->size = n;
+    data->nbBlocks = nbBlocks;
+    data->values.resize(BSIZE*BSIZE*nbBlocks);
+    if (nbBlocks == 0) return;
+
+    Real* values = &data->values[0];
+    helper::vector<Real> scale(nbBlocks);
+    helper::vector<char> singular(nbBlocks);
+
+    // copy the blocks in structure of arrays layout, padding the incomplete last block with identity
+#ifdef _OPENMP
+    #pragma omp parallel for
+#endif
+    for (helper::IndexOpenMP<int>::type b = 0; b < nbBlocks; ++b)
+    {
+        const SubMatrix& m = M.bloc(b);
+        const int sz = std::min((int)BSIZE, n - (int)b*BSIZE);
+        Real s = 0;
+        for (int i=0; i<BSIZE; ++i)
+        {
+            for (int j=0; j<BSIZE; ++j)
+                values[(i*BSIZE+j)*nbBlocks+b] = (i<sz && j<sz) ? m[i][j] : (Real)(i==j ? 1 : 0);
+            if (i<sz) s = std::max(s, (Real)fabs(m[i][i]));
+        }
+        scale[b] = s;
+    }
+
+    const int nbBatches = (nbBlocks + BATCH-1) / BATCH;
+    int nbSingular = 0;
+#ifdef _OPENMP
+    #pragma omp parallel for reduction(+:nbSingular)
+#endif
+    for (helper::IndexOpenMP<int>::type c = 0; c < nbBatches; ++c)
+        nbSingular += invertBatch(values, nbBlocks, c*BATCH, std::min(nbBlocks, (int)(c+1)*BATCH), &scale[0], &singular[0]);
+
+    if (nbSingular > 0)
+    {
+        // blocks with a null pivot are inverted again with the generic inversion
+        for (int b=0; b<nbBlocks; ++b)
+        {
+            if (!singular[b]) continue;
+            SubMatrix m = M.bloc(b);
+            for (int i = n - b*BSIZE; i<BSIZE; ++i)
+                m[i][i] = 1;
+            SubMatrix inv;
+            Matrix::traits::invert(inv, m);
+            for (int i=0; i<BSIZE; ++i)
+                for (int j=0; j<BSIZE; ++j)
+                    values[(i*BSIZE+j)*nbBlocks+b] = inv[i][j];
+        }
+    }
+
+    if (f_verbose.getValue())
+    {
+        sout << nbBlocks << " blocks inverted, " << nbSingular << " of them needed pivoting" << sendl;
+        sout << M << sendl;
+    }
+}
+
+template<class TMatrix, class TVector>
+int BlockJacobiPreconditioner<TMatrix,TVector>::invertBatch(Real* values, int nbBlocks, int b0, int b1, const Real* scale, char* singular)
+{
+    const int nb = b1 - b0;
+    const Real eps = std::numeric_limits<Real>::epsilon();
+    Real pivot[BATCH];
+    Real factor[BATCH];
+
+    for (int b=0; b<nb; ++b)
+        singular[b0+b] = 0;
+
+    // in place Gauss-Jordan elimination, every innermost loop runs over the blocks of the batch
+    for (int k=0; k<BSIZE; ++k)
+    {
+        Real* akk = values + (k*BSIZE+k)*nbBlocks + b0;
+        for (int b=0; b<nb; ++b)
+        {
+            const Real p = akk[b];
+            const bool bad = !(fabs(p) > scale[b0+b]*eps);
+            singular[b0+b] |= bad;
+            pivot[b] = bad ? (Real)1 : (Real)1/p;
+            akk[b] = 1;
+        }
+        for (int j=0; j<BSIZE; ++j)
+        {
+            Real* akj = values + (k*BSIZE+j)*nbBlocks + b0;
+            for (int b=0; b<nb; ++b)
+                akj[b] *= pivot[b];
+        }
+        for (int i=0; i<BSIZE; ++i)
+        {
+            if (i == k) continue;
+            Real* aik = values + (i*BSIZE+k)*nbBlocks + b0;
+            for (int b=0; b<nb; ++b)
+            {
+                factor[b] = aik[b];
+                aik[b] = 0;
+            }
+            for (int j=0; j<BSIZE; ++j)
+            {
+                Real* aij = values + (i*BSIZE+j)*nbBlocks + b0;
+                const Real* akj = values + (k*BSIZE+j)*nbBlocks + b0;
+                for (int b=0; b<nb; ++b)
+                    aij[b] -= factor[b]*akj[b];
+            }
+        }
+    }
+
+    int nbSingular = 0;
+    for (int b=0; b<nb; ++b)
+        if (singular[b0+b]) ++nbSingular;
+    return nbSingular;
+}
+
+template<class TMatrix, class TVector>
+void BlockJacobiPreconditioner<TMatrix,TVector>::applyBatch(const Real* values, int nbBlocks, int b0, int b1, VReal* z, const VReal* r)
+{
+    const int nb = b1 - b0;
+    VReal acc[BATCH];
+    const VReal* rb = r + b0*BSIZE;
+    VReal* zb = z + b0*BSIZE;
+
+    for (int i=0; i<BSIZE; ++i)
+    {
+        for (int b=0; b<nb; ++b)
+            acc[b] = 0;
+        for (int j=0; j<BSIZE; ++j)
+        {
+            const Real* aij = values + (i*BSIZE+j)*nbBlocks + b0;
+            for (int b=0; b<nb; ++b)
+                acc[b] += (VReal)aij[b] * rb[b*BSIZE+j];
+        }
+        for (int b=0; b<nb; ++b)
+            zb[b*BSIZE+i] = acc[b];
+    }
 }
 
 } // namespace linearsolver
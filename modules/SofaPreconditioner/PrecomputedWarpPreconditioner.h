@@ -29,6 +29,7 @@
 #include <sofa/simulation/MechanicalVisitor.h>
 #include <SofaBaseLinearSolver/CompressedRowSparseMatrix.h>
 #include <SofaBaseLinearSolver/FullMatrix.h>
+#include <SofaBaseLinearSolver/BlockCompressedMatrix.h>
 #include <sofa/helper/map.h>
 #include <math.h>
 #include <fstream>
@@ -51,20 +52,33 @@ public :
     typedef FullMatrix<Real> TBaseMatrix;
     typedef FullVector<Real> TBaseVector;
 
+    /// Storage of the inverse: full row-major matrix, or tiles (possibly compressed) in Real or float precision
+    enum { FULL_STORAGE = 0, BLOCK_STORAGE, FLOAT_BLOCK_STORAGE };
+
     SparseMatrix<Real> JR;
     FullMatrix<Real> JRMinv;
     FullMatrix<Real>* MinvPtr;
+    BlockCompressedMatrix<Real>* MinvBlockPtr;
+    BlockCompressedMatrix<float>* MinvFloatPtr;
+    int storage;
+    helper::vector<Real> rowBuffer;
     std::vector<int> idActiveDofs;
     std::vector<int> invActiveDofs;
     bool shared;
     PrecomputedWarpPreconditionerInternalData()
-        : MinvPtr(new FullMatrix<Real>), shared(false)
+        : MinvPtr(new FullMatrix<Real>), MinvBlockPtr(new BlockCompressedMatrix<Real>), MinvFloatPtr(new BlockCompressedMatrix<float>)
+        , storage(FULL_STORAGE), shared(false)
     {
     }
 
     ~PrecomputedWarpPreconditionerInternalData()
     {
-        if (!shared && MinvPtr!=NULL) delete MinvPtr;
+        if (!shared)
+        {
+            delete MinvPtr;
+            delete MinvBlockPtr;
+            delete MinvFloatPtr;
+        }
     }
 
     void setMinv(FullMatrix<Real>* m, bool shared = true)
@@ -74,20 +88,114 @@ public :
         this->shared = shared;
     }
 
+    /// Use the inverses shared by all the preconditioners using the same file name
+    void setShared(const std::string& name)
+    {
+        if (!shared)
+        {
+            delete MinvBlockPtr;
+            delete MinvFloatPtr;
+        }
+        MinvBlockPtr = getSharedBlockMatrix(name);
+        MinvFloatPtr = getSharedFloatMatrix(name);
+        setMinv(getSharedMatrix(name));
+    }
+
     static FullMatrix<Real>* getSharedMatrix(const std::string& name)
     {
         static std::map< std::string,FullMatrix<Real> > matrices;
         return &(matrices[name]);
     }
 
-    void readMinvFomFile(std::ifstream & compFileIn)
+    static BlockCompressedMatrix<Real>* getSharedBlockMatrix(const std::string& name)
+    {
+        static std::map< std::string,BlockCompressedMatrix<Real> > matrices;
+        return &(matrices[name]);
+    }
+
+    static BlockCompressedMatrix<float>* getSharedFloatMatrix(const std::string& name)
+    {
+        static std::map< std::string,BlockCompressedMatrix<float> > matrices;
+        return &(matrices[name]);
+    }
+
+    /// Size of the inverse already built, 0 if it is not built
+    unsigned builtSize() const
     {
+        if (storage == FULL_STORAGE) return MinvPtr->rowSize();
+        else if (storage == BLOCK_STORAGE) return MinvBlockPtr->rowSize();
+        else return MinvFloatPtr->rowSize();
+    }
+
+    bool readMinvFomFile(std::ifstream & compFileIn)
+    {
+        if (storage == BLOCK_STORAGE) return MinvBlockPtr->read(compFileIn, rowBuffer.size(), rowBuffer.size());
+        else if (storage == FLOAT_BLOCK_STORAGE) return MinvFloatPtr->read(compFileIn, rowBuffer.size(), rowBuffer.size());
         compFileIn.read((char*) (*MinvPtr)[0], MinvPtr->colSize() * MinvPtr->rowSize() * sizeof(Real));
+        return true;
     }
 
     void writeMinvFomFile(std::ofstream & compFileOut)
     {
-        compFileOut.write((char*) (*MinvPtr)[0], MinvPtr->colSize() * MinvPtr->rowSize() * sizeof(Real));
+        if (storage == BLOCK_STORAGE) MinvBlockPtr->write(compFileOut);
+        else if (storage == FLOAT_BLOCK_STORAGE) MinvFloatPtr->write(compFileOut);
+        else compFileOut.write((char*) (*MinvPtr)[0], MinvPtr->colSize() * MinvPtr->rowSize() * sizeof(Real));
+    }
+
+    /// Start filling the inverse row by row
+    void beginRows(unsigned size, unsigned blockSize, double tolerance)
+    {
+        rowBuffer.resize(size);
+        if (storage == FULL_STORAGE) MinvPtr->resize(size,size);
+        else if (storage == BLOCK_STORAGE) MinvBlockPtr->beginRows(size, size, blockSize, tolerance);
+        else MinvFloatPtr->beginRows(size, size, blockSize, tolerance);
+    }
+
+    /// Where the values of row i are written before commitRow(i)
+    Real* getRow(unsigned i)
+    {
+        return (storage == FULL_STORAGE) ? (*MinvPtr)[i] : &rowBuffer[0];
+    }
+
+    /// Store row i, scaled by scale in the tiled storages (the full matrix is scaled once it is complete)
+    void commitRow(unsigned i, double scale)
+    {
+        if (storage == BLOCK_STORAGE) MinvBlockPtr->setRow(i, &rowBuffer[0], scale);
+        else if (storage == FLOAT_BLOCK_STORAGE) MinvFloatPtr->setRow(i, &rowBuffer[0], scale);
+    }
+
+    void endRows()
+    {
+        if (storage == BLOCK_STORAGE) MinvBlockPtr->endRows();
+        else if (storage == FLOAT_BLOCK_STORAGE) MinvFloatPtr->endRows();
+    }
+
+    /// z = Minv * r
+    void mul(TBaseVector& z, const TBaseVector& r)
+    {
+        if (storage == FULL_STORAGE) z = (*MinvPtr) * r;
+        else if (storage == BLOCK_STORAGE) MinvBlockPtr->mul(z, r);
+        else MinvFloatPtr->mul(z, r);
+    }
+
+    /// out[c] += factor * Minv(i,cols[c])
+    void addRowTimes(unsigned i, Real factor, const std::vector<int>& cols, Real* out) const
+    {
+        if (storage == FULL_STORAGE)
+        {
+            const Real* row = (*MinvPtr)[i];
+            for (unsigned c=0; c<cols.size(); c++) out[c] += factor * row[cols[c]];
+        }
+        else if (storage == BLOCK_STORAGE) MinvBlockPtr->addRowTimes(i, factor, cols, out);
+        else MinvFloatPtr->addRowTimes(i, factor, cols, out);
+    }
+
+    /// Memory used by the inverse, in bytes
+    std::size_t memorySize() const
+    {
+        if (storage == FULL_STORAGE) return (std::size_t)MinvPtr->rowSize() * MinvPtr->colSize() * sizeof(Real);
+        else if (storage == BLOCK_STORAGE) return MinvBlockPtr->memorySize();
+        else return MinvFloatPtr->memorySize();
     }
 };
 
@@ -116,6 +224,9 @@ public:
     Data<bool> f_verbose; ///< Dump system state at each iteration
     Data<bool> use_file; ///< Dump system matrix in a file
     Data<bool> share_matrix; ///< Share the compliance matrix in memory if they are related to the same file (WARNING: might require to reload Sofa when opening a new scene...)
+    Data<bool> float_storage; ///< Store the inverse in single precision
+    Data<unsigned> block_size; ///< Size of the square tiles used to store the inverse (0 = full row-major matrix)
+    Data<double> compression_tolerance; ///< Relative error bound of the low-rank approximation of each tile (0 = no compression)
     Data <std::string> solverName; ///< Name of the solver to use to precompute the first matrix
     Data<bool> use_rotations; ///< Use Rotations around the preconditioner
     Data<double> draw_rotations_scale; ///< Scale rotations in draw function
@@ -134,9 +245,10 @@ public:
 
     bool hasUpdatedMatrix() override {return false;}
 
+    /// Returns NULL when the inverse is not stored as a full matrix (see block_size)
     TBaseMatrix * getSystemMatrixInv()
     {
-        return internalData.MinvPtr;
+        return (internalData.storage == internalData.FULL_STORAGE) ? internalData.MinvPtr : NULL;
     }
 
     /// Pre-construction check method called by ObjectFactory.
@@ -73,6 +73,9 @@ PrecomputedWarpPreconditioner<TDataTypes>::PrecomputedWarpPreconditioner()
     , f_verbose( initData(&f_verbose,false,"verbose","Dump system state at each iteration") )
     , use_file( initData(&use_file,true,"use_file","Dump system matrix in a file") )
     , share_matrix( initData(&share_matrix,true,"share_matrix","Share the compliance matrix in memory if they are related to the same file (WARNING: might require to reload Sofa when opening a new scene...)") )
+    , float_storage( initData(&float_storage,false,"float_storage","Store the inverse in single precision (implies a tiled storage)") )
+    , block_size( initData(&block_size,(unsigned)0,"block_size","Size of the square tiles used to store the inverse (0 = full row-major matrix, or 64 if float_storage or compression_tolerance is set)") )
+    , compression_tolerance( initData(&compression_tolerance,0.0,"compression_tolerance","Relative error bound (Frobenius norm) of the low-rank approximation of each tile of the inverse (0 = no compression)") )
     , solverName(initData(&solverName, std::string(""), "solverName", "Name of the solver to use to precompute the first matrix"))
     , use_rotations( initData(&use_rotations,true,"use_rotations","Use Rotations around the preconditioner") )
     , draw_rotations_scale( initData(&draw_rotations_scale,0.0,"draw_rotations_scale","Scale rotations in draw function") )
@@ -121,7 +124,7 @@ void PrecomputedWarpPreconditioner<TDataTypes>::solve (TMatrix& /*M*/, TVector&
             }
 
             //Solve tmp = M^-1 * z
-            T = (*internalData.MinvPtr) * z;
+            internalData.mul(T, z);
 
             //Solve z = R * tmp
             k = 0; l = 0;
@@ -137,7 +140,7 @@ void PrecomputedWarpPreconditioner<TDataTypes>::solve (TMatrix& /*M*/, TVector&
         else
         {
             //Solve tmp = M^-1 * z
-            z = (*internalData.MinvPtr) * r;
+            internalData.mul(z, r);
         }
     }
     else z = r;
@@ -159,33 +162,44 @@ void PrecomputedWarpPreconditioner<TDataTypes>::loadMatrix(TMatrix& M)
     factInt = 1.0; // christian : it is not a compliance... but an admittance that is computed !
     if (EulerSolver) factInt = EulerSolver->getPositionIntegrationFactor(); // here, we compute a compliance
 
+    const double tolerance = std::max(compression_tolerance.getValue(), 0.0);
+    unsigned blockSize = block_size.getValue();
+    if (blockSize == 0 && (float_storage.getValue() || tolerance > 0)) blockSize = 64;
+
+    if (float_storage.getValue()) internalData.storage = internalData.FLOAT_BLOCK_STORAGE;
+    else if (blockSize > 0) internalData.storage = internalData.BLOCK_STORAGE;
+    else internalData.storage = internalData.FULL_STORAGE;
+
     std::stringstream ss;
-    ss << this->getContext()->getName() << "-" << systemSize << "-" << dt << ((sizeof(Real)==sizeof(float)) ? ".compf" : ".comp");
+    ss << this->getContext()->getName() << "-" << systemSize << "-" << dt;
+    if (internalData.storage == internalData.FULL_STORAGE) ss << ((sizeof(Real)==sizeof(float)) ? ".compf" : ".comp");
+    else ss << "-" << blockSize << "-" << tolerance << ((internalData.storage == internalData.FLOAT_BLOCK_STORAGE) ? ".compbf" : ".compb");
     std::string fname = ss.str();
 
-    if (share_matrix.getValue()) internalData.setMinv(internalData.getSharedMatrix(fname));
+    if (share_matrix.getValue()) internalData.setShared(fname);
 
-    if (share_matrix.getValue() && internalData.MinvPtr->rowSize() == (defaulttype::BaseMatrix::Index)systemSize)
+    if (share_matrix.getValue() && internalData.builtSize() == systemSize)
     {
         msg_info("PrecomputedWarpPreconditioner") << "shared matrix : " << fname << " is already built." ;
     }
     else
     {
-        internalData.MinvPtr->resize(matrixSize,matrixSize);
+        internalData.beginRows(matrixSize, blockSize, tolerance);
 
         std::ifstream compFileIn(fname.c_str(), std::ifstream::binary);
 
-        if(compFileIn.good() && use_file.getValue())
+        if(compFileIn.good() && use_file.getValue() && internalData.readMinvFomFile(compFileIn))
         {
-            msg_info("PrecomputedWarpPreconditioner") << "file open : " << fname << " compliance being loaded" ;
-            internalData.readMinvFomFile(compFileIn);
+            msg_info("PrecomputedWarpPreconditioner") << "file open : " << fname << " compliance loaded" ;
             compFileIn.close();
         }
         else
         {
             msg_info("PrecomputedWarpPreconditioner") << "Precompute : " << fname << " compliance." ;
+            internalData.beginRows(matrixSize, blockSize, tolerance);
             if (solverName.getValue().empty()) loadMatrixWithCSparse(M);
             else loadMatrixWithSolver();
+            internalData.endRows();
 
             if (use_file.getValue())
             {
@@ -196,13 +210,19 @@ void PrecomputedWarpPreconditioner<TDataTypes>::loadMatrix(TMatrix& M)
             compFileIn.close();
         }
 
-        for (unsigned int j=0; j<matrixSize; j++)
+        // the tiled storages are scaled row by row while they are filled
+        if (internalData.storage == internalData.FULL_STORAGE)
         {
-            Real * minvVal = (*internalData.MinvPtr)[j];
-            for (unsigned i=0; i<matrixSize; i++) minvVal[i] /= (Real)factInt;
+            for (unsigned int j=0; j<matrixSize; j++)
+            {
+                Real * minvVal = (*internalData.MinvPtr)[j];
+                for (unsigned i=0; i<matrixSize; i++) minvVal[i] /= (Real)factInt;
+            }
         }
     }
 
+    msg_info("PrecomputedWarpPreconditioner") << "Inverse stored in " << internalData.memorySize() / (1024*1024) << " MB";
+
     R.resize(nb_dofs*9);
     T.resize(matrixSize);
     for(unsigned int k = 0; k < nb_dofs; k++)
@@ -244,7 +264,7 @@ void PrecomputedWarpPreconditioner<TDataTypes>::loadMatrixWithCSparse(TMatrix& M
             b.set(pid_j*dof_on_node+d,1.0);
             solver.solve(M,r,b);
 
-            Real * minvVal = (*internalData.MinvPtr)[j*dof_on_node+d];
+            Real * minvVal = internalData.getRow(j*dof_on_node+d);
             for (unsigned int i=0; i<nb_dofs; i++)
             {
                 unsigned pid_i;
@@ -255,6 +275,7 @@ void PrecomputedWarpPreconditioner<TDataTypes>::loadMatrixWithCSparse(TMatrix& M
                     minvVal[i*dof_on_node+c] = (Real)(r.element(pid_i*dof_on_node+c)*factInt);
                 }
             }
+            internalData.commitRow(j*dof_on_node+d, 1.0/factInt);
 
             b.set(pid_j*dof_on_node+d,0.0);
         }
@@ -417,7 +438,7 @@ void PrecomputedWarpPreconditioner<TDataTypes>::loadMatrixWithSolver()
                 msg_info()<<"getV : "<<velocity;
             }
 
-            Real * minvVal = (*internalData.MinvPtr)[j*dof_on_node+d];
+            Real * minvVal = internalData.getRow(j*dof_on_node+d);
             for (unsigned int i=0; i<nb_dofs; i++)
             {
                 unsigned pid_i;
@@ -428,6 +449,7 @@ void PrecomputedWarpPreconditioner<TDataTypes>::loadMatrixWithSolver()
                     minvVal[i*dof_on_node+c] = (Real) (velocity[pid_i][c]*factInt);
                 }
             }
+            internalData.commitRow(j*dof_on_node+d, 1.0/factInt);
         }
 
         unitary_force.clear();
@@ -620,18 +642,14 @@ void PrecomputedWarpPreconditioner<TDataTypes>::ComputeResult(defaulttype::BaseM
             }
         }
 
+        // rows of Minv are read contiguously, one per non-zero of JR
         nl=0;
         for (typename SparseMatrix<Real>::LineConstIterator jit1 = internalData.JR.begin(); jit1 != internalData.JR.end(); jit1++)
         {
-            for (unsigned c = 0; c<internalData.idActiveDofs.size(); c++)
+            Real* line = internalData.JRMinv[nl];
+            for (typename SparseMatrix<Real>::LElementConstIterator i1 = jit1->second.begin(); i1 != jit1->second.end(); i1++)
             {
-                int col = internalData.idActiveDofs[c];
-                Real v = (Real)0.0;
-                for (typename SparseMatrix<Real>::LElementConstIterator i1 = jit1->second.begin(); i1 != jit1->second.end(); i1++)
-                {
-                    v += (Real)(internalData.MinvPtr->element(i1->first,col) * i1->second);
-                }
-                internalData.JRMinv.set(nl,c,v);
+                internalData.addRowTimes(i1->first, (Real)i1->second, internalData.idActiveDofs, line);
             }
             nl++;
         }
@@ -641,15 +659,10 @@ void PrecomputedWarpPreconditioner<TDataTypes>::ComputeResult(defaulttype::BaseM
         nl=0;
         for (typename JMatrix::LineConstIterator jit1 = J.begin(); jit1 != J.end(); jit1++)
         {
-            for (unsigned c = 0; c<internalData.idActiveDofs.size(); c++)
+            Real* line = internalData.JRMinv[nl];
+            for (typename JMatrix::LElementConstIterator i1 = jit1->second.begin(); i1 != jit1->second.end(); i1++)
             {
-                int col = internalData.idActiveDofs[c];
-                Real v = (Real)0.0;
-                for (typename JMatrix::LElementConstIterator i1 = jit1->second.begin(); i1 != jit1->second.end(); i1++)
-                {
-                    v += (Real)(internalData.MinvPtr->element(i1->first,col) * i1->second);
-                }
-                internalData.JRMinv.set(nl,c,v);
+                internalData.addRowTimes(i1->first, (Real)i1->second, internalData.idActiveDofs, line);
             }
             nl++;
         }
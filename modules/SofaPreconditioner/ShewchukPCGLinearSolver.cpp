@@ -65,6 +65,9 @@ ShewchukPCGLinearSolver<TMatrix,TVector>::ShewchukPCGLinearSolver()
     f_graph.setWidget("graph");
 //    f_graph.setReadOnly(true);
     first = true;
+    preconditioners = NULL;
+    precond_updated = false;
+    precond_iterations = 0;
     this->f_listening.setValue(true);
 }
 
@@ -97,6 +100,7 @@ void ShewchukPCGLinearSolver<TMatrix,TVector>::setSystemMBKMatrix(const core::Me
 
     if (first) {  //We initialize all the preconditioners for the first step
         preconditioners->setSystemMBKMatrix(mparams);
+        precond_updated = true;
         first = false;
         next_refresh_step = 1;
 
@@ -107,6 +111,8 @@ void ShewchukPCGLinearSolver<TMatrix,TVector>::setSystemMBKMatrix(const core::Me
         if (f_update_step.getValue()>0) {
             if (next_refresh_step>=f_update_step.getValue()) {
                 preconditioners->setSystemMBKMatrix(mparams);
+                // asynchronous preconditioners only change their factorization from time to time
+                if (preconditioners->hasUpdatedMatrix()) precond_updated = true;
                 next_refresh_step=1;
             } else {
                 next_refresh_step++;
@@ -221,6 +227,15 @@ void ShewchukPCGLinearSolver<TMatrix,TVector>::solve (Matrix& M, Vector& x, Vect
     vtmp.deleteTempVector(&s);
 
     sofa::helper::AdvancedTimer::valSet("PCG iterations", iter);
+
+    if (apply_precond) {
+        // growth of the number of iterations since the last update of the preconditioner
+        if (precond_updated || precond_iterations == 0) {
+            precond_iterations = iter;
+            precond_updated = false;
+        }
+        sofa::helper::AdvancedTimer::valSet("PCG iterations growth", (double)iter / (double)precond_iterations);
+    }
     sofa::helper::AdvancedTimer::stepEnd("PCGLinearSolver::solve");
 }
 
@@ -73,6 +73,8 @@ private :
     sofa::core::behavior::LinearSolver* preconditioners;
     bool first;
     int newton_iter;
+    bool precond_updated;
+    unsigned precond_iterations; ///< number of iterations of the first solve after the last preconditioner update
 
 protected:
     /// This method is separated from the rest to be able to use custom/optimized versions depending on the types of vectors.
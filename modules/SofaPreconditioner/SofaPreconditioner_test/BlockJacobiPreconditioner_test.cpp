@@ -0,0 +1,146 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2018 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#include <SofaPreconditioner/BlockJacobiPreconditioner.h>
+using sofa::component::linearsolver::BlockJacobiPreconditioner ;
+using sofa::component::linearsolver::BlockDiagonalMatrix ;
+using sofa::component::linearsolver::FullVector ;
+
+#include <SofaSimulationGraph/DAGSimulation.h>
+using sofa::simulation::Node ;
+
+#include <SofaSimulationCommon/SceneLoaderXML.h>
+using sofa::simulation::SceneLoaderXML ;
+
+#include <SofaTest/Sofa_test.h>
+
+#include <cstdlib>
+
+namespace
+{
+
+typedef BlockJacobiPreconditioner< BlockDiagonalMatrix<3,double>, FullVector<double> > BlockJacobiPreconditioner3 ;
+typedef BlockDiagonalMatrix<6,double> BlockDiagonalMatrix6 ;
+typedef BlockJacobiPreconditioner< BlockDiagonalMatrix6, FullVector<double> > BlockJacobiPreconditioner6 ;
+
+class BlockJacobiPreconditioner_test : public sofa::Sofa_test<>
+{
+public:
+    Node::SPtr root ;
+
+    void TearDown()
+    {
+        if (root)
+            sofa::simulation::getSimulation()->unload(root) ;
+    }
+
+    BlockJacobiPreconditioner3* loadPreconditioner(const std::string& attributes)
+    {
+        std::stringstream scene ;
+        scene << "<?xml version='1.0'?>                                                    \n"
+                 "<Node name='Root'>                                                       \n"
+                 "   <BlockJacobiPreconditioner name='preconditioner' " << attributes << "/> \n"
+                 "</Node>                                                                  \n" ;
+        root = SceneLoaderXML::loadFromMemory("testscene", scene.str().c_str(), scene.str().size()) ;
+        if (!root) return NULL ;
+        return dynamic_cast<BlockJacobiPreconditioner3*>(root->getObject("preconditioner")) ;
+    }
+};
+
+TEST_F(BlockJacobiPreconditioner_test, defaultTemplate)
+{
+    EXPECT_MSG_NOEMIT(Error, Warning) ;
+    BlockJacobiPreconditioner3* preconditioner = loadPreconditioner("") ;
+    ASSERT_NE(preconditioner, nullptr) ;
+    EXPECT_EQ(preconditioner->getTemplateName(), "FullVector") ;
+}
+
+/// Scenes written before the other block sizes were added name the 3x3 instance after its vector type
+TEST_F(BlockJacobiPreconditioner_test, vectorTemplateName)
+{
+    EXPECT_MSG_NOEMIT(Error, Warning) ;
+    BlockJacobiPreconditioner3* preconditioner = loadPreconditioner("template='FullVector'") ;
+    ASSERT_NE(preconditioner, nullptr) ;
+    EXPECT_EQ(preconditioner->getTemplateName(), "FullVector") ;
+}
+
+TEST_F(BlockJacobiPreconditioner_test, blockSizeTemplateName)
+{
+    EXPECT_MSG_NOEMIT(Error, Warning) ;
+    const std::string name = BlockJacobiPreconditioner6::templateName() ;
+    EXPECT_EQ(name, BlockDiagonalMatrix6::Name()) ;
+    loadPreconditioner("template='" + name + "'") ;
+    ASSERT_NE(root.get(), nullptr) ;
+    BlockJacobiPreconditioner6* preconditioner = dynamic_cast<BlockJacobiPreconditioner6*>(root->getObject("preconditioner")) ;
+    ASSERT_NE(preconditioner, nullptr) ;
+    EXPECT_EQ(preconditioner->getTemplateName(), name) ;
+}
+
+/// Inverse applied to a known block diagonal system: 100 complete 3x3 blocks and an
+/// incomplete 2x2 one, so the second batch is only partly filled. Block 70 and the
+/// last block have a null first pivot and go through the generic inversion.
+TEST_F(BlockJacobiPreconditioner_test, solveBlockDiagonalSystem)
+{
+    EXPECT_MSG_NOEMIT(Error, Warning) ;
+    typedef BlockDiagonalMatrix<3,double> Matrix3 ;
+    const int nbComplete = 100 ;
+    const int n = 3*nbComplete + 2 ;
+
+    Matrix3 M ;
+    M.resize(n, n) ;
+    std::srand(42) ;
+    for (int b=0; b<nbComplete; ++b)
+    {
+        Matrix3::Bloc& m = *M.wbloc(b) ;
+        for (int i=0; i<3; ++i)
+            for (int j=0; j<3; ++j)
+                m[i][j] = (double)std::rand()/RAND_MAX - 0.5 + (i==j ? 4.0 : 0.0) ;
+    }
+    Matrix3::Bloc& permuted = *M.wbloc(70) ;
+    permuted.clear() ;
+    permuted[0][1] = 2 ; permuted[0][2] = 1 ;
+    permuted[1][0] = 1 ;
+    permuted[2][1] = 1 ; permuted[2][2] = 3 ;
+    Matrix3::Bloc& last = *M.wbloc(nbComplete) ;
+    last.clear() ;
+    last[0][1] = 1 ;
+    last[1][0] = 1 ; last[1][1] = 1 ;
+
+    FullVector<double> x(n), b(n), z ;
+    for (int i=0; i<n; ++i)
+        x[i] = (double)std::rand()/RAND_MAX - 0.5 ;
+    for (int i=0; i<n; ++i)
+    {
+        b[i] = 0 ;
+        for (int j=(i/3)*3; j<std::min(n,(i/3)*3+3); ++j)
+            b[i] += M.element(i,j) * x[j] ;
+    }
+
+    BlockJacobiPreconditioner3::SPtr preconditioner = sofa::core::objectmodel::New<BlockJacobiPreconditioner3>() ;
+    preconditioner->invert(M) ;
+    preconditioner->solve(M, z, b) ;
+
+    ASSERT_EQ(z.size(), n) ;
+    for (int i=0; i<n; ++i)
+        EXPECT_NEAR(z[i], x[i], 1e-10) << "row " << i ;
+}
+
+}
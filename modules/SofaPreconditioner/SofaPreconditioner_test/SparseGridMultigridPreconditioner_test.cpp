@@ -0,0 +1,263 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2018 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#include <SofaPreconditioner/SparseGridMultigridPreconditioner.inl>
+using sofa::component::linearsolver::SparseGridMultigridPreconditioner ;
+using sofa::component::linearsolver::CompressedRowSparseMatrix ;
+using sofa::component::linearsolver::FullVector ;
+using sofa::component::linearsolver::NoThreadManager ;
+using sofa::component::topology::SparseGridTopology ;
+
+#include <SofaSimulationGraph/DAGSimulation.h>
+using sofa::simulation::Node ;
+using sofa::core::ExecParams ;
+using sofa::core::objectmodel::New ;
+
+#include <SofaTest/Sofa_test.h>
+
+#include <map>
+
+namespace
+{
+
+typedef CompressedRowSparseMatrix<double> Matrix ;
+typedef FullVector<double> Vector ;
+typedef SparseGridMultigridPreconditioner<Matrix,Vector> SparseGridMultigridPreconditionerCRS ;
+
+/// Gives access to the hierarchy built by invert()
+class TestedMultigrid : public SparseGridMultigridPreconditionerCRS
+{
+public:
+    SOFA_CLASS(TestedMultigrid, SparseGridMultigridPreconditionerCRS) ;
+
+    typedef SparseGridMultigridPreconditionerCRS::Level Level ;
+    typedef SparseGridMultigridPreconditionerCRS::Transfer Transfer ;
+    typedef SparseGridMultigridPreconditionerCRS::SparseGridMultigridPreconditionerInvertData InvertData ;
+    using SparseGridMultigridPreconditionerCRS::grids ;
+
+    InvertData* getData(Matrix& M) { return (InvertData*)this->getMatrixInvertData(&M) ; }
+};
+
+/// Sparse rows of the test systems, used for the products
+typedef std::vector< std::map<int,double> > Rows ;
+
+class SparseGridMultigridPreconditioner_test : public sofa::Sofa_test<>
+{
+public:
+    enum { bsize = 3 } ;
+
+    Node::SPtr root ;
+    SparseGridTopology::SPtr grid ;
+    TestedMultigrid::SPtr multigrid ;
+
+    void TearDown()
+    {
+        if (root)
+            sofa::simulation::getSimulation()->unload(root) ;
+    }
+
+    /// a unit cube voxelized into a n*n*n sparse grid, with the multigrid preconditioner
+    void createScene(int n)
+    {
+        if (root)
+            sofa::simulation::getSimulation()->unload(root) ;
+        sofa::simulation::setSimulation(new sofa::simulation::graph::DAGSimulation()) ;
+        root = sofa::simulation::getSimulation()->createNewGraph("root") ;
+
+        grid = New<SparseGridTopology>() ;
+        std::stringstream resolution ;
+        resolution << n << " " << n << " " << n ;
+        grid->findData("n")->read(resolution.str()) ;
+        grid->findData("vertices")->read("0 0 0  1 0 0  0 1 0  1 1 0  0 0 1  1 0 1  0 1 1  1 1 1") ;
+        grid->findData("input_quads")->read("0 2 3 1  4 5 7 6  0 1 5 4  2 6 7 3  0 4 6 2  1 3 7 5") ;
+        root->addObject(grid) ;
+
+        multigrid = New<TestedMultigrid>() ;
+        root->addObject(multigrid) ;
+        root->init(ExecParams::defaultInstance()) ;
+    }
+
+    /// graph laplacian of the hexahedra corners, for each of the bsize components, plus a small diagonal shift
+    void assembleSystem(Rows& rows, Matrix& M) const
+    {
+        const int n = grid->getNbPoints()*bsize ;
+        rows.assign(n, std::map<int,double>()) ;
+        for (int h=0; h<grid->getNbHexahedra(); ++h)
+        {
+            const SparseGridTopology::Hexa hexa = grid->getHexahedron(h) ;
+            for (int i=0; i<8; ++i)
+                for (int j=i+1; j<8; ++j)
+                    for (int d=0; d<bsize; ++d)
+                    {
+                        const int a = hexa[i]*bsize+d, b = hexa[j]*bsize+d ;
+                        rows[a][a] += 1 ; rows[b][b] += 1 ;
+                        rows[a][b] -= 1 ; rows[b][a] -= 1 ;
+                    }
+        }
+        for (int i=0; i<n; ++i) rows[i][i] += 1e-2 ;
+
+        M.resize(n,n) ;
+        for (int i=0; i<n; ++i)
+            for (std::map<int,double>::const_iterator it=rows[i].begin(); it!=rows[i].end(); ++it)
+                M.add(i, it->first, it->second) ;
+        M.compress() ;
+    }
+
+    static void multiply(const Rows& rows, const std::vector<double>& x, std::vector<double>& y)
+    {
+        y.assign(rows.size(), 0.0) ;
+        for (unsigned i=0; i<rows.size(); ++i)
+            for (std::map<int,double>::const_iterator it=rows[i].begin(); it!=rows[i].end(); ++it)
+                y[i] += it->second * x[it->first] ;
+    }
+
+    static double dot(const std::vector<double>& a, const std::vector<double>& b)
+    {
+        double s = 0 ;
+        for (unsigned i=0; i<a.size(); ++i) s += a[i]*b[i] ;
+        return s ;
+    }
+
+    /// number of preconditioned conjugate gradient iterations to reduce the residual norm by 1e8,
+    /// with the multigrid V-cycle or with the Jacobi preconditioner
+    int pcgIterations(const Rows& rows, Matrix& M, bool useMultigrid)
+    {
+        const int n = (int)rows.size() ;
+        std::vector<double> b(n), x(n, 0.0), r, z(n), p, q ;
+        for (int i=0; i<n; ++i) b[i] = sin(0.1*i) + 0.5 ;
+        r = b ;
+        const double tol2 = 1e-16 * dot(b,b) ;
+
+        Vector vr(n), vz(n) ;
+        double rz = 0 ;
+        for (int it=0; it<1000; ++it)
+        {
+            if (dot(r,r) <= tol2) return it ;
+            if (useMultigrid)
+            {
+                for (int i=0; i<n; ++i) vr[i] = r[i] ;
+                multigrid->solve(M, vz, vr) ;
+                for (int i=0; i<n; ++i) z[i] = vz[i] ;
+            }
+            else
+                for (int i=0; i<n; ++i) z[i] = r[i] / rows[i].find(i)->second ;
+
+            const double rzOld = rz ;
+            rz = dot(r,z) ;
+            if (it == 0) p = z ;
+            else for (int i=0; i<n; ++i) p[i] = z[i] + rz/rzOld * p[i] ;
+            multiply(rows, p, q) ;
+            const double alpha = rz / dot(p,q) ;
+            for (int i=0; i<n; ++i) { x[i] += alpha*p[i] ; r[i] -= alpha*q[i] ; }
+        }
+        return 1000 ;
+    }
+};
+
+/// The prolongation interpolates the coarse grid, and the coarse operator is P^T A P
+TEST_F(SparseGridMultigridPreconditioner_test, galerkinCoarseOperator)
+{
+    EXPECT_MSG_NOEMIT(Error) ;
+    createScene(5) ;
+    ASSERT_GE(multigrid->grids.size(), 2u) ;
+    const SparseGridTopology* fineGrid = multigrid->grids[0] ;
+    const SparseGridTopology* coarseGrid = multigrid->grids[1] ;
+    const int nbFine = fineGrid->getNbPoints(), nbCoarse = coarseGrid->getNbPoints() ;
+    ASSERT_EQ(nbFine, 125) ;
+    ASSERT_EQ(nbCoarse, 27) ;
+
+    Rows rows ;
+    Matrix M ;
+    assembleSystem(rows, M) ;
+    multigrid->invert(M) ;
+    TestedMultigrid::InvertData* data = multigrid->getData(M) ;
+    ASSERT_EQ(data->bsize, (unsigned)bsize) ;
+    ASSERT_GE(data->levels.size(), 2u) ;
+    const TestedMultigrid::Transfer& t = data->transfers[0] ;
+    ASSERT_EQ((int)t.prolongBegin.size(), nbFine+1) ;
+
+    // dense point-wise prolongation, which reproduces constant and linear fields
+    std::vector< std::vector<double> > P(nbFine, std::vector<double>(nbCoarse, 0.0)) ;
+    for (int f=0; f<nbFine; ++f)
+    {
+        double sum = 0 ;
+        sofa::defaulttype::Vector3 interpolated ;
+        for (int k=t.prolongBegin[f]; k<t.prolongBegin[f+1]; ++k)
+        {
+            const int c = t.prolongIndex[k] ;
+            P[f][c] += t.prolongWeight[k] ;
+            sum += t.prolongWeight[k] ;
+            interpolated += sofa::defaulttype::Vector3(coarseGrid->getPX(c), coarseGrid->getPY(c), coarseGrid->getPZ(c)) * t.prolongWeight[k] ;
+        }
+        EXPECT_NEAR(sum, 1.0, 1e-10) << "fine point " << f ;
+        EXPECT_NEAR(interpolated[0], fineGrid->getPX(f), 1e-10) << "fine point " << f ;
+        EXPECT_NEAR(interpolated[1], fineGrid->getPY(f), 1e-10) << "fine point " << f ;
+        EXPECT_NEAR(interpolated[2], fineGrid->getPZ(f), 1e-10) << "fine point " << f ;
+    }
+
+    // R^T A P computed densely, compared with the coarse level
+    const int nc = nbCoarse*bsize ;
+    std::vector< std::vector<double> > AP(rows.size(), std::vector<double>(nc, 0.0)) ;
+    for (unsigned i=0; i<rows.size(); ++i)
+        for (std::map<int,double>::const_iterator it=rows[i].begin(); it!=rows[i].end(); ++it)
+            for (int c=0; c<nbCoarse; ++c)
+                AP[i][c*bsize + it->first%bsize] += it->second * P[it->first/bsize][c] ;
+
+    const TestedMultigrid::Level& coarse = data->levels[1] ;
+    ASSERT_EQ(coarse.size, nc) ;
+    std::vector< std::vector<double> > stored(nc, std::vector<double>(nc, 0.0)) ;
+    for (int i=0; i<nc; ++i)
+        for (int k=coarse.rowBegin[i]; k<coarse.rowBegin[i+1]; ++k)
+            stored[i][coarse.colsIndex[k]] += coarse.colsValue[k] ;
+    for (int i=0; i<nc; ++i)
+        for (int j=0; j<nc; ++j)
+        {
+            double expected = 0 ;
+            for (int f=0; f<nbFine; ++f)
+                expected += P[f][i/bsize] * AP[f*bsize + i%bsize][j] ;
+            EXPECT_NEAR(stored[i][j], expected, 1e-10) << "coarse entry " << i << " " << j ;
+        }
+}
+
+/// The number of multigrid-preconditioned iterations barely grows with the resolution, unlike Jacobi
+TEST_F(SparseGridMultigridPreconditioner_test, pcgIterationsUnderRefinement)
+{
+    EXPECT_MSG_NOEMIT(Error) ;
+    const int resolutions[3] = { 5, 9, 17 } ;
+    int multigridIterations[3], jacobiIterations[3] ;
+    for (int k=0; k<3; ++k)
+    {
+        createScene(resolutions[k]) ;
+        Rows rows ;
+        Matrix M ;
+        assembleSystem(rows, M) ;
+        multigrid->invert(M) ;
+        multigridIterations[k] = pcgIterations(rows, M, true) ;
+        jacobiIterations[k] = pcgIterations(rows, M, false) ;
+        EXPECT_LT(multigridIterations[k], 1000) << "resolution " << resolutions[k] ;
+        EXPECT_LT(jacobiIterations[k], 1000) << "resolution " << resolutions[k] ;
+    }
+
+    EXPECT_LT(multigridIterations[2], jacobiIterations[2]) ;
+    EXPECT_LT(multigridIterations[2]-multigridIterations[0], jacobiIterations[2]-jacobiIterations[0]) ;
+}
+
+}
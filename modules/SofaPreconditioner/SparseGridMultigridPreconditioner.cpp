@@ -0,0 +1,46 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2018 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#include <SofaPreconditioner/SparseGridMultigridPreconditioner.inl>
+#include <sofa/core/ObjectFactory.h>
+
+namespace sofa
+{
+
+namespace component
+{
+
+namespace linearsolver
+{
+
+SOFA_DECL_CLASS(SparseGridMultigridPreconditioner)
+
+int SparseGridMultigridPreconditionerClass = core::RegisterObject("Geometric multigrid preconditioner built on the SparseGridTopology hierarchy: trilinear prolongation between grid levels, Galerkin coarse operators and Jacobi or Gauss-Seidel smoothing. One V-cycle is applied per solve.")
+        .add< SparseGridMultigridPreconditioner< CompressedRowSparseMatrix<double>, FullVector<double> > >(true)
+        .addAlias("MultigridPreconditioner")
+        ;
+
+} // namespace linearsolver
+
+} // namespace component
+
+} // namespace sofa
+
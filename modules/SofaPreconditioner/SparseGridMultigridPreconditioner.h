@@ -0,0 +1,139 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2018 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#ifndef SOFA_COMPONENT_LINEARSOLVER_SPARSEGRIDMULTIGRIDPRECONDITIONER_H
+#define SOFA_COMPONENT_LINEARSOLVER_SPARSEGRIDMULTIGRIDPRECONDITIONER_H
+#include "config.h"
+
+#include <sofa/core/behavior/LinearSolver.h>
+#include <SofaBaseLinearSolver/MatrixLinearSolver.h>
+#include <SofaBaseLinearSolver/CompressedRowSparseMatrix.h>
+#include <SofaBaseLinearSolver/FullVector.h>
+#include <SofaBaseTopology/SparseGridTopology.h>
+#include <sofa/helper/OptionsGroup.h>
+#include <sofa/helper/vector.h>
+
+namespace sofa
+{
+
+namespace component
+{
+
+namespace linearsolver
+{
+
+/// Geometric multigrid preconditioner built on the SparseGridTopology hierarchy.
+///
+/// Each coarse level is a SparseGridTopology built from the finer one (reused
+/// if it already exists). The prolongation P is the trilinear interpolation
+/// stored in the coarse grid's hierarchical point map, restriction is P^T and
+/// coarse operators are obtained by Galerkin product A_c = P^T A P.
+/// solve() applies one symmetric V-cycle, so it can be used as the
+/// preconditioner of ShewchukPCGLinearSolver.
+template<class TMatrix, class TVector, class TThreadManager = NoThreadManager>
+class SparseGridMultigridPreconditioner : public sofa::component::linearsolver::MatrixLinearSolver<TMatrix,TVector,TThreadManager>
+{
+public:
+    SOFA_CLASS(SOFA_TEMPLATE3(SparseGridMultigridPreconditioner,TMatrix,TVector,TThreadManager),SOFA_TEMPLATE3(sofa::component::linearsolver::MatrixLinearSolver,TMatrix,TVector,TThreadManager));
+
+    typedef TMatrix Matrix;
+    typedef TVector Vector;
+    typedef typename Matrix::Index Index;
+    typedef TThreadManager ThreadManager;
+    typedef sofa::component::linearsolver::MatrixLinearSolver<TMatrix,TVector,TThreadManager> Inherit;
+    typedef sofa::component::topology::SparseGridTopology SparseGridTopology;
+
+    Data<bool> f_verbose; ///< Dump the hierarchy when it is (re)built
+    Data<unsigned> f_nbLevels; ///< Maximum number of levels, including the finest one
+    Data<unsigned> f_nbSmoothingSteps; ///< Number of pre- and post-smoothing steps on each level
+    Data<helper::OptionsGroup> f_smoother; ///< Smoother used on each level (Jacobi or GaussSeidel)
+    Data<double> f_damping; ///< Damping factor of the Jacobi smoother
+    Data<unsigned> f_maxCoarseSize; ///< Coarsest systems up to this size are solved with a dense Cholesky factorization (cubic cost), larger ones are smoothed
+
+protected:
+    SparseGridMultigridPreconditioner();
+public:
+    void bwdInit() override;
+    void solve (Matrix& M, Vector& x, Vector& b) override;
+    void invert(Matrix& M) override;
+
+    MatrixInvertData * createInvertData() override
+    {
+        return new SparseGridMultigridPreconditionerInvertData();
+    }
+
+protected :
+
+    /// Scalar compressed row storage used for every level of the hierarchy
+    struct Level
+    {
+        int size;
+        helper::vector<int> rowBegin;
+        helper::vector<int> colsIndex;
+        helper::vector<double> colsValue;
+        helper::vector<double> invDiag;
+        helper::vector<double> x, b, r;
+    };
+
+    /// Point-wise transfer between a level and the next coarser one,
+    /// stored both as prolongation rows (fine point -> coarse points) and
+    /// restriction rows (coarse point -> fine points)
+    struct Transfer
+    {
+        helper::vector<int> prolongBegin;
+        helper::vector<int> prolongIndex;
+        helper::vector<double> prolongWeight;
+        helper::vector<int> restrictBegin;
+        helper::vector<int> restrictIndex;
+        helper::vector<double> restrictWeight;
+    };
+
+    class SparseGridMultigridPreconditionerInvertData : public MatrixInvertData
+    {
+    public :
+        unsigned bsize;
+        helper::vector<Level> levels;
+        helper::vector<Transfer> transfers;
+        helper::vector<double> coarseFactor; ///< dense Cholesky factor of the coarsest level (empty if it is smoothed instead)
+    };
+
+    /// sparse grids of the hierarchy, from finest to coarsest
+    helper::vector<SparseGridTopology*> grids;
+    /// coarse grids created by this component
+    helper::vector<SparseGridTopology::SPtr> createdGrids;
+
+    void buildTransfer(const SparseGridTopology* coarse, int nbFinePoints, Transfer& t) const;
+    void galerkinProduct(const Level& fine, const Transfer& t, unsigned bsize, int nbCoarsePoints, Level& coarse) const;
+    void computeDiagonal(Level& level) const;
+    void factorCoarse(const Level& level, helper::vector<double>& factor) const;
+    void solveCoarse(const Level& level, const helper::vector<double>& factor, helper::vector<double>& x, const helper::vector<double>& b) const;
+    void residual(const Level& level, const helper::vector<double>& x, const helper::vector<double>& b, helper::vector<double>& r) const;
+    void smooth(Level& level, unsigned nbSteps, bool backward) const;
+    void vcycle(SparseGridMultigridPreconditionerInvertData* data, unsigned l) const;
+};
+
+} // namespace linearsolver
+
+} // namespace component
+
+} // namespace sofa
+
+#endif
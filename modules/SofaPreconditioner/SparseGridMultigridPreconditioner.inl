@@ -0,0 +1,461 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2018 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#ifndef SOFA_COMPONENT_LINEARSOLVER_SPARSEGRIDMULTIGRIDPRECONDITIONER_INL
+#define SOFA_COMPONENT_LINEARSOLVER_SPARSEGRIDMULTIGRIDPRECONDITIONER_INL
+#include <SofaPreconditioner/SparseGridMultigridPreconditioner.h>
+#include <sofa/core/objectmodel/BaseContext.h>
+#include <algorithm>
+#include <math.h>
+
+namespace sofa
+{
+
+namespace component
+{
+
+namespace linearsolver
+{
+
+template<class TMatrix, class TVector, class TThreadManager>
+SparseGridMultigridPreconditioner<TMatrix,TVector,TThreadManager>::SparseGridMultigridPreconditioner()
+    : f_verbose( initData(&f_verbose,false,"verbose","Dump the hierarchy when it is (re)built") )
+    , f_nbLevels( initData(&f_nbLevels,(unsigned)4,"nbLevels","Maximum number of levels, including the finest one") )
+    , f_nbSmoothingSteps( initData(&f_nbSmoothingSteps,(unsigned)2,"nbSmoothingSteps","Number of pre- and post-smoothing steps on each level") )
+    , f_smoother( initData(&f_smoother,helper::OptionsGroup(2,"Jacobi","GaussSeidel"),"smoother","Smoother used on each level (Jacobi or GaussSeidel)") )
+    , f_damping( initData(&f_damping,2.0/3.0,"damping","Damping factor of the Jacobi smoother") )
+    , f_maxCoarseSize( initData(&f_maxCoarseSize,(unsigned)500,"maxCoarseSize","Coarsest systems up to this size are solved with a dense Cholesky factorization (cubic cost), larger ones are smoothed") )
+{
+    f_smoother.beginEdit()->setSelectedItem(1);
+    f_smoother.endEdit();
+}
+
+template<class TMatrix, class TVector, class TThreadManager>
+void SparseGridMultigridPreconditioner<TMatrix,TVector,TThreadManager>::bwdInit()
+{
+    Inherit::bwdInit();
+
+    grids.clear();
+    createdGrids.clear();
+
+    SparseGridTopology* grid = NULL;
+    this->getContext()->get(grid);
+    if (grid == NULL)
+    {
+        serr << "No SparseGridTopology found, only the smoother will be applied" << sendl;
+        return;
+    }
+
+    grids.push_back(grid);
+    while (grids.size() < f_nbLevels.getValue())
+    {
+        SparseGridTopology* fine = grids.back();
+        if (fine->getNx() <= 2 && fine->getNy() <= 2 && fine->getNz() <= 2)
+            break;
+
+        SparseGridTopology* coarse = fine->getCoarserSparseGrid();
+        if (coarse == NULL)
+        {
+            SparseGridTopology::SPtr c = sofa::core::objectmodel::New< SparseGridTopology >(true);
+            this->addSlave(c);
+            c->setFinerSparseGrid(fine);
+            c->init();
+            createdGrids.push_back(c);
+            coarse = c.get();
+        }
+
+        if (coarse->getNbPoints() == 0 || coarse->getNbPoints() >= fine->getNbPoints())
+            break;
+        grids.push_back(coarse);
+    }
+
+    if (f_verbose.getValue())
+    {
+        sout << "Sparse grid hierarchy :";
+        for (unsigned l=0; l<grids.size(); ++l)
+            sout << " (" << grids[l]->getNx() << "x" << grids[l]->getNy() << "x" << grids[l]->getNz() << ") -> " << grids[l]->getNbPoints() << " points";
+        sout << sendl;
+    }
+}
+
+/// The coarse grid stores for each of its points the weights of the fine
+/// points it interpolates. The same data read column-wise gives the
+/// prolongation rows.
+template<class TMatrix, class TVector, class TThreadManager>
+void SparseGridMultigridPreconditioner<TMatrix,TVector,TThreadManager>::buildTransfer(const SparseGridTopology* coarse, int nbFinePoints, Transfer& t) const
+{
+    const SparseGridTopology::HierarchicalPointMap& pointMap = coarse->_hierarchicalPointMap;
+    const int nbCoarsePoints = (int)pointMap.size();
+
+    t.restrictBegin.resize(nbCoarsePoints+1);
+    t.restrictIndex.clear();
+    t.restrictWeight.clear();
+    t.prolongBegin.assign(nbFinePoints+1, 0);
+    t.restrictBegin[0] = 0;
+    for (int i=0; i<nbCoarsePoints; ++i)
+    {
+        for (SparseGridTopology::AHierarchicalPointMap::const_iterator it = pointMap[i].begin(); it != pointMap[i].end(); ++it)
+        {
+            if (it->first < 0 || it->first >= nbFinePoints) continue;
+            t.restrictIndex.push_back(it->first);
+            t.restrictWeight.push_back(it->second);
+            ++t.prolongBegin[it->first+1];
+        }
+        t.restrictBegin[i+1] = (int)t.restrictIndex.size();
+    }
+
+    for (int f=0; f<nbFinePoints; ++f)
+        t.prolongBegin[f+1] += t.prolongBegin[f];
+    t.prolongIndex.resize(t.restrictIndex.size());
+    t.prolongWeight.resize(t.restrictWeight.size());
+    helper::vector<int> pos(t.prolongBegin.begin(), t.prolongBegin.end()-1);
+    for (int i=0; i<nbCoarsePoints; ++i)
+    {
+        for (int k=t.restrictBegin[i]; k<t.restrictBegin[i+1]; ++k)
+        {
+            const int p = pos[t.restrictIndex[k]]++;
+            t.prolongIndex[p] = i;
+            t.prolongWeight[p] = t.restrictWeight[k];
+        }
+    }
+}
+
+/// A_c = P^T A P, one coarse row at a time with a sparse accumulator.
+/// P acts identically on the bsize components of each point.
+template<class TMatrix, class TVector, class TThreadManager>
+void SparseGridMultigridPreconditioner<TMatrix,TVector,TThreadManager>::galerkinProduct(const Level& fine, const Transfer& t, unsigned bsize, int nbCoarsePoints, Level& coarse) const
+{
+    const int nc = nbCoarsePoints*bsize;
+    coarse.size = nc;
+    coarse.rowBegin.resize(nc+1);
+    coarse.colsIndex.clear();
+    coarse.colsValue.clear();
+    coarse.rowBegin[0] = 0;
+
+    helper::vector<double> acc(nc, 0.0);
+    helper::vector<int> marker(nc, -1);
+    helper::vector<int> cols;
+
+    for (int ci=0; ci<nbCoarsePoints; ++ci)
+    {
+        for (unsigned d=0; d<bsize; ++d)
+        {
+            const int row = ci*bsize+d;
+            cols.clear();
+            for (int ri=t.restrictBegin[ci]; ri<t.restrictBegin[ci+1]; ++ri)
+            {
+                const int fineRow = t.restrictIndex[ri]*bsize+d;
+                const double w1 = t.restrictWeight[ri];
+                for (int k=fine.rowBegin[fineRow]; k<fine.rowBegin[fineRow+1]; ++k)
+                {
+                    const int fineCol = fine.colsIndex[k];
+                    const int g = fineCol / bsize;
+                    const int e = fineCol % bsize;
+                    const double a = w1 * fine.colsValue[k];
+                    for (int pj=t.prolongBegin[g]; pj<t.prolongBegin[g+1]; ++pj)
+                    {
+                        const int col = t.prolongIndex[pj]*bsize+e;
+                        if (marker[col] != row)
+                        {
+                            marker[col] = row;
+                            acc[col] = 0.0;
+                            cols.push_back(col);
+                        }
+                        acc[col] += a * t.prolongWeight[pj];
+                    }
+                }
+            }
+            std::sort(cols.begin(), cols.end());
+            for (unsigned k=0; k<cols.size(); ++k)
+            {
+                coarse.colsIndex.push_back(cols[k]);
+                coarse.colsValue.push_back(acc[cols[k]]);
+            }
+            coarse.rowBegin[row+1] = (int)coarse.colsIndex.size();
+        }
+    }
+}
+
+template<class TMatrix, class TVector, class TThreadManager>
+void SparseGridMultigridPreconditioner<TMatrix,TVector,TThreadManager>::computeDiagonal(Level& level) const
+{
+    level.invDiag.assign(level.size, 0.0);
+    for (int i=0; i<level.size; ++i)
+        for (int k=level.rowBegin[i]; k<level.rowBegin[i+1]; ++k)
+            if (level.colsIndex[k] == i && level.colsValue[k] != 0.0)
+                level.invDiag[i] = 1.0 / level.colsValue[k];
+    level.x.assign(level.size, 0.0);
+    level.b.assign(level.size, 0.0);
+    level.r.assign(level.size, 0.0);
+}
+
+/// In-place dense LL^T factorization; rows without a positive pivot (empty
+/// or unconstrained DOFs) are left out and get a zero solution.
+template<class TMatrix, class TVector, class TThreadManager>
+void SparseGridMultigridPreconditioner<TMatrix,TVector,TThreadManager>::factorCoarse(const Level& level, helper::vector<double>& factor) const
+{
+    const int n = level.size;
+    factor.assign((size_t)n*n, 0.0);
+    for (int i=0; i<n; ++i)
+        for (int k=level.rowBegin[i]; k<level.rowBegin[i+1]; ++k)
+            factor[(size_t)i*n+level.colsIndex[k]] = level.colsValue[k];
+
+    for (int j=0; j<n; ++j)
+    {
+        double* Lj = &factor[(size_t)j*n];
+        double d = Lj[j];
+        for (int k=0; k<j; ++k)
+            d -= Lj[k]*Lj[k];
+        if (d <= 0.0)
+        {
+            for (int k=0; k<=j; ++k) Lj[k] = 0.0;
+            for (int i=j+1; i<n; ++i) factor[(size_t)i*n+j] = 0.0;
+            continue;
+        }
+        Lj[j] = sqrt(d);
+        const double invLjj = 1.0 / Lj[j];
+        for (int i=j+1; i<n; ++i)
+        {
+            double* Li = &factor[(size_t)i*n];
+            double s = Li[j];
+            for (int k=0; k<j; ++k)
+                s -= Li[k]*Lj[k];
+            Li[j] = s * invLjj;
+        }
+    }
+}
+
+template<class TMatrix, class TVector, class TThreadManager>
+void SparseGridMultigridPreconditioner<TMatrix,TVector,TThreadManager>::solveCoarse(const Level& level, const helper::vector<double>& factor, helper::vector<double>& x, const helper::vector<double>& b) const
+{
+    const int n = level.size;
+    for (int i=0; i<n; ++i)
+    {
+        const double* Li = &factor[(size_t)i*n];
+        if (Li[i] == 0.0) { x[i] = 0.0; continue; }
+        double s = b[i];
+        for (int k=0; k<i; ++k)
+            s -= Li[k]*x[k];
+        x[i] = s / Li[i];
+    }
+    for (int i=n-1; i>=0; --i)
+    {
+        const double Lii = factor[(size_t)i*n+i];
+        if (Lii == 0.0) { x[i] = 0.0; continue; }
+        double s = x[i];
+        for (int k=i+1; k<n; ++k)
+            s -= factor[(size_t)k*n+i]*x[k];
+        x[i] = s / Lii;
+    }
+}
+
+template<class TMatrix, class TVector, class TThreadManager>
+void SparseGridMultigridPreconditioner<TMatrix,TVector,TThreadManager>::residual(const Level& level, const helper::vector<double>& x, const helper::vector<double>& b, helper::vector<double>& r) const
+{
+    for (int i=0; i<level.size; ++i)
+    {
+        double s = b[i];
+        for (int k=level.rowBegin[i]; k<level.rowBegin[i+1]; ++k)
+            s -= level.colsValue[k] * x[level.colsIndex[k]];
+        r[i] = s;
+    }
+}
+
+/// Damped Jacobi, or Gauss-Seidel sweeps. Post-smoothing sweeps backward so
+/// that the V-cycle stays symmetric, as required by the conjugate gradient.
+template<class TMatrix, class TVector, class TThreadManager>
+void SparseGridMultigridPreconditioner<TMatrix,TVector,TThreadManager>::smooth(Level& level, unsigned nbSteps, bool backward) const
+{
+    const int n = level.size;
+    helper::vector<double>& x = level.x;
+    const helper::vector<double>& b = level.b;
+    if (f_smoother.getValue().getSelectedId() == 0)
+    {
+        const double w = f_damping.getValue();
+        for (unsigned s=0; s<nbSteps; ++s)
+        {
+            residual(level, x, b, level.r);
+            for (int i=0; i<n; ++i)
+                x[i] += w * level.invDiag[i] * level.r[i];
+        }
+        return;
+    }
+
+    for (unsigned s=0; s<nbSteps; ++s)
+    {
+        for (int j=0; j<n; ++j)
+        {
+            const int i = backward ? n-1-j : j;
+            double t = b[i];
+            for (int k=level.rowBegin[i]; k<level.rowBegin[i+1]; ++k)
+                t -= level.colsValue[k] * x[level.colsIndex[k]];
+            x[i] += t * level.invDiag[i];
+        }
+    }
+}
+
+template<class TMatrix, class TVector, class TThreadManager>
+void SparseGridMultigridPreconditioner<TMatrix,TVector,TThreadManager>::vcycle(SparseGridMultigridPreconditionerInvertData* data, unsigned l) const
+{
+    Level& level = data->levels[l];
+    const unsigned nbSteps = f_nbSmoothingSteps.getValue();
+
+    if (l+1 == data->levels.size())
+    {
+        if (!data->coarseFactor.empty())
+            solveCoarse(level, data->coarseFactor, level.x, level.b);
+        else
+        {
+            std::fill(level.x.begin(), level.x.end(), 0.0);
+            smooth(level, nbSteps, false);
+            smooth(level, nbSteps, true);
+        }
+        return;
+    }
+
+    const unsigned bsize = data->bsize;
+    const Transfer& t = data->transfers[l];
+    Level& coarse = data->levels[l+1];
+
+    std::fill(level.x.begin(), level.x.end(), 0.0);
+    smooth(level, nbSteps, false);
+    residual(level, level.x, level.b, level.r);
+
+    const int nbCoarsePoints = (int)t.restrictBegin.size()-1;
+    for (int ci=0; ci<nbCoarsePoints; ++ci)
+        for (unsigned d=0; d<bsize; ++d)
+        {
+            double s = 0.0;
+            for (int k=t.restrictBegin[ci]; k<t.restrictBegin[ci+1]; ++k)
+                s += t.restrictWeight[k] * level.r[t.restrictIndex[k]*bsize+d];
+            coarse.b[ci*bsize+d] = s;
+        }
+
+    vcycle(data, l+1);
+
+    const int nbFinePoints = (int)t.prolongBegin.size()-1;
+    for (int f=0; f<nbFinePoints; ++f)
+        for (unsigned d=0; d<bsize; ++d)
+        {
+            double s = 0.0;
+            for (int k=t.prolongBegin[f]; k<t.prolongBegin[f+1]; ++k)
+                s += t.prolongWeight[k] * coarse.x[t.prolongIndex[k]*bsize+d];
+            level.x[f*bsize+d] += s;
+        }
+
+    smooth(level, nbSteps, true);
+}
+
+template<class TMatrix, class TVector, class TThreadManager>
+void SparseGridMultigridPreconditioner<TMatrix,TVector,TThreadManager>::invert(Matrix& M)
+{
+    SparseGridMultigridPreconditionerInvertData * data = (SparseGridMultigridPreconditionerInvertData *) this->getMatrixInvertData(&M);
+
+    M.compress();
+    const int n = M.rowSize();
+
+    data->levels.clear();
+    data->transfers.clear();
+    data->coarseFactor.clear();
+    data->bsize = 0;
+
+    // finest level: copy of the system matrix, with empty rows made explicit
+    data->levels.resize(1);
+    Level& fine = data->levels[0];
+    {
+        const typename Matrix::VecIndex& rowIndex = M.getRowIndex();
+        const typename Matrix::VecIndex& rowBegin = M.getRowBegin();
+        const typename Matrix::VecIndex& colsIndex = M.getColsIndex();
+        const typename Matrix::VecBloc& colsValue = M.getColsValue();
+        fine.size = n;
+        fine.rowBegin.assign(n+1, 0);
+        for (unsigned xi=0; xi<rowIndex.size(); ++xi)
+            fine.rowBegin[rowIndex[xi]+1] = rowBegin[xi+1] - rowBegin[xi];
+        for (int i=0; i<n; ++i)
+            fine.rowBegin[i+1] += fine.rowBegin[i];
+        fine.colsIndex.resize(colsIndex.size());
+        fine.colsValue.resize(colsValue.size());
+        for (unsigned k=0; k<colsIndex.size(); ++k)
+        {
+            fine.colsIndex[k] = colsIndex[k];
+            fine.colsValue[k] = colsValue[k];
+        }
+    }
+
+    if (!grids.empty())
+    {
+        const int nbPoints = grids[0]->getNbPoints();
+        if (nbPoints > 0 && n > 0 && n % nbPoints == 0)
+            data->bsize = n / nbPoints;
+        else
+            serr << "System size " << n << " does not match the " << nbPoints << " points of the sparse grid, only the smoother will be applied" << sendl;
+    }
+
+    if (data->bsize > 0)
+    {
+        const unsigned nbLevels = std::min((unsigned)grids.size(), std::max(f_nbLevels.getValue(), (unsigned)1));
+        data->levels.resize(nbLevels);
+        data->transfers.resize(nbLevels-1);
+        for (unsigned l=1; l<nbLevels; ++l)
+        {
+            buildTransfer(grids[l], grids[l-1]->getNbPoints(), data->transfers[l-1]);
+            galerkinProduct(data->levels[l-1], data->transfers[l-1], data->bsize, grids[l]->getNbPoints(), data->levels[l]);
+        }
+    }
+
+    for (unsigned l=0; l<data->levels.size(); ++l)
+        computeDiagonal(data->levels[l]);
+
+    // without a hierarchy the "coarsest" level is the system itself, keep smoothing it
+    if (data->levels.size() > 1 && (unsigned)data->levels.back().size <= f_maxCoarseSize.getValue())
+        factorCoarse(data->levels.back(), data->coarseFactor);
+
+    if (f_verbose.getValue())
+    {
+        sout << "Multigrid levels :";
+        for (unsigned l=0; l<data->levels.size(); ++l)
+            sout << " " << data->levels[l].size << " (" << data->levels[l].colsValue.size() << " nnz)";
+        sout << (data->coarseFactor.empty() ? ", smoothed coarse level" : ", direct coarse solve") << sendl;
+    }
+}
+
+template<class TMatrix, class TVector, class TThreadManager>
+void SparseGridMultigridPreconditioner<TMatrix,TVector,TThreadManager>::solve (Matrix& M, Vector& z, Vector& r)
+{
+    SparseGridMultigridPreconditionerInvertData * data = (SparseGridMultigridPreconditionerInvertData *) this->getMatrixInvertData(&M);
+
+    Level& fine = data->levels[0];
+    for (int i=0; i<fine.size; ++i)
+        fine.b[i] = r[i];
+
+    vcycle(data, 0);
+
+    for (int i=0; i<fine.size; ++i)
+        z[i] = fine.x[i];
+}
+
+} // namespace linearsolver
+
+} // namespace component
+
+} // namespace sofa
+
+#endif
@@ -43,6 +43,7 @@ SOFA_LINK_CLASS(ShewchukPCGLinearSolver)
 SOFA_LINK_CLASS(JacobiPreconditioner)
 SOFA_LINK_CLASS(BlockJacobiPreconditioner)
 SOFA_LINK_CLASS(SSORPreconditioner)
+SOFA_LINK_CLASS(SparseGridMultigridPreconditioner)
 SOFA_LINK_CLASS(WarpPreconditioner)
 SOFA_LINK_CLASS(PrecomputedWarpPreconditioner)
 
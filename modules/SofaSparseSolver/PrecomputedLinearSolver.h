@@ -28,6 +28,7 @@
 #include <sofa/simulation/MechanicalVisitor.h>
 #include <SofaBaseLinearSolver/SparseMatrix.h>
 #include <SofaBaseLinearSolver/FullMatrix.h>
+#include <SofaBaseLinearSolver/BlockCompressedMatrix.h>
 #include <sofa/helper/map.h>
 #include <math.h>
 #include <SofaBaseLinearSolver/CompressedRowSparseMatrix.h>
@@ -49,11 +50,22 @@ public :
     typedef typename TMatrix::Real Real;
     typedef FullMatrix<Real> TBaseMatrix ;
 
+    /// Storage of the inverse: full row-major matrix, or tiles (possibly compressed) in Real or float precision
+    enum { FULL_STORAGE = 0, BLOCK_STORAGE, FLOAT_BLOCK_STORAGE };
+
     FullMatrix<Real> JMinv;
     FullMatrix<Real> Minv;
+    BlockCompressedMatrix<Real> MinvBlock;
+    BlockCompressedMatrix<float> MinvFloat;
+    int storage;
     std::vector<int> idActiveDofs;
     std::vector<int> invActiveDofs;
 
+    PrecomputedLinearSolverInternalData()
+        : storage(FULL_STORAGE)
+    {
+    }
+
     bool readFile(const char * filename,unsigned systemSize)
     {
         std::ifstream compFileIn(filename, std::ifstream::binary);
@@ -61,9 +73,12 @@ public :
         if(compFileIn.good())
         {
             msg_info("PrecomputedLInearSolverInternalData") << "file '" << filename << "' with compliance being loaded." ;
-            compFileIn.read((char*) Minv[0], systemSize * systemSize * sizeof(Real));
+            bool ok = true;
+            if (storage == FULL_STORAGE) compFileIn.read((char*) Minv[0], systemSize * systemSize * sizeof(Real));
+            else if (storage == BLOCK_STORAGE) ok = MinvBlock.read(compFileIn, systemSize, systemSize);
+            else ok = MinvFloat.read(compFileIn, systemSize, systemSize);
             compFileIn.close();
-            return true;
+            return ok;
         }
         return false;
     }
@@ -71,9 +86,66 @@ public :
     void writeFile(const char * filename,unsigned systemSize)
     {
         std::ofstream compFileOut(filename, std::fstream::out | std::fstream::binary);
-        compFileOut.write((char*) Minv[0], systemSize * systemSize*sizeof(Real));
+        if (storage == FULL_STORAGE) compFileOut.write((char*) Minv[0], systemSize * systemSize*sizeof(Real));
+        else if (storage == BLOCK_STORAGE) MinvBlock.write(compFileOut);
+        else MinvFloat.write(compFileOut);
         compFileOut.close();
     }
+
+    /// Start filling the inverse row by row
+    void beginRows(unsigned systemSize, unsigned blockSize, double tolerance)
+    {
+        if (storage == FULL_STORAGE) Minv.resize(systemSize,systemSize);
+        else if (storage == BLOCK_STORAGE) MinvBlock.beginRows(systemSize, systemSize, blockSize, tolerance);
+        else MinvFloat.beginRows(systemSize, systemSize, blockSize, tolerance);
+    }
+
+    template<class T>
+    void setRow(unsigned i, const T* values, double scale)
+    {
+        if (storage == FULL_STORAGE)
+        {
+            Real* row = Minv[i];
+            for (unsigned j=0; j<(unsigned)Minv.colSize(); j++) row[j] = (Real)(values[j] * scale);
+        }
+        else if (storage == BLOCK_STORAGE) MinvBlock.setRow(i, values, scale);
+        else MinvFloat.setRow(i, values, scale);
+    }
+
+    void endRows()
+    {
+        if (storage == BLOCK_STORAGE) MinvBlock.endRows();
+        else if (storage == FLOAT_BLOCK_STORAGE) MinvFloat.endRows();
+    }
+
+    /// z = Minv * r
+    template<class V>
+    void mul(V& z, const V& r)
+    {
+        if (storage == FULL_STORAGE) z = Minv * r;
+        else if (storage == BLOCK_STORAGE) MinvBlock.mul(z, r);
+        else MinvFloat.mul(z, r);
+    }
+
+    /// out[c] += factor * Minv(i,cols[c])
+    void addRowTimes(unsigned i, Real factor, const std::vector<int>& cols, Real* out) const
+    {
+        if (storage == FULL_STORAGE)
+        {
+            const Real* row = Minv[i];
+            for (unsigned c=0; c<cols.size(); c++) out[c] += factor * row[cols[c]];
+        }
+        else if (storage == BLOCK_STORAGE) MinvBlock.addRowTimes(i, factor, cols, out);
+        else MinvFloat.addRowTimes(i, factor, cols, out);
+    }
+
+    /// Memory used by the inverse, in bytes
+    std::size_t memorySize() const
+    {
+        if (storage == FULL_STORAGE) return (std::size_t)Minv.rowSize() * Minv.colSize() * sizeof(Real);
+        else if (storage == BLOCK_STORAGE) return MinvBlock.memorySize();
+        else return MinvFloat.memorySize();
+    }
 };
 
 /// Linear system solver based on a precomputed inverse matrix
@@ -90,6 +162,9 @@ public:
     Data<bool> jmjt_twostep; ///< Use two step algorithm to compute JMinvJt
     Data<bool> f_verbose; ///< Dump system state at each iteration
     Data<bool> use_file; ///< Dump system matrix in a file
+    Data<bool> float_storage; ///< Store the inverse in single precision
+    Data<unsigned> block_size; ///< Size of the square tiles used to store the inverse (0 = full row-major matrix)
+    Data<double> compression_tolerance; ///< Relative error bound of the low-rank approximation of each tile (0 = no compression)
     Data<int> init_MaxIter;
     Data<double> init_Tolerance;
     Data<double> init_Threshold;
@@ -123,9 +198,10 @@ public:
         return TVector::Name();
     }
 
+    /// Returns NULL when the inverse is not stored as a full matrix (see block_size)
     TBaseMatrix * getSystemMatrixInv()
     {
-        return &internalData.Minv;
+        return (internalData.storage == internalData.FULL_STORAGE) ? &internalData.Minv : NULL;
     }
 
 protected :
@@ -64,6 +64,9 @@ PrecomputedLinearSolver<TMatrix,TVector>::PrecomputedLinearSolver()
     : jmjt_twostep( initData(&jmjt_twostep,true,"jmjt_twostep","Use two step algorithm to compute JMinvJt") )
     , f_verbose( initData(&f_verbose,false,"verbose","Dump system state at each iteration") )
     , use_file( initData(&use_file,true,"use_file","Dump system matrix in a file") )
+    , float_storage( initData(&float_storage,false,"float_storage","Store the inverse in single precision (implies a tiled storage)") )
+    , block_size( initData(&block_size,(unsigned)0,"block_size","Size of the square tiles used to store the inverse (0 = full row-major matrix, or 64 if float_storage or compression_tolerance is set)") )
+    , compression_tolerance( initData(&compression_tolerance,0.0,"compression_tolerance","Relative error bound (Frobenius norm) of the low-rank approximation of each tile of the inverse (0 = no compression)") )
 {
     first = true;
 }
@@ -84,14 +87,13 @@ void PrecomputedLinearSolver<TMatrix,TVector>::setSystemMBKMatrix(const core::Me
 template<class TMatrix,class TVector>
 void PrecomputedLinearSolver<TMatrix,TVector>::solve (TMatrix& , TVector& z, TVector& r)
 {
-    z = internalData.Minv * r;
+    internalData.mul(z, r);
 }
 
 template<class TMatrix,class TVector>
 void PrecomputedLinearSolver<TMatrix,TVector >::loadMatrix(TMatrix& M)
 {
     systemSize = this->currentGroup->systemMatrix->rowSize();
-    internalData.Minv.resize(systemSize,systemSize);
     dt = this->getContext()->getDt();
 
     odesolver::EulerImplicitSolver* EulerSolver;
@@ -99,25 +101,45 @@ void PrecomputedLinearSolver<TMatrix,TVector >::loadMatrix(TMatrix& M)
     factInt = 1.0; // christian : it is not a compliance... but an admittance that is computed !
     if (EulerSolver) factInt = EulerSolver->getPositionIntegrationFactor(); // here, we compute a compliance
 
+    const double tolerance = std::max(compression_tolerance.getValue(), 0.0);
+    unsigned blockSize = block_size.getValue();
+    if (blockSize == 0 && (float_storage.getValue() || tolerance > 0)) blockSize = 64;
+
+    if (float_storage.getValue()) internalData.storage = internalData.FLOAT_BLOCK_STORAGE;
+    else if (blockSize > 0) internalData.storage = internalData.BLOCK_STORAGE;
+    else internalData.storage = internalData.FULL_STORAGE;
+
     std::stringstream ss;
-    ss << this->getContext()->getName() << "-" << systemSize << "-" << dt << ".comp";
+    ss << this->getContext()->getName() << "-" << systemSize << "-" << dt;
+    if (internalData.storage == internalData.FULL_STORAGE) ss << ".comp";
+    else ss << "-" << blockSize << "-" << tolerance << ((internalData.storage == internalData.FLOAT_BLOCK_STORAGE) ? ".compbf" : ".compb");
+
+    if (internalData.storage == internalData.FULL_STORAGE) internalData.Minv.resize(systemSize,systemSize);
+
     if(! use_file.getValue() || ! internalData.readFile(ss.str().c_str(),systemSize) )
     {
 #ifdef SOFA_HAVE_CSPARSE
+        internalData.beginRows(systemSize, blockSize, tolerance);
         loadMatrixWithCSparse(M);
+        internalData.endRows();
         if (use_file.getValue()) internalData.writeFile(ss.str().c_str(),systemSize);
 #else
         serr << "CSPARSE support is required to invert the matrix" << sendl;
 #endif
     }
 
-    for (unsigned int j=0; j<systemSize; j++)
+    if (internalData.storage == internalData.FULL_STORAGE)
     {
-        for (unsigned i=0; i<systemSize; i++)
+        for (unsigned int j=0; j<systemSize; j++)
         {
-            internalData.Minv.set(j,i,internalData.Minv.element(j,i)/factInt);
+            for (unsigned i=0; i<systemSize; i++)
+            {
+                internalData.Minv.set(j,i,internalData.Minv.element(j,i)/factInt);
+            }
         }
     }
+
+    msg_info() << "Inverse stored in " << internalData.memorySize() / (1024*1024) << " MB";
 }
 
 #ifdef SOFA_HAVE_CSPARSE
@@ -160,10 +182,8 @@ void PrecomputedLinearSolver<TMatrix,TVector>::loadMatrixWithCSparse(TMatrix& M)
         b.set(j,1.0);
 
         solver.solve(matSolv,r,b);
-        for (unsigned int i=0; i<systemSize; i++)
-        {
-            internalData.Minv.set(j,i,r.element(i) * factInt);
-        }
+        // the full matrix is stored scaled by factInt, as in the file, the tiled storages directly keep the inverse
+        internalData.setRow(j, r.ptr(), (internalData.storage == internalData.FULL_STORAGE) ? factInt : 1.0);
     }
     msg_info("PrecomputedLinearSolver") << "Precomputing constraint correction : " << std::fixed << 100.0f << " %   " << '\xd';
 
@@ -236,18 +256,14 @@ void PrecomputedLinearSolver<TMatrix,TVector>::ComputeResult(defaulttype::BaseMa
     internalData.JMinv.clear();
     internalData.JMinv.resize(J.rowSize(),internalData.idActiveDofs.size());
 
+    // rows of Minv are read contiguously, one per non-zero of J
     nl=0;
     for (typename JMatrix::LineConstIterator jit1 = J.begin(); jit1 != J.end(); jit1++)
     {
-        for (unsigned c = 0; c<internalData.idActiveDofs.size(); c++)
+        Real* line = internalData.JMinv[nl];
+        for (typename JMatrix::LElementConstIterator i1 = jit1->second.begin(); i1 != jit1->second.end(); i1++)
         {
-            int col = internalData.idActiveDofs[c];
-            Real v = 0.0;
-            for (typename JMatrix::LElementConstIterator i1 = jit1->second.begin(); i1 != jit1->second.end(); i1++)
-            {
-                v += internalData.Minv.element(i1->first,col) * i1->second;
-            }
-            internalData.JMinv.set(nl,c,v);
+            internalData.addRowTimes(i1->first, (Real)i1->second, internalData.idActiveDofs, line);
         }
         nl++;
     }
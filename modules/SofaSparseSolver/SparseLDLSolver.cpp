@@ -22,6 +22,7 @@
 // Author: Hadrien Courtecuisse
 #define SOFA_COMPONENT_LINEARSOLVER_SPARSELDLSOLVER_CPP
 #include <SofaSparseSolver/SparseLDLSolver.inl>
+#include <SofaBaseLinearSolver/AsyncMatrixLinearSolver.inl>
 #include <sofa/core/ObjectFactory.h>
 
 namespace sofa
@@ -40,12 +41,16 @@ int SparseLDLSolverClass = core::RegisterObject("Direct linear solver based on S
         .add< SparseLDLSolver< CompressedRowSparseMatrix<defaulttype::Mat<3,3,double> >,FullVector<double> > >(true)
         .add< SparseLDLSolver< CompressedRowSparseMatrix<float>,FullVector<float> > >(true)
         .add< SparseLDLSolver< CompressedRowSparseMatrix<defaulttype::Mat<3,3,float> >,FullVector<float> > >(true)
+        .add< SparseLDLSolver< CompressedRowSparseMatrix<double>,FullVector<double>,AsyncThreadManager > >()
+        .add< SparseLDLSolver< CompressedRowSparseMatrix<defaulttype::Mat<3,3,double> >,FullVector<double>,AsyncThreadManager > >()
         ;
 
 template class SOFA_SPARSE_SOLVER_API SparseLDLSolver< CompressedRowSparseMatrix<double>,FullVector<double> >;
 template class SOFA_SPARSE_SOLVER_API SparseLDLSolver< CompressedRowSparseMatrix< defaulttype::Mat<3,3,double> >,FullVector<double> >;
 template class SOFA_SPARSE_SOLVER_API SparseLDLSolver< CompressedRowSparseMatrix<float>,FullVector<float> >;
 template class SOFA_SPARSE_SOLVER_API SparseLDLSolver< CompressedRowSparseMatrix< defaulttype::Mat<3,3,float> >,FullVector<float> >;
+template class SOFA_SPARSE_SOLVER_API SparseLDLSolver< CompressedRowSparseMatrix<double>,FullVector<double>,AsyncThreadManager >;
+template class SOFA_SPARSE_SOLVER_API SparseLDLSolver< CompressedRowSparseMatrix< defaulttype::Mat<3,3,double> >,FullVector<double>,AsyncThreadManager >;
 
 } // namespace linearsolver
 
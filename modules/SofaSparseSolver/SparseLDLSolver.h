@@ -31,6 +31,7 @@
 #include <sofa/helper/map.h>
 #include <math.h>
 #include <SofaSparseSolver/SparseLDLSolverImpl.h>
+#include <SofaBaseLinearSolver/AsyncMatrixLinearSolver.h>
 #include <sofa/defaulttype/BaseMatrix.h>
 
 namespace sofa
@@ -81,6 +82,8 @@ extern template class SOFA_SPARSE_SOLVER_API SparseLDLSolver< CompressedRowSpars
 extern template class SOFA_SPARSE_SOLVER_API SparseLDLSolver< CompressedRowSparseMatrix< defaulttype::Mat<3,3,double> >,FullVector<double> >;
 extern template class SOFA_SPARSE_SOLVER_API SparseLDLSolver< CompressedRowSparseMatrix< float>,FullVector<float> >;
 extern template class SOFA_SPARSE_SOLVER_API SparseLDLSolver< CompressedRowSparseMatrix< defaulttype::Mat<3,3,float> >,FullVector<float> >;
+extern template class SOFA_SPARSE_SOLVER_API SparseLDLSolver< CompressedRowSparseMatrix<double>,FullVector<double>,AsyncThreadManager >;
+extern template class SOFA_SPARSE_SOLVER_API SparseLDLSolver< CompressedRowSparseMatrix< defaulttype::Mat<3,3,double> >,FullVector<double>,AsyncThreadManager >;
 #endif
 
 
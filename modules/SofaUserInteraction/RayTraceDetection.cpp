@@ -129,31 +129,24 @@ void RayTraceDetection::findPairsVolume (CubeModel * cm1, CubeModel * cm2)
     const Vector3 & maxVect2 = cube2.maxVect ();
     int size = tm1->getSize ();
 
+    /* collect the rays to trace: for each point of tm1 inside the bounding box of tm2, follow the opposite of its normal */
+    helper::vector<int> rayTriangle;
+    helper::vector<int> rayPoint;
+    helper::vector<Vector3> rayOrigin;
+    helper::vector<Vector3> rayDirection;
+
     for (int j = 0; j < size; j++)
     {
-
         /*creates a Triangle for each object being tested */
         Triangle tri1 (tm1, j);
 
-
-        /*cosAngle will store the angle between the triangle from t1 and his corresponding in t2 */
-        double cosAngle;
-        /*cosAngle will store the angle between the triangle from t1 and another triangle on t1 that is crossed by the -normal of tri1*/
-        double cosAngle2;
-        /*resTriangle and resTriangle2 will store the triangle result from the trace method */
-        int resTriangle = -1;
-        int resTriangle2 = -1;
-        Vector3 trianglePoints[4];
-        //bool found = false;
         int nPoints = 0;
+        Vector3 trianglePoints[3];
         Vector3 normau[3];
-        /*if it fails to find a correspondence between the triangles it tries the raytracing procedure */
-        /*test if this triangle was tested before */
 
-        /*set the triangle as tested */
+        /*test only the points related to this triangle */
         int flags = tri1.flags();
 
-        /*test only the points related to this triangle */
         if (flags & TriangleModel::FLAG_P1)
         {
             normau[nPoints] = tm1->pNorms[tri1.p1Index ()];
@@ -173,8 +166,7 @@ void RayTraceDetection::findPairsVolume (CubeModel * cm1, CubeModel * cm2)
 
         for (int t = 0; t < nPoints; t++)
         {
-
-            Vector3 point = trianglePoints[t];
+            const Vector3& point = trianglePoints[t];
 
             if ((point[0] < (minVect2[0]))
                 || (point[0] > maxVect2[0] )
@@ -183,65 +175,81 @@ void RayTraceDetection::findPairsVolume (CubeModel * cm1, CubeModel * cm2)
                 || (point[2] < minVect2[2] )
                 || (point[2] > maxVect2[2] ))
                 continue;
-            /*res and res2 will store the point of intercection and the distance from the point */
-            TriangleOctree::traceResult res, res2;
-            /*search a triangle on t2 */
-            resTriangle =
-                tm2->octreeRoot->
-                trace (point /*+ normau[t] * (contactDistance / 2) */ ,
-                        -normau[t], res);
-            if (resTriangle == -1)
-                continue;
-            Triangle triang2 (tm2, resTriangle);
-            cosAngle = dot (tri1.n (), triang2.n ());
-            if (cosAngle > 0)
-                continue;
-            /*search a triangle on t1, to be sure that the triangle found on t2 isn't outside the t1 object */
-
-            /*if there is no triangle in t1  that is crossed by the tri1 normal (resTriangle2==-1), it means that t1 is not an object with a closed volume, so we can't continue.
-              If the distance from the  point to the triangle on t1 is less than the distance to the triangle on t2 it means that the corresponding point is outside t1, and is not a good point */
-            resTriangle2 =
-                tm1->octreeRoot->trace (point, -normau[t], res2);
-
 
+            rayTriangle.push_back(j);
+            rayPoint.push_back(t);
+            rayOrigin.push_back(point /*+ normau[t] * (contactDistance / 2) */);
+            rayDirection.push_back(-normau[t]);
+        }
+    }
 
-            if (resTriangle2 == -1 || res2.t < res.t)
-            {
+    /*res will store the point of intercection and the distance from the point, all the rays are traced at once on t2 */
+    helper::vector<TriangleOctree::traceResult> res;
+    tm2->traceBatch(rayOrigin, rayDirection, res);
 
-                continue;
-            }
+    /*keep the rays that found a triangle on t2 facing the triangle of t1 */
+    helper::vector<unsigned int> candidates;
+    helper::vector<Vector3> candidateOrigin;
+    helper::vector<Vector3> candidateDirection;
+    for (unsigned int r = 0; r < res.size(); r++)
+    {
+        if (res[r].tid == -1)
+            continue;
+        Triangle tri1 (tm1, rayTriangle[r]);
+        Triangle triang2 (tm2, res[r].tid);
+        /*cosAngle will store the angle between the triangle from t1 and his corresponding in t2 */
+        double cosAngle = dot (tri1.n (), triang2.n ());
+        if (cosAngle > 0)
+            continue;
+        candidates.push_back(r);
+        candidateOrigin.push_back(rayOrigin[r]);
+        candidateDirection.push_back(rayDirection[r]);
+    }
 
+    /*search a triangle on t1, to be sure that the triangle found on t2 isn't outside the t1 object */
+    helper::vector<TriangleOctree::traceResult> res2;
+    tm1->traceBatch(candidateOrigin, candidateDirection, res2);
 
-            Triangle tri3 (tm1, resTriangle2);
-            cosAngle2 = dot (tri1.n (), tri3.n ());
-            if (cosAngle2 > 0)
-                continue;
+    for (unsigned int c = 0; c < candidates.size(); c++)
+    {
+        const unsigned int r = candidates[c];
 
-            Vector3 Q =
-                (triang2.p1 () * (1.0 - res.u - res.v)) +
-                (triang2.p2 () * res.u) + (triang2.p3 () * res.v);
+        /*if there is no triangle in t1  that is crossed by the tri1 normal (resTriangle2==-1), it means that t1 is not an object with a closed volume, so we can't continue.
+          If the distance from the  point to the triangle on t1 is less than the distance to the triangle on t2 it means that the corresponding point is outside t1, and is not a good point */
+        if (res2[c].tid == -1 || res2[c].t < res[r].t)
+        {
+            continue;
+        }
 
-            outputs->resize (outputs->size () + 1);
-            DetectionOutput *detection = &*(outputs->end () - 1);
+        Triangle tri1 (tm1, rayTriangle[r]);
+        Triangle triang2 (tm2, res[r].tid);
+        Triangle tri3 (tm1, res2[c].tid);
+        /*cosAngle2 will store the angle between the triangle from t1 and another triangle on t1 that is crossed by the -normal of tri1*/
+        double cosAngle2 = dot (tri1.n (), tri3.n ());
+        if (cosAngle2 > 0)
+            continue;
 
+        Vector3 Q =
+            (triang2.p1 () * (1.0 - res[r].u - res[r].v)) +
+            (triang2.p2 () * res[r].u) + (triang2.p3 () * res[r].v);
 
-            detection->elem =
-                std::pair <
-                core::CollisionElementIterator,
-                core::CollisionElementIterator > (tri1, triang2);
-            detection->point[0] = point;
+        outputs->resize (outputs->size () + 1);
+        DetectionOutput *detection = &*(outputs->end () - 1);
 
-            detection->point[1] = Q;
 
-            detection->normal = normau[t];
+        detection->elem =
+            std::pair <
+            core::CollisionElementIterator,
+            core::CollisionElementIterator > (tri1, triang2);
+        detection->point[0] = rayOrigin[r];
 
-            detection->value = -(res.t);
+        detection->point[1] = Q;
 
-            detection->id = tri1.getIndex()*3+t;
-            //found = true;
+        detection->normal = -rayDirection[r];
 
-        }
+        detection->value = -(res[r].t);
 
+        detection->id = tri1.getIndex()*3+rayPoint[r];
     }
 
 }